@@ -0,0 +1,121 @@
+/* Fork latency benchmark
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <yaosp/region.h>
+
+/* The benchmark measures how long fork() takes in the parent with a
+   heap of different sizes. The heap is a lazy region that is touched
+   page by page before the measurement. The pages are only read, so
+   they are all mapped to the zero page and even the largest heap
+   needs memory only for its page tables. */
+
+#define ROUNDS 32
+
+static uint64_t get_time( void ) {
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+
+    return ( uint64_t )tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int run_benchmark( uint32_t heap_size ) {
+    int i;
+    pid_t pid;
+    uint32_t offset;
+    void* address;
+    uint64_t start;
+    uint64_t fork_time;
+    uint64_t total_time;
+    region_id region;
+    volatile uint8_t* heap;
+
+    region = memory_region_create(
+        "forkbench", heap_size,
+        REGION_READ | REGION_WRITE | REGION_LAZY, &address
+    );
+
+    if ( region < 0 ) {
+        fprintf( stderr, "forkbench: failed to create %u MB heap\n", heap_size / ( 1024 * 1024 ) );
+        return -1;
+    }
+
+    if ( memory_region_alloc_pages( region ) != 0 ) {
+        fprintf( stderr, "forkbench: failed to allocate %u MB heap\n", heap_size / ( 1024 * 1024 ) );
+        memory_region_delete( region );
+        return -1;
+    }
+
+    heap = ( volatile uint8_t* )address;
+
+    for ( offset = 0; offset < heap_size; offset += PAGE_SIZE ) {
+        ( void )heap[ offset ];
+    }
+
+    fork_time = 0;
+    total_time = 0;
+
+    for ( i = 0; i < ROUNDS; i++ ) {
+        start = get_time();
+
+        pid = fork();
+
+        if ( pid == 0 ) {
+            _exit( 0 );
+        }
+
+        fork_time += get_time() - start;
+
+        if ( pid < 0 ) {
+            fprintf( stderr, "forkbench: fork failed\n" );
+            memory_region_delete( region );
+            return -1;
+        }
+
+        waitpid( pid, NULL, 0 );
+
+        total_time += get_time() - start;
+    }
+
+    printf(
+        "%4u MB heap: fork %u us, fork+exit+wait %u us\n",
+        heap_size / ( 1024 * 1024 ),
+        ( uint32_t )( fork_time / ROUNDS ),
+        ( uint32_t )( total_time / ROUNDS )
+    );
+
+    memory_region_delete( region );
+
+    return 0;
+}
+
+int main( int argc, char** argv ) {
+    if ( ( run_benchmark( 1 * 1024 * 1024 ) != 0 ) ||
+         ( run_benchmark( 64 * 1024 * 1024 ) != 0 ) ||
+         ( run_benchmark( 512 * 1024 * 1024 ) != 0 ) ) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
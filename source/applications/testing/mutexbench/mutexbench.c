@@ -0,0 +1,100 @@
+/* pthread mutex benchmark
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+/* The benchmark measures the cost of a lock/unlock pair of a pthread
+   mutex without contention, then the time two threads need to increase
+   a shared counter protected by a mutex. */
+
+#define ROUNDS 1000000
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile int counter = 0;
+static volatile int finished = 0;
+
+static uint64_t get_time( void ) {
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+
+    return ( uint64_t )tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void* counter_thread( void* arg ) {
+    int i;
+
+    for ( i = 0; i < ROUNDS; i++ ) {
+        pthread_mutex_lock( &mutex );
+        counter++;
+        pthread_mutex_unlock( &mutex );
+    }
+
+    pthread_mutex_lock( &mutex );
+    finished++;
+    pthread_mutex_unlock( &mutex );
+
+    return NULL;
+}
+
+int main( int argc, char** argv ) {
+    int i;
+    uint64_t start;
+    uint64_t elapsed;
+    pthread_t thread;
+
+    start = get_time();
+
+    for ( i = 0; i < ROUNDS; i++ ) {
+        pthread_mutex_lock( &mutex );
+        pthread_mutex_unlock( &mutex );
+    }
+
+    elapsed = get_time() - start;
+
+    printf( "uncontended: %u ns/lock+unlock\n", ( uint32_t )( elapsed * 1000 / ROUNDS ) );
+
+    start = get_time();
+
+    if ( pthread_create( &thread, NULL, counter_thread, NULL ) != 0 ) {
+        fprintf( stderr, "%s: failed to create thread.\n", argv[ 0 ] );
+        return EXIT_FAILURE;
+    }
+
+    counter_thread( NULL );
+
+    while ( finished < 2 ) {
+        usleep( 1000 );
+    }
+
+    elapsed = get_time() - start;
+
+    printf(
+        "contended:   %u ns/lock+unlock, counter: %d (expected %d)\n",
+        ( uint32_t )( elapsed * 1000 / ( 2 * ROUNDS ) ),
+        counter,
+        2 * ROUNDS
+    );
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+/* pthread read-write lock benchmark
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+/* The benchmark measures the time a number of reader threads need to
+   read lock and unlock a read-write lock, while a writer thread updates
+   the protected data from time to time. Run it with the number of the
+   reader threads as the parameter. */
+
+#define ROUNDS 1000000
+#define WRITE_INTERVAL 1000
+#define MAX_READERS 16
+
+static pthread_rwlock_t rwlock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t finish_mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile int data[ 2 ] = { 0, 0 };
+static volatile int errors = 0;
+static volatile int finished = 0;
+static volatile int readers_running = 0;
+
+static uint64_t get_time( void ) {
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+
+    return ( uint64_t )tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void thread_finished( void ) {
+    pthread_mutex_lock( &finish_mutex );
+    finished++;
+    pthread_mutex_unlock( &finish_mutex );
+}
+
+static void* reader_thread( void* arg ) {
+    int i;
+
+    for ( i = 0; i < ROUNDS; i++ ) {
+        pthread_rwlock_rdlock( &rwlock );
+
+        /* The writer updates both items together */
+
+        if ( data[ 0 ] != data[ 1 ] ) {
+            errors++;
+        }
+
+        pthread_rwlock_unlock( &rwlock );
+    }
+
+    pthread_mutex_lock( &finish_mutex );
+    readers_running--;
+    finished++;
+    pthread_mutex_unlock( &finish_mutex );
+
+    return NULL;
+}
+
+static void* writer_thread( void* arg ) {
+    while ( readers_running > 0 ) {
+        pthread_rwlock_wrlock( &rwlock );
+        data[ 0 ]++;
+        data[ 1 ]++;
+        pthread_rwlock_unlock( &rwlock );
+
+        usleep( WRITE_INTERVAL );
+    }
+
+    thread_finished();
+
+    return NULL;
+}
+
+int main( int argc, char** argv ) {
+    int i;
+    int readers;
+    uint64_t start;
+    uint64_t elapsed;
+    pthread_t thread;
+
+    readers = 2;
+
+    if ( argc > 1 ) {
+        readers = atoi( argv[ 1 ] );
+    }
+
+    if ( ( readers < 1 ) || ( readers > MAX_READERS ) ) {
+        fprintf( stderr, "%s: the number of readers must be between 1 and %d.\n", argv[ 0 ], MAX_READERS );
+        return EXIT_FAILURE;
+    }
+
+    readers_running = readers;
+
+    start = get_time();
+
+    for ( i = 0; i < readers; i++ ) {
+        if ( pthread_create( &thread, NULL, reader_thread, NULL ) != 0 ) {
+            fprintf( stderr, "%s: failed to create thread.\n", argv[ 0 ] );
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ( pthread_create( &thread, NULL, writer_thread, NULL ) != 0 ) {
+        fprintf( stderr, "%s: failed to create thread.\n", argv[ 0 ] );
+        return EXIT_FAILURE;
+    }
+
+    while ( finished < readers + 1 ) {
+        usleep( 1000 );
+    }
+
+    elapsed = get_time() - start;
+
+    printf(
+        "%d readers: %u ns/rdlock+unlock, %d writes, %d errors\n",
+        readers,
+        ( uint32_t )( elapsed * 1000 / ( ( uint64_t )readers * ROUNDS ) ),
+        data[ 0 ],
+        errors
+    );
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+/* Sleep latency benchmark
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+/* The benchmark measures how late a thread wakes up from usleep().
+   With a periodic scheduler tick the wakeup is rounded up to the next
+   tick, with one-shot timers it should be close to the requested time
+   even if the CPU was idle while the thread slept. */
+
+#define ROUNDS 1000
+
+static uint64_t get_time( void ) {
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+
+    return ( uint64_t )tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int run_benchmark( useconds_t delay ) {
+    int i;
+    uint64_t start;
+    uint64_t latency;
+    uint64_t min_latency;
+    uint64_t max_latency;
+    uint64_t total_latency;
+
+    min_latency = ~0ULL;
+    max_latency = 0;
+    total_latency = 0;
+
+    for ( i = 0; i < ROUNDS; i++ ) {
+        start = get_time();
+
+        if ( usleep( delay ) != 0 ) {
+            fprintf( stderr, "sleepbench: usleep failed\n" );
+            return -1;
+        }
+
+        latency = get_time() - start;
+
+        if ( latency < min_latency ) {
+            min_latency = latency;
+        }
+
+        if ( latency > max_latency ) {
+            max_latency = latency;
+        }
+
+        total_latency += latency;
+    }
+
+    printf(
+        "usleep(%4u): min %u us, avg %u us, max %u us\n",
+        delay,
+        ( uint32_t )min_latency,
+        ( uint32_t )( total_latency / ROUNDS ),
+        ( uint32_t )max_latency
+    );
+
+    return 0;
+}
+
+int main( int argc, char** argv ) {
+    if ( ( run_benchmark( 10 ) != 0 ) ||
+         ( run_benchmark( 100 ) != 0 ) ||
+         ( run_benchmark( 1000 ) != 0 ) ) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+/* Process spawn benchmark
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+/* The benchmark starts short-lived children the way shells and init
+   scripts do: fork()+execve(), vfork()+execve() and posix_spawn(). The
+   children are this program started with the "child" argument, which
+   exits right away. A heap of HEAP_SIZE bytes is touched before the
+   benchmark, so fork() has a realistic address space to clone. */
+
+#define SELF_PATH "/application/spawnbench"
+#define HEAP_SIZE ( 8 * 1024 * 1024 )
+#define ROUNDS    256
+
+extern char** environ;
+
+static char* child_argv[] = { SELF_PATH, "child", NULL };
+
+static uint64_t get_time( void ) {
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+
+    return ( uint64_t )tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static pid_t spawn_fork( void ) {
+    pid_t pid;
+
+    pid = fork();
+
+    if ( pid == 0 ) {
+        execve( SELF_PATH, child_argv, environ );
+        _exit( 127 );
+    }
+
+    return pid;
+}
+
+static pid_t spawn_vfork( void ) {
+    pid_t pid;
+
+    pid = vfork();
+
+    if ( pid == 0 ) {
+        execve( SELF_PATH, child_argv, environ );
+        _exit( 127 );
+    }
+
+    return pid;
+}
+
+static pid_t spawn_posix( void ) {
+    pid_t pid;
+
+    if ( posix_spawn( &pid, SELF_PATH, NULL, NULL, child_argv, environ ) != 0 ) {
+        return -1;
+    }
+
+    return pid;
+}
+
+static int run_benchmark( const char* name, pid_t ( *spawn )( void ) ) {
+    int i;
+    int status;
+    pid_t pid;
+    uint64_t start;
+    uint64_t time;
+
+    start = get_time();
+
+    for ( i = 0; i < ROUNDS; i++ ) {
+        pid = spawn();
+
+        if ( pid < 0 ) {
+            fprintf( stderr, "spawnbench: %s failed\n", name );
+            return -1;
+        }
+
+        waitpid( pid, &status, 0 );
+    }
+
+    time = get_time() - start;
+
+    printf(
+        "%-12s %u us per process, %u processes per second\n",
+        name, ( uint32_t )( time / ROUNDS ),
+        ( uint32_t )( ( uint64_t )ROUNDS * 1000000 / ( time > 0 ? time : 1 ) )
+    );
+
+    return 0;
+}
+
+int main( int argc, char** argv ) {
+    char* heap;
+
+    if ( ( argc > 1 ) &&
+         ( strcmp( argv[ 1 ], "child" ) == 0 ) ) {
+        return EXIT_SUCCESS;
+    }
+
+    heap = ( char* )malloc( HEAP_SIZE );
+
+    if ( heap == NULL ) {
+        fprintf( stderr, "spawnbench: failed to allocate heap\n" );
+        return EXIT_FAILURE;
+    }
+
+    memset( heap, 0, HEAP_SIZE );
+
+    if ( ( run_benchmark( "fork+exec", spawn_fork ) != 0 ) ||
+         ( run_benchmark( "vfork+exec", spawn_vfork ) != 0 ) ||
+         ( run_benchmark( "posix_spawn", spawn_posix ) != 0 ) ) {
+        free( heap );
+        return EXIT_FAILURE;
+    }
+
+    free( heap );
+
+    return EXIT_SUCCESS;
+}
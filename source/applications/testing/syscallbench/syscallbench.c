@@ -0,0 +1,119 @@
+/* System call entry benchmark
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <yaosp/sysinfo.h>
+#include <yaosp/syscall_table.h>
+
+/* The benchmark measures the cost of a system call that does nothing
+   (gettid) with both kernel entry methods: the int $0x80 software
+   interrupt and the sysenter instruction. The result is reported in
+   processor cycles per call. */
+
+#define CALLS 1000000
+
+typedef int entry_function_t( int number );
+
+static inline uint64_t rdtsc( void ) {
+    uint64_t value;
+
+    __asm__ __volatile__(
+        "rdtsc\n"
+        : "=A" ( value )
+    );
+
+    return value;
+}
+
+static int call_int80( int number ) {
+    int result;
+
+    __asm__ __volatile__(
+        "int $0x80\n"
+        : "=a" ( result )
+        : "0" ( number )
+        : "memory"
+    );
+
+    return result;
+}
+
+static int call_sysenter( int number ) {
+    int result;
+
+    /* The kernel returns to the address at (%ebp) with the stack
+       pointer above it and clobbers %ecx and %edx. */
+
+    __asm__ __volatile__(
+        "pushl %%ebp\n"
+        "pushl $1f\n"
+        "movl %%esp, %%ebp\n"
+        "sysenter\n"
+        "1:\n"
+        "popl %%ebp\n"
+        : "=a" ( result )
+        : "0" ( number )
+        : "ecx", "edx", "memory"
+    );
+
+    return result;
+}
+
+static void run_benchmark( const char* name, entry_function_t* function ) {
+    int i;
+    uint64_t start;
+    uint64_t elapsed;
+
+    /* Warm up the caches before the measurement */
+
+    for ( i = 0; i < 1000; i++ ) {
+        function( SYS_gettid );
+    }
+
+    start = rdtsc();
+
+    for ( i = 0; i < CALLS; i++ ) {
+        function( SYS_gettid );
+    }
+
+    elapsed = rdtsc() - start;
+
+    printf( "%-10s %u cycles/call\n", name, ( uint32_t )( elapsed / CALLS ) );
+}
+
+int main( int argc, char** argv ) {
+    processor_info_t info;
+
+    if ( get_processor_info( &info, 1 ) != 1 ) {
+        fprintf( stderr, "%s: failed to get processor informations.\n", argv[ 0 ] );
+        return EXIT_FAILURE;
+    }
+
+    run_benchmark( "int $0x80", call_int80 );
+
+    if ( info.features & CPU_FEATURE_SEP ) {
+        run_benchmark( "sysenter", call_sysenter );
+    } else {
+        printf( "sysenter   not supported by the processor\n" );
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+/* Time query benchmark
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/time.h>
+#include <yaosp/time.h>
+
+/* The benchmark measures how many times the current time can be asked
+   in a second. get_system_time() always enters the kernel, gettimeofday()
+   and clock_gettime() calculate the time from the TSC and the time page
+   if the kernel uses the TSC as its clock source. */
+
+#define CALLS 1000000
+
+typedef void time_function_t( void );
+
+static uint64_t get_time( void ) {
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+
+    return ( uint64_t )tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void call_get_system_time( void ) {
+    get_system_time();
+}
+
+static void call_gettimeofday( void ) {
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+}
+
+static void call_clock_gettime( void ) {
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+}
+
+static void run_benchmark( const char* name, time_function_t* function ) {
+    int i;
+    uint64_t start;
+    uint64_t elapsed;
+
+    start = get_time();
+
+    for ( i = 0; i < CALLS; i++ ) {
+        function();
+    }
+
+    elapsed = get_time() - start;
+
+    if ( elapsed == 0 ) {
+        elapsed = 1;
+    }
+
+    printf(
+        "%-16s %u calls/s, %u ns/call\n",
+        name,
+        ( uint32_t )( ( uint64_t )CALLS * 1000000 / elapsed ),
+        ( uint32_t )( elapsed * 1000 / CALLS )
+    );
+}
+
+int main( int argc, char** argv ) {
+    run_benchmark( "get_system_time", call_get_system_time );
+    run_benchmark( "gettimeofday", call_gettimeofday );
+    run_benchmark( "clock_gettime", call_clock_gettime );
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/* TLB benchmark for remapped regions
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include <yaosp/region.h>
+
+/* The benchmark blits a 1600x1200x32 "framebuffer" into a back buffer
+   tile by tile, going down the columns. Every row of a tile is in a
+   different page, so the blit is dominated by TLB misses when the source
+   is mapped with 4 kB pages. The source is a read-only mapping of physical
+   memory, mapped once at a 4 MB aligned address (the kernel uses large
+   pages for it) and once with a one page offset (normal pages). */
+
+#define FB_WIDTH  1600
+#define FB_HEIGHT 1200
+#define FB_PITCH  ( FB_WIDTH * 4 )
+#define FB_SIZE   ( FB_PITCH * FB_HEIGHT )
+
+#define TILE_SIZE 16
+#define ROUNDS    32
+
+#define PHYSICAL_BASE ( 16 * 1024 * 1024 )
+#define REGION_SIZE   ( 8 * 1024 * 1024 )
+
+static uint8_t* back_buffer;
+
+static uint64_t get_time( void ) {
+    struct timeval tv;
+
+    gettimeofday( &tv, NULL );
+
+    return ( uint64_t )tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void blit( uint8_t* fb ) {
+    int x;
+    int y;
+    int row;
+
+    for ( x = 0; x < FB_WIDTH; x += TILE_SIZE ) {
+        for ( y = 0; y < FB_HEIGHT; y += TILE_SIZE ) {
+            for ( row = y; row < y + TILE_SIZE; row++ ) {
+                memcpy(
+                    back_buffer + row * FB_PITCH + x * 4,
+                    fb + row * FB_PITCH + x * 4,
+                    TILE_SIZE * 4
+                );
+            }
+        }
+    }
+}
+
+static int run_benchmark( const char* name, uint32_t physical ) {
+    int i;
+    void* address;
+    uint64_t start;
+    uint64_t time;
+    region_id region;
+
+    region = memory_region_create( "tlbbench", REGION_SIZE, REGION_READ, &address );
+
+    if ( region < 0 ) {
+        fprintf( stderr, "tlbbench: failed to create region\n" );
+        return -1;
+    }
+
+    if ( memory_region_remap_pages( region, ( void* )physical ) != 0 ) {
+        fprintf( stderr, "tlbbench: failed to remap region\n" );
+        memory_region_delete( region );
+        return -1;
+    }
+
+    /* Warm up the caches */
+
+    blit( ( uint8_t* )address );
+
+    start = get_time();
+
+    for ( i = 0; i < ROUNDS; i++ ) {
+        blit( ( uint8_t* )address );
+    }
+
+    time = get_time() - start;
+
+    printf(
+        "%-12s region at %p: %u us per blit\n",
+        name, address, ( uint32_t )( time / ROUNDS )
+    );
+
+    memory_region_delete( region );
+
+    return 0;
+}
+
+int main( int argc, char** argv ) {
+    back_buffer = ( uint8_t* )malloc( FB_SIZE );
+
+    if ( back_buffer == NULL ) {
+        fprintf( stderr, "tlbbench: failed to allocate back buffer\n" );
+        return EXIT_FAILURE;
+    }
+
+    memset( back_buffer, 0, FB_SIZE );
+
+    if ( ( run_benchmark( "4 MB pages", PHYSICAL_BASE ) != 0 ) ||
+         ( run_benchmark( "4 kB pages", PHYSICAL_BASE + PAGE_SIZE ) != 0 ) ) {
+        free( back_buffer );
+        return EXIT_FAILURE;
+    }
+
+    free( back_buffer );
+
+    return EXIT_SUCCESS;
+}
@@ -42,6 +42,9 @@ i386_feature_t i386_features[] = {
     { CPU_FEATURE_PAE, "pae" },
     { CPU_FEATURE_IA64, "ia64" },
     { CPU_FEATURE_EST, "est" },
+    { CPU_FEATURE_PSE, "pse" },
+    { CPU_FEATURE_INVARIANT_TSC, "invariant_tsc" },
+    { CPU_FEATURE_SEP, "sep" },
     { 0, "" }
 };
 
@@ -184,6 +187,18 @@ static int do_get_processor_info( void ) {
         }
 
         printf( "\n" );
+        printf(
+            "TLB IPIs:     %u sent, %u received\n",
+            info->tlb_ipis_sent, info->tlb_ipis_received
+        );
+        printf(
+            "TLB flushes:  %u full, %u pages\n",
+            info->tlb_full_flushes, info->tlb_page_flushes
+        );
+        printf(
+            "Run queue:    %u threads, %u migrations\n",
+            info->run_queue_length, info->migrations
+        );
     }
 
     free( info_table );
@@ -212,6 +227,32 @@ static int do_get_memory_info( void ) {
     printf( "Kmalloc memory\n" );
     printf( "  used:      %u Kb\n", ( memory_info.kmalloc_used_pages * pagesize / 1024 ) );
     printf( "  allocated: %u Kb\n", ( memory_info.kmalloc_alloc_size / 1024 ) );
+    printf( "  cached:    %u objects\n", memory_info.kmalloc_cached_objects );
+    printf( "  hits:      %u\n", memory_info.kmalloc_magazine_hits );
+    printf( "  misses:    %u\n", memory_info.kmalloc_magazine_misses );
+    printf( "  flushes:   %u\n", memory_info.kmalloc_magazine_flushes );
+    printf( "\n" );
+    printf( "Page caches\n" );
+    printf( "  cached: %u Kb\n", ( memory_info.page_cache_pages * pagesize / 1024 ) );
+    printf( "  hits:   %u\n", memory_info.page_cache_hits );
+    printf( "  misses: %u\n", memory_info.page_cache_misses );
+    printf( "\n" );
+    printf( "File cache\n" );
+    printf( "  cached:    %u Kb\n", ( memory_info.file_cache_pages * pagesize / 1024 ) );
+    printf( "  hits:      %u\n", memory_info.file_cache_hits );
+    printf( "  misses:    %u\n", memory_info.file_cache_misses );
+    printf( "  evictions: %u\n", memory_info.file_cache_evictions );
+    printf( "\n" );
+    printf( "File mapping faults\n" );
+    printf( "  faults:     %u\n", memory_info.file_map_faults );
+    printf( "  sequential: %u\n", memory_info.file_map_sequential_faults );
+    printf( "  pages:      %u\n", memory_info.file_map_pages );
+
+    if ( memory_info.file_map_faults > 0 ) {
+        printf( "  pages/fault: %u.%02u\n",
+                memory_info.file_map_pages / memory_info.file_map_faults,
+                ( memory_info.file_map_pages * 100 / memory_info.file_map_faults ) % 100 );
+    }
 
     return EXIT_SUCCESS;
 }
@@ -20,9 +20,13 @@
 #include <ioctl.h>
 #include <macros.h>
 #include <vfs/vfs.h>
+#include <sched/scheduler.h>
 
 #include "terminal.h"
 
+/* Slightly below the input drivers that produce the events for us */
+#define TERMINAL_INPUT_RT_PRIORITY 9
+
 static int input_device = -1;
 static int current_qualifiers = 0;
 
@@ -225,6 +229,8 @@ int init_terminal_input( void ) {
         return thread;
     }
 
+    thread_set_scheduler( thread, SCHED_FIFO, TERMINAL_INPUT_RT_PRIORITY );
+
     thread_wake_up( thread );
 
     return 0;
@@ -25,6 +25,9 @@
 
 #define INPUT_DRV_COUNT 2
 
+/* The real-time priority of the input driver threads */
+#define INPUT_THREAD_RT_PRIORITY 10
+
 typedef enum input_driver_type {
     T_KEYBOARD,
     T_MOUSE,
@@ -24,6 +24,7 @@
 #include <macros.h>
 #include <mm/kmalloc.h>
 #include <vfs/vfs.h>
+#include <sched/scheduler.h>
 
 #include "../input.h"
 
@@ -169,6 +170,11 @@ static int ps2_keyboard_init( void ) {
         goto error2;
     }
 
+    /* Input events are delivered by a real-time thread, so the
+       latency does not depend on the CPU load */
+
+    thread_set_scheduler( thread, SCHED_FIFO, INPUT_THREAD_RT_PRIORITY );
+
     return 0;
 
 error2:
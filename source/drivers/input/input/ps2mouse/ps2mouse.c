@@ -24,6 +24,7 @@
 #include <macros.h>
 #include <mm/kmalloc.h>
 #include <vfs/vfs.h>
+#include <sched/scheduler.h>
 
 #include "../input.h"
 
@@ -125,6 +126,11 @@ static int ps2_mouse_start( void ) {
         return mouse_thread;
     }
 
+    /* Input events are delivered by a real-time thread, so the
+       latency does not depend on the CPU load */
+
+    thread_set_scheduler( mouse_thread, SCHED_FIFO, INPUT_THREAD_RT_PRIORITY );
+
     error = thread_wake_up( mouse_thread );
 
     if ( error < 0 ) {
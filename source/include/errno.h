@@ -65,6 +65,7 @@
 #define EAFNOSUPPORT  44
 #define ECONNREFUSED  45
 #define ENOTSOCK      46
+#define EFAULT        47
 
 #define errno (*__errno_location())
 
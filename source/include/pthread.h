@@ -22,11 +22,11 @@
 #include <stddef.h>
 #include <inttypes.h>
 #include <time.h>
+#include <sched.h>
 
-#define PTHREAD_MUTEX_MAGIC 0xC001C0DE
-#define PTHREAD_COND_MAGIC  0xDEADBEEF
-
-#define PTHREAD_MUTEX_INITIALIZER { 0, -1 }
+#define PTHREAD_MUTEX_INITIALIZER { 0, PTHREAD_MUTEX_DEFAULT, 0, 0 }
+#define PTHREAD_COND_INITIALIZER { 0, 0 }
+#define PTHREAD_RWLOCK_INITIALIZER { PTHREAD_MUTEX_INITIALIZER, 0, 0, 0, 0, 0, 0 }
 
 #define PTHREAD_ONCE_INIT 0
 
@@ -51,11 +51,17 @@ typedef struct pthread {
 
 typedef struct pthread_mutexattr {
     int flags;
+    int type;
 } pthread_mutexattr_t;
 
+/* Mutexes and condition variables are built on futexes, locking and
+   unlocking them doesn't enter the kernel unless there is contention. */
+
 typedef struct pthread_mutex {
-    uint32_t init_magic;
-    int mutex_id;
+    int state; /* 0: unlocked, 1: locked, 2: locked with waiters */
+    int type;
+    int owner; /* Only used by recursive and error checking mutexes */
+    int count;
 } pthread_mutex_t;
 
 typedef struct pthread_condattr {
@@ -63,10 +69,27 @@ typedef struct pthread_condattr {
 } pthread_condattr_t;
 
 typedef struct pthread_cond {
-    uint32_t init_magic;
-    int cond_id;
+    int sequence;
+    int waiters;
 } pthread_cond_t;
 
+typedef struct pthread_rwlockattr {
+    int flags;
+} pthread_rwlockattr_t;
+
+/* Read-write locks prefer writers: new readers are blocked while a writer
+   waits for the lock, so a thread must not read lock it recursively. */
+
+typedef struct pthread_rwlock {
+    pthread_mutex_t mutex; /* Protects the other fields */
+    int readers;
+    int writer;
+    int readers_waiting;
+    int writers_waiting;
+    int read_sequence;
+    int write_sequence;
+} pthread_rwlock_t;
+
 typedef int pthread_once_t;
 typedef int pthread_key_t;
 
@@ -77,6 +100,13 @@ int pthread_attr_setname( pthread_attr_t* attr, char* name );
 
 int pthread_create( pthread_t* thread, const pthread_attr_t* attr,
                     void *( *start_routine )( void* ), void* arg );
+pthread_t pthread_self( void );
+
+int pthread_setaffinity_np( pthread_t thread, size_t cpusetsize, const cpu_set_t* cpuset );
+int pthread_getaffinity_np( pthread_t thread, size_t cpusetsize, cpu_set_t* cpuset );
+
+int pthread_setschedparam( pthread_t thread, int policy, const struct sched_param* param );
+int pthread_getschedparam( pthread_t thread, int* policy, struct sched_param* param );
 
 int pthread_mutexattr_init( pthread_mutexattr_t* attr );
 int pthread_mutexattr_destroy( pthread_mutexattr_t* attr );
@@ -102,6 +132,17 @@ int pthread_cond_timedwait( pthread_cond_t* cond, pthread_mutex_t* mutex, const
 int pthread_cond_signal( pthread_cond_t* cond );
 int pthread_cond_broadcast( pthread_cond_t* cond );
 
+int pthread_rwlockattr_init( pthread_rwlockattr_t* attr );
+int pthread_rwlockattr_destroy( pthread_rwlockattr_t* attr );
+
+int pthread_rwlock_init( pthread_rwlock_t* rwlock, const pthread_rwlockattr_t* attr );
+int pthread_rwlock_destroy( pthread_rwlock_t* rwlock );
+int pthread_rwlock_rdlock( pthread_rwlock_t* rwlock );
+int pthread_rwlock_tryrdlock( pthread_rwlock_t* rwlock );
+int pthread_rwlock_wrlock( pthread_rwlock_t* rwlock );
+int pthread_rwlock_trywrlock( pthread_rwlock_t* rwlock );
+int pthread_rwlock_unlock( pthread_rwlock_t* rwlock );
+
 int pthread_once(pthread_once_t* once_control, void (*init_routine)(void));
 
 int pthread_key_create(pthread_key_t* key, void (*destructor)(void*));
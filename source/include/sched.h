@@ -0,0 +1,61 @@
+/* yaosp C library
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+/* The maximum number of CPUs that can be described by a CPU set */
+#define CPU_SETSIZE 32
+
+/* Scheduling policies */
+#define SCHED_OTHER 0
+#define SCHED_FIFO  1
+#define SCHED_RR    2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct sched_param {
+    int sched_priority;
+};
+
+typedef struct cpu_set {
+    uint32_t mask;
+} cpu_set_t;
+
+#define CPU_ZERO( set ) ( ( set )->mask = 0 )
+#define CPU_SET( cpu, set ) ( ( set )->mask |= ( 1U << ( cpu ) ) )
+#define CPU_CLR( cpu, set ) ( ( set )->mask &= ~( 1U << ( cpu ) ) )
+#define CPU_ISSET( cpu, set ) ( ( ( set )->mask & ( 1U << ( cpu ) ) ) != 0 )
+
+int sched_setscheduler( pid_t pid, int policy, const struct sched_param* param );
+int sched_getscheduler( pid_t pid );
+int sched_setparam( pid_t pid, const struct sched_param* param );
+int sched_getparam( pid_t pid, struct sched_param* param );
+int sched_get_priority_min( int policy );
+int sched_get_priority_max( int policy );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SCHED_H_ */
@@ -0,0 +1,71 @@
+/* yaosp C library
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SPAWN_H_
+#define _SPAWN_H_
+
+#include <signal.h>
+#include <sys/types.h>
+
+#define POSIX_SPAWN_SETSIGMASK 0x01
+#define POSIX_SPAWN_SETSIGDEF  0x02
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct posix_spawnattr {
+    short flags;
+    sigset_t sigmask;
+    sigset_t sigdefault;
+} posix_spawnattr_t;
+
+struct spawn_file_action;
+
+typedef struct posix_spawn_file_actions {
+    int count;
+    int allocated;
+    struct spawn_file_action* actions;
+} posix_spawn_file_actions_t;
+
+int posix_spawn( pid_t* pid, const char* path, const posix_spawn_file_actions_t* file_actions,
+                 const posix_spawnattr_t* attr, char* const argv[], char* const envp[] );
+int posix_spawnp( pid_t* pid, const char* file, const posix_spawn_file_actions_t* file_actions,
+                  const posix_spawnattr_t* attr, char* const argv[], char* const envp[] );
+
+int posix_spawn_file_actions_init( posix_spawn_file_actions_t* file_actions );
+int posix_spawn_file_actions_destroy( posix_spawn_file_actions_t* file_actions );
+int posix_spawn_file_actions_addopen( posix_spawn_file_actions_t* file_actions, int fd,
+                                      const char* path, int flags, mode_t mode );
+int posix_spawn_file_actions_addclose( posix_spawn_file_actions_t* file_actions, int fd );
+int posix_spawn_file_actions_adddup2( posix_spawn_file_actions_t* file_actions, int fd, int new_fd );
+
+int posix_spawnattr_init( posix_spawnattr_t* attr );
+int posix_spawnattr_destroy( posix_spawnattr_t* attr );
+int posix_spawnattr_getflags( const posix_spawnattr_t* attr, short* flags );
+int posix_spawnattr_setflags( posix_spawnattr_t* attr, short flags );
+int posix_spawnattr_getsigmask( const posix_spawnattr_t* attr, sigset_t* sigmask );
+int posix_spawnattr_setsigmask( posix_spawnattr_t* attr, const sigset_t* sigmask );
+int posix_spawnattr_getsigdefault( const posix_spawnattr_t* attr, sigset_t* sigdefault );
+int posix_spawnattr_setsigdefault( posix_spawnattr_t* attr, const sigset_t* sigdefault );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SPAWN_H_ */
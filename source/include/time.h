@@ -30,6 +30,10 @@ extern "C" {
 #endif
 
 typedef long clock_t;
+typedef int clockid_t;
+
+#define CLOCK_REALTIME  0
+#define CLOCK_MONOTONIC 1
 
 typedef struct timeval {
     time_t      tv_sec;  /* Seconds */
@@ -86,6 +90,9 @@ char* ctime_r( const time_t* timep, char* buf );
 
 int nanosleep( const struct timespec* req, struct timespec* rem );
 
+int clock_gettime( clockid_t clock_id, struct timespec* tp );
+int clock_getres( clockid_t clock_id, struct timespec* res );
+
 #ifdef __cplusplus
 }
 #endif
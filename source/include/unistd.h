@@ -95,10 +95,12 @@ extern char** environ;
 void _exit( int status );
 
 pid_t fork( void );
+pid_t vfork( void );
 
 int execv( const char* file, char* const argv[] );
 int execve( const char* filename, char* const argv[], char* const envp[] );
 int execvp( const char* filename, char* const argv[] );
+int execvpe( const char* file, char* const argv[], char* const envp[] );
 int execl( const char* path, const char *arg, ... );
 int execlp( const char* file, const char* arg, ... );
 
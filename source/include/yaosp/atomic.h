@@ -21,4 +21,10 @@
 
 int atomic_swap(void* p, int i);
 
+/* Stores new to *p if it contains old. Returns the previous value of *p. */
+int atomic_cmpxchg(void* p, int old, int new);
+
+/* Adds i to *p and returns the previous value of *p. */
+int atomic_add(void* p, int i);
+
 #endif /* _YAOSP_ATOMIC_H_ */
@@ -0,0 +1,35 @@
+/* yaosp C library
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _YAOSP_FUTEX_H_
+#define _YAOSP_FUTEX_H_
+
+#include <time.h>
+
+/* The count to pass to futex_wake() to wake up every waiter */
+#define FUTEX_WAKE_ALL 0x7FFFFFFF
+
+/* Sleeps until the futex is woken up if *address still contains value.
+   wakeup_time is an absolute time in microseconds, NULL means no timeout.
+   Returns 0 when woken up, otherwise -EAGAIN, -ETIME or -EINTR. */
+int futex_wait( int* address, int value, const time_t* wakeup_time );
+
+/* Wakes up at most count threads waiting on the futex. */
+int futex_wake( int* address, int count );
+
+#endif /* _YAOSP_FUTEX_H_ */
@@ -32,7 +32,8 @@ typedef int region_id;
 
 typedef enum region_flags {
     REGION_READ = (1 << 0),
-    REGION_WRITE = (1 << 1)
+    REGION_WRITE = (1 << 1),
+    REGION_LAZY = (1 << 9)
 } region_flags_t;
 
 region_id memory_region_create( const char* name, uint64_t size, uint32_t flags, void** address );
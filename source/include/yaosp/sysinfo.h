@@ -48,7 +48,10 @@ enum {
     CPU_FEATURE_SSE3 = ( 1 << 8 ),
     CPU_FEATURE_PAE = ( 1 << 9 ),
     CPU_FEATURE_IA64 = ( 1 << 10 ),
-    CPU_FEATURE_EST = ( 1 << 11 )
+    CPU_FEATURE_EST = ( 1 << 11 ),
+    CPU_FEATURE_PSE = ( 1 << 12 ),
+    CPU_FEATURE_INVARIANT_TSC = ( 1 << 13 ),
+    CPU_FEATURE_SEP = ( 1 << 14 )
 };
 
 typedef int process_id;
@@ -91,6 +94,12 @@ typedef struct processor_info {
     int present;
     int running;
     uint32_t features;
+    uint32_t tlb_ipis_sent;
+    uint32_t tlb_ipis_received;
+    uint32_t tlb_full_flushes;
+    uint32_t tlb_page_flushes;
+    uint32_t run_queue_length;
+    uint32_t migrations;
 } processor_info_t;
 
 typedef struct memory_info {
@@ -98,6 +107,23 @@ typedef struct memory_info {
     uint32_t total_page_count;
     uint32_t kmalloc_used_pages;
     uint32_t kmalloc_alloc_size;
+
+    /* Per-CPU kmalloc magazine informations (summed for all CPUs) */
+
+    uint32_t kmalloc_cached_objects;
+    uint32_t kmalloc_magazine_hits;
+    uint32_t kmalloc_magazine_misses;
+    uint32_t kmalloc_magazine_flushes;
+    uint32_t page_cache_pages;
+    uint32_t page_cache_hits;
+    uint32_t page_cache_misses;
+    uint32_t file_cache_pages;
+    uint32_t file_cache_hits;
+    uint32_t file_cache_misses;
+    uint32_t file_cache_evictions;
+    uint32_t file_map_faults;
+    uint32_t file_map_sequential_faults;
+    uint32_t file_map_pages;
 } memory_info_t;
 
 int get_kernel_info( kernel_info_t* kernel_info );
@@ -21,6 +21,22 @@
 
 #include <time.h>
 
+/* Clock modes of the time page */
+#define TIME_PAGE_SYSCALL 0 /* The time has to be asked from the kernel */
+#define TIME_PAGE_TSC     1 /* The time can be calculated from the TSC */
+
+/* The shift of the multiplier in the time page */
+#define TIME_PAGE_US_SHIFT 32
+
+/* The read-only page the kernel maps to the process to calculate
+   the current time without a system call */
+typedef struct time_page {
+    uint32_t clock_mode;
+    uint32_t tsc_to_us_mult;
+    uint64_t tsc_base;
+    uint64_t boot_time;
+} time_page_t;
+
 time_t get_boot_time( void );
 time_t get_system_time( void );
 time_t get_idle_time( void );
@@ -19,6 +19,8 @@
 #ifndef _YAOSP_YAOSP_H_
 #define _YAOSP_YAOSP_H_
 
+#include <inttypes.h>
+
 enum mutex_flags {
     MUTEX_NONE = 0,
     MUTEX_RECURSIVE = ( 1 << 0 )
@@ -27,4 +29,7 @@ enum mutex_flags {
 void reboot( void );
 void halt( void );
 
+int set_thread_affinity( int thread_id, uint32_t affinity );
+int get_thread_affinity( int thread_id, uint32_t* affinity );
+
 #endif /* _YAOSP_YAOSP_H_ */
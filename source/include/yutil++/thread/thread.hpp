@@ -32,6 +32,7 @@ class Thread {
     virtual ~Thread( void );
 
     bool start( void );
+    bool setAffinity( uint32_t mask );
 
     virtual int run( void ) = 0;
 
@@ -20,10 +20,12 @@
 #define _ARCH_APIC_H_
 
 #include <types.h>
+#include <config.h>
 
 #define APIC_TIMER_IRQ     0xF0
 #define APIC_SPURIOUS_IRQ  0xF1
 #define APIC_TLB_FLUSH_IRQ 0xF2
+#define APIC_RESCHEDULE_IRQ 0xF3
 
 /* Local APIC register offsets */
 
@@ -68,6 +70,16 @@ static inline void apic_write( uint32_t reg, uint32_t value ) {
     *( ( volatile uint32_t* )( local_apic_address + reg ) ) = value;
 }
 
+#ifdef ENABLE_SMP
+/**
+ * Sends an inter-processor interrupt to the specified CPU.
+ *
+ * @param processor The index of the target CPU
+ * @param vector The interrupt vector to deliver
+ */
+void apic_send_ipi( int processor, int vector );
+#endif /* ENABLE_SMP */
+
 void setup_local_apic( void );
 
 int init_apic( void );
@@ -74,6 +74,18 @@ void atomic_or( atomic_t* atomic, int value );
  */
 int atomic_swap( atomic_t* atomic, int value );
 
+/**
+ * Atomically replaces the value stored in the atomic structure
+ * with a new one if it is equal to the expected old value.
+ *
+ * @param atomic The pointer to the atomic structure
+ * @param old The value expected to be stored in the structure
+ * @param new The value to store if the expectation is met
+ * @return The value stored in the structure before the operation,
+ *         the exchange was done if it is equal to the old parameter
+ */
+int atomic_cmpxchg( atomic_t* atomic, int old, int new );
+
 /**
  * Atomically tests and clears the nth bit in the dword pointer
  * by the specified address.
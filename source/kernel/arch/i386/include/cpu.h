@@ -26,6 +26,9 @@
 #define EFLAG_ID ( 1 << 21 ) /* ID flag */
 
 #define X86_MSR_TSC 0x10
+#define X86_MSR_SYSENTER_CS  0x174
+#define X86_MSR_SYSENTER_ESP 0x175
+#define X86_MSR_SYSENTER_EIP 0x176
 
 #ifndef __ASSEMBLER__
 
@@ -40,6 +43,7 @@ typedef struct i386_cpu {
     uint8_t apic_id;
     uint64_t bus_speed;
     tss_t tss;
+    struct i386_memory_context* memory_context;
 } i386_cpu_t;
 
 typedef struct i386_feature {
@@ -59,9 +63,13 @@ enum {
     CPU_FEATURE_SSE3 = ( 1 << 8 ),
     CPU_FEATURE_PAE = ( 1 << 9 ),
     CPU_FEATURE_IA64 = ( 1 << 10 ),
-    CPU_FEATURE_EST = ( 1 << 11 )
+    CPU_FEATURE_EST = ( 1 << 11 ),
+    CPU_FEATURE_PSE = ( 1 << 12 ),
+    CPU_FEATURE_INVARIANT_TSC = ( 1 << 13 ),
+    CPU_FEATURE_SEP = ( 1 << 14 )
 };
 
+extern uint32_t tsc_khz;
 extern uint64_t tsc_to_ns_scale;
 
 extern i386_feature_t i386_features[];
@@ -93,6 +101,9 @@ register_t get_cr3( void );
  */
 void set_cr3( register_t cr3 );
 
+register_t get_cr4( void );
+void set_cr4( register_t cr4 );
+
 register_t get_ebp( void );
 
 void clear_task_switched( void );
@@ -137,6 +148,15 @@ int detect_cpu( void );
 int cpu_calibrate_speed( void );
 int cpu_calibrate_speed_with_acpi( void );
 
+/**
+ * Programs the SYSENTER MSRs of the current CPU so user space can
+ * enter the kernel with the sysenter instruction instead of int $0x80.
+ * It has to be called on every CPU after its TSS has been loaded.
+ *
+ * @param processor The index of the current processor
+ */
+void init_sysenter( int processor );
+
 #endif /* __ASSELBLER__ */
 
 #endif /* _ARCH_CPU_H_ */
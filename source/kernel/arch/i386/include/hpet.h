@@ -27,7 +27,17 @@
 #define HPET_STATUS  0x020
 #define HPET_COUNTER 0x0F0
 
+#define HPET_Tn_CONFIG( n )     ( 0x100 + 0x20 * ( n ) )
+#define HPET_Tn_COMPARATOR( n ) ( 0x108 + 0x20 * ( n ) )
+
+#define HPET_ID_64BIT 0x2000
+
 #define HPET_CONFIG_ENABLE 0x001
+#define HPET_CONFIG_LEGACY 0x002
+
+#define HPET_TN_INT_ENABLE 0x004
+#define HPET_TN_PERIODIC   0x008
+#define HPET_TN_32BIT      0x100
 
 #define HPET_MIN_PERIOD 100000UL
 #define HPET_MAX_PERIOD 100000000UL
@@ -37,6 +47,29 @@ extern uint32_t hpet_address;
 
 uint32_t hpet_readl( uint32_t reg );
 
+/**
+ * Reads the 64 bit main counter of the HPET.
+ *
+ * @return The value of the counter
+ */
+uint64_t hpet_read_counter( void );
+
+/**
+ * Returns the period of the main counter.
+ *
+ * @return The length of one counter tick in femtoseconds
+ */
+uint32_t hpet_get_period( void );
+
 int hpet_init( void );
 
+/**
+ * Registers the first HPET timer as the one-shot clock event device of
+ * the current CPU. The timer is routed to IRQ 0 in legacy replacement
+ * mode, so this should be used only if there is no local APIC.
+ *
+ * @return On success 0 is returned
+ */
+int hpet_init_clockevent( void );
+
 #endif /* _I386_HPET_H_ */
@@ -30,9 +30,17 @@
 #define PGDIR_SIZE  ( 1UL << PGDIR_SHIFT )
 #define PGDIR_MASK  ( ~( PGDIR_SIZE - 1 ) )
 
+/* Regions at least this big are placed at an address aligned to
+   this size, so remapped ones can be mapped with large pages. */
+#define REGION_LARGE_ALIGN PGDIR_SIZE
+
 #define FIRST_KERNEL_ADDRESS 0x100000
 #define LAST_KERNEL_ADDRESS  0x3FFFFFFF
 
+/* The kernel accesses physical memory through an identity mapped
+   region, so pages above this limit can't be handed out. */
+#define KERNEL_MAPPED_MEMORY_LIMIT ( 512 * 1024 * 1024 )
+
 #define FIRST_USER_ADDRESS        0x40000000
 #define FIRST_USER_REGION_ADDRESS 0x80000000
 #define FIRST_USER_STACK_ADDRESS  0xC0000000
@@ -22,8 +22,24 @@
 #include <types.h>
 #include <config.h>
 
+#include <arch/atomic.h>
+#include <arch/spinlock.h>
+#include <arch/mm/tlb.h>
+
 typedef struct i386_memory_context {
     uint32_t* page_directory;
+
+    /* The processors that have the page directory loaded, TLB
+       invalidations are sent only to them. */
+
+    atomic_t cpu_mask;
+
+    /* Invalidations collected while a batch is open */
+
+    spinlock_t tlb_lock;
+    int tlb_batch_depth;
+    tlb_batch_t tlb_pending;
+    struct memory_page* tlb_pending_pages;
 } i386_memory_context_t;
 
 int arch_memory_context_init( memory_context_t* context );
@@ -31,6 +47,45 @@ int arch_memory_context_destroy( memory_context_t* context );
 
 int arch_memory_context_clone( memory_context_t* old_context, memory_context_t* new_context );
 
+/**
+ * Loads a memory context on the current processor. The scheduler does
+ * this on thread switches, this is needed only when the memory context
+ * of the running process is replaced.
+ *
+ * @param context The memory context to load
+ */
+void arch_memory_context_load( memory_context_t* context );
+
 int arch_memory_context_translate_address( memory_context_t* context, ptr_t linear, ptr_t* physical );
 
+/**
+ * Makes sure that the page mapped at the specified address is not shared
+ * with other mappings, a shared page is replaced with a private copy.
+ * The kernel can write to the returned physical address even if the page
+ * is mapped read-only.
+ *
+ * @param context The memory context
+ * @param linear The linear address in the context
+ * @param physical The physical address is stored here
+ * @return On success 0 is returned
+ */
+int arch_memory_context_unshare_page( memory_context_t* context, ptr_t linear, ptr_t* physical );
+
+/**
+ * Opens a TLB batch on the memory context. The invalidations requested
+ * until the batch is closed are collected and sent to the other
+ * processors with one IPI. Batches can be nested.
+ *
+ * @param context The memory context
+ */
+void arch_memory_context_begin_tlb_batch( memory_context_t* context );
+
+/**
+ * Closes a batch opened by arch_memory_context_begin_tlb_batch(), the
+ * collected ranges are flushed when the outermost batch is closed.
+ *
+ * @param context The memory context
+ */
+void arch_memory_context_end_tlb_batch( memory_context_t* context );
+
 #endif /* _ARCH_MM_CONTEXT_H_ */
@@ -27,20 +27,84 @@
 #define PAGE_PRESENT 0x1
 #define PAGE_WRITE   0x2
 #define PAGE_USER    0x4
+#define PAGE_LARGE   0x80
 
 #define PGD_INDEX(addr) ((addr)>>PGDIR_SHIFT)
 #define PT_INDEX(addr)  (((addr)>>PAGE_SHIFT) & 1023)
 
+/* Write protect bit of CR0, makes the read-only pages
+   read-only for the kernel as well. */
+#define CR0_WP 0x10000
+
+/* Page size extension bit of CR4, enables 4 MB pages in the page directory */
+#define CR4_PSE 0x10
+
+/* True if the page directory entries can map 4 MB pages directly */
+extern bool paging_large_pages;
+
+/* A page filled with zeros that is mapped read-only to the
+   not yet written pages of lazy regions. */
+extern ptr_t zero_page;
+
 int get_paging_flags_for_region( memory_region_t* region );
 
 int paging_alloc_table_entries( uint32_t* table, uint32_t from, uint32_t to, uint32_t flags, int fail_on_nonempty );
 int paging_fill_table_entries( uint32_t* table, uint32_t address, uint32_t from, uint32_t to, uint32_t flags );
-int paging_clear_table_entries( uint32_t* table, uint32_t from, uint32_t to );
-int paging_free_table_entries( uint32_t* table, uint32_t from, uint32_t to );
+int paging_clear_table_entries( uint32_t* table, uint32_t from, uint32_t to, memory_page_t** freed );
+int paging_free_table_entries( uint32_t* table, uint32_t from, uint32_t to, memory_page_t** freed );
 int paging_clone_table_entries( uint32_t* old_table, uint32_t* new_table,
                                 uint32_t from, uint32_t to, int remove_write );
 int paging_copy_table_entries( uint32_t* old_table, uint32_t* new_table, uint32_t from, uint32_t to );
 
+/**
+ * Shares the page table of a page directory entry between two page
+ * directories. The entry is made read-only in both directories, so the
+ * first write through it faults and the table is copied with
+ * paging_unshare_table(). A read-only directory entry that points to a
+ * page table always means a shared table. This has to be called with
+ * pages_lock held.
+ *
+ * @param old_page_directory The page directory that owns the table
+ * @param new_page_directory The page directory to share the table with
+ * @param index The index of the entry in the page directories
+ */
+void paging_share_table( uint32_t* old_page_directory, uint32_t* new_page_directory, uint32_t index );
+
+/**
+ * Gives a page directory its own copy of a shared page table. The pages
+ * mapped by the table get a new reference and are made read-only in both
+ * copies. This has to be called with pages_lock held, the caller is
+ * responsible for the TLB invalidation.
+ *
+ * @param page_directory The page directory
+ * @param index The index of the entry in the page directory
+ * @return 1 if the directory entry was changed, 0 if the table was not
+ *         shared, otherwise a negative error code
+ */
+int paging_unshare_table( uint32_t* page_directory, uint32_t index );
+
+/**
+ * Unshares the page tables of an address range of a memory context.
+ * This has to be called before the page table entries of the range
+ * are modified.
+ *
+ * @param context The memory context
+ * @param address The start of the range
+ * @param size The size of the range
+ * @return On success 0 is returned
+ */
+int paging_unshare_tables( memory_context_t* context, ptr_t address, uint64_t size );
+
+/**
+ * Replaces a 4 MB page directory entry with a page table that
+ * maps the same physical memory with the same flags.
+ *
+ * @param page_directory The page directory
+ * @param index The index of the large page in the page directory
+ * @return On success 0 is returned
+ */
+int paging_split_large_page( uint32_t* page_directory, uint32_t index );
+
 int init_paging( void );
 
 #endif /* _ARCH_MM_PAGING_H_ */
@@ -0,0 +1,102 @@
+/* TLB invalidation
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _ARCH_MM_TLB_H_
+#define _ARCH_MM_TLB_H_
+
+#include <types.h>
+
+/**
+ * The number of separate address ranges a batch can hold. A batch
+ * with more ranges is turned into a full TLB flush.
+ */
+#define TLB_BATCH_RANGES 8
+
+/**
+ * Batches with more pages than this are flushed by reloading CR3
+ * instead of invalidating the pages one by one.
+ */
+#define TLB_INVLPG_LIMIT 32
+
+struct memory_context;
+struct i386_memory_context;
+
+typedef struct tlb_range {
+    ptr_t address;
+    uint32_t size;
+} tlb_range_t;
+
+/**
+ * @struct tlb_batch
+ *
+ * A set of linear address ranges whose TLB entries have to be
+ * invalidated. Overlapping and adjacent ranges are merged.
+ */
+typedef struct tlb_batch {
+    bool flush_all;
+    uint32_t page_count;
+    uint32_t range_count;
+    tlb_range_t ranges[ TLB_BATCH_RANGES ];
+} tlb_batch_t;
+
+void tlb_batch_init( tlb_batch_t* batch );
+void tlb_batch_add( tlb_batch_t* batch, ptr_t address, uint64_t size );
+
+/**
+ * Invalidates the TLB entries of an address range of a memory context
+ * on every processor that currently uses the context. The ranges of the
+ * kernel context are invalidated on all processors. If a batch is open
+ * on the context (see arch_memory_context_begin_tlb_batch()) the range
+ * is only recorded and flushed when the batch is closed.
+ *
+ * @param context The memory context
+ * @param address The start of the range
+ * @param size The size of the range
+ */
+void tlb_flush_range( struct memory_context* context, ptr_t address, uint64_t size );
+
+/**
+ * Invalidates an address range like tlb_flush_range() and frees the
+ * pages that were unmapped from it after the invalidation is done on
+ * every processor. If a batch is open the pages are freed when the
+ * batch is closed.
+ *
+ * @param context The memory context
+ * @param address The start of the range
+ * @param size The size of the range
+ * @param pages The pages collected by do_put_page_deferred()
+ */
+void tlb_flush_range_and_free( struct memory_context* context, ptr_t address, uint64_t size,
+                               struct memory_page* pages );
+
+/**
+ * Loads the page directory of a memory context on the current
+ * processor and updates the CPU masks of the old and new contexts.
+ * This has to be called with interrupts disabled.
+ *
+ * @param context The context to switch to
+ */
+void tlb_load_context( struct i386_memory_context* context );
+
+/**
+ * Executes the invalidations requested by other processors
+ * for the current one. This is called from the TLB flush IPI.
+ */
+void tlb_handle_shootdown( void );
+
+#endif /* _ARCH_MM_TLB_H_ */
@@ -26,16 +26,19 @@
 
 #ifdef ENABLE_SMP
 
-extern volatile uint32_t tlb_invalidate_mask;
+/* The processors that are up and running */
+extern volatile uint32_t active_cpu_mask;
 
 void processor_activated( void );
 
-void flush_tlb_global( void );
-
 int arch_boot_processors( void );
-#else
-#include <arch/cpu.h>
-#define flush_tlb_global flush_tlb
+
+/**
+ * Interrupts the specified CPU to make it run the scheduler.
+ *
+ * @param processor The index of the CPU
+ */
+void arch_send_reschedule_ipi( int processor );
 #endif /* ENABLE_SMP */
 
 #endif /* _ARCH_SMP_H_ */
@@ -21,6 +21,7 @@
 #include <console.h>
 #include <config.h>
 #include <kernel.h>
+#include <clockevent.h>
 #include <mm/region.h>
 #include <sched/scheduler.h>
 
@@ -31,6 +32,7 @@
 #include <arch/smp.h>
 #include <arch/atomic.h>
 #include <arch/interrupt.h>
+#include <arch/mm/tlb.h>
 
 static int fake_lapic_id = 0;
 
@@ -81,9 +83,19 @@ cpu_t* get_processor( void ) {
 }
 #endif /* ENABLE_SMP */
 
+static int lapic_set_next_event( clockevent_t* event, uint64_t delta );
+
+static clockevent_t lapic_clockevent = {
+    .name = "local APIC timer",
+    .features = CLOCKEVENT_ONESHOT,
+    .min_delta = 1,
+    .max_delta = 0,
+    .set_next_event = lapic_set_next_event
+};
+
 void apic_timer_irq( registers_t* regs ) {
     apic_write( LAPIC_EOI, 0 );
-    schedule( regs );
+    clockevent_handle_event( regs );
 }
 
 void apic_spurious_irq( registers_t* regs ) {
@@ -91,18 +103,58 @@ void apic_spurious_irq( registers_t* regs ) {
     apic_write( LAPIC_EOI, 0 );
 }
 
+void apic_reschedule_irq( registers_t* regs ) {
+    apic_write( LAPIC_EOI, 0 );
+    schedule( regs );
+}
+
 void apic_tlb_flush_irq( registers_t* regs ) {
 #ifdef ENABLE_SMP
-    int processor_id;
+    get_processor()->tlb_ipis_received++;
+    tlb_handle_shootdown();
+#endif /* ENABLE_SMP */
 
-    processor_id = get_processor_id();
+    apic_write( LAPIC_EOI, 0 );
+}
 
-    if ( atomic_test_and_clear( ( void* )&tlb_invalidate_mask, processor_id ) ) {
-        flush_tlb();
-    }
+#ifdef ENABLE_SMP
+void apic_send_ipi( int processor, int vector ) {
+    uint32_t tmp;
+
+    /* Wait for busy to clear */
+
+    while ( apic_read( LAPIC_ICR_LOW ) & ( 1 << 12 ) ) ;
+
+    apic_write( LAPIC_ICR_HIGH, arch_processor_table[ processor ].apic_id << 24 );
+
+    /* Fixed delivery mode, physical destination, no shorthand */
+
+    tmp = apic_read( LAPIC_ICR_LOW );
+    tmp &= ~0x000CDFFF;
+    tmp |= vector;
+
+    apic_write( LAPIC_ICR_LOW, tmp );
+}
+
+void arch_send_reschedule_ipi( int processor ) {
+    apic_send_ipi( processor, APIC_RESCHEDULE_IRQ );
+}
 #endif /* ENABLE_SMP */
 
-    apic_write( LAPIC_EOI, 0 );
+static int lapic_set_next_event( clockevent_t* event, uint64_t delta ) {
+    uint64_t count;
+
+    /* The timer counts the bus clock divided by 4 */
+
+    count = delta * ( arch_processor_table[ 0 ].bus_speed / 4 ) / 1000000;
+
+    if ( count == 0 ) {
+        count = 1;
+    }
+
+    apic_write( LAPIC_TIMER_INIT_COUNT, ( uint32_t )count );
+
+    return 0;
 }
 
 __init void calibrate_apic_timer( void ) {
@@ -217,23 +269,19 @@ __init int init_apic( void ) {
 }
 
 __init int init_apic_timer( void ) {
-    uint32_t init_count;
-
     if ( !apic_present ) {
         return -ENOENT;
     }
 
-    init_count = arch_processor_table[ 0 ].bus_speed;
-    init_count /= 1000;
-    init_count /= 4;
-
     apic_write( LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV_4 );
     apic_write(
         LAPIC_LVT_TIMER,
-        ( 1 << 17 ) | /* periodic timer */
-        APIC_TIMER_IRQ
+        APIC_TIMER_IRQ /* one-shot timer */
     );
-    apic_write( LAPIC_TIMER_INIT_COUNT, init_count );
 
-    return 0;
+    /* The longest delta is limited by the 32 bit initial count register */
+
+    lapic_clockevent.max_delta = 0xFFFFFFFFULL * 1000000 / ( arch_processor_table[ 0 ].bus_speed / 4 );
+
+    return clockevent_register( &lapic_clockevent );
 }
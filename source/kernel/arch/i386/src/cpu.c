@@ -48,6 +48,9 @@ i386_feature_t i386_features[] = {
     { CPU_FEATURE_PAE, "pae" },
     { CPU_FEATURE_IA64, "ia64" },
     { CPU_FEATURE_EST, "est" },
+    { CPU_FEATURE_PSE, "pse" },
+    { CPU_FEATURE_INVARIANT_TSC, "invariant_tsc" },
+    { CPU_FEATURE_SEP, "sep" },
     { 0, "" }
 };
 
@@ -107,6 +110,10 @@ __init int detect_cpu( void ) {
         family = ( regs[ 0 ] >> 8 ) & 0xF;
         model = ( regs[ 0 ] >> 4 ) & 0xF;
 
+        if ( regs[ 3 ] & ( 1 << 3 ) ) {
+            features |= CPU_FEATURE_PSE;
+        }
+
         if ( regs[ 3 ] & ( 1 << 4 ) ) {
             features |= CPU_FEATURE_TSC;
         }
@@ -119,9 +126,12 @@ __init int detect_cpu( void ) {
             features |= CPU_FEATURE_APIC;
         }
 
-        if ( regs[ 3 ] & ( 1 << 11 ) ) {
-            /* TODO: check processor signature */
-            features |= CPU_FEATURE_SYSCALL;
+        /* The early Pentium Pro models report SEP without actually
+           supporting the sysenter/sysexit instructions. */
+
+        if ( ( regs[ 3 ] & ( 1 << 11 ) ) &&
+             ( ( family != 6 ) || ( model >= 3 ) || ( ( regs[ 0 ] & 0xF ) >= 3 ) ) ) {
+            features |= CPU_FEATURE_SEP;
         }
 
         if ( regs[ 3 ] & ( 1 << 12 ) ) {
@@ -176,6 +186,16 @@ __init int detect_cpu( void ) {
         }
     }
 
+    if ( largest_func_num >= 0x80000007 ) {
+        cpuid( 0x80000007, regs );
+
+        /* The TSC runs at a constant rate in all P- and C-states */
+
+        if ( regs[ 3 ] & ( 1 << 8 ) ) {
+            features |= CPU_FEATURE_INVARIANT_TSC;
+        }
+    }
+
     if ( largest_func_num >= 0x80000004 ) {
         size_t j;
 
@@ -261,6 +281,8 @@ __init int detect_cpu( void ) {
         arch_processor_table[ i ].model = model;
     }
 
+    init_sysenter( 0 );
+
     /* Initialize random number generator */
     random_init(rdtsc());
 
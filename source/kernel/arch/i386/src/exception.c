@@ -62,6 +62,7 @@ void handle_invalid_opcode( registers_t* regs ) {
 }
 
 void handle_device_not_available( registers_t* regs ) {
+    bool ints;
     thread_t* thread;
     i386_thread_t* arch_thread;
     fpu_state_t* fpu_state;
@@ -70,7 +71,10 @@ void handle_device_not_available( registers_t* regs ) {
     arch_thread = ( i386_thread_t* )thread->arch_data;
     fpu_state = arch_thread->fpu_state;
 
-    scheduler_lock();
+    /* The FPU belongs to the local CPU, it is enough to make
+       sure that we are not preempted while loading its state */
+
+    ints = disable_interrupts();
 
     clear_task_switched();
 
@@ -86,7 +90,9 @@ void handle_device_not_available( registers_t* regs ) {
     load_fpu_state( fpu_state );
     arch_thread->flags |= THREAD_FPU_DIRTY;
 
-    scheduler_unlock();
+    if ( ints ) {
+        enable_interrupts();
+    }
 }
 
 void handle_general_protection_fault( registers_t* regs ) {
@@ -17,12 +17,15 @@
  */
 
 #include <errno.h>
+#include <irq.h>
 #include <console.h>
+#include <clockevent.h>
 #include <mm/region.h>
 #include <mm/context.h>
 
 #include <arch/hpet.h>
 #include <arch/cpu.h>
+#include <arch/interrupt.h>
 
 int hpet_present = 0;
 uint32_t hpet_address = 0;
@@ -40,6 +43,61 @@ void hpet_writel( uint32_t value, uint32_t reg ) {
     *( volatile uint32_t* )( hpet_virt_address + reg ) = value;
 }
 
+uint64_t hpet_read_counter( void ) {
+    uint32_t low;
+    uint32_t high;
+
+    /* Read the high half again if the low one wrapped around meanwhile */
+
+    do {
+        high = hpet_readl( HPET_COUNTER + 4 );
+        low = hpet_readl( HPET_COUNTER );
+    } while ( high != hpet_readl( HPET_COUNTER + 4 ) );
+
+    return ( ( uint64_t )high << 32 ) | low;
+}
+
+uint32_t hpet_get_period( void ) {
+    return hpet_period;
+}
+
+static int hpet_set_next_event( clockevent_t* event, uint64_t delta ) {
+    uint32_t comparator;
+
+    /* The period is in femtoseconds */
+
+    comparator = hpet_readl( HPET_COUNTER ) + ( uint32_t )( delta * 1000000000ULL / hpet_period );
+    hpet_writel( comparator, HPET_Tn_COMPARATOR( 0 ) );
+
+    /* The comparator only matches once, the event is lost if the
+       counter passed it before it was written */
+
+    if ( ( int32_t )( hpet_readl( HPET_COUNTER ) - comparator ) >= 0 ) {
+        return -ETIME;
+    }
+
+    return 0;
+}
+
+static clockevent_t hpet_clockevent = {
+    .name = "HPET",
+    .features = CLOCKEVENT_ONESHOT,
+    .min_delta = 5,
+    .max_delta = 0,
+    .set_next_event = hpet_set_next_event
+};
+
+static int hpet_irq( int irq, void* data, registers_t* regs ) {
+    /* The irq was acked and masked by the interrupt handler.
+       We have to re-enable it here to let it fire next time. */
+
+    arch_enable_irq( irq );
+
+    clockevent_handle_event( regs );
+
+    return 0;
+}
+
 static int hpet_stop_counter( void ) {
     uint32_t cfg;
 
@@ -155,3 +213,37 @@ int hpet_init( void ) {
 
     return -ENOENT;
 }
+
+int hpet_init_clockevent( void ) {
+    int error;
+    uint32_t cfg;
+
+    if ( !hpet_present ) {
+        return -ENOENT;
+    }
+
+    /* Use the first timer in 32 bit one-shot mode */
+
+    cfg = hpet_readl( HPET_Tn_CONFIG( 0 ) );
+    cfg &= ~HPET_TN_PERIODIC;
+    cfg |= HPET_TN_INT_ENABLE | HPET_TN_32BIT;
+    hpet_writel( cfg, HPET_Tn_CONFIG( 0 ) );
+
+    /* Route the first timer to IRQ 0 instead of the PIT */
+
+    cfg = hpet_readl( HPET_CONFIG );
+    cfg |= HPET_CONFIG_LEGACY;
+    hpet_writel( cfg, HPET_CONFIG );
+
+    error = request_irq( 0, hpet_irq, NULL );
+
+    if ( error < 0 ) {
+        return error;
+    }
+
+    /* The comparator must stay within half of the 32 bit range */
+
+    hpet_clockevent.max_delta = 0x7FFFFFFFULL * hpet_period / 1000000000ULL;
+
+    return clockevent_register( &hpet_clockevent );
+}
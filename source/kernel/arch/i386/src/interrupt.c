@@ -67,6 +67,7 @@ extern void isr128( void );
 extern void isr240( void );
 extern void isr241( void );
 extern void isr242( void );
+extern void isr243( void );
 
 idt_descriptor_t idt[ IDT_ENTRIES ];
 
@@ -183,6 +184,7 @@ __init int init_interrupts( void ) {
     set_interrupt_gate( APIC_TIMER_IRQ, isr240 );
     set_interrupt_gate( APIC_SPURIOUS_IRQ, isr241 );
     set_interrupt_gate( APIC_TLB_FLUSH_IRQ, isr242 );
+    set_interrupt_gate( APIC_RESCHEDULE_IRQ, isr243 );
 
     idtp.limit = ( sizeof( idt_descriptor_t ) * IDT_ENTRIES ) - 1;
     idtp.base = ( uint32_t )&idt;
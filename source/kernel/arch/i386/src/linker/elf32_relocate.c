@@ -18,9 +18,33 @@
 
 #include <console.h>
 #include <errno.h>
+#include <smp.h>
+#include <mm/context.h>
 #include <lib/string.h>
 
 #include <arch/linker/elf32.h>
+#include <arch/mm/config.h>
+#include <arch/mm/context.h>
+
+/* The text of the images is mapped read-only and the kernel can't
+   write to read-only pages (CR0.WP is set), so the relocations are
+   written through the identity mapping of the physical page. Pages
+   shared with the file cache are replaced with a private copy first. */
+static uint32_t* elf32_get_reloc_target( uint32_t* target ) {
+    ptr_t physical;
+
+    /* Make sure that the page is loaded */
+
+    ( void )*( volatile uint32_t* )target;
+
+    if ( ( ( ( ptr_t )target & ~PAGE_MASK ) > PAGE_SIZE - sizeof( uint32_t ) ) ||
+         ( arch_memory_context_unshare_page( current_process()->memory_context,
+                                             ( ptr_t )target, &physical ) != 0 ) ) {
+        return target;
+    }
+
+    return ( uint32_t* )physical;
+}
 
 static int do_elf32_relocate_i386( elf32_context_t* context, elf32_image_t* image ) {
     uint32_t i;
@@ -31,10 +55,12 @@ static int do_elf32_relocate_i386( elf32_context_t* context, elf32_image_t* imag
 
     for ( i = 0, reloc = &image->info.reloc_table[0]; i < image->info.reloc_count; i++, reloc++ ) {
         uint32_t* target;
+        uint32_t* value;
         my_elf_symbol_t* symbol;
 
         symbol = &symbol_table[ ELF32_R_SYM( reloc->info ) ];
         target = ( uint32_t* )( image->text_region->address + reloc->offset - image->info.virtual_address );
+        value = elf32_get_reloc_target( target );
 
         switch ( ELF32_R_TYPE( reloc->info ) ) {
             case R_386_NONE :
@@ -49,7 +75,7 @@ static int do_elf32_relocate_i386( elf32_context_t* context, elf32_image_t* imag
                     return -ENOENT;
                 }
 
-                *target = *target + img->text_region->address + sym->address - img->info.virtual_address;
+                *value = *value + img->text_region->address + sym->address - img->info.virtual_address;
 
                 break;
             }
@@ -63,7 +89,7 @@ static int do_elf32_relocate_i386( elf32_context_t* context, elf32_image_t* imag
                     return -ENOENT;
                 }
 
-                *target = *target +
+                *value = *value +
                     img->text_region->address + sym->address - img->info.virtual_address - ( uint32_t )target;
 
                 break;
@@ -96,7 +122,7 @@ static int do_elf32_relocate_i386( elf32_context_t* context, elf32_image_t* imag
                     return -ENOENT;
                 }
 
-                *target = img->text_region->address + sym->address - img->info.virtual_address;
+                *value = img->text_region->address + sym->address - img->info.virtual_address;
 
                 break;
             }
@@ -110,13 +136,13 @@ static int do_elf32_relocate_i386( elf32_context_t* context, elf32_image_t* imag
                     return -ENOENT;
                 }
 
-                *target = img->text_region->address + sym->address - img->info.virtual_address;
+                *value = img->text_region->address + sym->address - img->info.virtual_address;
 
                 break;
             }
 
             case R_386_RELATIVE :
-                *target += image->text_region->address;
+                *value += image->text_region->address;
 
                 break;
 
@@ -16,14 +16,18 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <smp.h>
 #include <errno.h>
 #include <kernel.h>
 #include <console.h>
 #include <mm/kmalloc.h>
 #include <mm/context.h>
 #include <mm/pages.h>
+#include <lock/mutex.h>
 #include <lib/string.h>
 
+#include <arch/cpu.h>
+#include <arch/interrupt.h>
 #include <arch/mm/context.h>
 #include <arch/mm/paging.h>
 
@@ -49,6 +53,12 @@ int arch_memory_context_init( memory_context_t* context ) {
 
     memsetl( arch_context->page_directory, 0, PAGE_SIZE / 4 );
 
+    atomic_set( &arch_context->cpu_mask, 0 );
+    init_spinlock( &arch_context->tlb_lock, "TLB batch" );
+    arch_context->tlb_batch_depth = 0;
+    tlb_batch_init( &arch_context->tlb_pending );
+    arch_context->tlb_pending_pages = NULL;
+
     /* Set the arch. pointer in the memory context */
 
     context->arch_data = ( void* )arch_context;
@@ -69,14 +79,23 @@ int arch_memory_context_destroy( memory_context_t* context ) {
 
     page_directory = arch_context->page_directory;
 
+    spinlock_disable( &pages_lock );
+
     for ( i = FIRST_USER_ADDRESS / PGDIR_SIZE; i < 1024; i++ ) {
-        if ( page_directory[ i ] == 0 ) {
+        /* Large pages don't have a page table to free */
+
+        if ( ( page_directory[ i ] == 0 ) ||
+             ( page_directory[ i ] & PAGE_LARGE ) ) {
             continue;
         }
 
-        free_pages( ( void* )( page_directory[ i ] & PAGE_MASK ), 1 );
+        /* Shared page tables are freed by their last user */
+
+        do_put_page( &memory_pages[ ( page_directory[ i ] & PAGE_MASK ) / PAGE_SIZE ] );
     }
 
+    spinunlock_enable( &pages_lock );
+
     free_pages( ( void* )page_directory, 1 );
     kfree( arch_context );
 
@@ -99,6 +118,25 @@ int arch_memory_context_clone( memory_context_t* old_context, memory_context_t*
     return 0;
 }
 
+void arch_memory_context_load( memory_context_t* context ) {
+    bool ints;
+    i386_cpu_t* arch_cpu;
+    i386_memory_context_t* arch_context;
+
+    arch_context = ( i386_memory_context_t* )context->arch_data;
+
+    ints = disable_interrupts();
+
+    arch_cpu = ( i386_cpu_t* )get_processor()->arch_data;
+
+    tlb_load_context( arch_context );
+    arch_cpu->tss.cr3 = ( register_t )arch_context->page_directory;
+
+    if ( ints ) {
+        enable_interrupts();
+    }
+}
+
 int arch_memory_context_translate_address( memory_context_t* context, ptr_t linear, ptr_t* physical ) {
     uint32_t offset;
     uint32_t* pgd_entry;
@@ -116,6 +154,12 @@ int arch_memory_context_translate_address( memory_context_t* context, ptr_t line
         return -EINVAL;
     }
 
+    if ( ( *pgd_entry ) & PAGE_LARGE ) {
+        *physical = ( ( *pgd_entry ) & PGDIR_MASK ) + ( linear & ~PGDIR_MASK ) + offset;
+
+        return 0;
+    }
+
     pt_entry = &( ( uint32_t* )( *pgd_entry & PAGE_MASK ) )[ PT_INDEX( linear ) ];
 
     if ( ( ( *pt_entry ) & PAGE_PRESENT ) == 0 ) {
@@ -126,3 +170,88 @@ int arch_memory_context_translate_address( memory_context_t* context, ptr_t line
 
     return 0;
 }
+
+int arch_memory_context_unshare_page( memory_context_t* context, ptr_t linear, ptr_t* physical ) {
+    int error;
+    uint32_t ptr;
+    uint32_t offset;
+    uint32_t* pgd_entry;
+    uint32_t* pt_entry;
+    memory_page_t* page;
+    i386_memory_context_t* arch_context;
+
+    if ( linear < FIRST_USER_ADDRESS ) {
+        *physical = linear;
+
+        return 0;
+    }
+
+    offset = linear & ~PAGE_MASK;
+    linear &= PAGE_MASK;
+
+    arch_context = ( i386_memory_context_t* )context->arch_data;
+
+    mutex_lock( context->mutex, LOCK_IGNORE_SIGNAL );
+
+    error = paging_unshare_tables( context, linear, PAGE_SIZE );
+
+    if ( error < 0 ) {
+        goto out;
+    }
+
+    pgd_entry = &arch_context->page_directory[ PGD_INDEX( linear ) ];
+
+    /* Large pages are used only by remapped regions that are not
+       backed by shared memory pages, so they can't be unshared. */
+
+    if ( ( ( ( *pgd_entry ) & PAGE_PRESENT ) == 0 ) ||
+         ( ( *pgd_entry ) & PAGE_LARGE ) ) {
+        error = -EINVAL;
+        goto out;
+    }
+
+    pt_entry = &( ( uint32_t* )( *pgd_entry & PAGE_MASK ) )[ PT_INDEX( linear ) ];
+
+    if ( ( ( *pt_entry ) & PAGE_PRESENT ) == 0 ) {
+        error = -EINVAL;
+        goto out;
+    }
+
+    ptr = *pt_entry & PAGE_MASK;
+    error = 0;
+
+    if ( ptr < memory_size ) {
+        spinlock_disable( &pages_lock );
+
+        page = &memory_pages[ ptr / PAGE_SIZE ];
+
+        if ( page->ref_count > 1 ) {
+            void* new_page;
+
+            new_page = do_alloc_pages( &memory_descriptors[ MEM_COMMON ], 1 );
+
+            if ( new_page == NULL ) {
+                error = -ENOMEM;
+            } else {
+                memcpy( new_page, ( void* )ptr, PAGE_SIZE );
+
+                page->ref_count--;
+
+                ptr = ( uint32_t )new_page;
+                *pt_entry = ptr | ( *pt_entry & ~PAGE_MASK );
+            }
+        }
+
+        spinunlock_enable( &pages_lock );
+    }
+
+    if ( error == 0 ) {
+        tlb_flush_range( context, linear, PAGE_SIZE );
+        *physical = ptr + offset;
+    }
+
+ out:
+    mutex_unlock( context->mutex );
+
+    return error;
+}
@@ -29,16 +29,36 @@
 #include <mm/context.h>
 #include <mm/pages.h>
 #include <vfs/vfs.h>
+#include <vfs/filecache.h>
 #include <lib/string.h>
 
 #include <arch/cpu.h>
 #include <arch/interrupt.h>
 #include <arch/mm/paging.h>
+#include <arch/mm/tlb.h>
 
 extern lock_id region_lock;
 
+extern char __copy_user_start[];
+extern char __copy_user_end[];
+extern char __copy_user_fault[];
+
 void dump_registers( registers_t* regs );
 
+/* A kernel mode fault inside arch_copy_user_data() is not fatal, the
+   copy is aborted and -EFAULT is returned to the caller. */
+static int fixup_user_copy( registers_t* regs ) {
+    if ( ( ( regs->error_code & 0x4 ) == 0 ) &&
+         ( regs->eip >= ( register_t )__copy_user_start ) &&
+         ( regs->eip < ( register_t )__copy_user_end ) ) {
+        regs->eip = ( register_t )__copy_user_fault;
+
+        return 1;
+    }
+
+    return 0;
+}
+
 static void invalid_page_fault( thread_t* thread, registers_t* regs, uint32_t cr2, const char* message ) {
     kprintf( ERROR, "Invalid page fault at 0x%08x (%s)\n", cr2, message );
     dump_registers( regs );
@@ -62,21 +82,32 @@ static void invalid_page_fault( thread_t* thread, registers_t* regs, uint32_t cr
     }
 }
 
-static int handle_cow_page( memory_context_t* context, uint32_t address ) {
+static int handle_cow_page( memory_region_t* region, uint32_t address ) {
     uint32_t ptr;
     uint32_t index;
     int copy_page;
     memory_page_t* page;
+    memory_context_t* context;
 
     i386_memory_context_t* arch_context;
     uint32_t* page_directory;
     uint32_t* page_table;
 
+    context = region->context;
     arch_context = ( i386_memory_context_t* )context->arch_data;
     page_directory = arch_context->page_directory;
 
     mutex_lock( context->mutex, LOCK_IGNORE_SIGNAL );
 
+    /* The write may have faulted because the page table is shared
+       with another context, the table is copied first. */
+
+    if ( __unlikely( paging_unshare_tables( context, address & PAGE_MASK, PAGE_SIZE ) != 0 ) ) {
+        mutex_unlock( context->mutex );
+
+        return -ENOMEM;
+    }
+
     index = PGD_INDEX( address );
     ASSERT( page_directory[ index ] != 0 );
     page_table = ( uint32_t* )( page_directory[ index ] & PAGE_MASK );
@@ -91,7 +122,7 @@ static int handle_cow_page( memory_context_t* context, uint32_t address ) {
     page = &memory_pages[ ptr / PAGE_SIZE ];
     ASSERT( page->ref_count > 0 );
 
-    copy_page = ( page->ref_count > 1 );
+    copy_page = ( ( page->ref_count > 1 ) || ( ptr == zero_page ) );
 
     if ( copy_page ) {
         /* We have to copy this page */
@@ -105,12 +136,16 @@ static int handle_cow_page( memory_context_t* context, uint32_t address ) {
             return -ENOMEM;
         }
 
-        memcpy( new_page, ( void* )ptr, PAGE_SIZE );
+        if ( ptr == zero_page ) {
+            memsetl( new_page, 0, PAGE_SIZE / 4 );
+        } else {
+            memcpy( new_page, ( void* )ptr, PAGE_SIZE );
+        }
 
         page->ref_count--;
         ASSERT( page->ref_count > 0 );
 
-        page_table[ index ] = ( uint32_t )new_page | PAGE_PRESENT | PAGE_USER | PAGE_WRITE;
+        page_table[ index ] = ( uint32_t )new_page | get_paging_flags_for_region( region );
     } else {
         /* Copy-on-write already done on this page,
            simply give write access back. */
@@ -119,26 +154,27 @@ static int handle_cow_page( memory_context_t* context, uint32_t address ) {
     }
 
     spinunlock_enable( &pages_lock );
-    mutex_unlock( context->mutex );
 
-    if ( copy_page ) {
-        scheduler_lock();
-        context->process->pmem_size += PAGE_SIZE;
-        scheduler_unlock();
+    /* The copy of a shared page is already counted in the RSS
+       of the region, only the zero page was not accounted. */
+
+    if ( ptr == zero_page ) {
+        memory_region_account_pages( region, 1 );
     }
 
-    invlpg( address );
+    mutex_unlock( context->mutex );
+
+    /* Other threads of the process may still have the old page in their TLB */
+
+    tlb_flush_range( context, address, PAGE_SIZE );
 
     return 0;
 }
 
-#define MAX_PAGES_PER_LOAD 6
-
-static int handle_file_mapping( memory_region_t* region, uint32_t address ) {
+static int handle_lazy_page( memory_region_t* region, uint32_t address, int write ) {
     int error;
-    uint32_t page_count;
+    uint32_t* pt;
     uint32_t paging_flags;
-    uint32_t region_offset;
     uint32_t* page_directory;
     memory_context_t* context;
     i386_memory_context_t* arch_context;
@@ -149,15 +185,17 @@ static int handle_file_mapping( memory_region_t* region, uint32_t address ) {
     paging_flags = get_paging_flags_for_region( region );
 
     address &= PAGE_MASK;
-    ASSERT( address >= region->address );
-
-    region_offset = address - region->address;
-    page_count = PAGE_ALIGN( region->size - region_offset ) / PAGE_SIZE;
-    page_count = MIN( page_count, MAX_PAGES_PER_LOAD );
 
     mutex_lock( context->mutex, LOCK_IGNORE_SIGNAL );
 
-    /* Map the page table of this page */
+    error = paging_unshare_tables( context, address, PAGE_SIZE );
+
+    if ( __unlikely( error < 0 ) ) {
+        mutex_unlock( context->mutex );
+        return error;
+    }
+
+    /* Make sure that the page table of the page exists */
 
     error = paging_alloc_table_entries(
         page_directory,
@@ -172,94 +210,272 @@ static int handle_file_mapping( memory_region_t* region, uint32_t address ) {
         return error;
     }
 
-    /* Count the unmapped pages */
+    pt = ( uint32_t* )( page_directory[ PGD_INDEX( address ) ] & PAGE_MASK );
+
+    /* Maybe a different thread accessed the same page already.
+       If it was a read, a write access will fault again and
+       will be handled as a copy-on-write. */
+
+    if ( pt[ PT_INDEX( address ) ] != 0 ) {
+        mutex_unlock( context->mutex );
+        return 0;
+    }
+
+    if ( write ) {
+        void* p = alloc_pages( 1, MEM_COMMON );
+
+        if ( __unlikely( p == NULL ) ) {
+            mutex_unlock( context->mutex );
+            return -ENOMEM;
+        }
+
+        memsetl( p, 0, PAGE_SIZE / 4 );
+
+        pt[ PT_INDEX( address ) ] = ( uint32_t )p | paging_flags;
+        memory_region_account_pages( region, 1 );
+    } else {
+        spinlock_disable( &pages_lock );
+        memory_pages[ zero_page / PAGE_SIZE ].ref_count++;
+        spinunlock_enable( &pages_lock );
+
+        pt[ PT_INDEX( address ) ] = zero_page | ( paging_flags & ~PAGE_WRITE );
+    }
+
+    mutex_unlock( context->mutex );
+
+    invlpg( address );
+
+    return 0;
+}
+
+static inline uint32_t* get_page_entry( uint32_t* page_directory, ptr_t address ) {
+    uint32_t* pt;
+
+    pt = ( uint32_t* )( page_directory[ PGD_INDEX( address ) ] & PAGE_MASK );
+
+    return &pt[ PT_INDEX( address ) ];
+}
+
+static int map_cached_file_pages( memory_region_t* region, uint32_t* page_directory,
+                                  uint32_t index, uint32_t count, uint32_t* mapped ) {
+    int i;
+    int loaded;
+    ptr_t address;
+    uint32_t paging_flags;
+    ptr_t pages[ REGION_RA_MAX_PAGES ];
+
+    /* The cached pages are mapped read-only, writable
+       mappings get a private copy on the first write. */
+
+    paging_flags = get_paging_flags_for_region( region ) & ~PAGE_WRITE;
+    address = region->address + index * PAGE_SIZE;
+
+    while ( count > 0 ) {
+        loaded = file_cache_get_pages(
+            region->file,
+            region->file_offset / PAGE_SIZE + index,
+            MIN( count, REGION_RA_MAX_PAGES ), pages
+        );
+
+        if ( __unlikely( loaded < 0 ) ) {
+            return loaded;
+        }
+
+        memory_region_account_pages( region, loaded );
+
+        for ( i = 0; i < loaded; i++, address += PAGE_SIZE ) {
+            uint32_t* entry = get_page_entry( page_directory, address );
+
+            ASSERT( *entry == 0 );
+            *entry = pages[ i ] | paging_flags;
+        }
+
+        index += loaded;
+        count -= loaded;
+        *mapped += loaded;
+    }
+
+    return 0;
+}
 
+static int map_private_file_pages( memory_region_t* region, uint32_t* page_directory,
+                                   uint32_t index, uint32_t count, uint32_t* mapped ) {
+    uint8_t* p;
     uint32_t i;
-    uint32_t pgd_ind = PGD_INDEX( address );
-    uint32_t pt_ind = PT_INDEX( address );
-    uint32_t* pt = ( uint32_t* )( page_directory[ pgd_ind ] & PAGE_MASK );
+    uint32_t loaded;
+    ptr_t address;
+    uint32_t paging_flags;
+    uint32_t region_offset;
 
-    for ( i = 0; i < page_count; i++ ) {
-        if ( pt[ pt_ind ] != 0 ) {
-            break;
+    paging_flags = get_paging_flags_for_region( region );
+
+    while ( count > 0 ) {
+        /* Read as many pages at once as possible, but fall
+           back to smaller blocks if the memory is fragmented. */
+
+        loaded = count;
+
+        while ( ( p = ( uint8_t* )alloc_pages( loaded, MEM_COMMON ) ) == NULL ) {
+            if ( loaded == 1 ) {
+                return -ENOMEM;
+            }
+
+            loaded /= 2;
         }
 
-        if ( __unlikely( pt_ind == 1023 ) ) {
-            pt = ( uint32_t* )( page_directory[ ++pgd_ind ] & PAGE_MASK );
-            pt_ind = 0;
+        region_offset = index * PAGE_SIZE;
+
+        if ( region_offset >= region->file_size ) {
+            memsetl( p, 0, loaded * PAGE_SIZE / 4 );
         } else {
-            pt_ind++;
+            uint32_t file_data_size;
+
+            file_data_size = MIN( region->file_size - region_offset, loaded * PAGE_SIZE );
+
+            if ( do_pread_helper( region->file, p, file_data_size,
+                                  region->file_offset + region_offset ) != file_data_size ) {
+                free_pages( p, loaded );
+                return -EIO;
+            }
+
+            if ( file_data_size < loaded * PAGE_SIZE ) {
+                memset( p + file_data_size, 0, loaded * PAGE_SIZE - file_data_size );
+            }
+        }
+
+        memory_region_account_pages( region, loaded );
+
+        address = region->address + region_offset;
+
+        for ( i = 0; i < loaded; i++, address += PAGE_SIZE, p += PAGE_SIZE ) {
+            uint32_t* entry = get_page_entry( page_directory, address );
+
+            ASSERT( *entry == 0 );
+            *entry = ( uint32_t )p | paging_flags;
         }
+
+        index += loaded;
+        count -= loaded;
+        *mapped += loaded;
     }
 
+    return 0;
+}
+
+static int handle_file_mapping( memory_region_t* region, uint32_t address ) {
+    int error;
+    uint32_t i;
+    uint32_t run;
+    uint32_t last;
+    uint32_t index;
+    uint32_t first;
+    uint32_t count;
+    uint32_t mapped;
+    uint32_t cached_limit;
+    uint32_t paging_flags;
+    uint32_t* page_directory;
+    memory_context_t* context;
+    i386_memory_context_t* arch_context;
+
+    context = region->context;
+    arch_context = ( i386_memory_context_t* )context->arch_data;
+    page_directory = arch_context->page_directory;
+    paging_flags = get_paging_flags_for_region( region );
+
+    address &= PAGE_MASK;
+    ASSERT( address >= region->address );
+
+    index = ( address - region->address ) / PAGE_SIZE;
+
+    mutex_lock( context->mutex, LOCK_IGNORE_SIGNAL );
+
     /* Maybe a different thread tried to access the same
        page and already loaded it. */
-    if (i == 0) {
-        mutex_unlock(context->mutex);
+
+    if ( ( page_directory[ PGD_INDEX( address ) ] != 0 ) &&
+         ( *get_page_entry( page_directory, address ) != 0 ) ) {
+        mutex_unlock( context->mutex );
         return 0;
     }
 
-    page_count = i;
+    count = memory_region_readahead( region, index, &first );
+    last = first + count;
+
+    error = paging_unshare_tables( context, region->address + first * PAGE_SIZE, count * PAGE_SIZE );
 
-    /* Allocate memory for the new pages */
+    if ( __unlikely( error < 0 ) ) {
+        mutex_unlock( context->mutex );
+        return error;
+    }
 
-    void* p = alloc_pages( page_count, MEM_COMMON );
+    /* Map the page tables of the window */
 
-    if ( __unlikely( p == NULL ) ) {
+    error = paging_alloc_table_entries(
+        page_directory,
+        PGD_INDEX( region->address + first * PAGE_SIZE ),
+        PGD_INDEX( region->address + ( last - 1 ) * PAGE_SIZE ),
+        paging_flags | PAGE_WRITE,
+        0
+    );
+
+    if ( __unlikely( error < 0 ) ) {
         mutex_unlock( context->mutex );
-        return -ENOMEM;
+        return error;
     }
 
-    /* Load the data to the newly allocated pages */
+    /* Pages that are completely filled from the file are mapped from
+       the file cache, they are shared by all mappings of the file. */
 
-    if ( region_offset >= region->file_size ) {
-        memsetl( p, 0, page_count * PAGE_SIZE / 4 );
+    if ( ( region->file_offset % PAGE_SIZE ) == 0 ) {
+        cached_limit = region->file_size / PAGE_SIZE;
     } else {
-        off_t file_read_offset;
-        uint32_t file_data_size;
+        cached_limit = 0;
+    }
 
-        file_read_offset = region->file_offset + region_offset;
-        file_data_size = region->file_size - region_offset;
-        file_data_size = MIN( file_data_size, page_count * PAGE_SIZE );
+    /* Load the unmapped runs of the window, every run is
+       read from the file with as few requests as possible. */
 
-        ASSERT( ( file_data_size > 0 ) && ( file_data_size <= page_count * PAGE_SIZE ) );
+    mapped = 0;
 
-        if ( do_pread_helper( region->file, p, file_data_size, file_read_offset ) != file_data_size ) {
-            mutex_unlock( context->mutex );
-            free_pages( p, page_count );
-            return -EIO;
+    for ( i = first; i < last; i += run ) {
+        if ( *get_page_entry( page_directory, region->address + i * PAGE_SIZE ) != 0 ) {
+            run = 1;
+            continue;
         }
 
-        if ( file_data_size < page_count * PAGE_SIZE ) {
-            memset( ( uint8_t* )p + file_data_size, 0, page_count * PAGE_SIZE - file_data_size );
+        for ( run = 1; i + run < last; run++ ) {
+            if ( ( i + run == cached_limit ) ||
+                 ( *get_page_entry( page_directory, region->address + ( i + run ) * PAGE_SIZE ) != 0 ) ) {
+                break;
+            }
         }
-    }
 
-    /* Map the new pages */
+        if ( i < cached_limit ) {
+            error = map_cached_file_pages( region, page_directory, i, run, &mapped );
+        } else {
+            error = map_private_file_pages( region, page_directory, i, run, &mapped );
+        }
 
-    uint32_t p2 = ( uint32_t )p;
+        if ( error < 0 ) {
+            break;
+        }
+    }
 
-    pgd_ind = PGD_INDEX( address );
-    pt_ind = PT_INDEX( address );
-    pt = ( uint32_t* )( page_directory[ pgd_ind ] & PAGE_MASK );
+    memory_region_account_file_fault( region, mapped );
 
-    for ( i = 0; i < page_count; i++, p2 += PAGE_SIZE ) {
-        ASSERT( pt[ pt_ind ] == 0 );
-        pt[ pt_ind ] = p2 | paging_flags;
+    /* Failing to load the pages around the faulting one is not an error */
 
-        if ( __unlikely( pt_ind == 1023 ) ) {
-            pt = ( uint32_t* )( page_directory[ ++pgd_ind ] & PAGE_MASK );
-            pt_ind = 0;
-        } else {
-            pt_ind++;
-        }
+    if ( *get_page_entry( page_directory, address ) != 0 ) {
+        error = 0;
     }
 
     mutex_unlock( context->mutex );
 
-    invlpg( address );
+    if ( error == 0 ) {
+        invlpg( address );
+    }
 
-    return 0;
+    return error;
 }
 
 int handle_page_fault( registers_t* regs ) {
@@ -281,27 +497,45 @@ int handle_page_fault( registers_t* regs ) {
     /* If no region was found, this is an invalid memory access. */
 
     if ( region == NULL ) {
-        invalid_page_fault( thread, regs, cr2, "invalid access" );
+        if ( !fixup_user_copy( regs ) ) {
+            invalid_page_fault( thread, regs, cr2, "invalid access" );
+        }
+
         return 0;
     }
 
-    /* Handle copy-on-write pages */
+    /* Handle copy-on-write pages. The kernel can also write to
+       them as the write protection is enabled in CR0. */
 
-    if ( ( regs->error_code == 7 ) &&
+    if ( ( ( regs->error_code & 3 ) == 3 ) &&
          ( region->flags & REGION_WRITE ) ) {
-        error = handle_cow_page( region->context, cr2 );
+        error = handle_cow_page( region, cr2 );
     } else if ( ( ( regs->error_code & 1 ) == 0 ) &&
                 ( region->file != NULL ) ) {
         error = handle_file_mapping( region, cr2 );
+    } else if ( ( ( regs->error_code & 1 ) == 0 ) &&
+                ( region->flags & REGION_LAZY ) &&
+                ( region->flags & REGION_MAPPING_FLAGS ) &&
+                ( ( ( regs->error_code & 2 ) == 0 ) || ( region->flags & REGION_WRITE ) ) ) {
+        error = handle_lazy_page( region, cr2, regs->error_code & 2 );
     } else {
         error = -EINVAL;
     }
 
     memory_region_put( region );
 
+    /* Give back the unused pages of the file cache if the memory is
+       exhausted, the access is retried when we return from here. */
+
+    if ( ( error == -ENOMEM ) &&
+         ( file_cache_shrink( FILE_CACHE_SHRINK_BATCH ) > 0 ) ) {
+        return 0;
+    }
+
     /* In case of any error, this is an invalid page fault */
 
-    if ( error != 0 ) {
+    if ( ( error != 0 ) &&
+         ( !fixup_user_copy( regs ) ) ) {
         char* error_msg;
 
         switch ( error ) {
@@ -29,9 +29,13 @@
 
 #include <arch/cpu.h>
 #include <arch/mm/paging.h>
+#include <arch/mm/tlb.h>
 
 static i386_memory_context_t i386_kernel_memory_context;
 
+ptr_t zero_page;
+bool paging_large_pages = false;
+
 int get_paging_flags_for_region( memory_region_t* region ) {
     register uint32_t flags;
 
@@ -112,7 +116,7 @@ int paging_fill_table_entries( uint32_t* table, uint32_t address, uint32_t from,
     return 0;
 }
 
-int paging_clear_table_entries( uint32_t* table, uint32_t from, uint32_t to ) {
+int paging_clear_table_entries( uint32_t* table, uint32_t from, uint32_t to, memory_page_t** freed ) {
     uint32_t i;
 
     ASSERT( ( to >= 0 ) && ( to <= 1023 ) );
@@ -125,12 +129,15 @@ int paging_clear_table_entries( uint32_t* table, uint32_t from, uint32_t to ) {
     return 0;
 }
 
-int paging_free_table_entries( uint32_t* table, uint32_t from, uint32_t to ) {
+int paging_free_table_entries( uint32_t* table, uint32_t from, uint32_t to, memory_page_t** freed ) {
+    int count;
     uint32_t i;
 
     ASSERT( ( to >= 0 ) && ( to <= 1023 ) );
     ASSERT( from <= to );
 
+    count = 0;
+
     for ( i = from; i <= to; i++ ) {
         uint32_t ptr;
 
@@ -141,16 +148,17 @@ int paging_free_table_entries( uint32_t* table, uint32_t from, uint32_t to ) {
         ptr = table[ i ] & PAGE_MASK;
 
         if ( ptr < memory_size ) {
-            memory_page_t* page = &memory_pages[ ptr / PAGE_SIZE ];
+            do_put_page_deferred( &memory_pages[ ptr / PAGE_SIZE ], freed );
 
-            ASSERT( page->ref_count > 0 );
-            page->ref_count--;
+            if ( ptr != zero_page ) {
+                count++;
+            }
         }
 
         table[ i ] = 0;
     }
 
-    return 0;
+    return count;
 }
 
 int paging_clone_table_entries( uint32_t* old_table, uint32_t* new_table,
@@ -164,6 +172,12 @@ int paging_clone_table_entries( uint32_t* old_table, uint32_t* new_table,
         uint32_t ptr;
         memory_page_t* page;
 
+        /* Pages of lazy regions may be not allocated yet */
+
+        if ( old_table[ i ] == 0 ) {
+            continue;
+        }
+
         /* Remove write permission if needed and copy the address of the page */
 
         if ( remove_write ) {
@@ -198,8 +212,159 @@ int paging_copy_table_entries( uint32_t* old_table, uint32_t* new_table, uint32_
     return 0;
 }
 
-__init int init_paging( void ) {
+void paging_share_table( uint32_t* old_page_directory, uint32_t* new_page_directory, uint32_t index ) {
+    uint32_t entry;
+
+    entry = old_page_directory[ index ];
+
+    if ( entry == 0 ) {
+        return;
+    }
+
+    ASSERT( ( entry & PAGE_LARGE ) == 0 );
+    ASSERT( new_page_directory[ index ] == 0 );
+
+    /* The table gets one more reference, the pages mapped by it
+       are referenced only once by the table itself. */
+
+    memory_pages[ ( entry & PAGE_MASK ) / PAGE_SIZE ].ref_count++;
+
+    entry &= ~PAGE_WRITE;
+
+    old_page_directory[ index ] = entry;
+    new_page_directory[ index ] = entry;
+}
+
+int paging_unshare_table( uint32_t* page_directory, uint32_t index ) {
+    uint32_t i;
+    uint32_t entry;
+    uint32_t* old_table;
+    uint32_t* new_table;
+    memory_page_t* table_page;
+
+    entry = page_directory[ index ];
+
+    if ( ( entry == 0 ) ||
+         ( entry & ( PAGE_LARGE | PAGE_WRITE ) ) ) {
+        return 0;
+    }
+
+    old_table = ( uint32_t* )( entry & PAGE_MASK );
+    table_page = &memory_pages[ ( uint32_t )old_table / PAGE_SIZE ];
+
+    ASSERT( table_page->ref_count > 0 );
+
+    /* The other users of the table are already gone */
+
+    if ( table_page->ref_count == 1 ) {
+        page_directory[ index ] = entry | PAGE_WRITE;
+
+        return 1;
+    }
+
+    new_table = ( uint32_t* )do_alloc_pages( &memory_descriptors[ MEM_COMMON ], 1 );
+
+    if ( new_table == NULL ) {
+        return -ENOMEM;
+    }
+
+    /* Both copies of the table map the pages read-only, the first
+       write to them is handled as a copy-on-write. */
+
+    for ( i = 0; i < 1024; i++ ) {
+        uint32_t ptr;
+
+        if ( old_table[ i ] == 0 ) {
+            new_table[ i ] = 0;
+            continue;
+        }
+
+        old_table[ i ] &= ~PAGE_WRITE;
+        new_table[ i ] = old_table[ i ];
+
+        ptr = old_table[ i ] & PAGE_MASK;
+        ASSERT( ptr < memory_size );
+
+        memory_pages[ ptr / PAGE_SIZE ].ref_count++;
+    }
+
+    table_page->ref_count--;
+
+    page_directory[ index ] = ( uint32_t )new_table | ( entry & ~PAGE_MASK ) | PAGE_WRITE;
+
+    return 1;
+}
+
+int paging_unshare_tables( memory_context_t* context, ptr_t address, uint64_t size ) {
     int error;
+    int changed;
+    uint32_t index;
+    uint32_t last_index;
+    uint32_t* page_directory;
+    i386_memory_context_t* arch_context;
+
+    arch_context = ( i386_memory_context_t* )context->arch_data;
+    page_directory = arch_context->page_directory;
+
+    index = PGD_INDEX( address );
+    last_index = PGD_INDEX( address + size - 1 );
+
+    error = 0;
+    changed = 0;
+
+    spinlock_disable( &pages_lock );
+
+    for ( ; index <= last_index; index++ ) {
+        error = paging_unshare_table( page_directory, index );
+
+        if ( error < 0 ) {
+            break;
+        }
+
+        changed |= error;
+    }
+
+    spinunlock_enable( &pages_lock );
+
+    /* The invalidation drops the cached directory entries as well */
+
+    if ( changed ) {
+        tlb_flush_range( context, address, size );
+    }
+
+    return ( error < 0 ? error : 0 );
+}
+
+int paging_split_large_page( uint32_t* page_directory, uint32_t index ) {
+    uint32_t i;
+    uint32_t entry;
+    uint32_t* table;
+
+    entry = page_directory[ index ];
+    ASSERT( entry & PAGE_LARGE );
+
+    table = ( uint32_t* )alloc_pages( 1, MEM_COMMON );
+
+    if ( table == NULL ) {
+        return -ENOMEM;
+    }
+
+    /* The large page is split into 1024 normal pages, the flags
+       of the directory entry are valid for page table entries too. */
+
+    for ( i = 0; i < 1024; i++ ) {
+        table[ i ] = ( entry & ~PAGE_LARGE ) + i * PAGE_SIZE;
+    }
+
+    /* The directory entry stays writable, a read-only directory entry
+       pointing to a page table marks a shared table. */
+
+    page_directory[ index ] = ( uint32_t )table | ( entry & ( ~PAGE_MASK & ~PAGE_LARGE ) ) | PAGE_WRITE;
+
+    return 0;
+}
+
+__init int init_paging( void ) {
     uint32_t size;
     register_t dummy;
     memory_region_t* region;
@@ -217,14 +382,8 @@ __init int init_paging( void ) {
 
     memset( context, 0, sizeof( memory_context_t ) );
     memset( arch_context, 0, sizeof( i386_memory_context_t ) );
+    init_spinlock( &arch_context->tlb_lock, "TLB batch" );
 
-    error = array_init( &context->regions );
-
-    if ( error < 0 ) {
-        return error;
-    }
-
-    array_set_realloc_size( &context->regions, 32 );
     context->mutex = -1;
     context->next = context;
     context->arch_data = arch_context;
@@ -239,6 +398,33 @@ __init int init_paging( void ) {
 
     memsetl( arch_context->page_directory, 0, PAGE_SIZE / 4 );
 
+    /* Allocate the zero page. The reference of the allocation is
+       never dropped, so the page is not freed when it's unmapped
+       from the last region. */
+
+    zero_page = ( ptr_t )alloc_pages( 1, MEM_COMMON );
+
+    if ( zero_page == 0 ) {
+        return -ENOMEM;
+    }
+
+    memsetl( ( void* )zero_page, 0, PAGE_SIZE / 4 );
+
+    /* Remapped regions are mapped with 4 MB pages where it's possible
+       if the CPU supports them. This can be disabled with the
+       large_pages=false kernel parameter. */
+
+    if ( processor_table[ 0 ].features & CPU_FEATURE_PSE ) {
+        bool enabled = true;
+
+        get_kernel_param_as_bool( "large_pages", &enabled );
+
+        if ( enabled ) {
+            set_cr4( get_cr4() | CR4_PSE );
+            paging_large_pages = true;
+        }
+    }
+
     /* Map the screen */
 
     region = do_create_memory_region_at(
@@ -282,7 +468,7 @@ __init int init_paging( void ) {
     /* Map the kernel heap */
 
     size = MIN( get_total_page_count() * PAGE_SIZE,
-                512 * 1024 * 1024 ) - ( 1 * 1024 * 1024 + ( ( uint32_t )__kernel_end - 0x100000 ) );
+                KERNEL_MAPPED_MEMORY_LIMIT ) - ( 1 * 1024 * 1024 + ( ( uint32_t )__kernel_end - 0x100000 ) );
 
     region = do_create_memory_region_at(
         context,
@@ -299,13 +485,16 @@ __init int init_paging( void ) {
 
     set_cr3( ( uint32_t )arch_context->page_directory );
 
-    /* Enable paging */
+    /* Enable paging and write protection. The kernel has to respect the
+       read-only pages as well, otherwise it could write to the zero page
+       or to a page shared by copy-on-write. */
 
     __asm__ __volatile__(
         "movl %%cr0, %0\n"
-        "orl $0x80000000, %0\n"
+        "orl %1, %0\n"
         "movl %0, %%cr0\n"
-        : "=r" ( dummy )
+        : "=&r" ( dummy )
+        : "i" ( 0x80000000 | CR0_WP )
     );
 
     return 0;
@@ -30,11 +30,14 @@
 #include <arch/mm/region.h>
 #include <arch/mm/context.h>
 #include <arch/mm/paging.h>
+#include <arch/mm/tlb.h>
 
 int arch_memory_region_remap_pages( memory_region_t* region, ptr_t physical_address ) {
     int error;
-    uint32_t curr_pt;
-    uint32_t last_pt;
+    uint32_t index;
+    uint64_t end;
+    uint64_t address;
+    uint64_t table_end;
     uint32_t paging_flags;
     uint32_t* page_directory;
     i386_memory_context_t* arch_context;
@@ -43,65 +46,53 @@ int arch_memory_region_remap_pages( memory_region_t* region, ptr_t physical_addr
     arch_context = ( i386_memory_context_t* )region->context->arch_data;
     page_directory = arch_context->page_directory;
 
-    /* Allocate possibly missing page tables */
-
-    curr_pt = PGD_INDEX( region->address );
-    last_pt = PGD_INDEX( region->address + region->size - 1 );
-
-    error = paging_alloc_table_entries(
-        page_directory,
-        curr_pt,
-        last_pt,
-        paging_flags | PAGE_WRITE,
-        0
-    );
+    error = paging_unshare_tables( region->context, region->address, region->size );
 
-    if ( error < 0 ) {
+    if ( __unlikely( error < 0 ) ) {
         return error;
     }
 
-    /* Map the pages of the region */
-
-    uint32_t first_page = PT_INDEX( region->address );
-    uint32_t last_page = ( curr_pt == last_pt ? PT_INDEX( region->address + region->size - 1 ) : 1023 );
-
-    error = paging_fill_table_entries(
-        ( uint32_t* )( page_directory[ curr_pt ] & PAGE_MASK ),
-        physical_address, first_page,
-        last_page, paging_flags
-    );
+    address = region->address;
+    end = ( uint64_t )region->address + region->size;
+
+    /* Map the region one page directory entry at a time. Entries that are
+       covered completely and whose physical memory is aligned to 4 MB are
+       mapped with a large page, the rest of them get a page table. */
+
+    while ( address < end ) {
+        index = PGD_INDEX( address );
+        table_end = MIN( ( address & PGDIR_MASK ) + PGDIR_SIZE, end );
+
+        if ( ( paging_large_pages ) &&
+             ( table_end - address == PGDIR_SIZE ) &&
+             ( ( physical_address % PGDIR_SIZE ) == 0 ) &&
+             ( page_directory[ index ] == 0 ) ) {
+            page_directory[ index ] = physical_address | paging_flags | PAGE_LARGE;
+        } else {
+            error = paging_alloc_table_entries(
+                page_directory, index, index,
+                paging_flags | PAGE_WRITE, 0
+            );
 
-    if ( error < 0 ) {
-        return error;
-    }
+            if ( __unlikely( error < 0 ) ) {
+                return error;
+            }
 
-    curr_pt++;
-    physical_address += ( last_page - first_page + 1 ) * PAGE_SIZE;
+            ASSERT( ( page_directory[ index ] & PAGE_LARGE ) == 0 );
 
-    for ( ; curr_pt < last_pt; curr_pt++ ) {
-        error = paging_fill_table_entries(
-            ( uint32_t* )( page_directory[ curr_pt ] & PAGE_MASK ),
-            physical_address, 0,
-            1023, paging_flags
-        );
+            error = paging_fill_table_entries(
+                ( uint32_t* )( page_directory[ index ] & PAGE_MASK ),
+                physical_address, PT_INDEX( address ),
+                PT_INDEX( table_end - 1 ), paging_flags
+            );
 
-        if ( __unlikely( error < 0 ) ) {
-            return error;
+            if ( __unlikely( error < 0 ) ) {
+                return error;
+            }
         }
 
-        physical_address += 1024 * PAGE_SIZE;
-    }
-
-    if ( curr_pt == last_pt ) {
-        error = paging_fill_table_entries(
-            ( uint32_t* )( page_directory[ curr_pt ] & PAGE_MASK ),
-            physical_address, 0,
-            PT_INDEX( region->address + region->size - 1 ), paging_flags
-        );
-
-        if ( error < 0 ) {
-            return error;
-        }
+        physical_address += table_end - address;
+        address = table_end;
     }
 
     return 0;
@@ -119,6 +110,12 @@ int arch_memory_region_alloc_pages( memory_region_t* region, ptr_t virtual, uint
     arch_context = ( i386_memory_context_t* )region->context->arch_data;
     page_directory = arch_context->page_directory;
 
+    error = paging_unshare_tables( region->context, virtual, size );
+
+    if ( __unlikely( error < 0 ) ) {
+        return error;
+    }
+
     /* Allocate possibly missing page tables */
 
     curr_pt = PGD_INDEX( virtual );
@@ -134,6 +131,12 @@ int arch_memory_region_alloc_pages( memory_region_t* region, ptr_t virtual, uint
         return error;
     }
 
+    /* The pages of lazy regions are allocated by the page fault handler */
+
+    if ( region->flags & REGION_LAZY ) {
+        return 0;
+    }
+
     /* Allocate the pages of the region */
 
     uint32_t first_page = PT_INDEX( virtual );
@@ -184,16 +187,84 @@ int arch_memory_region_alloc_pages( memory_region_t* region, ptr_t virtual, uint
     return error;
 }
 
-typedef int table_unmap_func_t( uint32_t* table, uint32_t from, uint32_t to );
+typedef int table_unmap_func_t( uint32_t* table, uint32_t from, uint32_t to, memory_page_t** freed );
+
+static int count_table_entries( uint32_t* table ) {
+    int count;
+    uint32_t i;
+
+    count = 0;
+
+    for ( i = 0; i < 1024; i++ ) {
+        if ( ( table[ i ] != 0 ) &&
+             ( ( table[ i ] & PAGE_MASK ) != zero_page ) ) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static int unmap_table_entries( uint32_t* page_directory, uint32_t index, uint32_t from, uint32_t to,
+                                table_unmap_func_t* unmap_function, memory_page_t** freed ) {
+    int error;
+    uint32_t* table;
+    memory_page_t* table_page;
+
+    /* Large pages are only used by remapped regions, there
+       are no pages to free when the entry is cleared. */
+
+    if ( page_directory[ index ] & PAGE_LARGE ) {
+        ASSERT( ( from == 0 ) && ( to == 1023 ) );
+        page_directory[ index ] = 0;
+
+        return 0;
+    }
+
+    table = ( uint32_t* )( page_directory[ index ] & PAGE_MASK );
+
+    if ( table == NULL ) {
+        return 0;
+    }
+
+    /* A shared page table that is unmapped completely is simply
+       dropped, the pages stay referenced by the other users of the
+       table. Partly unmapped tables have to be copied first. */
+
+    if ( ( page_directory[ index ] & PAGE_WRITE ) == 0 ) {
+        table_page = &memory_pages[ ( uint32_t )table / PAGE_SIZE ];
+
+        if ( ( from == 0 ) && ( to == 1023 ) && ( table_page->ref_count > 1 ) ) {
+            page_directory[ index ] = 0;
+            table_page->ref_count--;
+
+            return count_table_entries( table );
+        }
+
+        error = paging_unshare_table( page_directory, index );
+
+        if ( __unlikely( error < 0 ) ) {
+            kprintf( WARNING, "%s(): Failed to copy shared page table %u!\n", __FUNCTION__, index );
+            return 0;
+        }
+
+        table = ( uint32_t* )( page_directory[ index ] & PAGE_MASK );
+    }
+
+    return unmap_function( table, from, to, freed );
+}
 
 int arch_memory_region_unmap_pages( memory_region_t* region, ptr_t virtual, uint64_t size ) {
-    uint32_t* pd;
+    int count;
+    uint64_t end;
     uint32_t curr_pt;
     uint32_t last_pt;
     uint32_t* page_directory;
     table_unmap_func_t* unmap_function;
     i386_memory_context_t* arch_context;
 
+    memory_page_t* freed = NULL;
+
     arch_context = ( i386_memory_context_t* )region->context->arch_data;
     page_directory = arch_context->page_directory;
 
@@ -219,43 +290,101 @@ int arch_memory_region_unmap_pages( memory_region_t* region, ptr_t virtual, uint
             return -1;
     }
 
+    end = ( uint64_t )virtual + size;
     curr_pt = PGD_INDEX( virtual );
     last_pt = PGD_INDEX( virtual + size - 1 );
 
+    /* Large pages that are only partly unmapped have to be split first */
+
+    if ( ( page_directory[ curr_pt ] & PAGE_LARGE ) &&
+         ( ( ( virtual % PGDIR_SIZE ) != 0 ) || ( end - virtual < PGDIR_SIZE ) ) ) {
+        if ( paging_split_large_page( page_directory, curr_pt ) != 0 ) {
+            return -ENOMEM;
+        }
+    }
+
+    if ( ( page_directory[ last_pt ] & PAGE_LARGE ) &&
+         ( ( end % PGDIR_SIZE ) != 0 ) ) {
+        if ( paging_split_large_page( page_directory, last_pt ) != 0 ) {
+            return -ENOMEM;
+        }
+    }
+
     uint32_t first_page = PT_INDEX( virtual );
     uint32_t last_page = ( curr_pt == last_pt ? PT_INDEX( virtual + size - 1 ) : 1023 );
 
     /* Unmap the pages of the region */
 
-    spinlock_disable( &pages_lock );
+    count = 0;
 
-    pd = ( uint32_t* )( page_directory[ curr_pt ] & PAGE_MASK );
+    spinlock_disable( &pages_lock );
 
-    if ( pd != NULL ) {
-        unmap_function( pd, first_page, last_page );
-    }
+    count += unmap_table_entries( page_directory, curr_pt, first_page, last_page, unmap_function, &freed );
 
     curr_pt++;
 
     for ( ; curr_pt < last_pt; curr_pt++ ) {
-        pd = ( uint32_t* )( page_directory[ curr_pt ] & PAGE_MASK );
-        unmap_function( pd, 0, 1023 );
+        count += unmap_table_entries( page_directory, curr_pt, 0, 1023, unmap_function, &freed );
     }
 
     if ( curr_pt == last_pt ) {
-        pd = ( uint32_t* )( page_directory[ curr_pt ] & PAGE_MASK );
-        unmap_function( pd, 0, PT_INDEX( virtual + size - 1 ) );
+        count += unmap_table_entries(
+            page_directory, curr_pt, 0,
+            PT_INDEX( virtual + size - 1 ), unmap_function, &freed
+        );
     }
 
     spinunlock_enable( &pages_lock );
 
-    flush_tlb_global();
+    /* The pages are given back to the allocator only after no
+       processor can reach them through its TLB anymore */
+
+    tlb_flush_range_and_free( region->context, virtual, size, freed );
+
+    return count;
+}
+
+static int clone_table_entries( uint32_t* old_page_directory, uint32_t* new_page_directory, uint32_t index,
+                                uint32_t from, uint32_t to, uint32_t paging_flags, int remove_write ) {
+    int error;
+
+    /* Allocate the page table if it's missing */
+
+    error = paging_alloc_table_entries(
+        new_page_directory,
+        index,
+        index,
+        paging_flags | PAGE_WRITE,
+        0
+    );
+
+    if ( error < 0 ) {
+        return error;
+    }
+
+    if ( old_page_directory[ index ] == 0 ) {
+        return 0;
+    }
+
+    spinlock_disable( &pages_lock );
+
+    paging_clone_table_entries(
+        ( uint32_t* )( old_page_directory[ index ] & PAGE_MASK ),
+        ( uint32_t* )( new_page_directory[ index ] & PAGE_MASK ),
+        from, to, remove_write
+    );
+
+    spinunlock_enable( &pages_lock );
 
     return 0;
 }
 
 static int do_clone_allocated_region_pages( memory_region_t* old_region, memory_region_t* new_region ) {
     int error;
+    int share_tables;
+    uint32_t to;
+    uint32_t from;
+    uint32_t index;
     uint32_t curr_pt;
     uint32_t last_pt;
     uint32_t paging_flags;
@@ -270,62 +399,49 @@ static int do_clone_allocated_region_pages( memory_region_t* old_region, memory_
     arch_context = ( i386_memory_context_t* )new_region->context->arch_data;
     new_page_directory = arch_context->page_directory;
 
-    /* Allocate possibly missing page tables */
-
     curr_pt = PGD_INDEX( new_region->address );
     last_pt = PGD_INDEX( new_region->address + new_region->size - 1 );
 
-    error = paging_alloc_table_entries(
-        new_page_directory,
-        curr_pt,
-        last_pt,
-        paging_flags | PAGE_WRITE,
-        0
-    );
-
-    if ( error < 0 ) {
-        return error;
-    }
-
     int remove_write = ( ( new_region->flags & REGION_WRITE ) && ( ( new_region->flags & REGION_CLONED ) == 0 ) );
-    uint32_t first_page = PT_INDEX( new_region->address );
-    uint32_t last_page = ( curr_pt == last_pt ? PT_INDEX( new_region->address + new_region->size - 1 ) : 1023 );
 
-    /* Clone the pages of the region */
+    /* The page tables that map only this region are shared with the new
+       context instead of cloning their entries. They are copied when one
+       of the contexts modifies them, e.g. on the first write fault. Tables
+       of cloned regions are not shared as their pages are not copied on
+       write. */
 
-    spinlock_disable( &pages_lock );
+    share_tables = ( ( old_region->context != new_region->context ) &&
+                     ( ( new_region->flags & REGION_MAPPING_FLAGS ) == REGION_ALLOCATED ) );
 
-    paging_clone_table_entries(
-        ( uint32_t* )( old_page_directory[ curr_pt ] & PAGE_MASK ),
-        ( uint32_t* )( new_page_directory[ curr_pt ] & PAGE_MASK ),
-        first_page, last_page, remove_write
-    );
+    for ( index = curr_pt; index <= last_pt; index++ ) {
+        from = ( index == curr_pt ? PT_INDEX( new_region->address ) : 0 );
+        to = ( index == last_pt ? PT_INDEX( new_region->address + new_region->size - 1 ) : 1023 );
 
-    curr_pt++;
+        if ( ( share_tables ) &&
+             ( from == 0 ) &&
+             ( to == 1023 ) ) {
+            spinlock_disable( &pages_lock );
+            paging_share_table( old_page_directory, new_page_directory, index );
+            spinunlock_enable( &pages_lock );
 
-    for ( ; curr_pt < last_pt; curr_pt++ ) {
-        paging_clone_table_entries(
-            ( uint32_t* )( old_page_directory[ curr_pt ] & PAGE_MASK ),
-            ( uint32_t* )( new_page_directory[ curr_pt ] & PAGE_MASK ),
-            0, 1023, remove_write
-        );
-    }
+            continue;
+        }
 
-    if ( curr_pt == last_pt ) {
-        paging_clone_table_entries(
-            ( uint32_t* )( old_page_directory[ curr_pt ] & PAGE_MASK ),
-            ( uint32_t* )( new_page_directory[ curr_pt ] & PAGE_MASK ),
-            0, PT_INDEX( new_region->address + new_region->size - 1 ), remove_write
+        error = clone_table_entries(
+            old_page_directory, new_page_directory, index,
+            from, to, paging_flags, remove_write
         );
-    }
 
-    spinunlock_enable( &pages_lock );
+        if ( error < 0 ) {
+            return error;
+        }
+    }
 
     /* We need to flush the TLB as we might remove write access
        from the pages of the currently running process. */
 
-    if ( remove_write ) {
-        flush_tlb_global();
+    if ( ( remove_write ) || ( share_tables ) ) {
+        tlb_flush_range( old_region->context, old_region->address, old_region->size );
     }
 
     return 0;
@@ -346,6 +462,12 @@ static int do_clone_region_pages( memory_region_t* old_region, memory_region_t*
     arch_context = ( i386_memory_context_t* )new_region->context->arch_data;
     new_page_directory = arch_context->page_directory;
 
+    error = paging_unshare_tables( new_region->context, new_region->address, new_region->size );
+
+    if ( error < 0 ) {
+        return error;
+    }
+
     /* Allocate possibly missing page tables */
 
     error = paging_alloc_table_entries(
@@ -390,67 +512,21 @@ static int do_clone_region_pages( memory_region_t* old_region, memory_region_t*
 
 static int do_clone_remapped_region_pages( memory_region_t* old_region, memory_region_t* new_region ) {
     int error;
-    uint32_t curr_pt;
-    uint32_t last_pt;
-    uint32_t paging_flags;
-    uint32_t* old_page_directory;
-    uint32_t* new_page_directory;
-    i386_memory_context_t* arch_context;
-
-    paging_flags = get_paging_flags_for_region( new_region );
-
-    arch_context = ( i386_memory_context_t* )old_region->context->arch_data;
-    old_page_directory = arch_context->page_directory;
-    arch_context = ( i386_memory_context_t* )new_region->context->arch_data;
-    new_page_directory = arch_context->page_directory;
-
-    /* Allocate possibly missing page tables */
+    ptr_t physical_address;
 
-    curr_pt = PGD_INDEX( new_region->address );
-    last_pt = PGD_INDEX( new_region->address + new_region->size - 1 );
+    /* Remapped regions are physically contiguous, so the clone is simply
+       remapped to the same memory. This way it gets large pages as well
+       if its address allows them. */
 
-    error = paging_alloc_table_entries(
-        new_page_directory,
-        curr_pt,
-        last_pt,
-        paging_flags | PAGE_WRITE,
-        0
+    error = arch_memory_context_translate_address(
+        old_region->context, old_region->address, &physical_address
     );
 
     if ( error < 0 ) {
         return error;
     }
 
-    uint32_t first_page = PT_INDEX( new_region->address );
-    uint32_t last_page = ( curr_pt == last_pt ? PT_INDEX( new_region->address + new_region->size - 1 ) : 1023 );
-
-    /* Copy the page table entries of the region. */
-
-    paging_copy_table_entries(
-        ( uint32_t* )( old_page_directory[ curr_pt ] & PAGE_MASK ),
-        ( uint32_t* )( new_page_directory[ curr_pt ] & PAGE_MASK ),
-        first_page, last_page
-    );
-
-    curr_pt++;
-
-    for ( ; curr_pt < last_pt; curr_pt++ ) {
-        paging_copy_table_entries(
-            ( uint32_t* )( old_page_directory[ curr_pt ] & PAGE_MASK ),
-            ( uint32_t* )( new_page_directory[ curr_pt ] & PAGE_MASK ),
-            0, 1023
-        );
-    }
-
-    if ( curr_pt == last_pt ) {
-        paging_copy_table_entries(
-            ( uint32_t* )( old_page_directory[ curr_pt ] & PAGE_MASK ),
-            ( uint32_t* )( new_page_directory[ curr_pt ] & PAGE_MASK ),
-            0, PT_INDEX( new_region->address + new_region->size - 1 )
-        );
-    }
-
-    return 0;
+    return arch_memory_region_remap_pages( new_region, physical_address );
 }
 
 int arch_memory_region_clone_pages( memory_region_t* old_region, memory_region_t* new_region ) {
@@ -0,0 +1,389 @@
+/* TLB invalidation
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <types.h>
+#include <smp.h>
+#include <macros.h>
+#include <console.h>
+#include <mm/context.h>
+#include <lib/string.h>
+
+#include <arch/cpu.h>
+#include <arch/apic.h>
+#include <arch/smp.h>
+#include <arch/atomic.h>
+#include <arch/spinlock.h>
+#include <arch/interrupt.h>
+#include <arch/mm/tlb.h>
+#include <arch/mm/context.h>
+
+#ifdef ENABLE_SMP
+
+/**
+ * @struct tlb_shootdown
+ *
+ * The invalidations requested from a processor by the others. The
+ * requests are merged into the batch until the target processor
+ * executes them, requested and completed are sequence numbers used
+ * by the senders to wait for their own request.
+ */
+typedef struct tlb_shootdown {
+    spinlock_t lock;
+    volatile uint32_t requested;
+    volatile uint32_t completed;
+    tlb_batch_t batch;
+} tlb_shootdown_t;
+
+static tlb_shootdown_t shootdowns[ MAX_CPU_COUNT ];
+
+#endif /* ENABLE_SMP */
+
+void tlb_batch_init( tlb_batch_t* batch ) {
+    batch->flush_all = false;
+    batch->page_count = 0;
+    batch->range_count = 0;
+}
+
+void tlb_batch_add( tlb_batch_t* batch, ptr_t address, uint64_t size ) {
+    uint32_t i;
+    uint64_t end;
+    uint64_t start;
+    tlb_range_t* range;
+
+    if ( ( batch->flush_all ) ||
+         ( size == 0 ) ) {
+        return;
+    }
+
+    start = address & PAGE_MASK;
+    end = ( ( uint64_t )address + size + PAGE_SIZE - 1 ) & ~( ( uint64_t )PAGE_SIZE - 1 );
+
+    if ( ( end - start ) / PAGE_SIZE > TLB_INVLPG_LIMIT ) {
+        batch->flush_all = true;
+        return;
+    }
+
+    /* Merge the new range with an overlapping or adjacent one */
+
+    for ( i = 0; i < batch->range_count; i++ ) {
+        uint64_t range_end;
+
+        range = &batch->ranges[ i ];
+        range_end = ( uint64_t )range->address + range->size;
+
+        if ( ( start <= range_end ) &&
+             ( end >= range->address ) ) {
+            batch->page_count -= range->size / PAGE_SIZE;
+
+            start = MIN( start, range->address );
+            end = MAX( end, range_end );
+
+            range->address = start;
+            range->size = end - start;
+
+            goto out;
+        }
+    }
+
+    if ( batch->range_count == TLB_BATCH_RANGES ) {
+        batch->flush_all = true;
+        return;
+    }
+
+    range = &batch->ranges[ batch->range_count++ ];
+    range->address = start;
+    range->size = end - start;
+
+ out:
+    batch->page_count += range->size / PAGE_SIZE;
+
+    if ( batch->page_count > TLB_INVLPG_LIMIT ) {
+        batch->flush_all = true;
+    }
+}
+
+static inline bool tlb_batch_empty( tlb_batch_t* batch ) {
+    return ( ( !batch->flush_all ) && ( batch->range_count == 0 ) );
+}
+
+static void tlb_batch_flush_local( tlb_batch_t* batch ) {
+    uint32_t i;
+    ptr_t address;
+    cpu_t* processor;
+
+    processor = get_processor();
+
+    if ( batch->flush_all ) {
+        flush_tlb();
+        processor->tlb_full_flushes++;
+
+        return;
+    }
+
+    for ( i = 0; i < batch->range_count; i++ ) {
+        tlb_range_t* range = &batch->ranges[ i ];
+
+        for ( address = range->address;
+              address < range->address + range->size;
+              address += PAGE_SIZE ) {
+            invlpg( address );
+        }
+    }
+
+    processor->tlb_page_flushes += batch->page_count;
+}
+
+#ifdef ENABLE_SMP
+
+static void tlb_batch_merge( tlb_batch_t* batch, tlb_batch_t* other ) {
+    uint32_t i;
+
+    if ( other->flush_all ) {
+        batch->flush_all = true;
+        return;
+    }
+
+    for ( i = 0; i < other->range_count; i++ ) {
+        tlb_batch_add( batch, other->ranges[ i ].address, other->ranges[ i ].size );
+    }
+}
+
+/* Queues the batch for the processors in the mask and waits until all of
+   them execute it. The interrupts have to be disabled by the caller. */
+static void tlb_send_shootdown( uint32_t mask, tlb_batch_t* batch ) {
+    int i;
+    uint32_t timeout;
+    cpu_t* processor;
+    tlb_shootdown_t* shootdown;
+    uint32_t sequence[ MAX_CPU_COUNT ];
+
+    processor = get_processor();
+
+    for ( i = 0; i < MAX_CPU_COUNT; i++ ) {
+        if ( ( mask & ( 1 << i ) ) == 0 ) {
+            continue;
+        }
+
+        shootdown = &shootdowns[ i ];
+
+        spinlock( &shootdown->lock );
+        tlb_batch_merge( &shootdown->batch, batch );
+        sequence[ i ] = ++shootdown->requested;
+        spinunlock( &shootdown->lock );
+
+        apic_send_ipi( i, APIC_TLB_FLUSH_IRQ );
+        processor->tlb_ipis_sent++;
+    }
+
+    /* Wait for the other processors. Our own requests are served in the
+       meantime, an other processor may wait for us with interrupts disabled. */
+
+    for ( i = 0; i < MAX_CPU_COUNT; i++ ) {
+        if ( ( mask & ( 1 << i ) ) == 0 ) {
+            continue;
+        }
+
+        shootdown = &shootdowns[ i ];
+        timeout = 50000000;
+
+        while ( ( ( int32_t )( shootdown->completed - sequence[ i ] ) < 0 ) &&
+                ( timeout > 0 ) ) {
+            tlb_handle_shootdown();
+            __asm__ __volatile__( "pause" );
+            timeout--;
+        }
+
+        if ( timeout == 0 ) {
+            kprintf( WARNING, "TLB shootdown on processor %d timed out!\n", i );
+        }
+    }
+}
+
+void tlb_handle_shootdown( void ) {
+    uint32_t sequence;
+    tlb_batch_t batch;
+    tlb_shootdown_t* shootdown;
+
+    shootdown = &shootdowns[ get_processor_index() ];
+
+    if ( shootdown->completed == shootdown->requested ) {
+        return;
+    }
+
+    spinlock( &shootdown->lock );
+
+    memcpy( &batch, &shootdown->batch, sizeof( tlb_batch_t ) );
+    tlb_batch_init( &shootdown->batch );
+    sequence = shootdown->requested;
+
+    spinunlock( &shootdown->lock );
+
+    tlb_batch_flush_local( &batch );
+
+    shootdown->completed = sequence;
+}
+
+#endif /* ENABLE_SMP */
+
+static void tlb_flush_batch( memory_context_t* context, tlb_batch_t* batch ) {
+    bool ints;
+    uint32_t mask;
+    uint32_t self;
+    i386_memory_context_t* arch_context;
+
+    arch_context = ( i386_memory_context_t* )context->arch_data;
+
+    ints = disable_interrupts();
+
+    self = ( 1 << get_processor_index() );
+
+    /* The kernel part of the address space is shared by all contexts */
+
+    if ( context == &kernel_memory_context ) {
+#ifdef ENABLE_SMP
+        mask = active_cpu_mask;
+#else
+        mask = self;
+#endif /* ENABLE_SMP */
+    } else {
+        mask = atomic_get( &arch_context->cpu_mask );
+    }
+
+    if ( mask & self ) {
+        tlb_batch_flush_local( batch );
+    }
+
+#ifdef ENABLE_SMP
+    mask &= ~self;
+
+    if ( mask != 0 ) {
+        tlb_send_shootdown( mask, batch );
+    }
+#endif /* ENABLE_SMP */
+
+    if ( ints ) {
+        enable_interrupts();
+    }
+}
+
+void tlb_flush_range_and_free( memory_context_t* context, ptr_t address, uint64_t size, memory_page_t* pages ) {
+    tlb_batch_t batch;
+    memory_page_t* last;
+    i386_memory_context_t* arch_context;
+
+    arch_context = ( i386_memory_context_t* )context->arch_data;
+
+    spinlock_disable( &arch_context->tlb_lock );
+
+    if ( arch_context->tlb_batch_depth > 0 ) {
+        tlb_batch_add( &arch_context->tlb_pending, address, size );
+
+        if ( pages != NULL ) {
+            for ( last = pages; last->next != NULL; last = last->next ) {
+                /* find the end of the list */
+            }
+
+            last->next = arch_context->tlb_pending_pages;
+            arch_context->tlb_pending_pages = pages;
+        }
+
+        spinunlock_enable( &arch_context->tlb_lock );
+
+        return;
+    }
+
+    spinunlock_enable( &arch_context->tlb_lock );
+
+    tlb_batch_init( &batch );
+    tlb_batch_add( &batch, address, size );
+
+    tlb_flush_batch( context, &batch );
+
+    put_page_list( pages );
+}
+
+void tlb_flush_range( memory_context_t* context, ptr_t address, uint64_t size ) {
+    tlb_flush_range_and_free( context, address, size, NULL );
+}
+
+void arch_memory_context_begin_tlb_batch( memory_context_t* context ) {
+    i386_memory_context_t* arch_context;
+
+    arch_context = ( i386_memory_context_t* )context->arch_data;
+
+    spinlock_disable( &arch_context->tlb_lock );
+    arch_context->tlb_batch_depth++;
+    spinunlock_enable( &arch_context->tlb_lock );
+}
+
+void arch_memory_context_end_tlb_batch( memory_context_t* context ) {
+    tlb_batch_t batch;
+    memory_page_t* pages;
+    i386_memory_context_t* arch_context;
+
+    arch_context = ( i386_memory_context_t* )context->arch_data;
+
+    spinlock_disable( &arch_context->tlb_lock );
+
+    ASSERT( arch_context->tlb_batch_depth > 0 );
+
+    if ( --arch_context->tlb_batch_depth > 0 ) {
+        spinunlock_enable( &arch_context->tlb_lock );
+        return;
+    }
+
+    memcpy( &batch, &arch_context->tlb_pending, sizeof( tlb_batch_t ) );
+    tlb_batch_init( &arch_context->tlb_pending );
+
+    pages = arch_context->tlb_pending_pages;
+    arch_context->tlb_pending_pages = NULL;
+
+    spinunlock_enable( &arch_context->tlb_lock );
+
+    if ( !tlb_batch_empty( &batch ) ) {
+        tlb_flush_batch( context, &batch );
+    }
+
+    /* The pages unmapped in the batch can be reused now */
+
+    put_page_list( pages );
+}
+
+void tlb_load_context( i386_memory_context_t* context ) {
+    uint32_t self;
+    i386_cpu_t* arch_cpu;
+    i386_memory_context_t* previous;
+
+    arch_cpu = &arch_processor_table[ get_processor_index() ];
+    previous = arch_cpu->memory_context;
+    self = ( 1 << get_processor_index() );
+
+    /* The new context is marked before loading it, so a concurrent
+       shootdown either reaches us or happens before the CR3 reload. */
+
+    atomic_or( &context->cpu_mask, self );
+
+    set_cr3( ( uint32_t )context->page_directory );
+
+    if ( ( previous != NULL ) &&
+         ( previous != context ) ) {
+        atomic_and( &previous->cpu_mask, ~self );
+    }
+
+    arch_cpu->memory_context = context;
+}
@@ -18,9 +18,13 @@
  */
 
 #include <irq.h>
+#include <errno.h>
 #include <console.h>
 #include <time.h>
 #include <kernel.h>
+#include <clockevent.h>
+#include <mm/pages.h>
+#include <lib/string.h>
 #include <sched/scheduler.h>
 
 #include <arch/pit.h>
@@ -29,24 +33,37 @@
 #include <arch/spinlock.h>
 #include <arch/hwtime.h>
 #include <arch/apic.h>
+#include <arch/hpet.h>
 #include <arch/cpu.h>
 
+/* The counters the system time can be calculated from */
+enum {
+    CLOCK_TSC,
+    CLOCK_HPET
+};
+
 static int pit_freq = 1000; /* PIT frequency in Hz */
 static uint64_t boot_time = 0;
 
-static int pit_irq( int irq, void* data, registers_t* regs ) {
-    /* Wake up sleeper threads */
+static int clock_source = CLOCK_TSC;
+static uint64_t clock_base = 0;
+static uint32_t clock_to_us_mult = 0; /* usecs = ( ticks * mult ) >> 32 */
 
-    waitqueue_wake_up( &sleep_queue, get_system_time() );
+static clockevent_t pit_clockevent = {
+    .name = "PIT",
+    .features = CLOCKEVENT_PERIODIC,
+    .min_delta = 0,
+    .max_delta = 0,
+    .set_next_event = NULL
+};
 
-    if ( !apic_present ) {
-        /* The PIT irq was acked and masked by the interrupt handler.
-           We have to re-enable it here to let it fire next time. */
+static int pit_irq( int irq, void* data, registers_t* regs ) {
+    /* The PIT irq was acked and masked by the interrupt handler.
+       We have to re-enable it here to let it fire next time. */
 
-        arch_enable_irq( irq );
+    arch_enable_irq( irq );
 
-        schedule( regs );
-    }
+    clockevent_handle_event( regs );
 
     return 0;
 }
@@ -77,8 +94,16 @@ void pit_wait_wrap( void ) {
     }
 }
 
+static inline uint64_t clock_read( void ) {
+    if ( clock_source == CLOCK_HPET ) {
+        return hpet_read_counter();
+    }
+
+    return rdtsc();
+}
+
 uint64_t get_system_time( void ) {
-    return ( ( rdtsc() * tsc_to_ns_scale ) >> CYC2NS_SCALE_FACTOR ) / 1000 + boot_time;
+    return scale_clock( clock_read() - clock_base, clock_to_us_mult, 32 ) + boot_time;
 }
 
 int set_system_time( time_t* newtime ) {
@@ -90,13 +115,69 @@ uint64_t get_boot_time( void ) {
     return boot_time;
 }
 
+__init static void init_clock_source( void ) {
+    bool tsc_stable;
+
+    /* The TSC is the cheapest counter to read, but it can be used only
+       if it doesn't slow down or stop with the CPU. The HPET counter
+       is used otherwise if it's wide enough to never wrap around. The
+       tsc_stable=true kernel parameter forces the use of the TSC. */
+
+    tsc_stable = ( ( processor_table[ 0 ].features & CPU_FEATURE_INVARIANT_TSC ) != 0 );
+    get_kernel_param_as_bool( "tsc_stable", &tsc_stable );
+
+    if ( ( !tsc_stable ) &&
+         ( hpet_present ) &&
+         ( hpet_readl( HPET_ID ) & HPET_ID_64BIT ) ) {
+        clock_source = CLOCK_HPET;
+        clock_base = hpet_read_counter();
+        clock_to_us_mult = ( ( uint64_t )hpet_get_period() << 32 ) / 1000000000ULL;
+    } else {
+        clock_source = CLOCK_TSC;
+        clock_base = rdtsc();
+        clock_to_us_mult = ( 1000ULL << 32 ) / tsc_khz;
+    }
+
+    kprintf(
+        INFO, "Using %s as clock source.\n",
+        ( clock_source == CLOCK_TSC ) ? "TSC" : "HPET"
+    );
+}
+
+__init static int init_time_page( void ) {
+    time_page = ( time_page_t* )alloc_pages( 1, MEM_COMMON );
+
+    if ( time_page == NULL ) {
+        return -ENOMEM;
+    }
+
+    memset( time_page, 0, PAGE_SIZE );
+
+    /* User space can calculate the time only from the TSC */
+
+    if ( clock_source == CLOCK_TSC ) {
+        time_page->clock_mode = TIME_PAGE_TSC;
+        time_page->tsc_to_us_mult = clock_to_us_mult;
+        time_page->tsc_base = clock_base;
+        time_page->boot_time = boot_time;
+    } else {
+        time_page->clock_mode = TIME_PAGE_SYSCALL;
+    }
+
+    return 0;
+}
+
 __init int init_system_time( void ) {
     tm_t now;
 
     gethwclock( &now );
     boot_time = 1000000 * mktime( &now );
 
-    write_msr( X86_MSR_TSC, 0 );
+    /* The system time is counted from this point, the counter is
+       not reset because the other CPUs read it as well */
+
+    init_clock_source();
+    init_time_page();
 
     return 0;
 }
@@ -105,6 +186,14 @@ __init int init_pit( void ) {
     int error;
     uint32_t base;
 
+    /* The PIT is only used as a periodic tick if there is no
+       timer in the system that supports one-shot mode */
+
+    if ( ( apic_present ) ||
+         ( hpet_init_clockevent() == 0 ) ) {
+        return 0;
+    }
+
     if ( get_kernel_param_as_int( "pit_freq", &pit_freq ) == 0 ) {
         switch ( pit_freq ) {
             case 250 :
@@ -136,5 +225,5 @@ __init int init_pit( void ) {
         return error;
     }
 
-    return 0;
+    return clockevent_register( &pit_clockevent );
 }
@@ -25,19 +25,23 @@
 #include <arch/cpu.h>
 #include <arch/gdt.h>
 #include <arch/mm/paging.h>
+#include <arch/mm/tlb.h>
+#include <arch/interrupt.h>
 
-void switch_to_thread(register_t esp, uint32_t gs);
+void switch_to_thread(register_t esp, uint32_t gs, volatile int* prev_on_cpu);
 
 int schedule( registers_t* regs ) {
     uint32_t gs;
     thread_t* next;
     thread_t* current;
+    volatile int* prev_on_cpu;
     i386_cpu_t* arch_cpu;
     i386_thread_t* arch_thread;
     i386_memory_context_t* arch_mem_context;
 
-    /* Lock the scheduler */
-    scheduler_lock();
+    /* The run queues are locked by do_schedule(), the rest
+       is done with disabled interrupts on the local CPU */
+    disable_interrupts();
 
     /* Save the state of the previously running thread */
     current = current_thread();
@@ -77,18 +81,23 @@ int schedule( registers_t* regs ) {
 
     /* Set the new memory context if needed */
     if ( ( current == NULL ) || ( current->process != next->process ) ) {
-        set_cr3( ( uint32_t )arch_mem_context->page_directory );
+        tlb_load_context( arch_mem_context );
         arch_cpu->tss.cr3 = ( register_t )arch_mem_context->page_directory;
     }
 
     set_task_switched();
 
-    /* Unlock the scheduler spinlock. The iret instruction in
-       switch_to_thread() will enable interrupts if required. */
-    spinunlock(&scheduler_lock);
+    /* Other CPUs may pick the previous thread only after we left its
+       kernel stack, switch_to_thread() clears the flag after that. */
+    if ( ( current != NULL ) && ( current != next ) ) {
+        prev_on_cpu = &current->on_cpu;
+    } else {
+        prev_on_cpu = NULL;
+    }
 
-    /* Switch to the next thread */
-    switch_to_thread(arch_thread->esp, gs);
+    /* Switch to the next thread. The iret instruction in
+       switch_to_thread() will enable interrupts if required. */
+    switch_to_thread(arch_thread->esp, gs, prev_on_cpu);
 
     return 0;
 }
@@ -34,80 +34,18 @@
 #include <arch/idt.h>
 #include <arch/interrupt.h>
 #include <arch/mm/context.h>
+#include <arch/mm/paging.h>
 
 atomic_t ap_running;
 volatile uint32_t ap_stack_top;
 
-uint32_t active_cpu_mask = 0;
-volatile uint32_t tlb_invalidate_mask;
+volatile uint32_t active_cpu_mask = 0;
 
 extern int __smp_trampoline_start;
 extern int __smp_trampoline_end;
 
 void processor_activated( void ) {
-    active_cpu_mask |= ( 1 << get_processor_index() );
-}
-
-void flush_tlb_global( void ) {
-    /* Flush the TLB on the current CPU */
-
-    flush_tlb();
-
-    /* If we have more than one active CPU in the system we have to send
-       an IPI to others to flush the TLB on them as well. */
-
-    if ( atomic_get( &active_processor_count ) > 1 ) {
-        bool ints;
-        uint32_t tmp;
-        uint32_t timeout;
-
-        /* Disable interrupts */
-
-        ints = disable_interrupts();
-
-        /* This will tell other CPUs that they have to invalidate their TLB */
-
-        tlb_invalidate_mask = active_cpu_mask & ~( 1 << get_processor_index() );
-
-        /* Send the IPI to other processors */
-
-        /* Wait for busy to clear */
-
-        while ( apic_read( LAPIC_ICR_LOW ) & ( 1 << 12 ) ) ;
-
-        /* Build the command */
-
-        tmp = apic_read( LAPIC_ICR_LOW );
-        tmp &= ~0x000CDFFF;
-        tmp |= APIC_TLB_FLUSH_IRQ; /* vector number */
-        /* delivery mode: fixed */
-        tmp |= ( 1 << 11 ); /* destination mode: logical */
-        tmp |= ( 3 << 18 ); /* destination shorthand: all excluding self */
-
-        /* Write the command to the APIC register */
-
-        apic_write( LAPIC_ICR_LOW, tmp );
-
-        /* Wait until other CPUs do the TLB flush */
-
-        timeout = 50000000;
-
-        while ( ( tlb_invalidate_mask != 0 ) && ( timeout > 0 ) ) {
-            timeout--;
-        }
-
-        /* Re-enable interrupts if we disabled them */
-
-        if ( ints ) {
-            enable_interrupts();
-        }
-
-        /* Maybe a timeout happened? :( */
-
-        if ( timeout == 0 ) {
-            kprintf( WARNING, "Global TLB flush timed out!\n" );
-        }
-    }
+    atomic_or( ( atomic_t* )&active_cpu_mask, 1 << get_processor_index() );
 }
 
 void ap_processor_entry( void ) {
@@ -117,15 +55,21 @@ void ap_processor_entry( void ) {
 
     arch_context = ( i386_memory_context_t* )kernel_memory_context.arch_data;
 
+    /* The kernel mapping may use 4 MB pages */
+
+    if ( paging_large_pages ) {
+        set_cr4( get_cr4() | CR4_PSE );
+    }
+
     /* Enable paging */
 
     __asm__ __volatile__(
         "movl %0, %%cr3\n"
         "movl %%cr0, %0\n"
-        "orl $0x80000000, %0\n"
+        "orl %1, %0\n"
         "movl %0, %%cr0\n"
         :
-        : "r" ( arch_context->page_directory )
+        : "r" ( arch_context->page_directory ), "i" ( 0x80000000 | CR0_WP )
     );
 
     /* Load GDT */
@@ -160,6 +104,8 @@ void ap_processor_entry( void ) {
         : "a" ( ( GDT_ENTRIES + get_processor_index() ) * 8 )
     );
 
+    init_sysenter( get_processor_index() );
+
     /* Setup the local APIC and initialize the APIC timer */
 
     setup_local_apic();
@@ -46,10 +46,6 @@
 
 multiboot_header_t mb_header;
 
-#ifdef ENABLE_KMALLOC_DEBUG
-int init_serial_kmalloc_output( void );
-#endif /* ENABLE_KMALLOC_DEBUG */
-
 __init static int arch_init_page_allocator( multiboot_header_t* header ) {
     int error;
     int module_count;
@@ -113,7 +109,13 @@ __init static int arch_init_page_allocator( multiboot_header_t* header ) {
 
     /* Register memory types */
 
-    register_memory_type( MEM_COMMON, 0x100000, header->memory_upper * 1024 );
+    /* The buddy allocator doesn't prefer low addresses, so only the
+       part of the memory mapped by the kernel is given to it. */
+
+    register_memory_type(
+        MEM_COMMON, 0x100000,
+        MIN( header->memory_upper * 1024, KERNEL_MAPPED_MEMORY_LIMIT - 0x100000 )
+    );
     register_memory_type( MEM_LOW, 0x0, 1024 * 1024 );
 
     init_page_allocator_late();
@@ -266,10 +268,6 @@ __init void arch_start( multiboot_header_t* header ) {
     init_kernel_symbols();
     init_elf32_kernel_symbols();
 
-#ifdef ENABLE_KMALLOC_DEBUG
-    init_serial_kmalloc_output();
-#endif /* ENABLE_KMALLOC_DEBUG */
-
     /* Initialize memory region manager */
 
     preinit_regions();
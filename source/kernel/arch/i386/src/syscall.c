@@ -18,6 +18,12 @@
 
 #include <types.h>
 #include <syscall.h>
+#include <smp.h>
+
+#include <arch/cpu.h>
+#include <arch/gdt.h>
+
+extern void sysenter_entry( void );
 
 void system_call_entry(registers_t* regs) {
     uint32_t parameters[5] = {
@@ -30,3 +36,20 @@ void system_call_entry(registers_t* regs) {
 
     regs->eax = handle_system_call(regs->eax, parameters, (void*)regs);
 }
+
+void init_sysenter( int processor ) {
+    i386_cpu_t* arch_cpu;
+
+    if ( ( processor_table[ processor ].features & CPU_FEATURE_SEP ) == 0 ) {
+        return;
+    }
+
+    arch_cpu = &arch_processor_table[ processor ];
+
+    /* The stack pointer is loaded from the TSS by the entry code, so it
+       always follows the kernel stack of the current thread. */
+
+    write_msr( X86_MSR_SYSENTER_CS, KERNEL_CS );
+    write_msr( X86_MSR_SYSENTER_ESP, ( uint32_t )&arch_cpu->tss.esp0 );
+    write_msr( X86_MSR_SYSENTER_EIP, ( uint32_t )sysenter_entry );
+}
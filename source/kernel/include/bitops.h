@@ -28,4 +28,24 @@ static inline uint32_t bswap32( uint32_t value ) {
              ( value & 0x000000FF ) << 24 );
 }
 
+/**
+ * Returns the index of the least significant set bit.
+ *
+ * @param value The value to search in, it must not be zero
+ * @return The index of the first set bit
+ */
+static inline int find_first_set_bit( uint32_t value ) {
+    return __builtin_ctz( value );
+}
+
+/**
+ * Returns the index of the most significant set bit.
+ *
+ * @param value The value to search in, it must not be zero
+ * @return The index of the last set bit
+ */
+static inline int find_last_set_bit( uint32_t value ) {
+    return 31 - __builtin_clz( value );
+}
+
 #endif /* _BITOPS_H_ */
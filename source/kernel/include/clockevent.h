@@ -0,0 +1,105 @@
+/* Clock event handling
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _CLOCKEVENT_H_
+#define _CLOCKEVENT_H_
+
+#include <types.h>
+#include <thread.h>
+
+/* Clock event device features */
+#define CLOCKEVENT_PERIODIC 0x01
+#define CLOCKEVENT_ONESHOT  0x02
+
+/* The scheduler tick of a CPU that runs a thread (in usecs) */
+#define CLOCKEVENT_TICK 1000
+
+struct clockevent;
+
+typedef int clockevent_set_next_event_t( struct clockevent* event, uint64_t delta );
+
+/**
+ * @struct clockevent
+ *
+ * A timer device that interrupts the CPU it belongs to. Periodic devices
+ * are started by their drivers and tick with a fixed frequency. One-shot
+ * devices are programmed to the next time the CPU has something to do,
+ * so an idle CPU is not woken up until a timer expires or a thread is
+ * added to its run queue.
+ */
+typedef struct clockevent {
+    const char* name;
+    uint32_t features;
+
+    /* The range of the deltas accepted by set_next_event (in usecs) */
+    uint64_t min_delta;
+    uint64_t max_delta;
+
+    /* Programs a one-shot event after delta usecs. It returns -ETIME
+       if the event was missed because the delta was too short. */
+    clockevent_set_next_event_t* set_next_event;
+} clockevent_t;
+
+/**
+ * Registers the clock event device of the current CPU. A one-shot
+ * device is programmed for the first event by this function.
+ *
+ * @param event The clock event device
+ * @return On success 0 is returned
+ */
+int clockevent_register( clockevent_t* event );
+
+/**
+ * Handles the interrupt of a clock event device. The expired timers
+ * are fired and the current CPU is rescheduled.
+ *
+ * @param regs The registers of the interrupted thread
+ * @return On success 0 is returned
+ */
+int clockevent_handle_event( registers_t* regs );
+
+/**
+ * Programs the next event of the current CPU after a new thread was
+ * selected to run on it. A running thread gets an event after each
+ * CLOCKEVENT_TICK usecs, the idle thread only when the next timer
+ * expires. The interrupts have to be disabled while calling this function.
+ *
+ * @param next The thread selected to run
+ * @param now The current system time
+ */
+void clockevent_update( thread_t* next, uint64_t now );
+
+/**
+ * Brings the next event of the current CPU forward if a timer was
+ * inserted that expires earlier. The interrupts have to be disabled
+ * while calling this function.
+ *
+ * @param expire_time The expiration time of the new timer
+ */
+void clockevent_timer_added( uint64_t expire_time );
+
+/**
+ * Makes the specified CPU reschedule as soon as possible. This is used
+ * to wake up a CPU that runs its idle thread without a pending event.
+ * The interrupts have to be disabled while calling this function.
+ *
+ * @param processor The index of the CPU
+ */
+void clockevent_kick( int processor );
+
+#endif /* _CLOCKEVENT_H_ */
@@ -24,7 +24,6 @@
 //#define ENABLE_SMP 1
 //#define ENABLE_DEBUGGER 1
 #define ENABLE_NETWORK 1
-//#define ENABLE_KMALLOC_DEBUG 1
 //#define ENABLE_KMALLOC_BARRIERS 1
 
 /**
@@ -66,6 +65,18 @@
  */
 #define MAX_MEMORY_TYPES 4
 
+/**
+ * The number of block orders managed by the buddy page allocator.
+ * The biggest block on the free lists is 2^(MAX_PAGE_ORDER-1) pages.
+ */
+#define MAX_PAGE_ORDER 11
+
+/**
+ * The maximum number of single pages cached by a processor in front
+ * of the page allocator.
+ */
+#define MAX_PAGE_CACHE_SIZE 64
+
 /**
  * The size of the kernel stack for threads.
  */
@@ -66,5 +66,6 @@
 #define EAFNOSUPPORT  44
 #define ECONNREFUSED  45
 #define ENOTSOCK      46
+#define EFAULT        47
 
 #endif /* _ERRNO_H_ */
@@ -19,6 +19,27 @@
 #ifndef _FORK_H_
 #define _FORK_H_
 
+#include <process.h>
+
 int sys_fork( void );
 
+/**
+ * Creates a new process that shares the memory context of the
+ * current one. The calling thread is blocked until the new process
+ * calls execve() or exits.
+ *
+ * @return On success the thread ID of the new process is returned to
+ *         the parent and 0 to the child, otherwise a negative error code
+ */
+int sys_vfork( void );
+
+/**
+ * Gives back the borrowed memory context of a process created by
+ * vfork() and wakes up its parent. You have to call this method with
+ * a locked scheduler!
+ *
+ * @param process The process created by vfork()
+ */
+void vfork_release( process_t* process );
+
 #endif /* _FORK_H_ */
@@ -0,0 +1,76 @@
+/* Fast user space locking primitive
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _LOCK_FUTEX_H_
+#define _LOCK_FUTEX_H_
+
+#include <time.h>
+#include <lock/context.h>
+#include <sched/waitqueue.h>
+
+/* A futex is a 32bit integer in the memory of a process. The kernel
+   only keeps track of the threads waiting on it, the state of the lock
+   built on top of it is managed by user space. */
+
+/* The number of futex hash buckets, it has to be a power of two */
+#define FUTEX_BUCKET_COUNT 64
+
+typedef struct futex {
+    struct futex* next;
+
+    uint64_t key;
+    int waiter_count;
+    waitqueue_t waiters;
+} futex_t;
+
+/* The futexes are hashed into buckets by their key, each bucket has its
+   own lock, so waits and wakeups on unrelated futexes don't contend. */
+
+typedef struct futex_bucket {
+    lock_id lock;
+    futex_t* first;
+} futex_bucket_t;
+
+/**
+ * Puts the current thread to sleep on the futex at the specified address
+ * if it still contains the expected value. The value is checked while the
+ * bucket of the futex is locked, so a wakeup issued after the value was
+ * changed can't be lost.
+ *
+ * @param address The address of the futex
+ * @param value The expected value of the futex
+ * @param wakeup_time The system time when the wait times out, or NULL
+ *                    to wait without a timeout
+ * @return 0 is returned if the thread was woken up by sys_futex_wake(),
+ *         -EAGAIN if the value didn't match, -ETIME on timeout and -EINTR
+ *         if the wait was interrupted for another reason
+ */
+int sys_futex_wait( int* address, int value, time_t* wakeup_time );
+
+/**
+ * Wakes up threads waiting on the futex at the specified address.
+ *
+ * @param address The address of the futex
+ * @param count The maximum number of threads to wake up
+ * @return On success 0 is returned
+ */
+int sys_futex_wake( int* address, int count );
+
+int init_futexes( void );
+
+#endif /* _LOCK_FUTEX_H_ */
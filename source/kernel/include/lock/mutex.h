@@ -30,6 +30,10 @@ enum mutex_flags {
     MUTEX_RECURSIVE = ( 1 << 0 )
 };
 
+/* The maximum number of iterations a thread spins on a mutex held
+   by a thread running on another CPU before going to sleep */
+#define MUTEX_SPIN_LIMIT 1000
+
 typedef struct mutex {
     lock_header_t header;
 
@@ -38,6 +42,19 @@ typedef struct mutex {
 
     thread_id holder;
     waitqueue_t waiters;
+
+    /* The holder thread and the CPU it locked the mutex on. These are
+       only compared to the current thread of the CPU while spinning,
+       the thread is never accessed through this pointer. */
+
+    thread_t* holder_thread;
+    int holder_cpu;
+
+    /* Contention statistics */
+
+    uint32_t spin_count;    /* Lockings that succeeded after spinning */
+    uint32_t sleep_count;   /* The number of times a thread went to sleep */
+    uint32_t handoff_count; /* Unlocks that had to wake up a waiter */
 } mutex_t;
 
 int mutex_lock( lock_id mutex, int flags );
@@ -60,4 +77,8 @@ int sys_mutex_destroy( lock_id mutex );
 lock_id mutex_create( const char* name, int flags );
 int mutex_destroy( lock_id mutex );
 
+#ifdef ENABLE_DEBUGGER
+int dbg_list_mutexes( const char* params );
+#endif /* ENABLE_DEBUGGER */
+
 #endif /* _LOCK_MUTEX_H_ */
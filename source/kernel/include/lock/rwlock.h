@@ -19,10 +19,42 @@
 #ifndef _LOCK_RWLOCK_H_
 #define _LOCK_RWLOCK_H_
 
+#include <thread.h>
 #include <lock/context.h>
+#include <lock/common.h>
+#include <sched/waitqueue.h>
+
+/* The RW lock can be held by multiple readers or by a single writer at
+   the same time. Writers are preferred: new readers are blocked while a
+   writer is waiting for the lock, so a reader must not lock it again
+   while it already holds it. */
 
 typedef struct rwlock {
     lock_header_t header;
+
+    int readers;
+    int writers_waiting;
+    thread_id writer;
+
+    waitqueue_t reader_waiters;
+    waitqueue_t writer_waiters;
 } rwlock_t;
 
+int rwlock_read_lock( lock_id rwlock, int flags );
+int rwlock_read_unlock( lock_id rwlock );
+int rwlock_write_lock( lock_id rwlock, int flags );
+int rwlock_write_unlock( lock_id rwlock );
+
+int rwlock_clone( rwlock_t* old, rwlock_t* new );
+int rwlock_update( rwlock_t* rwlock, thread_id new_thread );
+
+int sys_rwlock_read_lock( lock_id rwlock );
+int sys_rwlock_write_lock( lock_id rwlock );
+int sys_rwlock_unlock( lock_id rwlock );
+int sys_rwlock_create( const char* name );
+int sys_rwlock_destroy( lock_id rwlock );
+
+lock_id rwlock_create( const char* name );
+int rwlock_destroy( lock_id rwlock );
+
 #endif /* _LOCK_RWLOCK_H_ */
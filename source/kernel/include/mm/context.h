@@ -22,7 +22,6 @@
 #include <config.h>
 #include <mm/region.h>
 #include <lock/mutex.h>
-#include <lib/array.h>
 
 struct process;
 
@@ -30,9 +29,15 @@ typedef struct memory_context {
     struct memory_context* next;
 
     lock_id mutex;
-    array_t regions;
     struct process* process;
 
+    /* The regions of the context, see memory_region_t */
+
+    memory_region_t* region_root;
+    memory_region_t* first_region;
+    memory_region_t* last_hit;
+    int region_count;
+
     void* arch_data;
 } memory_context_t;
 
@@ -58,6 +63,15 @@ int memory_context_insert_region( memory_context_t* context, memory_region_t* re
  */
 int memory_context_remove_region( memory_context_t* context, memory_region_t* region );
 
+/**
+ * Updates the memory context after the size of one of its regions
+ * has been changed.
+ *
+ * @param context The memory context of the region
+ * @param region The resized region
+ */
+void memory_context_update_region( memory_context_t* context, memory_region_t* region );
+
 memory_region_t* memory_context_get_region_for( memory_context_t* context, ptr_t address );
 
 /**
@@ -85,6 +99,14 @@ bool memory_context_find_unmapped_region( memory_context_t* context, ptr_t start
  */
 bool memory_context_can_resize_region( memory_context_t* context, memory_region_t* region, uint64_t new_size );
 
+/**
+ * Creates a new memory context that contains only the kernel.
+ *
+ * @param process The process we're creating the memory context for
+ * @return On success the new memory context is returned, otherwise NULL
+ */
+memory_context_t* memory_context_create( struct process* process );
+
 /**
  * Clones an existing memory context.
  *
@@ -23,63 +23,75 @@
 #include <config.h>
 
 /**
- * Minimum block size that should be allocated when a new
- * block is created by kmalloc. This value has to be page
- * aligned.
+ * The number of general purpose object caches used by kmalloc.
  */
-#define KMALLOC_BLOCK_SIZE      131072
+#define KMALLOC_CACHE_COUNT 8
+
+#define KMALLOC_LARGE_MAGIC 0xCAFEBAB0
 
 /**
- * The size of the root block that is allocated during the
- * kernel initialization. This value has to be page aligned.
+ * Header of the allocations that are too big for the object
+ * caches. These are allocated directly from the page allocator
+ * and the header is stored at the start of the first page.
  */
-#define KMALLOC_ROOT_SIZE       524288
+typedef struct kmalloc_large {
+    uint32_t magic;
+    uint16_t pages;
+    uint16_t site;
+} kmalloc_large_t;
 
-#define KMALLOC_BLOCK_MAGIC 0xCAFEBAB0
-#define KMALLOC_CHUNK_MAGIC 0xDEADBEE0
+typedef struct kmalloc_statistics {
+    uint32_t used_pages;
+    uint32_t alloc_size;
 
-enum {
-    CHUNK_FREE = 1
-};
+    /* Per-CPU magazine informations (summed for all CPUs) */
 
-struct kmalloc_chunk;
+    uint32_t cached_objects;
+    uint32_t magazine_hits;
+    uint32_t magazine_misses;
+    uint32_t magazine_flushes;
+} kmalloc_statistics_t;
 
-typedef struct kmalloc_block {
-    uint32_t magic;
-    uint32_t pages;
-    uint32_t biggest_free;
-    struct kmalloc_block* next;
-} kmalloc_block_t;
-
-typedef struct kmalloc_chunk {
-    uint32_t magic;
-    uint32_t size;
-    struct kmalloc_block* block;
-    struct kmalloc_chunk* prev;
-    struct kmalloc_chunk* next;
-} kmalloc_chunk_t;
-
-#ifdef ENABLE_KMALLOC_DEBUG
+/**
+ * The number of call sites tracked by the allocation profiler
+ * and the number of size classes in the histogram of a site.
+ */
+#define KMALLOC_PROFILER_SITES   256
+#define KMALLOC_PROFILER_BUCKETS 9
 
-typedef struct {
-    int ( *init )( void );
-    int ( *malloc )( uint32_t size, void* p );
-    int ( *malloc_trace )( ptr_t ip, const char* name );
-    int ( *free )( void* p );
-} kmalloc_debug_output_t;
+typedef struct kmalloc_site_stat {
+    uint32_t alloc_count;
+    uint32_t free_count;
+    int32_t live_bytes;
+    uint32_t histogram[ KMALLOC_PROFILER_BUCKETS ];
+} kmalloc_site_stat_t;
 
-void kmalloc_debug( uint32_t size, void* p );
-void kfree_debug( void* p );
-void kmalloc_set_debug_output( kmalloc_debug_output_t* out );
+/**
+ * Accounts an allocation to the call site it was made from.
+ *
+ * @param ip The address of the caller of kmalloc
+ * @param size The requested size
+ * @param real_size The number of bytes used by the allocation
+ * @return The identifier of the call site that has to be passed
+ *         to kmalloc_profiler_free() when the memory is freed
+ */
+uint16_t kmalloc_profiler_alloc( ptr_t ip, uint32_t size, uint32_t real_size );
+void kmalloc_profiler_free( uint16_t site, uint32_t real_size );
 
-#endif /* ENABLE_KMALLOC_DEBUG */
+/**
+ * Creates the kmalloc_profile node in the kernel debug filesystem
+ * that lists the statistics of the call sites.
+ *
+ * @return On success 0 is returned
+ */
+int init_kmalloc_profiler( void );
 
 #ifdef ENABLE_KMALLOC_BARRIERS
 
 #define KMALLOC_BARRIER_SIZE 512
 
 void* kmalloc_create_barriers(void* p, size_t size);
-void kmalloc_validate_barriers(void* p);
+void kmalloc_validate_barriers(void* p, size_t size);
 
 #endif /* ENABLE_KMALLOC_BARRIERS */
 
@@ -100,7 +112,12 @@ void* kcalloc( uint32_t nmemb, uint32_t size );
  */
 void kfree( void* p );
 
-void kmalloc_get_statistics( uint32_t* used_pages, uint32_t* alloc_size );
+/**
+ * Collects the statistics of the kernel memory allocator.
+ *
+ * @param stats The structure to fill with the statistics
+ */
+void kmalloc_get_statistics( kmalloc_statistics_t* stats );
 
 /**
  * Initializes the kernel memory allocator. This function is called
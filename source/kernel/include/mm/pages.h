@@ -29,11 +29,8 @@ enum memory_type {
     MEM_ARCH_FIRST
 };
 
-typedef struct memory_type_desc {
-    bool free;
-    ptr_t start;
-    ptr_t size;
-} memory_type_desc_t;
+#define PAGE_FREE_BLOCK 0x1
+#define PAGE_SLAB       0x2
 
 /**
  * @struct page
@@ -41,12 +38,46 @@ typedef struct memory_type_desc {
  * This structure represents a page of the physical memory.
  * An array of this structure is stored after the kernel to
  * manage the status (allocated/free) of all physical memory
- * pages.
+ * pages. The first page of a free block of the buddy allocator
+ * has the PAGE_FREE_BLOCK flag set and links the block to the
+ * free list of its order. Pages used by the slab allocator have
+ * the PAGE_SLAB flag set and point to their slab with owner.
  */
 typedef struct memory_page {
     int ref_count;
+    uint16_t flags;
+    uint16_t order;
+    struct memory_page* prev;
+    struct memory_page* next;
+    void* owner;
 } memory_page_t;
 
+typedef struct memory_type_desc {
+    bool free;
+    ptr_t start;
+    ptr_t size;
+
+    /* Buddy allocator state of this memory type */
+
+    uint32_t free_page_count;
+    memory_page_t* free_lists[ MAX_PAGE_ORDER ];
+} memory_type_desc_t;
+
+/**
+ * @struct page_cache
+ *
+ * Per-CPU cache of free single pages of the MEM_COMMON memory
+ * type. Single page allocations are served from here without
+ * taking pages_lock. The cache is refilled from and drained to
+ * the global allocator in batches.
+ */
+typedef struct page_cache {
+    uint32_t count;
+    uint32_t hits;
+    uint32_t misses;
+    void* pages[ MAX_PAGE_CACHE_SIZE ];
+} page_cache_t;
+
 /**
  * @struct memory_info
  *
@@ -63,6 +94,32 @@ typedef struct memory_info {
 
     uint32_t kmalloc_used_pages;
     uint32_t kmalloc_alloc_size;
+
+    /* Per-CPU kmalloc magazine informations (summed for all CPUs) */
+
+    uint32_t kmalloc_cached_objects;
+    uint32_t kmalloc_magazine_hits;
+    uint32_t kmalloc_magazine_misses;
+    uint32_t kmalloc_magazine_flushes;
+
+    /* Per-CPU page cache informations (summed for all CPUs) */
+
+    uint32_t page_cache_pages;
+    uint32_t page_cache_hits;
+    uint32_t page_cache_misses;
+
+    /* File page cache informations */
+
+    uint32_t file_cache_pages;
+    uint32_t file_cache_hits;
+    uint32_t file_cache_misses;
+    uint32_t file_cache_evictions;
+
+    /* File mapping fault informations */
+
+    uint32_t file_map_faults;
+    uint32_t file_map_sequential_faults;
+    uint32_t file_map_pages;
 } memory_info_t;
 
 extern uint64_t memory_size;
@@ -70,8 +127,39 @@ extern memory_page_t* memory_pages;
 extern spinlock_t pages_lock;
 extern memory_type_desc_t memory_descriptors[ MAX_MEMORY_TYPES ];
 
+extern uint32_t page_cache_high;
+extern uint32_t page_cache_batch;
+
 void* do_alloc_pages( memory_type_desc_t* memory_desc, uint32_t count );
 
+/**
+ * Drops a reference of a physical memory page. The page is given
+ * back to the allocator when its reference counter reaches zero.
+ * The caller has to hold pages_lock.
+ *
+ * @param page The page to release
+ */
+void do_put_page( memory_page_t* page );
+
+/**
+ * Drops a reference of a physical memory page like do_put_page(), but
+ * the page is not freed when the last reference is dropped, it is added
+ * to a list instead. This is used when the page may still be reachable
+ * through stale TLB entries, the list has to be freed by put_page_list()
+ * after the TLB flush. The caller has to hold pages_lock.
+ *
+ * @param page The page to release
+ * @param list The list of pages to free later
+ */
+void do_put_page_deferred( memory_page_t* page, memory_page_t** list );
+
+/**
+ * Frees the pages collected by do_put_page_deferred().
+ *
+ * @param list The first page of the list
+ */
+void put_page_list( memory_page_t* list );
+
 /**
  * Allocates a number of physical memory pages.
  *
@@ -112,5 +200,6 @@ int reserve_memory_pages( ptr_t start, ptr_t size );
 int register_memory_type( int mem_type, ptr_t start, ptr_t size );
 int init_page_allocator( ptr_t page_map_address, uint64_t _memory_size );
 int init_page_allocator_late( void );
+int init_page_caches( void );
 
 #endif /* _MM_PAGES_H_ */
@@ -24,6 +24,14 @@
 
 #include <arch/mm/config.h>
 
+/**
+ * The limits of the readahead window of file mapped regions in pages.
+ * Random accesses load the minimal window around the faulting page,
+ * sequential faults double the window up to the maximum.
+ */
+#define REGION_RA_MIN_PAGES 4
+#define REGION_RA_MAX_PAGES 64
+
 struct memory_context;
 struct file;
 
@@ -39,8 +47,9 @@ typedef enum region_flags {
     REGION_ALLOCATED = ( 1 << 6 ),
     REGION_CLONED = ( 1 << 7 ),
     REGION_CALL_FROM_USERSPACE = ( 1 << 8 ),
+    REGION_LAZY = ( 1 << 9 ),
     REGION_USER_FLAGS = ( REGION_READ | REGION_WRITE | REGION_EXECUTE | REGION_KERNEL |
-                         REGION_STACK | REGION_CALL_FROM_USERSPACE ),
+                         REGION_STACK | REGION_CALL_FROM_USERSPACE | REGION_LAZY ),
     REGION_MAPPING_FLAGS = ( REGION_REMAPPED | REGION_ALLOCATED | REGION_CLONED )
 } region_flags_t;
 
@@ -60,8 +69,44 @@ typedef struct memory_region {
     size_t file_size;
 
     struct memory_context* context;
+
+    /* The number of private physical pages mapped to the region. Pages
+       of lazy regions are allocated on the first write access, until
+       then reads are served from the shared zero page. */
+
+    uint32_t rss;
+
+    /* Readahead state of file mapped regions protected by the mutex of
+       the memory context. ra_next is the page index after the last loaded
+       window, a fault there means sequential access. */
+
+    uint32_t ra_next;
+    uint32_t ra_window;
+    uint32_t file_faults;
+    uint32_t file_fault_pages;
+
+    /* Links of the memory context. The regions of a context are
+       stored in an AVL tree ordered by address and in a list in
+       the same order. The gap is the unmapped space between the
+       previous region and this one, subtree_gap is the biggest
+       gap in the subtree of the region. */
+
+    struct memory_region* parent;
+    struct memory_region* left;
+    struct memory_region* right;
+    struct memory_region* prev;
+    struct memory_region* next;
+    int height;
+    uint64_t gap;
+    uint64_t subtree_gap;
 } memory_region_t;
 
+typedef struct region_fault_statistics {
+    uint32_t faults;
+    uint32_t sequential_faults;
+    uint32_t pages;
+} region_fault_statistics_t;
+
 typedef struct region_info {
     ptr_t start;
     ptr_t size;
@@ -85,6 +130,30 @@ int do_memory_region_remap_pages( memory_region_t* region, ptr_t physical_addres
 int do_memory_region_alloc_pages( memory_region_t* region );
 int do_memory_region_put( memory_region_t* region );
 
+void memory_region_account_pages( memory_region_t* region, int count );
+
+/**
+ * Calculates the window of pages to load on a fault of a file mapped
+ * region and updates the readahead state of the region. The memory
+ * context of the region has to be locked.
+ *
+ * @param region The region of the fault
+ * @param index The index of the faulting page in the region
+ * @param first The index of the first page in the window is stored here
+ * @return The number of pages in the window
+ */
+uint32_t memory_region_readahead( memory_region_t* region, uint32_t index, uint32_t* first );
+
+/**
+ * Records the number of pages mapped by a fault of a file mapped region.
+ *
+ * @param region The region of the fault
+ * @param count The number of mapped pages
+ */
+void memory_region_account_file_fault( memory_region_t* region, uint32_t count );
+
+void memory_region_get_fault_statistics( region_fault_statistics_t* stats );
+
 /* Memory region handling */
 
 memory_region_t* memory_region_create( const char* name, uint64_t size, uint32_t flags );
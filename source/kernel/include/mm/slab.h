@@ -0,0 +1,224 @@
+/* Slab allocator
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _MM_SLAB_H_
+#define _MM_SLAB_H_
+
+#include <types.h>
+#include <config.h>
+
+#include <arch/spinlock.h>
+
+/**
+ * The maximum number of objects in a slab. This
+ * defines the size of the free bitmap in the slab
+ * header.
+ */
+#define KMEM_SLAB_MAX_OBJECTS 256
+
+/**
+ * The minimum size and alignment of the objects.
+ */
+#define KMEM_OBJECT_ALIGN 8
+
+/**
+ * The number of objects that a per-CPU magazine can hold and
+ * the number of objects moved between a magazine and the slabs
+ * of the cache at once.
+ */
+#define KMEM_MAGAZINE_SIZE  32
+#define KMEM_MAGAZINE_BATCH 16
+
+#define KMEM_SLAB_MAGIC 0x51AB51AB
+
+/**
+ * Cache flags
+ */
+enum {
+    KMEM_CACHE_TAGGED = ( 1 << 0 )  /* Store a 16 bit tag for every object */
+};
+
+struct kmem_cache;
+
+/**
+ * @struct kmem_slab
+ *
+ * A slab is a page aligned set of physical memory pages that is
+ * cut into equal sized objects. This header is stored at the start
+ * of the first page, the objects follow it. A set bit in the bitmap
+ * means that the object with the same index is free. Slabs of tagged
+ * caches have the tag array between the header and the objects.
+ */
+typedef struct kmem_slab {
+    uint32_t magic;
+    struct kmem_cache* cache;
+    struct kmem_slab* prev;
+    struct kmem_slab* next;
+    uint16_t* tags;
+    uint8_t* objects;
+    uint32_t free_count;
+    uint32_t bitmap[ KMEM_SLAB_MAX_OBJECTS / 32 ];
+} kmem_slab_t;
+
+/**
+ * @struct kmem_magazine
+ *
+ * A per-CPU stack of free objects in front of the slabs of a cache.
+ * Allocations and frees on the owner CPU are served from here without
+ * taking the lock of the cache, objects are moved from and to the slabs
+ * in batches when the magazine runs empty or gets full.
+ */
+typedef struct kmem_magazine {
+    uint32_t count;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t flushes;
+    void* objects[ KMEM_MAGAZINE_SIZE ];
+} kmem_magazine_t;
+
+typedef struct kmem_cache {
+    const char* name;
+    spinlock_t lock;
+
+    uint32_t flags;
+    uint32_t object_size;
+    uint32_t objects_offset;
+    uint32_t slab_pages;
+    uint32_t objects_per_slab;
+
+    /* Slabs with free objects, full slabs and at most one
+       completely free slab that is kept to avoid thrashing. */
+
+    kmem_slab_t* partial_slabs;
+    kmem_slab_t* full_slabs;
+    kmem_slab_t* empty_slab;
+
+    kmem_magazine_t magazines[ MAX_CPU_COUNT ];
+
+    /* Statistics */
+
+    uint32_t slab_count;
+    uint32_t object_count;
+
+    struct kmem_cache* next;
+} kmem_cache_t;
+
+/**
+ * Initializes a cache for fixed size objects in a caller provided
+ * structure. This is used by kmalloc to set up its size class caches
+ * before any memory can be allocated.
+ *
+ * @param cache The cache structure to initialize
+ * @param name The name of the cache
+ * @param object_size The size of the objects in the cache
+ * @param flags The KMEM_CACHE_* flags of the cache
+ * @return On success 0 is returned
+ */
+int kmem_cache_init( kmem_cache_t* cache, const char* name, uint32_t object_size, uint32_t flags );
+
+/**
+ * Creates a new cache for fixed size objects.
+ *
+ * @param name The name of the cache
+ * @param object_size The size of the objects in the cache
+ * @return On success a non-NULL pointer is returned to the new cache
+ */
+kmem_cache_t* kmem_cache_create( const char* name, uint32_t object_size );
+
+/**
+ * Destroys a cache created by kmem_cache_create(). All objects of
+ * the cache have to be freed before calling this.
+ *
+ * @param cache The cache to destroy
+ */
+void kmem_cache_destroy( kmem_cache_t* cache );
+
+/**
+ * Allocates an object from the specified cache.
+ *
+ * @param cache The cache to allocate the object from
+ * @return On success a non-NULL pointer is returned to the object
+ */
+void* kmem_cache_alloc( kmem_cache_t* cache );
+
+/**
+ * Frees an object previously allocated from the specified cache.
+ *
+ * @param cache The cache the object was allocated from
+ * @param p The object to free
+ */
+void kmem_cache_free( kmem_cache_t* cache, void* p );
+
+/**
+ * Returns the slab that contains the specified object.
+ *
+ * @param p Pointer to an object
+ * @return The slab of the object or NULL if the pointer is not
+ *         in a page owned by the slab allocator
+ */
+kmem_slab_t* kmem_get_slab( void* p );
+
+/**
+ * Sets the tag of an object in a cache created with the
+ * KMEM_CACHE_TAGGED flag.
+ *
+ * @param slab The slab of the object
+ * @param p Pointer to the object
+ * @param tag The new tag of the object
+ */
+void kmem_set_tag( kmem_slab_t* slab, void* p, uint16_t tag );
+
+/**
+ * Returns the tag of an object in a cache created with the
+ * KMEM_CACHE_TAGGED flag.
+ *
+ * @param slab The slab of the object
+ * @param p Pointer to the object
+ * @return The tag of the object
+ */
+uint16_t kmem_get_tag( kmem_slab_t* slab, void* p );
+
+/**
+ * Returns the index of the current processor that can be used
+ * to access per-CPU data. Before the per-CPU magazines are enabled
+ * only the boot processor runs, 0 is returned then.
+ *
+ * @return The index of the current processor
+ */
+int kmem_get_processor_index( void );
+
+/**
+ * Collects the statistics of all caches.
+ *
+ * @param used_pages The number of pages used by the slabs
+ * @param alloc_size The number of allocated bytes
+ * @param magazine The summed object count and counters of the
+ *                 per-CPU magazines are stored here
+ */
+void kmem_get_statistics( uint32_t* used_pages, uint32_t* alloc_size, kmem_magazine_t* magazine );
+
+/**
+ * Enables the per-CPU magazines of the caches. This is called
+ * during the kernel initialization when the current processor
+ * can be already identified.
+ *
+ * @return On success 0 is returned
+ */
+int init_kmem_magazines( void );
+
+#endif /* _MM_SLAB_H_ */
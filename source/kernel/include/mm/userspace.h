@@ -19,6 +19,52 @@
 #ifndef _MM_USERSPACE_H_
 #define _MM_USERSPACE_H_
 
+#include <types.h>
+#include <errno.h>
+
+#include <arch/mm/config.h>
+
+int arch_copy_user_data( void* dest, const void* src, size_t size );
+
+static inline bool is_user_buffer( const void* buffer, size_t size ) {
+    return ( ( ( ptr_t )buffer >= FIRST_USER_ADDRESS ) &&
+             ( ( ptr_t )buffer + size >= ( ptr_t )buffer ) );
+}
+
+/**
+ * Copies data to a userspace buffer. Unlike a plain memcpy() a page
+ * fault that can't be resolved (e.g. a write to a read-only page) fails
+ * the copy instead of killing the thread.
+ *
+ * @param dest The userspace buffer
+ * @param src The kernel buffer
+ * @param size The number of bytes to copy
+ * @return On success 0 is returned, -EFAULT if the userspace buffer is invalid
+ */
+static inline int copy_to_user( void* dest, const void* src, size_t size ) {
+    if ( !is_user_buffer( dest, size ) ) {
+        return -EFAULT;
+    }
+
+    return arch_copy_user_data( dest, src, size );
+}
+
+/**
+ * Copies data from a userspace buffer, see copy_to_user().
+ *
+ * @param dest The kernel buffer
+ * @param src The userspace buffer
+ * @param size The number of bytes to copy
+ * @return On success 0 is returned, -EFAULT if the userspace buffer is invalid
+ */
+static inline int copy_from_user( void* dest, const void* src, size_t size ) {
+    if ( !is_user_buffer( src, size ) ) {
+        return -EFAULT;
+    }
+
+    return arch_copy_user_data( dest, src, size );
+}
+
 void* sys_sbrk( int increment );
 
 #endif // _MM_USERSPACE_H_
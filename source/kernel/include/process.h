@@ -35,6 +35,7 @@
 #define WUNTRACED 2
 
 struct ipc_port;
+struct thread;
 
 typedef struct process {
     hashitem_t hash;
@@ -51,6 +52,14 @@ typedef struct process {
 
     memory_region_t* heap_region;
 
+    /* The address of the time page in the process or 0 if it's not mapped */
+    ptr_t time_page;
+
+    /* The thread that created this process with vfork(). It is blocked
+       until the process gets its own memory context with execve() or
+       exits, until then the memory context belongs to its process. */
+    struct thread* vfork_parent;
+
     uint64_t vmem_size;
     uint64_t pmem_size;
 
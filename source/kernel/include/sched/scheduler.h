@@ -23,10 +23,83 @@
 #include <thread.h>
 #include <config.h>
 #include <sched/waitqueue.h>
+#include <sched/timerwheel.h>
 
 #include <arch/spinlock.h>
 
-extern waitqueue_t sleep_queue;
+/* The number of thread priority levels */
+#define SCHED_PRIORITY_COUNT ( PRIORITY_HIGH + 1 )
+
+/* The time slice of the lowest and the highest priority threads (in usecs) */
+#define SCHED_MIN_QUANTUM ( 10 * 1000 )
+#define SCHED_MAX_QUANTUM ( 100 * 1000 )
+
+/* The maximum number of levels a thread is moved from its static
+   priority by the interactivity bonus or penalty. */
+#define SCHED_MAX_SLEEP_BONUS 3
+
+/* Scheduling policies */
+enum {
+    SCHED_OTHER = 0,
+    SCHED_FIFO = 1,
+    SCHED_RR = 2
+};
+
+/* The range of the real-time priorities */
+#define SCHED_RT_PRIORITY_MIN 1
+#define SCHED_RT_PRIORITY_MAX 31
+
+/* The time slice of SCHED_RR threads (in usecs) */
+#define SCHED_RR_QUANTUM ( 50 * 1000 )
+
+/* Real-time threads may use SCHED_RT_RUNTIME usecs from every
+   SCHED_RT_PERIOD on a CPU, the rest is left for other threads */
+#define SCHED_RT_PERIOD ( 1000 * 1000 )
+#define SCHED_RT_RUNTIME ( 950 * 1000 )
+
+/* The time between two load balancing of the run queues (in usecs) */
+#define SCHED_BALANCE_INTERVAL ( 100 * 1000 )
+
+/**
+ * @struct priority_array
+ *
+ * One FIFO list of ready threads for each priority level. The bits of
+ * the bitmap are set for the non-empty lists, so the thread with the
+ * highest priority is found in constant time.
+ */
+typedef struct priority_array {
+    uint32_t bitmap;
+    uint32_t count;
+    thread_t* first[ SCHED_PRIORITY_COUNT ];
+    thread_t* last[ SCHED_PRIORITY_COUNT ];
+} priority_array_t;
+
+/**
+ * @struct run_queue
+ *
+ * The ready threads of one CPU. Each processor schedules threads from
+ * its own run queue and steals work from the busiest one when it has
+ * nothing else to run. Real-time threads are kept in a separate array
+ * that is always checked before the time-sliced ones.
+ *
+ * Each run queue has its own lock, so the CPUs don't have to lock the
+ * scheduler to pick their next thread. It is taken after the scheduler
+ * lock, and two run queues are locked in the order of their CPUs.
+ */
+typedef struct run_queue {
+    spinlock_t lock;
+    priority_array_t rt;
+    priority_array_t arrays[ 2 ];
+    priority_array_t* active;
+    priority_array_t* expired;
+    uint64_t rt_time;
+    uint64_t rt_period_start;
+    uint64_t last_balance;
+    uint32_t migrations;
+    int processor;
+} run_queue_t;
+
+extern timer_wheel_t sleep_queue;
 extern spinlock_t scheduler_lock;
 
 #define scheduler_lock() spinlock_disable( &scheduler_lock )
@@ -38,6 +111,48 @@ int add_thread_to_expired( thread_t* thread );
 
 void reset_thread_quantum( thread_t* thread );
 
+/**
+ * Accounts the time the current thread spent in user or kernel mode
+ * since its last checkpoint and sets whether it runs in the kernel
+ * from now on. This doesn't lock the scheduler, only disables the
+ * interrupts on the local CPU.
+ *
+ * @param thread The current thread
+ * @param in_system Non-zero if the thread enters the kernel, zero if it
+ *                  returns to user space
+ */
+void set_thread_in_system( thread_t* thread, int in_system );
+
+/**
+ * Moves the thread to an allowed run queue if it is waiting for
+ * a CPU that was removed from its affinity mask. The scheduler
+ * has to be locked while calling this function.
+ *
+ * @param thread The thread whose affinity mask was changed
+ */
+void update_thread_affinity( thread_t* thread );
+
+/**
+ * Changes the scheduling policy and the real-time priority of a thread.
+ * The scheduler has to be locked while calling this function.
+ *
+ * @param thread The thread to change
+ * @param policy The new policy (SCHED_OTHER, SCHED_FIFO or SCHED_RR)
+ * @param priority The real-time priority, it must be 0 for SCHED_OTHER
+ *                 and between SCHED_RT_PRIORITY_MIN and SCHED_RT_PRIORITY_MAX
+ *                 for the real-time policies
+ * @return On success 0 is returned, otherwise -EINVAL
+ */
+int do_set_thread_scheduler( thread_t* thread, int policy, int priority );
+
+/**
+ * Returns the number of threads waiting in the specified run queue.
+ *
+ * @param queue The run queue
+ * @return The number of ready and expired threads in the queue
+ */
+uint32_t get_run_queue_length( run_queue_t* queue );
+
 thread_t* do_schedule( thread_t* current );
 int schedule( registers_t* regs );
 
@@ -0,0 +1,111 @@
+/* Hierarchical timer wheel
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SCHED_TIMERWHEEL_H_
+#define _SCHED_TIMERWHEEL_H_
+
+#include <types.h>
+#include <sched/waitqueue.h>
+
+#include <arch/spinlock.h>
+
+/* The length of one timer wheel tick is 2^TIMER_WHEEL_SHIFT usecs */
+#define TIMER_WHEEL_SHIFT 10
+
+/* The innermost level has 2^8 slots, each of the outer levels has
+   2^6 slots and covers 2^6 times longer period than the previous */
+#define TIMER_ROOT_BITS  8
+#define TIMER_LEVEL_BITS 6
+#define TIMER_ROOT_SIZE  ( 1 << TIMER_ROOT_BITS )
+#define TIMER_LEVEL_SIZE ( 1 << TIMER_LEVEL_BITS )
+#define TIMER_LEVEL_COUNT 3
+
+/**
+ * @struct timer_wheel
+ *
+ * A hierarchical timing wheel for nodes with a wakeup time. Inserting
+ * and removing a node is done in constant time. The nodes of the outer
+ * levels are moved to the inner ones as the wheel turns. The nodes of
+ * the root slot belonging to the current tick are compared with the
+ * current time, so they expire with microsecond resolution.
+ *
+ * The wheel has its own lock, so the time of the next expiry can be
+ * checked without locking the scheduler. It is always the innermost
+ * lock, no other lock is taken while it is held.
+ */
+typedef struct timer_wheel {
+    spinlock_t lock;
+    uint64_t current_tick;
+    uint32_t count;
+    waitqueue_t root[ TIMER_ROOT_SIZE ];
+    waitqueue_t levels[ TIMER_LEVEL_COUNT ][ TIMER_LEVEL_SIZE ];
+} timer_wheel_t;
+
+/**
+ * Inserts a node to the timer wheel according to its wakeup time.
+ *
+ * @param wheel The pointer to the timer wheel
+ * @param node The node to insert
+ * @return On success 0 is returned
+ */
+int timer_wheel_add_node( timer_wheel_t* wheel, waitnode_t* node );
+
+/**
+ * Removes a node from the timer wheel. It is not an error to call
+ * this with a node that is not (or no longer) in the wheel.
+ *
+ * @param wheel The pointer to the timer wheel
+ * @param node The node to remove
+ * @return On success 0 is returned
+ */
+int timer_wheel_remove_node( timer_wheel_t* wheel, waitnode_t* node );
+
+/**
+ * Wakes up the threads and fires the callbacks of all nodes with
+ * a wakeup time less or equal to the specified time. The scheduler
+ * is locked only once for all the nodes expiring in this call, and
+ * it is not locked at all if no node is due.
+ *
+ * @param wheel The pointer to the timer wheel
+ * @param now The current system time
+ * @return On success 0 is returned
+ */
+int timer_wheel_expire( timer_wheel_t* wheel, uint64_t now );
+
+/**
+ * Returns the time when the next node of the timer wheel expires. Nodes
+ * on the outer levels are not examined, the time of the next cascade is
+ * returned for them instead, so the result may be earlier than the real
+ * expiry but never later.
+ *
+ * @param wheel The pointer to the timer wheel
+ * @param limit The result is not greater than this time
+ * @return The time of the next expiry
+ */
+uint64_t timer_wheel_next_expiry( timer_wheel_t* wheel, uint64_t limit );
+
+/**
+ * Initializes a timer wheel.
+ *
+ * @param wheel The pointer to the timer wheel
+ * @param now The current system time
+ * @return On success 0 is returned
+ */
+int init_timer_wheel( timer_wheel_t* wheel, uint64_t now );
+
+#endif /* _SCHED_TIMERWHEEL_H_ */
@@ -45,6 +45,9 @@ typedef struct waitnode {
     uint64_t wakeup_time;
     bool in_queue;
 
+    /* The timer wheel slot the node is linked to */
+    struct waitqueue* slot;
+
     struct waitnode* prev;
     struct waitnode* next;
 } waitnode_t;
@@ -54,17 +57,6 @@ typedef struct waitqueue {
     waitnode_t* last_node;
 } waitqueue_t;
 
-/**
- * Inserts a new node to the specified waitqueue. The new node
- * will be inserted to the list according to its wakeup time.
- *
- * @param queue The pointer to the waitqueue structure
- * @param node The pointer to the waitnode structure that will
- *             be inserted into the waitqueue
- * @return On success 0 is returned
- */
-int waitqueue_add_node( waitqueue_t* queue, waitnode_t* node );
-
 /**
  * Inserts a new node to the specified waitqueue. The new node
  * will be inserted to the end of the list.
@@ -85,16 +77,6 @@ int waitqueue_add_node_tail( waitqueue_t* queue, waitnode_t* node );
  */
 int waitqueue_remove_node( waitqueue_t* queue, waitnode_t* node );
 
-/**
- * Wakes up nodes in the queue with wakeup time less or
- * equal to the specified time in now parameter.
- *
- * @param queue The pointer to the waitqueue structure
- * @param now The time to use as a reference for the wakeup
- * @return On success 0 is returned
- */
-int waitqueue_wake_up( waitqueue_t* queue, uint64_t now );
-
 /**
  * Wakes up the first count number of nodes from the queue.
  *
@@ -23,6 +23,9 @@
 #include <config.h>
 #include <thread.h>
 #include <process.h>
+#include <clockevent.h>
+#include <mm/pages.h>
+#include <sched/scheduler.h>
 
 #include <arch/atomic.h>
 
@@ -39,6 +42,21 @@ typedef struct cpu {
 
     void* arch_data;
     uint32_t features;
+
+    page_cache_t page_cache;
+    run_queue_t run_queue;
+
+    /* The timer device of the CPU and the time of its next event */
+
+    clockevent_t* clockevent;
+    uint64_t next_event;
+
+    /* TLB shootdown statistics */
+
+    uint32_t tlb_ipis_sent;
+    uint32_t tlb_ipis_received;
+    uint32_t tlb_full_flushes;
+    uint32_t tlb_page_flushes;
 } cpu_t;
 
 typedef struct processor_info {
@@ -47,6 +65,12 @@ typedef struct processor_info {
     int present;
     int running;
     uint32_t features;
+    uint32_t tlb_ipis_sent;
+    uint32_t tlb_ipis_received;
+    uint32_t tlb_full_flushes;
+    uint32_t tlb_page_flushes;
+    uint32_t run_queue_length;
+    uint32_t migrations;
 } processor_info_t;
 
 extern int processor_count;
@@ -25,8 +25,12 @@
 #include <mm/region.h>
 #include <lib/hashtable.h>
 
+#include <arch/atomic.h>
 #include <arch/mm/config.h>
 
+/* The affinity mask that allows a thread to run on any CPU */
+#define THREAD_AFFINITY_ALL 0xFFFFFFFF
+
 #define KERNEL_STACK_PAGES ( KERNEL_STACK_SIZE / PAGE_SIZE )
 #define USER_STACK_PAGES   ( USER_STACK_SIZE / PAGE_SIZE )
 
@@ -62,12 +66,19 @@ typedef struct thread {
     int state;
     int priority;
     int exit_code;
-    int in_scheduler;
+    atomic_t in_scheduler;
     int blocking_semaphore;
 
     struct process* process;
 
     /* Scheduling time stuffs */
+    int cpu;
+    volatile int on_cpu; /* A CPU still runs on the kernel stack */
+    uint32_t cpu_affinity;
+    int sched_policy;
+    int rt_priority;
+    int sleep_bonus;
+    int dynamic_priority;
     uint64_t quantum;
     uint64_t exec_time;
     uint64_t cpu_time;
@@ -95,6 +106,9 @@ typedef struct thread {
     /* TLD data */
     ptr_t* tld_data;
 
+    /* The process created by vfork() that borrows our memory context */
+    struct process* vfork_child;
+
     /* Architecture specific data */
     void* arch_data;
 } thread_t;
@@ -155,6 +169,28 @@ int do_wake_up_thread( thread_t* thread );
  */
 int thread_wake_up( thread_id id );
 
+int do_set_thread_affinity( thread_t* thread, uint32_t affinity );
+
+/**
+ * Restricts the processors a thread is allowed to run on.
+ *
+ * @param id The id of the thread
+ * @param affinity A mask with a bit set for each allowed CPU index
+ * @return On success 0 is returned, otherwise -EINVAL if the thread does not
+ *         exist or the mask does not contain any running processor
+ */
+int thread_set_affinity( thread_id id, uint32_t affinity );
+
+/**
+ * Changes the scheduling policy of a thread.
+ *
+ * @param id The id of the thread
+ * @param policy The new scheduling policy (SCHED_OTHER, SCHED_FIFO or SCHED_RR)
+ * @param priority The real-time priority of the thread (0 for SCHED_OTHER)
+ * @return On success 0 is returned, otherwise -EINVAL
+ */
+int thread_set_scheduler( thread_id id, int policy, int priority );
+
 /**
  * Returnes the total number of created threads.
  *
@@ -176,6 +212,10 @@ thread_t* get_thread_by_id( thread_id id );
 thread_id sys_create_thread( const char* name, int priority, thread_entry_t* entry, void* arg, uint32_t user_stack_size );
 int sys_exit_thread( int exit_code );
 int sys_wake_up_thread( thread_id id );
+int sys_set_thread_affinity( thread_id id, uint32_t affinity );
+int sys_get_thread_affinity( thread_id id, uint32_t* affinity );
+int sys_sched_setscheduler( thread_id id, int policy, int priority );
+int sys_sched_getscheduler( thread_id id, int* priority );
 
 thread_id sys_gettid( void );
 
@@ -32,6 +32,13 @@
 #define NSEC_PER_MSEC       1000000L
 #define CYC2NS_SCALE_FACTOR 10 /* 2^10, carefully chosen */
 
+/* Clock modes of the time page */
+#define TIME_PAGE_SYSCALL 0 /* The time has to be asked from the kernel */
+#define TIME_PAGE_TSC     1 /* The time can be calculated from the TSC */
+
+/* The shift of the multiplier in the time page */
+#define TIME_PAGE_US_SHIFT 32
+
 typedef struct timeval {
     time_t      tv_sec;    /* Seconds */
     suseconds_t tv_usec;   /* Microseconds */
@@ -78,6 +85,42 @@ struct rusage {
     long   ru_nivcsw;        /* involuntary context switches */
 };
 
+/**
+ * @struct time_page
+ *
+ * A read-only page that is mapped to the processes asking for it with
+ * sys_get_time_page(). It contains everything needed to calculate the
+ * current time in user space without a system call. The page is filled
+ * during boot and it is not modified after that.
+ */
+typedef struct time_page {
+    uint32_t clock_mode;
+    uint32_t tsc_to_us_mult; /* usecs = ( ( tsc - tsc_base ) * mult ) >> TIME_PAGE_US_SHIFT */
+    uint64_t tsc_base;
+    uint64_t boot_time;
+} time_page_t;
+
+extern time_page_t* time_page;
+
+/**
+ * Multiplies a 64 bit counter value with a 32 bit fixed point scale
+ * without overflowing the intermediate result and without a division.
+ *
+ * @param value The counter value
+ * @param mult The scale multiplied by 2^shift
+ * @param shift The number of fraction bits of the scale (at most 32)
+ * @return The scaled value
+ */
+static inline uint64_t scale_clock( uint64_t value, uint32_t mult, int shift ) {
+    uint64_t low;
+    uint64_t high;
+
+    low = ( uint64_t )( uint32_t )value * mult;
+    high = ( value >> 32 ) * mult;
+
+    return ( low >> shift ) + ( high << ( 32 - shift ) );
+}
+
 time_t time(time_t* tloc);
 
 /* int sys_adjtimex(timex_t* txc_p); */
@@ -104,5 +147,6 @@ int sys_stime( int* tptr );
 int sys_get_boot_time( time_t* _time );
 int sys_get_system_time( time_t* time );
 int sys_get_idle_time( time_t* _time );
+int sys_get_time_page( void** address );
 
 #endif /* _TIME_H_ */
@@ -0,0 +1,118 @@
+/* File page cache
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _VFS_FILECACHE_H_
+#define _VFS_FILECACHE_H_
+
+#include <types.h>
+#include <lib/hashtable.h>
+
+/**
+ * When the number of free pages goes below this limit the
+ * unused pages of the cache are given back before new ones
+ * are read from the disk.
+ */
+#define FILE_CACHE_LOW_FREE_PAGES 256
+
+/**
+ * The number of pages evicted at once when the memory is low.
+ */
+#define FILE_CACHE_SHRINK_BATCH 32
+
+struct inode;
+struct file;
+
+typedef struct file_page_key {
+    struct inode* inode;
+    uint32_t index;
+} file_page_key_t;
+
+/**
+ * @struct file_page
+ *
+ * A page of a file in the cache. The cache holds one reference to
+ * the physical page, every mapping of the page holds an other one.
+ * The pages of an inode are linked together so they can be dropped
+ * when the inode is released, all cached pages are on an LRU list
+ * used for the eviction.
+ */
+typedef struct file_page {
+    hashitem_t hash;
+    file_page_key_t key;
+    ptr_t address;
+
+    struct file_page* inode_prev;
+    struct file_page* inode_next;
+    struct file_page* lru_prev;
+    struct file_page* lru_next;
+} file_page_t;
+
+typedef struct file_cache_statistics {
+    uint32_t page_count;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+} file_cache_statistics_t;
+
+/**
+ * Returns the cached pages of a file starting at the specified page
+ * index. The pages not found in the cache are read from the file.
+ * Every returned page has an extra reference taken for the caller.
+ *
+ * @param file The file to get the pages of
+ * @param index The index of the first page in the file
+ * @param count The maximum number of pages to return
+ * @param pages The addresses of the pages are stored here
+ * @return On success the number of returned pages (at least 1)
+ *         is returned, otherwise a negative error code
+ */
+int file_cache_get_pages( struct file* file, uint32_t index, uint32_t count, ptr_t* pages );
+
+/**
+ * Drops the cached pages of an inode that contain data from the
+ * specified range of the file. This has to be called when the file
+ * is modified. Pages already mapped keep their old contents, pages
+ * that were being read while this was called are not cached.
+ *
+ * @param inode The inode of the file
+ * @param offset The start of the modified range
+ * @param size The size of the modified range
+ */
+void file_cache_invalidate( struct inode* inode, off_t offset, off_t size );
+
+/**
+ * Drops all cached pages of an inode.
+ *
+ * @param inode The inode of the file
+ */
+void file_cache_drop_inode( struct inode* inode );
+
+/**
+ * Gives back the least recently used pages of the cache that
+ * are not mapped to any memory region.
+ *
+ * @param count The number of pages to free
+ * @return The number of freed pages
+ */
+uint32_t file_cache_shrink( uint32_t count );
+
+void file_cache_get_statistics( file_cache_statistics_t* stats );
+
+int init_file_cache( void );
+
+#endif /* _VFS_FILECACHE_H_ */
@@ -29,6 +29,7 @@ typedef int64_t ino_t;
 
 struct mount_point;
 struct io_context;
+struct file_page;
 
 typedef struct inode {
     hashitem_t hash;
@@ -39,6 +40,15 @@ typedef struct inode {
     struct mount_point* mount_point;
     void* fs_node;
 
+    /* The pages of the file in the file cache */
+
+    struct file_page* cached_pages;
+
+    /* Incremented when the cached pages are invalidated, the pages
+       read while this changed can't be added to the cache. */
+
+    uint32_t cache_sequence;
+
     struct inode* next_free;
 } inode_t;
 
@@ -49,7 +59,7 @@ typedef struct inode_cache {
     int max_free_inode_count;
     inode_t* free_inodes;
 
-    lock_id mutex;
+    lock_id lock;
 } inode_cache_t;
 
 inode_t* get_inode( struct mount_point* mount_point, ino_t inode_number );
@@ -90,4 +100,11 @@ uint32_t get_inode_cache_size( inode_cache_t* cache );
 int init_inode_cache( inode_cache_t* cache, int current_size, int free_inodes, int max_free_inodes );
 void destroy_inode_cache( inode_cache_t* cache );
 
+/**
+ * Creates the object cache used to allocate the inode structures.
+ *
+ * @return On success 0 is returned
+ */
+int init_inode_allocator( void );
+
 #endif /* _VFS_INODE_H_ */
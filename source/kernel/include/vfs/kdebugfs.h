@@ -22,6 +22,13 @@
 #include <vfs/inode.h>
 #include <lib/hashtable.h>
 
+struct kdbgfs_node;
+
+/**
+ * Called when a node is opened to regenerate its content.
+ */
+typedef int kdbgfs_update_t( struct kdbgfs_node* node, void* data );
+
 typedef struct kdbgfs_node {
     hashitem_t hash;
 
@@ -31,14 +38,42 @@ typedef struct kdbgfs_node {
     char* buffer;
     size_t buffer_size;
     size_t max_buffer_size;
+
+    kdbgfs_update_t* update;
+    void* update_data;
 } kdbgfs_node_t;
 
 typedef struct kdbgfs_dir_cookie {
     int position;
 } kdbgfs_dir_cookie_t;
 
+/**
+ * Private copy of the content of a node with an update function. It is
+ * taken when the node is opened, so a concurrent open that regenerates
+ * the content doesn't change the data under an ongoing read.
+ */
+typedef struct kdbgfs_snapshot {
+    size_t size;
+    char data[ 0 ];
+} kdbgfs_snapshot_t;
+
 kdbgfs_node_t* kdebugfs_create_node( const char* name, size_t max_buffer_size );
 int kdebugfs_write_node( kdbgfs_node_t* node, void* data, size_t size );
+int kdebugfs_clear_node( kdbgfs_node_t* node );
+
+/**
+ * Sets the function that regenerates the content of the node
+ * every time it is opened. This can be used to export data
+ * that is collected by the kernel instead of a log. The update
+ * functions are serialized and every open reads its own copy
+ * of the regenerated content.
+ *
+ * @param node The node
+ * @param update The update function
+ * @param data The data parameter of the update function
+ * @return On success 0 is returned
+ */
+int kdebugfs_set_update( kdbgfs_node_t* node, kdbgfs_update_t* update, void* data );
 
 int init_kdebugfs( void );
 
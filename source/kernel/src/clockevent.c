@@ -0,0 +1,156 @@
+/* Clock event handling
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <smp.h>
+#include <macros.h>
+#include <console.h>
+#include <clockevent.h>
+#include <sched/scheduler.h>
+
+#include <arch/smp.h>
+#include <arch/interrupt.h>
+
+static void clockevent_program( cpu_t* cpu, uint64_t expires, uint64_t now ) {
+    uint64_t delta;
+    clockevent_t* event;
+
+    event = cpu->clockevent;
+
+    delta = ( expires > now ) ? expires - now : 0;
+    delta = MAX( delta, event->min_delta );
+    delta = MIN( delta, event->max_delta );
+
+    /* Retry with a longer delta if the event was missed */
+
+    while ( event->set_next_event( event, delta ) == -ETIME ) {
+        delta *= 2;
+    }
+
+    cpu->next_event = now + delta;
+}
+
+int clockevent_register( clockevent_t* event ) {
+    cpu_t* cpu;
+
+    cpu = get_processor();
+
+    scheduler_lock();
+
+    cpu->clockevent = event;
+
+    if ( event->features & CLOCKEVENT_ONESHOT ) {
+        ASSERT( ( event->min_delta > 0 ) && ( event->min_delta <= event->max_delta ) );
+
+        clockevent_program( cpu, 0, get_system_time() );
+    }
+
+    scheduler_unlock();
+
+    kprintf(
+        INFO,
+        "clockevent: CPU %d uses %s in %s mode.\n",
+        get_processor_index(),
+        event->name,
+        ( event->features & CLOCKEVENT_ONESHOT ) ? "one-shot" : "periodic"
+    );
+
+    return 0;
+}
+
+int clockevent_handle_event( registers_t* regs ) {
+    /* Wake up sleeper threads */
+
+    timer_wheel_expire( &sleep_queue, get_system_time() );
+
+    schedule( regs );
+
+    return 0;
+}
+
+void clockevent_update( thread_t* next, uint64_t now ) {
+    cpu_t* cpu;
+    uint64_t expires;
+    clockevent_t* event;
+
+    ASSERT( is_interrupts_disabled() );
+
+    cpu = get_processor();
+    event = cpu->clockevent;
+
+    if ( ( event == NULL ) ||
+         ( ( event->features & CLOCKEVENT_ONESHOT ) == 0 ) ) {
+        return;
+    }
+
+    /* Skip the ticks while the CPU is idle */
+
+    if ( next == cpu->idle_thread ) {
+        expires = now + event->max_delta;
+    } else {
+        expires = now + CLOCKEVENT_TICK;
+    }
+
+    expires = timer_wheel_next_expiry( &sleep_queue, expires );
+
+    clockevent_program( cpu, expires, now );
+}
+
+void clockevent_timer_added( uint64_t expire_time ) {
+    cpu_t* cpu;
+    clockevent_t* event;
+
+    ASSERT( is_interrupts_disabled() );
+
+    cpu = get_processor();
+    event = cpu->clockevent;
+
+    if ( ( event == NULL ) ||
+         ( ( event->features & CLOCKEVENT_ONESHOT ) == 0 ) ||
+         ( expire_time >= cpu->next_event ) ) {
+        return;
+    }
+
+    clockevent_program( cpu, expire_time, get_system_time() );
+}
+
+void clockevent_kick( int processor ) {
+    cpu_t* cpu;
+    clockevent_t* event;
+
+    ASSERT( is_interrupts_disabled() );
+
+    cpu = &processor_table[ processor ];
+    event = cpu->clockevent;
+
+    /* A periodic device reschedules the CPU on the next tick anyway */
+
+    if ( ( event == NULL ) ||
+         ( ( event->features & CLOCKEVENT_ONESHOT ) == 0 ) ) {
+        return;
+    }
+
+    if ( processor == get_processor_index() ) {
+        clockevent_program( cpu, 0, get_system_time() );
+    }
+#ifdef ENABLE_SMP
+    else {
+        arch_send_reschedule_ipi( processor );
+    }
+#endif /* ENABLE_SMP */
+}
@@ -21,6 +21,7 @@
 #include <thread.h>
 #include <config.h>
 #include <sched/scheduler.h>
+#include <lock/mutex.h>
 #include <lib/stdarg.h>
 #include <lib/printf.h>
 #include <lib/string.h>
@@ -43,6 +44,7 @@ static dbg_command_t debugger_commands[] = {
     { "show-thread-info",  dbg_show_thread_info,       "Show the informations of the specified thread" },
     { "trace-thread",      dbg_trace_thread,           "Prints the backtrace of the selected thread" },
     { "dump-ready-list",   dbg_dump_ready_list,        "Dumps the list of ready threads" },
+    { "list-mutexes",      dbg_list_mutexes,           "List the kernel mutexes with their contention statistics" },
     { "help",              dbg_show_help,              "Displays this message :)" },
     { "exit",              dbg_exit,                   "Exit from the kernel debugger" },
     { NULL, NULL }
@@ -26,6 +26,8 @@
 #include <sched/scheduler.h>
 #include <lib/string.h>
 
+#include <fork.h>
+
 #include <arch/fork.h>
 
 int sys_fork( void ) {
@@ -63,6 +65,8 @@ int sys_fork( void ) {
         memory_region_put( new_process->heap_region );
     }
 
+    new_process->time_page = this_process->time_page;
+
     /* Clone the I/O context */
     new_process->io_context = io_context_clone( this_process->io_context );
 
@@ -95,6 +99,9 @@ int sys_fork( void ) {
     /* Set the parent ID of the new thread */
     new_thread->parent_id = this_thread->id;
     new_thread->tld_data = this_thread->tld_data;
+    new_thread->cpu_affinity = this_thread->cpu_affinity;
+    new_thread->sched_policy = this_thread->sched_policy;
+    new_thread->rt_priority = this_thread->rt_priority;
 
     /* If the process has an userspace stack region then we have to find
        out the region ID of the cloned stack region. */
@@ -159,3 +166,152 @@ error2:
 error1:
     return error;
 }
+
+int sys_vfork( void ) {
+    int error;
+    thread_t* new_thread;
+    process_t* new_process;
+    thread_t* this_thread;
+    process_t* this_process;
+
+    this_thread = current_thread();
+    this_process = this_thread->process;
+
+    /* Create a new process */
+    new_process = allocate_process( this_process->name );
+
+    if ( new_process == NULL ) {
+        error = -ENOMEM;
+        goto error1;
+    }
+
+    /* Clone the I/O context */
+    new_process->io_context = io_context_clone( this_process->io_context );
+
+    if ( new_process->io_context == NULL ) {
+        error = -ENOMEM;
+        goto error2;
+    }
+
+    /* Clone the locking context */
+    new_process->lock_context = lock_context_clone( this_process->lock_context );
+
+    if ( new_process->lock_context == NULL ) {
+        error = -ENOMEM;
+        goto error2;
+    }
+
+    /* Create the main thread of the new process */
+    new_thread = allocate_thread(
+        this_thread->name,
+        new_process,
+        this_thread->priority,
+        this_thread->kernel_stack_pages
+    );
+
+    if ( new_thread == NULL ) {
+        error = -ENOMEM;
+        goto error2;
+    }
+
+    /* Set the parent ID of the new thread. The new thread runs on the
+       userspace stack of this thread, so it doesn't get its own stack
+       region. */
+    new_thread->parent_id = this_thread->id;
+    new_thread->tld_data = this_thread->tld_data;
+    new_thread->cpu_affinity = this_thread->cpu_affinity;
+    new_thread->sched_policy = this_thread->sched_policy;
+    new_thread->rt_priority = this_thread->rt_priority;
+
+    error = arch_do_fork( this_thread, new_thread );
+
+    if ( error < 0 ) {
+        goto error3;
+    }
+
+    /* Copy signal related informations to the new thread */
+    memcpy(
+        &new_thread->signal_handlers[ 0 ],
+        &this_thread->signal_handlers[ 0 ],
+        ( _NSIG - 1 ) * sizeof( struct sigaction )
+    );
+
+    /* The new process borrows the memory context of this one instead of
+       cloning it. The context is given back in vfork_release(). */
+    new_process->memory_context = this_process->memory_context;
+    new_process->heap_region = this_process->heap_region;
+    new_process->time_page = this_process->time_page;
+
+    /* Insert the new process and thread */
+    scheduler_lock();
+
+    error = insert_process( new_process );
+
+    if ( error >= 0 ) {
+        error = insert_thread( new_thread );
+
+        if ( error >= 0 ) {
+            lock_context_update( new_process->lock_context, new_thread->id );
+
+            new_process->vfork_parent = this_thread;
+            this_thread->vfork_child = new_process;
+
+            add_thread_to_ready( new_thread );
+
+            error = new_thread->id;
+        }
+    }
+
+    if ( error < 0 ) {
+        scheduler_unlock();
+
+        new_process->memory_context = NULL;
+        new_process->heap_region = NULL;
+
+        goto error3;
+    }
+
+    /* Wait until the child stops using our memory context */
+    while ( this_thread->vfork_child != NULL ) {
+        this_thread->state = THREAD_WAITING;
+
+        scheduler_unlock();
+        sched_preempt();
+        scheduler_lock();
+    }
+
+    scheduler_unlock();
+
+    return error;
+
+error3:
+    /* NOTE: We don't have to destroy the process because
+             destroy_thread() will do it. */
+
+    destroy_thread( new_thread );
+
+    return error;
+
+error2:
+    destroy_process( new_process );
+
+error1:
+    return error;
+}
+
+void vfork_release( process_t* process ) {
+    thread_t* parent;
+
+    ASSERT( scheduler_is_locked() );
+
+    parent = process->vfork_parent;
+
+    if ( parent == NULL ) {
+        return;
+    }
+
+    process->vfork_parent = NULL;
+    parent->vfork_child = NULL;
+
+    do_wake_up_thread( parent );
+}
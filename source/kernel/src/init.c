@@ -26,6 +26,7 @@
 #include <errno.h>
 #include <process.h>
 #include <mm/pages.h>
+#include <mm/kmalloc.h>
 #include <vfs/vfs.h>
 #include <network/network.h>
 #include <lib/string.h>
@@ -143,6 +144,7 @@ int init_thread( void* arg ) {
 #endif /* ENABLE_SMP */
 
     init_vfs();
+    init_kmalloc_profiler();
     load_bootmodules();
     mount_root_filesystem();
 
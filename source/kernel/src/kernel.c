@@ -32,6 +32,9 @@
 #include <symbols.h>
 #include <sched/scheduler.h>
 #include <lock/context.h>
+#include <lock/futex.h>
+#include <mm/pages.h>
+#include <mm/slab.h>
 #include <lib/stdarg.h>
 #include <lib/string.h>
 #include <lib/ctype.h>
@@ -239,6 +242,7 @@ int sys_shutdown( void ) {
 
 __init void kernel_main( void ) {
     init_locking();
+    init_futexes();
     init_regions();
     init_devices();
     init_module_loader();
@@ -254,6 +258,8 @@ __init void kernel_main( void ) {
         return;
     }
 
+    init_page_caches();
+    init_kmem_magazines();
     init_smp_late();
     create_init_thread();
 
@@ -18,6 +18,7 @@
 
 #include <loader.h>
 #include <errno.h>
+#include <fork.h>
 #include <console.h>
 #include <smp.h>
 #include <kernel.h>
@@ -27,6 +28,8 @@
 #include <sched/scheduler.h>
 #include <vfs/vfs.h>
 
+#include <arch/mm/context.h>
+
 #define USER_STACK_PAGES ( USER_STACK_SIZE / PAGE_SIZE )
 
 typedef struct app_loader_private {
@@ -253,6 +256,7 @@ int do_execve( char* path, char** argv, char** envp, bool free_argv ) {
 
     struct sigaction* handler;
     binary_loader_t* binary_loader;
+    memory_context_t* new_context;
 
     /* Open the file */
 
@@ -312,6 +316,20 @@ int do_execve( char* path, char** argv, char** envp, bool free_argv ) {
         goto _error3;
     }
 
+    /* A process created by vfork() runs in the memory context of its
+       parent, it gets a new one instead of emptying the borrowed context. */
+
+    if ( thread->process->vfork_parent != NULL ) {
+        new_context = memory_context_create( thread->process );
+
+        if ( new_context == NULL ) {
+            error = -ENOMEM;
+            goto _error4;
+        }
+    } else {
+        new_context = NULL;
+    }
+
     if ( free_argv ) {
         kfree( argv );
     }
@@ -333,9 +351,19 @@ int do_execve( char* path, char** argv, char** envp, bool free_argv ) {
 
     /* Empty the memory context of the process */
 
-    memory_context_delete_regions( thread->process->memory_context );
+    if ( new_context != NULL ) {
+        thread->process->memory_context = new_context;
+        arch_memory_context_load( new_context );
+
+        scheduler_lock();
+        vfork_release( thread->process );
+        scheduler_unlock();
+    } else {
+        memory_context_delete_regions( thread->process->memory_context );
+    }
 
     thread->process->heap_region = NULL;
+    thread->process->time_page = 0;
 
     /* Empty the locking context of the process */
 
@@ -367,7 +395,7 @@ int do_execve( char* path, char** argv, char** envp, bool free_argv ) {
     thread->user_stack_region = memory_region_create(
         "stack",
         USER_STACK_PAGES * PAGE_SIZE,
-        REGION_READ | REGION_WRITE | REGION_STACK
+        REGION_READ | REGION_WRITE | REGION_STACK | REGION_LAZY
     );
 
     if ( thread->user_stack_region == NULL ) {
@@ -462,6 +490,9 @@ int do_execve( char* path, char** argv, char** envp, bool free_argv ) {
 
     /* Cleanup process before the memory context is destroyed */
 
+ _error4:
+    free_param_array( cloned_envv, envc );
+
  _error3:
     free_param_array( cloned_argv, argc );
 
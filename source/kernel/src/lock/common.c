@@ -75,7 +75,7 @@ int lock_timed_wait_on( lock_context_t* context, thread_t* thread, lock_type_t t
     sleepnode.wakeup_time = wakeup_time;
     sleepnode.in_queue = false;
 
-    waitqueue_add_node( &sleep_queue, &sleepnode );
+    timer_wheel_add_node( &sleep_queue, &sleepnode );
 
     thread->state = THREAD_WAITING;
     thread->blocking_semaphore = id;
@@ -90,7 +90,7 @@ int lock_timed_wait_on( lock_context_t* context, thread_t* thread, lock_type_t t
     thread->blocking_semaphore = -1;
 
     spinlock( &scheduler_lock );
-    waitqueue_remove_node( &sleep_queue, &sleepnode );
+    timer_wheel_remove_node( &sleep_queue, &sleepnode );
     spinunlock( &scheduler_lock );
 
     header = lock_context_get( context, id );
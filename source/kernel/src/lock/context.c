@@ -125,8 +125,7 @@ static int lock_context_clone_iterator( hashitem_t* hash, void* data ) {
             break;
 
         case RWLOCK :
-            kprintf( WARNING, "lock_context_clone_iterator(): RW lock cloning not yet implemented!\n" );
-            error = -ENOSYS;
+            error = rwlock_clone( ( rwlock_t* )header, ( rwlock_t* )new_header );
             break;
 
         default :
@@ -200,8 +199,7 @@ static int lock_context_update_iterator( hashitem_t* hash, void* data ) {
             break;
 
         case RWLOCK :
-            kprintf( WARNING, "lock_context_update_iterator(): RW lock update not yet implemented!\n" );
-            error = -ENOSYS;
+            error = rwlock_update( ( rwlock_t* )header, new_thread );
             break;
 
         default :
@@ -298,10 +296,8 @@ static int lock_context_destroy_helper( hashitem_t* item, void* data ) {
         case MUTEX :
         case SEMAPHORE :
         case CONDITION :
-            kfree( header );
-            break;
-
         case RWLOCK :
+            kfree( header );
             break;
     }
 
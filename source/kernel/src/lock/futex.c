@@ -0,0 +1,254 @@
+/* Fast user space locking primitive
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <macros.h>
+#include <smp.h>
+#include <kernel.h>
+#include <mm/kmalloc.h>
+#include <lock/futex.h>
+#include <lock/mutex.h>
+#include <sched/scheduler.h>
+#include <lib/hashtable.h>
+
+/* The buckets are protected by mutexes rather than spinlocks, because
+   the value of the futex is compared while its bucket is locked. Reading
+   user memory may page fault (the region could be unmapped by another
+   thread, or not populated yet) and the page fault handler can sleep. */
+
+static futex_bucket_t futex_buckets[ FUTEX_BUCKET_COUNT ];
+
+/* Futexes are private to a process, so the key is built from the ID of
+   the process and the virtual address of the futex. */
+static inline uint64_t futex_key( thread_t* thread, int* address ) {
+    return ( ( uint64_t )thread->process->id << 32 ) | ( ptr_t )address;
+}
+
+static inline futex_bucket_t* futex_get_bucket( uint64_t key ) {
+    return &futex_buckets[ hash_int64( ( const void* )&key ) & ( FUTEX_BUCKET_COUNT - 1 ) ];
+}
+
+/* Looks up a futex in its bucket. The bucket has to be locked. */
+static futex_t* futex_lookup( futex_bucket_t* bucket, uint64_t key ) {
+    futex_t* futex;
+
+    for ( futex = bucket->first; futex != NULL; futex = futex->next ) {
+        if ( futex->key == key ) {
+            return futex;
+        }
+    }
+
+    return NULL;
+}
+
+static void futex_unlink( futex_bucket_t* bucket, futex_t* futex ) {
+    futex_t** link;
+
+    for ( link = &bucket->first; *link != futex; link = &( *link )->next ) {
+        ASSERT( *link != NULL );
+    }
+
+    *link = futex->next;
+}
+
+static inline bool futex_address_valid( int* address ) {
+    return ( ( ( ptr_t )address >= FIRST_USER_ADDRESS ) &&
+             ( ( ( ptr_t )address & ( sizeof( int ) - 1 ) ) == 0 ) );
+}
+
+int sys_futex_wait( int* address, int value, time_t* wakeup_time ) {
+    int error;
+    uint64_t key;
+    uint64_t timeout;
+    futex_t* futex;
+    futex_t* new_futex;
+    thread_t* thread;
+    waitnode_t waitnode;
+    waitnode_t sleepnode;
+    futex_bucket_t* bucket;
+
+    if ( !futex_address_valid( address ) ) {
+        return -EINVAL;
+    }
+
+    /* Check the value before locking the bucket to avoid the
+       allocation below if the futex was already changed. */
+
+    if ( *( volatile int* )address != value ) {
+        return -EAGAIN;
+    }
+
+    if ( wakeup_time != NULL ) {
+        timeout = *wakeup_time;
+    } else {
+        timeout = INFINITE_TIMEOUT;
+    }
+
+    new_futex = ( futex_t* )kmalloc( sizeof( futex_t ) );
+
+    if ( new_futex == NULL ) {
+        return -ENOMEM;
+    }
+
+    thread = current_thread();
+    key = futex_key( thread, address );
+    bucket = futex_get_bucket( key );
+
+    mutex_lock( bucket->lock, LOCK_IGNORE_SIGNAL );
+
+    if ( *( volatile int* )address != value ) {
+        error = -EAGAIN;
+        goto out;
+    }
+
+    futex = futex_lookup( bucket, key );
+
+    if ( futex == NULL ) {
+        futex = new_futex;
+        new_futex = NULL;
+
+        futex->key = key;
+        futex->waiter_count = 0;
+        init_waitqueue( &futex->waiters );
+
+        futex->next = bucket->first;
+        bucket->first = futex;
+    }
+
+    futex->waiter_count++;
+
+    scheduler_lock();
+
+    waitnode.type = WAIT_THREAD;
+    waitnode.u.thread = thread->id;
+    waitnode.in_queue = false;
+
+    waitqueue_add_node_tail( &futex->waiters, &waitnode );
+
+    if ( timeout != INFINITE_TIMEOUT ) {
+        sleepnode.type = WAIT_THREAD;
+        sleepnode.u.thread = thread->id;
+        sleepnode.wakeup_time = timeout;
+        sleepnode.in_queue = false;
+
+        timer_wheel_add_node( &sleep_queue, &sleepnode );
+    }
+
+    thread->state = THREAD_WAITING;
+
+    scheduler_unlock();
+    mutex_unlock( bucket->lock );
+
+    sched_preempt();
+
+    mutex_lock( bucket->lock, LOCK_IGNORE_SIGNAL );
+
+    if ( timeout != INFINITE_TIMEOUT ) {
+        scheduler_lock();
+        timer_wheel_remove_node( &sleep_queue, &sleepnode );
+        scheduler_unlock();
+    }
+
+    /* sys_futex_wake() removes the nodes it wakes up from the queue */
+
+    if ( waitnode.in_queue ) {
+        waitqueue_remove_node( &futex->waiters, &waitnode );
+
+        if ( ( timeout != INFINITE_TIMEOUT ) &&
+             ( get_system_time() >= timeout ) ) {
+            error = -ETIME;
+        } else {
+            error = -EINTR;
+        }
+    } else {
+        error = 0;
+    }
+
+    /* The last waiter frees the futex */
+
+    if ( --futex->waiter_count == 0 ) {
+        futex_unlink( bucket, futex );
+        new_futex = futex;
+    }
+
+ out:
+    mutex_unlock( bucket->lock );
+
+    if ( new_futex != NULL ) {
+        kfree( new_futex );
+    }
+
+    return error;
+}
+
+int sys_futex_wake( int* address, int count ) {
+    uint64_t key;
+    futex_t* futex;
+    futex_bucket_t* bucket;
+
+    if ( !futex_address_valid( address ) ) {
+        return -EINVAL;
+    }
+
+    if ( count <= 0 ) {
+        return -EINVAL;
+    }
+
+    key = futex_key( current_thread(), address );
+    bucket = futex_get_bucket( key );
+
+    mutex_lock( bucket->lock, LOCK_IGNORE_SIGNAL );
+
+    futex = futex_lookup( bucket, key );
+
+    if ( futex != NULL ) {
+        scheduler_lock();
+        waitqueue_wake_up_head( &futex->waiters, count );
+        scheduler_unlock();
+    }
+
+    mutex_unlock( bucket->lock );
+
+    return 0;
+}
+
+__init int init_futexes( void ) {
+    int i;
+    int error;
+    futex_bucket_t* bucket;
+
+    for ( i = 0, bucket = futex_buckets; i < FUTEX_BUCKET_COUNT; i++, bucket++ ) {
+        bucket->lock = mutex_create( "futex bucket mutex", MUTEX_NONE );
+
+        if ( bucket->lock < 0 ) {
+            error = bucket->lock;
+            goto error;
+        }
+
+        bucket->first = NULL;
+    }
+
+    return 0;
+
+ error:
+    while ( --i >= 0 ) {
+        mutex_destroy( futex_buckets[ i ].lock );
+    }
+
+    return error;
+}
@@ -27,13 +27,69 @@
 #include <sched/scheduler.h>
 #include <lib/string.h>
 
+#ifdef ENABLE_SMP
+/* Checks if the holder of the mutex is running on another CPU. The
+   fields are read without the lock context being locked, so the mutex
+   could be destroyed meanwhile. The CPU index is checked and the holder
+   is only compared to the current thread of that CPU for this reason. */
+static bool mutex_holder_running( mutex_t* mutex ) {
+    int cpu;
+    thread_t* holder;
+
+    cpu = *( volatile int* )&mutex->holder_cpu;
+    holder = *( thread_t* volatile* )&mutex->holder_thread;
+
+    if ( ( holder == NULL ) ||
+         ( cpu < 0 ) ||
+         ( cpu >= MAX_CPU_COUNT ) ||
+         ( cpu == get_processor_index() ) ) {
+        return false;
+    }
+
+    return ( processor_table[ cpu ].current_thread == holder );
+}
+
+/* Spins while the mutex is locked and its holder is running on another
+   CPU, so short critical sections don't cost two context switches. The
+   lock context is released while spinning. */
+static int mutex_spin( lock_context_t* context, mutex_t* mutex ) {
+    int i;
+    lock_id mutex_id;
+
+    mutex_id = mutex->header.id;
+
+    spinunlock_enable( &context->lock );
+
+    for ( i = 0; i < MUTEX_SPIN_LIMIT; i++ ) {
+        if ( ( *( volatile thread_id* )&mutex->holder == -1 ) ||
+             ( !mutex_holder_running( mutex ) ) ) {
+            break;
+        }
+
+        __asm__ __volatile__( "pause" );
+    }
+
+    spinlock_disable( &context->lock );
+
+    /* Make sure the mutex wasn't destroyed while we were spinning */
+
+    if ( lock_context_get( context, mutex_id ) != ( lock_header_t* )mutex ) {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+#endif /* ENABLE_SMP */
+
 int do_acquire_mutex( lock_context_t* context, mutex_t* mutex, thread_t* thread,
                       time_t timeout, bool try_lock, int flags ) {
     int error;
-    lock_id mutex_id;
+    bool spun;
+    bool slept;
     uint64_t wakeup_time;
 
-    mutex_id = mutex->header.id;
+    spun = false;
+    slept = false;
     wakeup_time = get_system_time() + timeout;
 
     while ( mutex->holder != -1 ) {
@@ -55,8 +111,30 @@ int do_acquire_mutex( lock_context_t* context, mutex_t* mutex, thread_t* thread,
             return -ETIME;
         }
 
+#ifdef ENABLE_SMP
+        /* Spin for a while first if the holder is running, it will
+           probably release the mutex soon */
+
+        if ( ( !spun ) &&
+             ( mutex_holder_running( mutex ) ) ) {
+            spun = true;
+
+            error = mutex_spin( context, mutex );
+
+            if ( error < 0 ) {
+                return error;
+            }
+
+            continue;
+        }
+#endif /* ENABLE_SMP */
+
         /* Wait for the mutex to be released */
 
+        spun = false;
+        slept = true;
+        mutex->sleep_count++;
+
         if ( timeout != INFINITE_TIMEOUT ) {
             uint64_t now;
 
@@ -87,7 +165,14 @@ int do_acquire_mutex( lock_context_t* context, mutex_t* mutex, thread_t* thread,
         }
     }
 
+    if ( ( spun ) &&
+         ( !slept ) ) {
+        mutex->spin_count++;
+    }
+
     mutex->holder = thread->id;
+    mutex->holder_thread = thread;
+    mutex->holder_cpu = get_processor_index();
     mutex->recursive_count++;
 
     return 0;
@@ -160,12 +245,19 @@ void do_release_mutex( mutex_t* mutex ) {
 
     if ( --mutex->recursive_count == 0 ) {
         mutex->holder = -1;
+        mutex->holder_thread = NULL;
 
-        /* Wake up one waiter */
+        /* Wake up one waiter. The waiters are only added and removed
+           while the lock context is locked, so it is safe to check the
+           queue without the scheduler lock. */
 
-        spinlock( &scheduler_lock );
-        waitqueue_wake_up_head( &mutex->waiters, 1 );
-        spinunlock( &scheduler_lock );
+        if ( !waitqueue_is_empty( &mutex->waiters ) ) {
+            mutex->handoff_count++;
+
+            spinlock( &scheduler_lock );
+            waitqueue_wake_up_head( &mutex->waiters, 1 );
+            spinunlock( &scheduler_lock );
+        }
     }
 }
 
@@ -224,6 +316,11 @@ int mutex_clone( mutex_t* old, mutex_t* new ) {
     }
 
     new->flags = old->flags;
+    new->holder_thread = NULL;
+    new->holder_cpu = 0;
+    new->spin_count = 0;
+    new->sleep_count = 0;
+    new->handoff_count = 0;
 
     if ( old->holder == current_thread()->id ) {
         new->holder = 0; /* this will tell lock_context_update() to do the update :) */
@@ -303,6 +400,11 @@ static int do_create_mutex( lock_context_t* context, const char* name, int flags
     mutex->holder = -1;
     mutex->flags = flags;
     mutex->recursive_count = 0;
+    mutex->holder_thread = NULL;
+    mutex->holder_cpu = 0;
+    mutex->spin_count = 0;
+    mutex->sleep_count = 0;
+    mutex->handoff_count = 0;
 
     error = init_waitqueue( &mutex->waiters );
 
@@ -357,6 +459,41 @@ int mutex_destroy( lock_id mutex ) {
     return do_destroy_mutex( &kernel_lock_context, mutex );
 }
 
+#ifdef ENABLE_DEBUGGER
+static int dbg_list_mutexes_iterator( hashitem_t* item, void* data ) {
+    mutex_t* mutex;
+    lock_header_t* header;
+
+    header = ( lock_header_t* )item;
+
+    if ( header->type != MUTEX ) {
+        return 0;
+    }
+
+    mutex = ( mutex_t* )header;
+
+    dbg_printf(
+        "%4d %-24s %5d %8u %8u %8u\n",
+        header->id,
+        header->name,
+        mutex->holder,
+        mutex->spin_count,
+        mutex->sleep_count,
+        mutex->handoff_count
+    );
+
+    return 0;
+}
+
+int dbg_list_mutexes( const char* params ) {
+    dbg_printf( "  id name                     holder    spins   sleeps handoffs\n" );
+
+    hashtable_iterate( &kernel_lock_context.lock_table, dbg_list_mutexes_iterator, NULL );
+
+    return 0;
+}
+#endif /* ENABLE_DEBUGGER */
+
 int sys_mutex_lock( lock_id mutex ) {
     return do_lock_mutex( current_process()->lock_context, mutex, false, INFINITE_TIMEOUT, 0 );
 }
@@ -0,0 +1,403 @@
+/* RW lock implementation
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <smp.h>
+#include <macros.h>
+#include <console.h>
+#include <mm/kmalloc.h>
+#include <lock/rwlock.h>
+#include <lock/common.h>
+#include <sched/scheduler.h>
+#include <lib/string.h>
+
+static rwlock_t* get_rwlock( lock_context_t* context, lock_id rwlock_id ) {
+    lock_header_t* header;
+
+    header = lock_context_get( context, rwlock_id );
+
+    if ( __unlikely( ( header == NULL ) ||
+                     ( header->type != RWLOCK ) ) ) {
+        return NULL;
+    }
+
+    return ( rwlock_t* )header;
+}
+
+/* Wakes up the next waiters after the lock was released. A waiting
+   writer is preferred, readers are only woken up if there is none. The
+   lock context has to be locked while calling this function. */
+static void rwlock_wake_up( rwlock_t* rwlock ) {
+    if ( ( rwlock->writer != -1 ) ||
+         ( rwlock->readers > 0 ) ) {
+        return;
+    }
+
+    spinlock( &scheduler_lock );
+
+    if ( rwlock->writers_waiting > 0 ) {
+        waitqueue_wake_up_head( &rwlock->writer_waiters, 1 );
+    } else {
+        waitqueue_wake_up_all( &rwlock->reader_waiters );
+    }
+
+    spinunlock( &scheduler_lock );
+}
+
+static int do_read_lock_rwlock( lock_context_t* context, lock_id rwlock_id, int flags ) {
+    int error;
+    rwlock_t* rwlock;
+    thread_t* thread;
+
+    spinlock_disable( &context->lock );
+
+    rwlock = get_rwlock( context, rwlock_id );
+
+    if ( rwlock == NULL ) {
+        spinunlock_enable( &context->lock );
+
+        kprintf(
+            WARNING,
+            "do_read_lock_rwlock(): Invalid RW lock id or the specified lock is not a RW lock!\n"
+        );
+
+        return -EINVAL;
+    }
+
+    thread = current_thread();
+
+    while ( ( rwlock->writer != -1 ) ||
+            ( rwlock->writers_waiting > 0 ) ) {
+        if ( rwlock->writer == thread->id ) {
+            spinunlock_enable( &context->lock );
+
+            return -EDEADLK;
+        }
+
+        if ( ( is_signal_pending( thread ) ) &&
+             ( ( flags & LOCK_IGNORE_SIGNAL ) == 0 ) ) {
+            spinunlock_enable( &context->lock );
+
+            return -EINTR;
+        }
+
+        error = lock_wait_on( context, thread, RWLOCK, rwlock_id, &rwlock->reader_waiters );
+
+        if ( error < 0 ) {
+            spinunlock_enable( &context->lock );
+
+            return error;
+        }
+    }
+
+    rwlock->readers++;
+
+    spinunlock_enable( &context->lock );
+
+    return 0;
+}
+
+static int do_write_lock_rwlock( lock_context_t* context, lock_id rwlock_id, int flags ) {
+    int error;
+    rwlock_t* rwlock;
+    thread_t* thread;
+
+    spinlock_disable( &context->lock );
+
+    rwlock = get_rwlock( context, rwlock_id );
+
+    if ( rwlock == NULL ) {
+        spinunlock_enable( &context->lock );
+
+        kprintf(
+            WARNING,
+            "do_write_lock_rwlock(): Invalid RW lock id or the specified lock is not a RW lock!\n"
+        );
+
+        return -EINVAL;
+    }
+
+    thread = current_thread();
+
+    if ( rwlock->writer == thread->id ) {
+        spinunlock_enable( &context->lock );
+
+        return -EDEADLK;
+    }
+
+    /* Block the new readers while we are waiting */
+
+    rwlock->writers_waiting++;
+
+    while ( ( rwlock->writer != -1 ) ||
+            ( rwlock->readers > 0 ) ) {
+        if ( ( is_signal_pending( thread ) ) &&
+             ( ( flags & LOCK_IGNORE_SIGNAL ) == 0 ) ) {
+            rwlock->writers_waiting--;
+
+            /* The readers blocked by us may continue now */
+
+            rwlock_wake_up( rwlock );
+
+            spinunlock_enable( &context->lock );
+
+            return -EINTR;
+        }
+
+        error = lock_wait_on( context, thread, RWLOCK, rwlock_id, &rwlock->writer_waiters );
+
+        if ( error < 0 ) {
+            spinunlock_enable( &context->lock );
+
+            return error;
+        }
+    }
+
+    rwlock->writers_waiting--;
+    rwlock->writer = thread->id;
+
+    spinunlock_enable( &context->lock );
+
+    return 0;
+}
+
+static int do_read_unlock_rwlock( rwlock_t* rwlock ) {
+    if ( rwlock->readers == 0 ) {
+        return -EPERM;
+    }
+
+    rwlock->readers--;
+    rwlock_wake_up( rwlock );
+
+    return 0;
+}
+
+static int do_write_unlock_rwlock( rwlock_t* rwlock ) {
+    if ( rwlock->writer != current_thread()->id ) {
+        return -EPERM;
+    }
+
+    rwlock->writer = -1;
+    rwlock_wake_up( rwlock );
+
+    return 0;
+}
+
+static int do_unlock_rwlock( lock_context_t* context, lock_id rwlock_id, int write ) {
+    int error;
+    rwlock_t* rwlock;
+
+    spinlock_disable( &context->lock );
+
+    rwlock = get_rwlock( context, rwlock_id );
+
+    if ( rwlock == NULL ) {
+        spinunlock_enable( &context->lock );
+
+        return -EINVAL;
+    }
+
+    /* A negative write parameter means that the type of the
+       unlock has to be figured out from the state of the lock */
+
+    if ( write < 0 ) {
+        write = ( rwlock->writer == current_thread()->id );
+    }
+
+    if ( write ) {
+        error = do_write_unlock_rwlock( rwlock );
+    } else {
+        error = do_read_unlock_rwlock( rwlock );
+    }
+
+    spinunlock_enable( &context->lock );
+
+    if ( error < 0 ) {
+        kprintf(
+            WARNING,
+            "Tried to unlock RW lock '%s' that is not locked by the current thread!\n",
+            rwlock->header.name
+        );
+    }
+
+    return error;
+}
+
+int rwlock_read_lock( lock_id rwlock, int flags ) {
+    return do_read_lock_rwlock( &kernel_lock_context, rwlock, flags );
+}
+
+int rwlock_read_unlock( lock_id rwlock ) {
+    return do_unlock_rwlock( &kernel_lock_context, rwlock, 0 );
+}
+
+int rwlock_write_lock( lock_id rwlock, int flags ) {
+    return do_write_lock_rwlock( &kernel_lock_context, rwlock, flags );
+}
+
+int rwlock_write_unlock( lock_id rwlock ) {
+    return do_unlock_rwlock( &kernel_lock_context, rwlock, 1 );
+}
+
+int rwlock_clone( rwlock_t* old, rwlock_t* new ) {
+    int error;
+
+    error = init_waitqueue( &new->reader_waiters );
+
+    if ( error < 0 ) {
+        return error;
+    }
+
+    error = init_waitqueue( &new->writer_waiters );
+
+    if ( error < 0 ) {
+        return error;
+    }
+
+    /* Only the current thread is copied to the new process, so the
+       read locks of the other threads are dropped */
+
+    new->writers_waiting = 0;
+
+    if ( old->writer == current_thread()->id ) {
+        new->writer = 0; /* this will tell lock_context_update() to do the update */
+        new->readers = 0;
+    } else {
+        new->writer = -1;
+        new->readers = 0;
+    }
+
+    return 0;
+}
+
+int rwlock_update( rwlock_t* rwlock, thread_id new_thread ) {
+    if ( rwlock->writer == 0 ) {
+        rwlock->writer = new_thread;
+    }
+
+    return 0;
+}
+
+static lock_id do_create_rwlock( lock_context_t* context, const char* name ) {
+    int error;
+    rwlock_t* rwlock;
+    size_t name_length;
+    lock_header_t* header;
+
+    name_length = strlen( name );
+
+    rwlock = ( rwlock_t* )kmalloc( sizeof( rwlock_t ) + name_length + 1 );
+
+    if ( rwlock == NULL ) {
+        error = -ENOMEM;
+        goto error1;
+    }
+
+    /* Initialize the lock header */
+
+    header = ( lock_header_t* )rwlock;
+
+    header->type = RWLOCK;
+    header->name = ( char* )( rwlock + 1 );
+    memcpy( header->name, name, name_length + 1 );
+
+    /* Initialize RW lock specific fields */
+
+    rwlock->readers = 0;
+    rwlock->writers_waiting = 0;
+    rwlock->writer = -1;
+
+    error = init_waitqueue( &rwlock->reader_waiters );
+
+    if ( error < 0 ) {
+        goto error2;
+    }
+
+    error = init_waitqueue( &rwlock->writer_waiters );
+
+    if ( error < 0 ) {
+        goto error2;
+    }
+
+    /* Insert to the lock context */
+
+    error = lock_context_insert( context, header );
+
+    if ( error < 0 ) {
+        goto error2;
+    }
+
+    return header->id;
+
+ error2:
+    kfree( rwlock );
+
+ error1:
+    return error;
+}
+
+lock_id rwlock_create( const char* name ) {
+    return do_create_rwlock( &kernel_lock_context, name );
+}
+
+static int do_destroy_rwlock( lock_context_t* context, lock_id rwlock_id ) {
+    int error;
+    rwlock_t* rwlock;
+    lock_header_t* header;
+
+    error = lock_context_remove( context, rwlock_id, RWLOCK, &header );
+
+    if ( error < 0 ) {
+        return error;
+    }
+
+    rwlock = ( rwlock_t* )header;
+
+    scheduler_lock();
+    waitqueue_wake_up_all( &rwlock->reader_waiters );
+    waitqueue_wake_up_all( &rwlock->writer_waiters );
+    scheduler_unlock();
+
+    kfree( rwlock );
+
+    return 0;
+}
+
+int rwlock_destroy( lock_id rwlock ) {
+    return do_destroy_rwlock( &kernel_lock_context, rwlock );
+}
+
+int sys_rwlock_read_lock( lock_id rwlock ) {
+    return do_read_lock_rwlock( current_process()->lock_context, rwlock, 0 );
+}
+
+int sys_rwlock_write_lock( lock_id rwlock ) {
+    return do_write_lock_rwlock( current_process()->lock_context, rwlock, 0 );
+}
+
+int sys_rwlock_unlock( lock_id rwlock ) {
+    return do_unlock_rwlock( current_process()->lock_context, rwlock, -1 );
+}
+
+int sys_rwlock_create( const char* name ) {
+    return do_create_rwlock( current_process()->lock_context, name );
+}
+
+int sys_rwlock_destroy( lock_id rwlock ) {
+    return do_destroy_rwlock( current_process()->lock_context, rwlock );
+}
@@ -32,66 +32,292 @@
 #include <arch/mm/context.h>
 #include <arch/mm/region.h>
 
-#define REGION_STEP_SIZE 32
-
 memory_context_t kernel_memory_context;
 
 extern lock_id region_lock;
 extern hashtable_t region_table;
 
-int memory_context_insert_region( memory_context_t* context, memory_region_t* region ) {
-    int i;
-    int error;
-    int region_count;
+static inline int region_height( memory_region_t* region ) {
+    return ( region == NULL ? 0 : region->height );
+}
 
-    region_count = array_get_size( &context->regions );
+static inline uint64_t region_subtree_gap( memory_region_t* region ) {
+    return ( region == NULL ? 0 : region->subtree_gap );
+}
 
-    /* Insert the region to the list */
+static inline uint64_t region_end( memory_region_t* region ) {
+    return ( region == NULL ? 0 : ( uint64_t )region->address + region->size );
+}
+
+static inline bool region_contains( memory_region_t* region, ptr_t address ) {
+    return ( ( region->address <= address ) &&
+             ( ( uint64_t )( address - region->address ) < region->size ) );
+}
+
+static void region_tree_update( memory_region_t* region ) {
+    region->height = MAX( region_height( region->left ), region_height( region->right ) ) + 1;
+    region->subtree_gap = MAX(
+        region->gap,
+        MAX( region_subtree_gap( region->left ), region_subtree_gap( region->right ) )
+    );
+}
+
+static void region_tree_replace_child( memory_context_t* context, memory_region_t* parent,
+                                       memory_region_t* old_child, memory_region_t* new_child ) {
+    if ( parent == NULL ) {
+        context->region_root = new_child;
+    } else if ( parent->left == old_child ) {
+        parent->left = new_child;
+    } else {
+        parent->right = new_child;
+    }
+
+    if ( new_child != NULL ) {
+        new_child->parent = parent;
+    }
+}
+
+static memory_region_t* region_tree_rotate_left( memory_context_t* context, memory_region_t* region ) {
+    memory_region_t* pivot;
+
+    pivot = region->right;
+    region->right = pivot->left;
+
+    if ( pivot->left != NULL ) {
+        pivot->left->parent = region;
+    }
 
-    for ( i = 0; i < region_count; i++ ) {
-        memory_region_t* tmp_region;
+    region_tree_replace_child( context, region->parent, region, pivot );
 
-        tmp_region = ( memory_region_t* )array_get_item( &context->regions, i );
+    pivot->left = region;
+    region->parent = pivot;
 
-        if ( region->address < tmp_region->address ) {
-            break;
+    region_tree_update( region );
+    region_tree_update( pivot );
+
+    return pivot;
+}
+
+static memory_region_t* region_tree_rotate_right( memory_context_t* context, memory_region_t* region ) {
+    memory_region_t* pivot;
+
+    pivot = region->left;
+    region->left = pivot->right;
+
+    if ( pivot->right != NULL ) {
+        pivot->right->parent = region;
+    }
+
+    region_tree_replace_child( context, region->parent, region, pivot );
+
+    pivot->right = region;
+    region->parent = pivot;
+
+    region_tree_update( region );
+    region_tree_update( pivot );
+
+    return pivot;
+}
+
+/* Walks from the specified region up to the root of the tree, updates the
+   height and the gap informations and restores the AVL balance. */
+static void region_tree_fixup( memory_context_t* context, memory_region_t* region ) {
+    int balance;
+
+    while ( region != NULL ) {
+        region_tree_update( region );
+
+        balance = region_height( region->left ) - region_height( region->right );
+
+        if ( balance > 1 ) {
+            if ( region_height( region->left->left ) < region_height( region->left->right ) ) {
+                region_tree_rotate_left( context, region->left );
+            }
+
+            region = region_tree_rotate_right( context, region );
+        } else if ( balance < -1 ) {
+            if ( region_height( region->right->right ) < region_height( region->right->left ) ) {
+                region_tree_rotate_right( context, region->right );
+            }
+
+            region = region_tree_rotate_left( context, region );
+        }
+
+        region = region->parent;
+    }
+}
+
+int memory_context_insert_region( memory_context_t* context, memory_region_t* region ) {
+    memory_region_t* parent;
+    memory_region_t* prev;
+    memory_region_t* next;
+    memory_region_t** link;
+
+    parent = NULL;
+    prev = NULL;
+    next = NULL;
+    link = &context->region_root;
+
+    /* Find the place of the region in the tree */
+
+    while ( *link != NULL ) {
+        parent = *link;
+
+        if ( region->address < parent->address ) {
+            next = parent;
+            link = &parent->left;
+        } else {
+            prev = parent;
+            link = &parent->right;
         }
     }
 
-    error = array_insert_item( &context->regions, i, ( void* )region );
+    *link = region;
+    region->parent = parent;
+    region->left = NULL;
+    region->right = NULL;
 
-    if ( error < 0 ) {
-        return error;
+    /* Link it to the ordered list as well */
+
+    region->prev = prev;
+    region->next = next;
+
+    if ( prev == NULL ) {
+        context->first_region = region;
+    } else {
+        prev->next = region;
+    }
+
+    if ( next != NULL ) {
+        next->prev = region;
     }
 
+    /* Update the gaps around the new region */
+
+    region->gap = region->address - region_end( prev );
+    region_tree_fixup( context, region );
+
+    if ( next != NULL ) {
+        next->gap = next->address - region_end( region );
+        region_tree_fixup( context, next );
+    }
+
+    context->region_count++;
+
     return 0;
 }
 
 int memory_context_remove_region( memory_context_t* context, memory_region_t* region ) {
-    int error;
+    memory_region_t* prev;
+    memory_region_t* next;
+    memory_region_t* fixup;
 
-    error = array_remove_item( &context->regions, ( void* )region );
+    if ( ( region->parent == NULL ) &&
+         ( context->region_root != region ) ) {
+        return -EINVAL;
+    }
+
+    prev = region->prev;
+    next = region->next;
+
+    /* Unlink the region from the tree */
+
+    if ( ( region->left != NULL ) &&
+         ( region->right != NULL ) ) {
+        /* Replace the region with the next one, that is the
+           leftmost region of the right subtree */
+
+        if ( next->parent == region ) {
+            fixup = next;
+        } else {
+            fixup = next->parent;
+            fixup->left = next->right;
+
+            if ( next->right != NULL ) {
+                next->right->parent = fixup;
+            }
+
+            next->right = region->right;
+            next->right->parent = next;
+        }
+
+        next->left = region->left;
+        next->left->parent = next;
+
+        region_tree_replace_child( context, region->parent, region, next );
+    } else {
+        fixup = region->parent;
+
+        region_tree_replace_child(
+            context, region->parent, region,
+            region->left != NULL ? region->left : region->right
+        );
+    }
+
+    /* Unlink it from the ordered list */
+
+    if ( prev == NULL ) {
+        context->first_region = next;
+    } else {
+        prev->next = next;
+    }
 
-    if ( error < 0 ) {
-        return error;
+    if ( next != NULL ) {
+        next->prev = prev;
+        next->gap = next->address - region_end( prev );
     }
 
+    region_tree_fixup( context, fixup );
+
+    if ( next != NULL ) {
+        region_tree_fixup( context, next );
+    }
+
+    if ( context->last_hit == region ) {
+        context->last_hit = NULL;
+    }
+
+    region->parent = NULL;
+    region->left = NULL;
+    region->right = NULL;
+    region->prev = NULL;
+    region->next = NULL;
+
+    context->region_count--;
+
     return 0;
 }
 
+void memory_context_update_region( memory_context_t* context, memory_region_t* region ) {
+    if ( region->next != NULL ) {
+        region->next->gap = region->next->address - region_end( region );
+        region_tree_fixup( context, region->next );
+    }
+}
+
 static memory_region_t* do_memory_context_get_region_for( memory_context_t* context, ptr_t address ) {
-    int i;
-    int region_count;
     memory_region_t* region;
 
-    region_count = array_get_size( &context->regions );
+    /* Page faults usually come in series for the same region */
+
+    region = context->last_hit;
+
+    if ( ( region != NULL ) &&
+         ( region_contains( region, address ) ) ) {
+        return region;
+    }
+
+    region = context->region_root;
 
-    for ( i = 0; i < region_count; i++ ) {
-        region = ( memory_region_t* )array_get_item( &context->regions, i );
+    while ( region != NULL ) {
+        if ( address < region->address ) {
+            region = region->left;
+        } else if ( region_contains( region, address ) ) {
+            context->last_hit = region;
 
-        if ( ( region->address <= address ) &&
-             ( address <= ( region->address + region->size - 1 ) ) ) {
             return region;
+        } else {
+            region = region->right;
         }
     }
 
@@ -118,58 +344,105 @@ memory_region_t* memory_context_get_region_for( memory_context_t* context, ptr_t
 
 bool memory_context_find_unmapped_region( memory_context_t* context, ptr_t start, ptr_t end,
                                           uint32_t size, ptr_t* address ) {
-    int region_count;
+    uint64_t gap_start;
+    uint64_t gap_end;
+    uint64_t low_limit;
+    uint64_t high_limit;
+    memory_region_t* region;
+    memory_region_t* last;
+
+    if ( ( size == 0 ) ||
+         ( ( uint64_t )end + 1 < ( uint64_t )start + size ) ) {
+        return false;
+    }
 
-    region_count = array_get_size( &context->regions );
+    /* A gap is suitable if it ends after low_limit and starts before
+       high_limit (and it is big enough of course). */
 
-    if ( region_count == 0 ) {
-        if ( ( start + size - 1 ) <= end ) {
-            *address = start;
+    low_limit = ( uint64_t )start + size;
+    high_limit = ( uint64_t )end + 1 - size;
 
-            return true;
+    region = context->region_root;
+
+    if ( ( region == NULL ) ||
+         ( region->subtree_gap < size ) ) {
+        goto check_highest;
+    }
+
+    /* Look for the lowest suitable gap before a region. The subtrees
+       without a big enough gap are skipped. */
+
+    while ( 1 ) {
+        gap_end = region->address;
+
+        if ( ( gap_end >= low_limit ) &&
+             ( region_subtree_gap( region->left ) >= size ) ) {
+            region = region->left;
+            continue;
         }
-    } else {
-        int i;
-        memory_region_t* region;
 
-        for ( i = 0; i < region_count; i++ ) {
-            region = ( memory_region_t* )array_get_item( &context->regions, i );
+        gap_start = region_end( region->prev );
 
-            if ( start + size <= region->address ) {
-                *address = start;
+ check_current:
+        if ( gap_start > high_limit ) {
+            return false;
+        }
 
-                return true;
-            } else {
-                start = MAX( start, region->address + region->size );
-            }
+        if ( ( gap_end >= low_limit ) &&
+             ( gap_end > gap_start ) &&
+             ( gap_end - gap_start >= size ) ) {
+            goto found;
+        }
+
+        if ( region_subtree_gap( region->right ) >= size ) {
+            region = region->right;
+            continue;
         }
 
-        if ( ( start + size - 1 ) <= end ) {
-            *address = start;
+        /* Go back up to the next region that has not been checked yet */
+
+        while ( 1 ) {
+            memory_region_t* child;
+
+            child = region;
+            region = region->parent;
+
+            if ( region == NULL ) {
+                goto check_highest;
+            }
 
-            return true;
+            if ( region->left == child ) {
+                gap_start = region_end( region->prev );
+                gap_end = region->address;
+                goto check_current;
+            }
         }
     }
 
-    return false;
-}
+ check_highest:
+    /* Check the space after the last region */
 
-bool memory_context_can_resize_region( memory_context_t* context, memory_region_t* region, uint64_t new_size ) {
-    int index;
-    memory_region_t* tmp_region;
+    last = context->region_root;
 
-    index = array_index_of( &context->regions, ( void* )region );
+    while ( ( last != NULL ) &&
+            ( last->right != NULL ) ) {
+        last = last->right;
+    }
 
-    if ( index == -1 ) {
-        kprintf(
-            WARNING,
-            "memory_context_can_resize_region(): Region not found in the memory context!\n"
-        );
+    gap_start = region_end( last );
 
+    if ( gap_start > high_limit ) {
         return false;
     }
 
-    if ( index == array_get_size( &context->regions ) - 1 ) {
+ found:
+    *address = ( ptr_t )MAX( gap_start, start );
+
+    return true;
+}
+
+bool memory_context_can_resize_region( memory_context_t* context, memory_region_t* region, uint64_t new_size ) {
+    if ( region->next == NULL ) {
         ptr_t end_address;
 
         if ( region->flags & REGION_KERNEL ) {
@@ -181,35 +454,48 @@ bool memory_context_can_resize_region( memory_context_t* context, memory_region_
         return ( ( region->address + new_size - 1 ) <= end_address );
     }
 
-    tmp_region = ( memory_region_t* )array_get_item( &context->regions, index + 1 );
-
-    return ( ( region->address + new_size - 1 ) < tmp_region->address );
+    return ( ( region->address + new_size - 1 ) < region->next->address );
 }
 
-memory_context_t* memory_context_clone( memory_context_t* old_context, process_t* new_process ) {
-    int i;
-    int region_count;
-    memory_context_t* new_context;
+memory_context_t* memory_context_create( process_t* process ) {
+    memory_context_t* context;
 
     /* Allocate a new memory context */
 
-    new_context = ( memory_context_t* )kmalloc( sizeof( memory_context_t ) );
+    context = ( memory_context_t* )kmalloc( sizeof( memory_context_t ) );
 
-    if ( new_context == NULL ) {
+    if ( context == NULL ) {
         return NULL;
     }
 
-    if ( memory_context_init( new_context ) != 0 ) {
-        kfree( new_context );
+    if ( memory_context_init( context ) != 0 ) {
+        kfree( context );
         return NULL;
     }
 
-    new_context->process = new_process;
+    context->process = process;
 
     /* Initialize the architecture dependent part of the memory context */
 
-    if ( arch_memory_context_init( new_context ) != 0 ) {
-        memory_context_destroy( new_context );
+    if ( arch_memory_context_init( context ) != 0 ) {
+        memory_context_destroy( context );
+        return NULL;
+    }
+
+    /* Map the kernel to the new context */
+
+    arch_memory_context_clone( &kernel_memory_context, context );
+
+    return context;
+}
+
+memory_context_t* memory_context_clone( memory_context_t* old_context, process_t* new_process ) {
+    memory_region_t* old_region;
+    memory_context_t* new_context;
+
+    new_context = memory_context_create( new_process );
+
+    if ( new_context == NULL ) {
         return NULL;
     }
 
@@ -217,16 +503,14 @@ memory_context_t* memory_context_clone( memory_context_t* old_context, process_t
 
     mutex_lock( old_context->mutex, LOCK_IGNORE_SIGNAL );
 
-    arch_memory_context_clone( old_context, new_context );
+    /* Write access is removed from the pages of the old context, the
+       TLB of the processors running it is flushed once at the end. */
 
-    region_count = array_get_size( &old_context->regions );
+    arch_memory_context_begin_tlb_batch( old_context );
 
-    for ( i = 0; i < region_count; i++ ) {
-        memory_region_t* old_region;
+    for ( old_region = old_context->first_region; old_region != NULL; old_region = old_region->next ) {
         memory_region_t* new_region;
 
-        old_region = ( memory_region_t* )array_get_item( &old_context->regions, i );
-
         /* Don't clone kernel regions */
 
         if ( old_region->flags & REGION_KERNEL ) {
@@ -256,6 +540,8 @@ memory_context_t* memory_context_clone( memory_context_t* old_context, process_t
             goto error;
         }
 
+        new_region->rss = old_region->rss;
+
         /* Insert the new region into the new context */
 
         if ( memory_context_insert_region( new_context, new_region ) != 0 ) {
@@ -263,12 +549,14 @@ memory_context_t* memory_context_clone( memory_context_t* old_context, process_t
         }
     }
 
+    arch_memory_context_end_tlb_batch( old_context );
     mutex_unlock( old_context->mutex );
 
-    /* Clone the vmem_size of the old process as well ;) */
+    /* Clone the vmem_size and pmem_size of the old process as well ;) */
 
     scheduler_lock();
     new_process->vmem_size = old_context->process->vmem_size;
+    new_process->pmem_size = old_context->process->pmem_size;
     scheduler_unlock();
 
     return new_context;
@@ -276,25 +564,21 @@ memory_context_t* memory_context_clone( memory_context_t* old_context, process_t
  error:
     /* TODO: cleanup! */
 
+    arch_memory_context_end_tlb_batch( old_context );
     mutex_unlock( old_context->mutex );
 
     return NULL;
 }
 
 int memory_context_delete_regions( memory_context_t* context ) {
-    int i;
-    int region_count;
     memory_region_t* region;
+    memory_region_t* next;
 
     mutex_lock( region_lock, LOCK_IGNORE_SIGNAL );
 
     /* Remove memory regions from the global map */
 
-    region_count = array_get_size( &context->regions );
-
-    for ( i = 0; i < region_count; i++ ) {
-        region = ( memory_region_t* )array_get_item( &context->regions, i );
-
+    for ( region = context->first_region; region != NULL; region = region->next ) {
         ASSERT( region->ref_count == 1 );
         ASSERT( ( region->flags & REGION_KERNEL ) == 0 );
 
@@ -305,23 +589,34 @@ int memory_context_delete_regions( memory_context_t* context ) {
 
     mutex_unlock( region_lock );
 
-    /* Clean up memory regions */
+    /* Clean up memory regions. The TLB invalidations are collected and
+       done at once at the end, the unmapped pages are freed only after
+       that, so other threads still running in the context can't reach
+       reused pages through their stale TLB entries. */
+
+    arch_memory_context_begin_tlb_batch( context );
 
-    for ( i = 0; i < region_count; i++ ) {
-        region = ( memory_region_t* )array_get_item( &context->regions, i );
+    for ( region = context->first_region; region != NULL; region = next ) {
+        next = region->next;
 
         arch_memory_region_unmap_pages( region, region->address, region->size );
         memory_region_destroy( region );
     }
 
-    /* Set the new size of memory regions in the context */
+    arch_memory_context_end_tlb_batch( context );
 
-    array_make_empty( &context->regions );
+    /* The context is empty now */
 
-    /* Update vmem statistics */
+    context->region_root = NULL;
+    context->first_region = NULL;
+    context->last_hit = NULL;
+    context->region_count = 0;
+
+    /* Update memory statistics */
 
     scheduler_lock();
     context->process->vmem_size = 0;
+    context->process->pmem_size = 0;
     scheduler_unlock();
 
     return 0;
@@ -339,58 +634,34 @@ int memory_context_translate_address( memory_context_t* context, ptr_t linear, p
 
 void memory_context_dump( memory_context_t* context ) {
     int i;
-    int region_count;
+    memory_region_t* region;
 
     kprintf( INFO, "Memory context dump:\n" );
 
-    region_count = array_get_size( &context->regions );
-
-    for ( i = 0; i < region_count; i++ ) {
-        memory_region_t* region;
-
-        region = ( memory_region_t* )array_get_item( &context->regions, i );
-
+    for ( i = 0, region = context->first_region; region != NULL; i++, region = region->next ) {
         memory_region_dump( region, i );
     }
 }
 
 int memory_context_init( memory_context_t* context ) {
-    int error;
-
     memset(
         context,
         0,
         sizeof( memory_context_t )
     );
 
-    error = array_init( &context->regions );
-
-    if ( error < 0 ) {
-        goto error1;
-    }
-
-    array_set_realloc_size( &context->regions, 32 );
-
     context->mutex = mutex_create( "Memory context mutex", MUTEX_NONE );
 
     if ( context->mutex < 0 ) {
-        error = context->mutex;
-        goto error2;
+        return context->mutex;
     }
 
     return 0;
-
- error2:
-    array_destroy( &context->regions );
-
- error1:
-    return error;
 }
 
 void memory_context_destroy( memory_context_t* context ) {
     arch_memory_context_destroy( context );
 
-    array_destroy( &context->regions );
     mutex_destroy( context->mutex );
     kfree( context );
 }
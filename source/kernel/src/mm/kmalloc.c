@@ -23,141 +23,75 @@
 #include <macros.h>
 #include <mm/kmalloc.h>
 #include <mm/pages.h>
+#include <mm/slab.h>
 #include <lib/string.h>
 
 #include <arch/spinlock.h>
 #include <arch/mm/config.h>
 
-static uint32_t used_pages = 0;
-static uint32_t alloc_size = 0;
+/* The sizes of the general purpose object caches. Requests bigger
+   than the biggest cache are served directly by the page allocator. */
+static uint32_t kmalloc_sizes[ KMALLOC_CACHE_COUNT ] = {
+    16, 32, 64, 128, 256, 512, 1024, 2048
+};
 
-static spinlock_t kmalloc_lock = INIT_SPINLOCK("kmalloc");
-static kmalloc_block_t* root = NULL;
-
-static inline int kmalloc_block_validate(kmalloc_block_t* block) {
-    return (block->magic == KMALLOC_BLOCK_MAGIC);
-}
+static const char* kmalloc_names[ KMALLOC_CACHE_COUNT ] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048"
+};
 
-static inline int kmalloc_chunk_validate(kmalloc_chunk_t* chunk) {
-    return ((chunk->magic & 0xFFFFFFF0) == KMALLOC_CHUNK_MAGIC);
-}
-
-static inline void kmalloc_chunk_set_free(kmalloc_chunk_t* chunk, int free) {
-    if (free) {
-        chunk->magic |= CHUNK_FREE;
-    } else {
-        chunk->magic &= ~CHUNK_FREE;
-    }
-}
+static kmem_cache_t kmalloc_caches[ KMALLOC_CACHE_COUNT ];
 
-static inline int kmalloc_chunk_is_free(kmalloc_chunk_t* chunk) {
-    return ((chunk->magic & CHUNK_FREE) != 0);
-}
+/* Statistics of the large allocations. The lock protects only these,
+   the object caches have their own locks and per-CPU magazines. */
+static uint32_t large_pages = 0;
+static uint32_t large_size = 0;
 
-static kmalloc_block_t* kmalloc_block_create(uint32_t pages) {
-    kmalloc_block_t* block;
-    kmalloc_chunk_t* chunk;
+static spinlock_t kmalloc_lock = INIT_SPINLOCK("kmalloc");
 
-    block = (kmalloc_block_t*)alloc_pages(pages, MEM_COMMON);
+static inline kmem_cache_t* kmalloc_get_cache( uint32_t size ) {
+    int i;
 
-    if (__unlikely(block == NULL)) {
-        return NULL;
+    for ( i = 0; i < KMALLOC_CACHE_COUNT; i++ ) {
+        if ( size <= kmalloc_sizes[ i ] ) {
+            return &kmalloc_caches[ i ];
+        }
     }
 
-    used_pages += pages;
-
-    block->magic = KMALLOC_BLOCK_MAGIC;
-    block->pages = pages;
-    block->next = NULL;
-
-    chunk = (kmalloc_chunk_t*)(block + 1);
-
-    chunk->magic = KMALLOC_CHUNK_MAGIC;
-    kmalloc_chunk_set_free(chunk, 1);
-    chunk->block = block;
-    chunk->size = (pages * PAGE_SIZE) - sizeof(kmalloc_block_t) - sizeof(kmalloc_chunk_t);
-    chunk->prev = NULL;
-    chunk->next = NULL;
-
-    block->biggest_free = chunk->size;
-
-    return block;
+    return NULL;
 }
 
-static void* __kmalloc_from_block(kmalloc_block_t* block, uint32_t size, uint32_t* real_size) {
-    void* p;
-    kmalloc_chunk_t* chunk;
+static void* kmalloc_large( uint32_t size, uint32_t* real_size ) {
+    uint32_t pages;
+    kmalloc_large_t* large;
 
-    chunk = (kmalloc_chunk_t*)(block + 1);
+    pages = PAGE_ALIGN( size + sizeof( kmalloc_large_t ) ) / PAGE_SIZE;
+    large = ( kmalloc_large_t* )alloc_pages( pages, MEM_COMMON );
 
-    while ((chunk != NULL) &&
-           ((!kmalloc_chunk_is_free(chunk)) ||
-            (chunk->size < size))) {
-        ASSERT(kmalloc_chunk_validate(chunk));
-        chunk = chunk->next;
-    }
-
-    if ( __unlikely( chunk == NULL ) ) {
+    if ( __unlikely( large == NULL ) ) {
         return NULL;
     }
 
-    kmalloc_chunk_set_free(chunk, 0);
-    p = ( void* )(chunk + 1);
-
-    if ( chunk->size > ( size + sizeof( kmalloc_chunk_t ) + 4 ) ) {
-        uint32_t remaining_size;
-        kmalloc_chunk_t* new_chunk;
-
-        remaining_size = chunk->size - size - sizeof( kmalloc_chunk_t );
-
-        chunk->size = size;
+    large->magic = KMALLOC_LARGE_MAGIC;
+    large->pages = pages;
 
-        new_chunk = ( kmalloc_chunk_t* )( ( uint8_t* )chunk + sizeof( kmalloc_chunk_t ) + size );
+    *real_size = pages * PAGE_SIZE - sizeof( kmalloc_large_t );
 
-        new_chunk->magic = KMALLOC_CHUNK_MAGIC;
-        kmalloc_chunk_set_free(new_chunk, 1);
-        new_chunk->size = remaining_size;
-        new_chunk->block = chunk->block;
-
-        /* link it to the current block */
-
-        new_chunk->prev = chunk;
-        new_chunk->next = chunk->next;
-        chunk->next = new_chunk;
-
-        if ( new_chunk->next != NULL ) {
-            new_chunk->next->prev = new_chunk;
-        }
-    }
-
-    /* Update the number of allocated bytes. */
-    alloc_size += chunk->size;
-    *real_size = chunk->size;
-
-    /* Recalculate the biggest free chunk in this block. */
-    block->biggest_free = 0;
-
-    chunk = (kmalloc_chunk_t*)(block + 1);
-
-    while (chunk != NULL) {
-        ASSERT(kmalloc_chunk_validate(chunk));
+    spinlock_disable( &kmalloc_lock );
 
-        if ((kmalloc_chunk_is_free(chunk)) &&
-            (chunk->size > block->biggest_free)) {
-            block->biggest_free = chunk->size;
-        }
+    large_pages += pages;
+    large_size += *real_size;
 
-        chunk = chunk->next;
-    }
+    spinunlock_enable( &kmalloc_lock );
 
-    return p;
+    return ( void* )( large + 1 );
 }
 
-void* kmalloc( uint32_t size ) {
+static void* do_kmalloc( uint32_t size, ptr_t caller ) {
     void* p;
-    uint32_t min_size;
-    uint32_t real_size = 0;
-    kmalloc_block_t* block;
+    uint32_t real_size;
+    uint32_t request_size;
+    kmem_cache_t* cache;
 
     /* Is this an invalid request? */
     if (__unlikely(size == 0)) {
@@ -165,83 +99,53 @@ void* kmalloc( uint32_t size ) {
         return NULL;
     }
 
-    /* Ensure the minimum allocation. */
-    if (size < sizeof(ptr_t)) {
-        size = sizeof(ptr_t);
-    }
+    request_size = size;
 
 #ifdef ENABLE_KMALLOC_BARRIERS
     size += 2 * KMALLOC_BARRIER_SIZE;
 #endif /* ENABLE_KMALLOC_BARRIERS */
 
-    spinlock_disable(&kmalloc_lock);
-
-    block = root;
+    cache = kmalloc_get_cache( size );
 
-    while (block != NULL) {
-        ASSERT(kmalloc_block_validate(block));
+    if ( __likely( cache != NULL ) ) {
+        p = kmem_cache_alloc( cache );
 
-        if (block->biggest_free >= size) {
-            goto block_found;
+        if (__unlikely(p == NULL)) {
+            return NULL;
         }
 
-        block = block->next;
-    }
-
-    /* create a new block */
-
-    min_size = PAGE_ALIGN(size + sizeof(kmalloc_block_t) + sizeof(kmalloc_chunk_t));
-
-    if (min_size < KMALLOC_BLOCK_SIZE) {
-        min_size = KMALLOC_BLOCK_SIZE;
-    }
-
-    block = kmalloc_block_create(min_size / PAGE_SIZE);
-
-    if (__unlikely(block == NULL)) {
-        spinunlock_enable(&kmalloc_lock);
-        return NULL;
-    }
-
-    /* link the new block to the list */
-
-    block->next = root;
-    root = block;
-
-    /* allocate the required memory from the new block */
-
-block_found:
-    p = __kmalloc_from_block(block, size, &real_size);
+        real_size = cache->object_size;
+        kmem_set_tag( kmem_get_slab( p ), p, kmalloc_profiler_alloc( caller, request_size, real_size ) );
+    } else {
+        p = kmalloc_large( size, &real_size );
 
-#ifdef ENABLE_KMALLOC_DEBUG
-    kmalloc_debug(size, p);
-#endif
+        if (__unlikely(p == NULL)) {
+            return NULL;
+        }
 
-#ifdef ENABLE_KMALLOC_BARRIERS
-    if (p != NULL) {
-        p = kmalloc_create_barriers(p, real_size);
+        ( ( kmalloc_large_t* )p - 1 )->site = kmalloc_profiler_alloc( caller, request_size, real_size );
     }
-#endif /* ENABLE_KMALLOC_BARRIERS */
 
-    spinunlock_enable(&kmalloc_lock);
-
-    if (__likely(p != NULL)) {
 #ifdef ENABLE_KMALLOC_BARRIERS
-        memset(p, 0xaa, size - 2 * KMALLOC_BARRIER_SIZE);
+    p = kmalloc_create_barriers(p, real_size);
+    memset(p, 0xaa, size - 2 * KMALLOC_BARRIER_SIZE);
 #else
-        memset(p, 0xaa, size);
+    memset(p, 0xaa, size);
 #endif /* ENABLE_KMALLOC_BARRIERS */
-    }
 
     return p;
 }
 
+void* kmalloc( uint32_t size ) {
+    return do_kmalloc( size, ( ptr_t )__builtin_return_address( 0 ) );
+}
+
 void* kcalloc( uint32_t nmemb, uint32_t size ) {
     void* p;
     uint32_t s;
 
     s = nmemb * size;
-    p = kmalloc( s );
+    p = do_kmalloc( s, ( ptr_t )__builtin_return_address( 0 ) );
 
     if ( p == NULL ) {
         return NULL;
@@ -253,104 +157,87 @@ void* kcalloc( uint32_t nmemb, uint32_t size ) {
 }
 
 void kfree( void* p ) {
-    kmalloc_chunk_t* chunk;
+    kmem_slab_t* slab;
+    kmalloc_large_t* large;
 
     if (__unlikely(p == NULL)) {
         return;
     }
 
 #ifdef ENABLE_KMALLOC_BARRIERS
-    kmalloc_validate_barriers(p);
     p = (uint8_t*)p - KMALLOC_BARRIER_SIZE;
 #endif /* ENABLE_KMALLOC_BARRIERS */
 
-    chunk = ( kmalloc_chunk_t* )( ( uint8_t* )p - sizeof( kmalloc_chunk_t ) );
+    slab = kmem_get_slab( p );
 
-    spinlock_disable( &kmalloc_lock );
-
-    if (__unlikely(!kmalloc_chunk_validate(chunk))) {
-        panic( "kfree(): Tried to free an invalid memory region! (%x)\n", p );
-    }
-
-    if (__unlikely(kmalloc_chunk_is_free(chunk))) {
-        panic( "kfree(): Tried to free a non-allocated memory region! (%x)\n", p );
-    }
-
-#ifdef ENABLE_KMALLOC_DEBUG
-    kfree_debug( p );
-#endif
-
-    alloc_size -= chunk->size;
-
-    /* Make the current chunk free. */
-    kmalloc_chunk_set_free(chunk, 1);
-
-    /* Destroy the previous data in this memory chunk. */
-    memset(chunk + 1, 0xAA, chunk->size);
+    if ( __likely( slab != NULL ) ) {
+#ifdef ENABLE_KMALLOC_BARRIERS
+        kmalloc_validate_barriers( (uint8_t*)p + KMALLOC_BARRIER_SIZE, slab->cache->object_size );
+#endif /* ENABLE_KMALLOC_BARRIERS */
 
-    /* Merge with the previous chunk if it is free */
-    if ((chunk->prev != NULL) &&
-        (kmalloc_chunk_is_free(chunk->prev))) {
-        kmalloc_chunk_t* prev_chunk = chunk->prev;
+        kmalloc_profiler_free( kmem_get_tag( slab, p ), slab->cache->object_size );
 
-        ASSERT(kmalloc_chunk_validate(chunk->prev));
+        /* Destroy the previous data in this memory chunk. */
+        memset( p, 0xAA, slab->cache->object_size );
 
-        chunk->magic = 0;
+        kmem_cache_free( slab->cache, p );
 
-        prev_chunk->size += chunk->size;
-        prev_chunk->size += sizeof(kmalloc_chunk_t);
+        return;
+    }
 
-        prev_chunk->next = chunk->next;
-        chunk = prev_chunk;
+    large = ( kmalloc_large_t* )p - 1;
 
-        if ( chunk->next != NULL ) {
-            chunk->next->prev = chunk;
-        }
+    if ( __unlikely( ( ( ( ptr_t )large % PAGE_SIZE ) != 0 ) ||
+                     ( large->magic != KMALLOC_LARGE_MAGIC ) ) ) {
+        panic( "kfree(): Tried to free an invalid memory region! (%x)\n", p );
     }
 
-    /* merge with the next chunk if it is free */
+#ifdef ENABLE_KMALLOC_BARRIERS
+    kmalloc_validate_barriers( (uint8_t*)p + KMALLOC_BARRIER_SIZE, large->pages * PAGE_SIZE - sizeof( kmalloc_large_t ) );
+#endif /* ENABLE_KMALLOC_BARRIERS */
 
-    if ((chunk->next != NULL) &&
-        (kmalloc_chunk_is_free(chunk->next))) {
-        kmalloc_chunk_t* next_chunk = chunk->next;
+    kmalloc_profiler_free( large->site, large->pages * PAGE_SIZE - sizeof( kmalloc_large_t ) );
 
-        ASSERT(kmalloc_chunk_validate(next_chunk));
+    spinlock_disable( &kmalloc_lock );
 
-        next_chunk->magic = 0;
+    large_pages -= large->pages;
+    large_size -= large->pages * PAGE_SIZE - sizeof( kmalloc_large_t );
 
-        chunk->size += next_chunk->size;
-        chunk->size += sizeof( kmalloc_chunk_t );
+    spinunlock_enable( &kmalloc_lock );
 
-        chunk->next = next_chunk->next;
+    large->magic = 0;
 
-        if ( chunk->next != NULL ) {
-            chunk->next->prev = chunk;
-        }
-    }
+    free_pages( ( void* )large, large->pages );
+}
 
-    /* update the biggest free chunk size in the current block */
+void kmalloc_get_statistics( kmalloc_statistics_t* stats ) {
+    kmem_magazine_t magazine;
 
-    if (chunk->size > chunk->block->biggest_free) {
-        chunk->block->biggest_free = chunk->size;
-    }
+    kmem_get_statistics( &stats->used_pages, &stats->alloc_size, &magazine );
 
-    spinunlock_enable( &kmalloc_lock );
-}
+    stats->cached_objects = magazine.count;
+    stats->magazine_hits = magazine.hits;
+    stats->magazine_misses = magazine.misses;
+    stats->magazine_flushes = magazine.flushes;
 
-void kmalloc_get_statistics( uint32_t* _used_pages, uint32_t* _alloc_size ) {
     spinlock_disable( &kmalloc_lock );
 
-    *_used_pages = used_pages;
-    *_alloc_size = alloc_size;
+    stats->used_pages += large_pages;
+    stats->alloc_size += large_size;
 
     spinunlock_enable( &kmalloc_lock );
 }
 
 __init int init_kmalloc( void ) {
-    root = kmalloc_block_create(KMALLOC_ROOT_SIZE / PAGE_SIZE);
+    int i;
+    int error;
 
-    if ( root == NULL ) {
-        return -ENOMEM;
+    for ( i = 0; i < KMALLOC_CACHE_COUNT; i++ ) {
+        error = kmem_cache_init( &kmalloc_caches[ i ], kmalloc_names[ i ], kmalloc_sizes[ i ], KMEM_CACHE_TAGGED );
+
+        if ( error < 0 ) {
+            return error;
+        }
     }
 
     return 0;
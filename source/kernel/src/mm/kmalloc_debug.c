@@ -18,50 +18,6 @@
 
 #include <mm/kmalloc.h>
 
-#ifdef ENABLE_KMALLOC_DEBUG
-
-#include <debug.h>
-#include <console.h>
-
-static kmalloc_debug_output_t* output = NULL;
-
-static int kmalloc_debug_trace( ptr_t ip, ptr_t symbol_address, const char* symbol_name, void* data ) {
-    kmalloc_debug_output_t* out;
-
-    out = ( kmalloc_debug_output_t* )data;
-
-    if ( symbol_name != NULL ) {
-        out->malloc_trace( ip, symbol_name );
-    } else {
-        out->malloc_trace( 0, "<unknown>" );
-    }
-
-    return 0;
-}
-
-void kmalloc_debug( uint32_t size, void* p ) {
-    if ( output != NULL ) {
-        output->malloc( size, p );
-        debug_print_stack_trace_cb( kmalloc_debug_trace, output );
-    }
-}
-
-void kfree_debug( void* p ) {
-    if ( output != NULL ) {
-        output->free( p );
-    }
-}
-
-void kmalloc_set_debug_output( kmalloc_debug_output_t* out ) {
-    output = out;
-
-    if ( output != NULL ) {
-        output->init();
-    }
-}
-
-#endif /* ENABLE_KMALLOC_DEBUG */
-
 #ifdef ENABLE_KMALLOC_BARRIERS
 
 #include <console.h>
@@ -78,14 +34,13 @@ void* kmalloc_create_barriers(void* p, size_t size) {
     return (data + KMALLOC_BARRIER_SIZE);
 }
 
-void kmalloc_validate_barriers(void* p) {
+void kmalloc_validate_barriers(void* p, size_t size) {
     int i;
     uint8_t* data = (uint8_t*)p;
     data -= KMALLOC_BARRIER_SIZE;
 
-    kmalloc_chunk_t* chunk = (kmalloc_chunk_t*)((uint8_t*)data - sizeof(kmalloc_chunk_t));
     uint8_t* before = data;
-    uint8_t* after = data + chunk->size - KMALLOC_BARRIER_SIZE;
+    uint8_t* after = data + size - KMALLOC_BARRIER_SIZE;
 
     uint8_t* failed_ptr;
     uint8_t expected_data;
@@ -0,0 +1,261 @@
+/* Memory allocator profiler
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <types.h>
+#include <errno.h>
+#include <kernel.h>
+#include <macros.h>
+#include <symbols.h>
+#include <mm/kmalloc.h>
+#include <mm/slab.h>
+#include <vfs/kdebugfs.h>
+#include <lib/string.h>
+
+#include <arch/interrupt.h>
+#include <arch/spinlock.h>
+
+/* The instruction pointers of the known call sites. The first entry is
+   not used by any site, allocations are accounted there when the table
+   is full. An entry is never changed once it is set, so the table can
+   be searched without locking. */
+static volatile ptr_t site_table[ KMALLOC_PROFILER_SITES ];
+static spinlock_t site_table_lock = INIT_SPINLOCK( "kmalloc profiler" );
+
+/* The statistics are collected per-CPU to keep the profiler away from
+   the shared cache lines, they are summed only when the node is read. */
+static kmalloc_site_stat_t site_stats[ MAX_CPU_COUNT ][ KMALLOC_PROFILER_SITES ];
+
+static kdbgfs_node_t* profiler_node;
+
+static uint16_t kmalloc_profiler_get_site( ptr_t ip ) {
+    uint32_t i;
+    uint32_t n;
+
+    i = ( ip >> 2 ) % ( KMALLOC_PROFILER_SITES - 1 ) + 1;
+
+    for ( n = 0; n < KMALLOC_PROFILER_SITES - 1; n++ ) {
+        if ( site_table[ i ] == ip ) {
+            return i;
+        }
+
+        if ( site_table[ i ] == 0 ) {
+            spinlock_disable( &site_table_lock );
+
+            if ( site_table[ i ] == 0 ) {
+                site_table[ i ] = ip;
+            }
+
+            spinunlock_enable( &site_table_lock );
+
+            /* Someone else could take the entry in the meantime */
+
+            if ( site_table[ i ] == ip ) {
+                return i;
+            }
+        }
+
+        if ( ++i == KMALLOC_PROFILER_SITES ) {
+            i = 1;
+        }
+    }
+
+    return 0;
+}
+
+static inline uint32_t kmalloc_profiler_get_bucket( uint32_t size ) {
+    uint32_t bucket = 0;
+
+    while ( ( bucket < KMALLOC_PROFILER_BUCKETS - 1 ) &&
+            ( size > ( 16U << bucket ) ) ) {
+        bucket++;
+    }
+
+    return bucket;
+}
+
+uint16_t kmalloc_profiler_alloc( ptr_t ip, uint32_t size, uint32_t real_size ) {
+    bool ints;
+    uint16_t site;
+    kmalloc_site_stat_t* stat;
+
+    site = kmalloc_profiler_get_site( ip );
+
+    ints = disable_interrupts();
+
+    stat = &site_stats[ kmem_get_processor_index() ][ site ];
+
+    stat->alloc_count++;
+    stat->live_bytes += real_size;
+    stat->histogram[ kmalloc_profiler_get_bucket( size ) ]++;
+
+    if ( ints ) {
+        enable_interrupts();
+    }
+
+    return site;
+}
+
+void kmalloc_profiler_free( uint16_t site, uint32_t real_size ) {
+    bool ints;
+    kmalloc_site_stat_t* stat;
+
+    ASSERT( site < KMALLOC_PROFILER_SITES );
+
+    ints = disable_interrupts();
+
+    stat = &site_stats[ kmem_get_processor_index() ][ site ];
+
+    stat->free_count++;
+    stat->live_bytes -= real_size;
+
+    if ( ints ) {
+        enable_interrupts();
+    }
+}
+
+static const char* bucket_names[ KMALLOC_PROFILER_BUCKETS ] = {
+    "<=16", "<=32", "<=64", "<=128", "<=256", "<=512", "<=1024", "<=2048", "larger"
+};
+
+static void kmalloc_profiler_write_header( kdbgfs_node_t* node ) {
+    int i;
+    int length;
+    char line[ 192 ];
+
+    length = snprintf(
+        line, sizeof( line ), "%-40s %8s %8s %10s",
+        "caller", "allocs", "frees", "live"
+    );
+
+    for ( i = 0; i < KMALLOC_PROFILER_BUCKETS; i++ ) {
+        length += snprintf( line + length, sizeof( line ) - length, " %7s", bucket_names[ i ] );
+    }
+
+    length += snprintf( line + length, sizeof( line ) - length, "\n" );
+
+    kdebugfs_write_node( node, line, length );
+}
+
+static void kmalloc_profiler_write_site( kdbgfs_node_t* node, uint16_t site, kmalloc_site_stat_t* stat ) {
+    int i;
+    int length;
+    char caller[ 64 ];
+    char line[ 192 ];
+    symbol_info_t symbol_info;
+
+    if ( site == 0 ) {
+        strcpy( caller, "<other>" );
+    } else if ( get_kernel_symbol_info( site_table[ site ], &symbol_info ) == 0 ) {
+        snprintf(
+            caller, sizeof( caller ), "%s+0x%x",
+            symbol_info.name, site_table[ site ] - symbol_info.address
+        );
+    } else {
+        snprintf( caller, sizeof( caller ), "0x%x", site_table[ site ] );
+    }
+
+    length = snprintf(
+        line, sizeof( line ), "%-40s %8u %8u %10d",
+        caller, stat->alloc_count, stat->free_count, stat->live_bytes
+    );
+
+    for ( i = 0; i < KMALLOC_PROFILER_BUCKETS; i++ ) {
+        length += snprintf( line + length, sizeof( line ) - length, " %7u", stat->histogram[ i ] );
+    }
+
+    length += snprintf( line + length, sizeof( line ) - length, "\n" );
+
+    kdebugfs_write_node( node, line, length );
+}
+
+static int kmalloc_profiler_update( kdbgfs_node_t* node, void* data ) {
+    int i;
+    int j;
+    int k;
+    int count;
+    uint16_t* order;
+    kmalloc_site_stat_t* totals;
+
+    totals = ( kmalloc_site_stat_t* )kcalloc( KMALLOC_PROFILER_SITES, sizeof( kmalloc_site_stat_t ) );
+    order = ( uint16_t* )kmalloc( KMALLOC_PROFILER_SITES * sizeof( uint16_t ) );
+
+    if ( ( totals == NULL ) || ( order == NULL ) ) {
+        kfree( totals );
+        kfree( order );
+
+        return -ENOMEM;
+    }
+
+    /* Sum the per-CPU statistics */
+
+    for ( i = 0; i < MAX_CPU_COUNT; i++ ) {
+        for ( j = 0; j < KMALLOC_PROFILER_SITES; j++ ) {
+            kmalloc_site_stat_t* stat = &site_stats[ i ][ j ];
+
+            totals[ j ].alloc_count += stat->alloc_count;
+            totals[ j ].free_count += stat->free_count;
+            totals[ j ].live_bytes += stat->live_bytes;
+
+            for ( k = 0; k < KMALLOC_PROFILER_BUCKETS; k++ ) {
+                totals[ j ].histogram[ k ] += stat->histogram[ k ];
+            }
+        }
+    }
+
+    /* Order the sites by the number of live bytes, the biggest
+       users (and the leaks) will be at the top. */
+
+    count = 0;
+
+    for ( i = 0; i < KMALLOC_PROFILER_SITES; i++ ) {
+        if ( totals[ i ].alloc_count == 0 ) {
+            continue;
+        }
+
+        for ( j = count; ( j > 0 ) && ( totals[ order[ j - 1 ] ].live_bytes < totals[ i ].live_bytes ); j-- ) {
+            order[ j ] = order[ j - 1 ];
+        }
+
+        order[ j ] = i;
+        count++;
+    }
+
+    kdebugfs_clear_node( node );
+    kmalloc_profiler_write_header( node );
+
+    for ( i = 0; i < count; i++ ) {
+        kmalloc_profiler_write_site( node, order[ i ], &totals[ order[ i ] ] );
+    }
+
+    kfree( totals );
+    kfree( order );
+
+    return 0;
+}
+
+int init_kmalloc_profiler( void ) {
+    profiler_node = kdebugfs_create_node( "kmalloc_profile", 64 * 1024 );
+
+    if ( profiler_node == NULL ) {
+        return -ENOMEM;
+    }
+
+    kdebugfs_set_update( profiler_node, kmalloc_profiler_update, NULL );
+
+    return 0;
+}
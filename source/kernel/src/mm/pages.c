@@ -19,13 +19,18 @@
 #include <types.h>
 #include <kernel.h>
 #include <errno.h>
+#include <console.h>
 #include <bootmodule.h>
 #include <macros.h>
 #include <config.h>
+#include <smp.h>
 #include <mm/pages.h>
 #include <mm/kmalloc.h>
+#include <mm/region.h>
+#include <vfs/filecache.h>
 #include <lib/string.h>
 
+#include <arch/interrupt.h>
 #include <arch/mm/config.h>
 
 uint64_t memory_size;
@@ -33,6 +38,10 @@ memory_page_t* memory_pages;
 spinlock_t pages_lock = INIT_SPINLOCK( "page allocator" );
 memory_type_desc_t memory_descriptors[ MAX_MEMORY_TYPES ];
 
+static bool page_cache_enabled = false;
+uint32_t page_cache_high = 48;
+uint32_t page_cache_batch = 16;
+
 static inline memory_type_desc_t* get_memory_descriptor( ptr_t address ) {
     int i;
     memory_type_desc_t* memory_desc;
@@ -53,105 +62,208 @@ static inline memory_type_desc_t* get_memory_descriptor( ptr_t address ) {
     return NULL;
 }
 
-void* do_alloc_pages( memory_type_desc_t* memory_desc, uint32_t count ) {
-    ptr_t i;
-    void* p;
-    bool found;
-    memory_page_t* page;
-    ptr_t page_count;
-    ptr_t region_start;
-    uint32_t free_page_count;
+static inline uint32_t get_block_order( uint32_t count ) {
+    uint32_t order = 0;
+
+    while ( ( 1U << order ) < count ) {
+        order++;
+    }
 
-    page_count = memory_desc->size / PAGE_SIZE;
+    return order;
+}
 
-    /* First make sure this memory region is big enough for
-       the requested number of pages */
+static inline void free_list_insert( memory_type_desc_t* memory_desc, memory_page_t* page, uint32_t order ) {
+    memory_page_t** list = &memory_desc->free_lists[ order ];
 
-    if ( __unlikely( page_count < count ) ) {
-        return NULL;
+    page->flags |= PAGE_FREE_BLOCK;
+    page->order = order;
+    page->prev = NULL;
+    page->next = *list;
+
+    if ( *list != NULL ) {
+        ( *list )->prev = page;
     }
 
-    p = NULL;
-    found = false;
-    page = &memory_pages[ memory_desc->start / PAGE_SIZE ];
-    region_start = 0;
-    free_page_count = 0;
-
-    for ( i = 0; i < page_count; i++, page++ ) {
-        if ( page->ref_count == 0 ) {
-            if ( !found ) {
-                found = true;
-                region_start = i;
-                free_page_count = 1;
-            } else {
-                free_page_count++;
-            }
+    *list = page;
+}
 
-            if ( free_page_count == count ) {
-                uint32_t j;
-                memory_page_t* tmp;
+static inline void free_list_remove( memory_type_desc_t* memory_desc, memory_page_t* page ) {
+    ASSERT( page->flags & PAGE_FREE_BLOCK );
 
-                tmp = &memory_pages[ ( memory_desc->start / PAGE_SIZE ) + region_start ];
+    if ( page->prev == NULL ) {
+        memory_desc->free_lists[ page->order ] = page->next;
+    } else {
+        page->prev->next = page->next;
+    }
 
-                for ( j = 0; j < count; j++, tmp++ ) {
-                    tmp->ref_count = 1;
-                }
+    if ( page->next != NULL ) {
+        page->next->prev = page->prev;
+    }
 
-                p = ( void* )( memory_desc->start + ( region_start * PAGE_SIZE ) );
+    page->flags &= ~PAGE_FREE_BLOCK;
+    page->prev = NULL;
+    page->next = NULL;
+}
 
-                break;
-            }
+/* Gives a naturally aligned block of pages back to the free lists and
+   merges it with its buddies as long as they are free as well. */
+static void buddy_free_block( memory_type_desc_t* memory_desc, ptr_t index, uint32_t order ) {
+    ptr_t buddy;
+    ptr_t first_index;
+    ptr_t last_index;
+    memory_page_t* buddy_page;
+
+    first_index = PAGE_ALIGN( memory_desc->start ) / PAGE_SIZE;
+    last_index = ( memory_desc->start + memory_desc->size ) / PAGE_SIZE;
+
+    memory_desc->free_page_count += ( 1U << order );
+
+    while ( order < MAX_PAGE_ORDER - 1 ) {
+        buddy = index ^ ( 1U << order );
+
+        if ( ( buddy < first_index ) ||
+             ( buddy + ( 1U << order ) > last_index ) ) {
+            break;
+        }
+
+        buddy_page = &memory_pages[ buddy ];
+
+        if ( ( ( buddy_page->flags & PAGE_FREE_BLOCK ) == 0 ) ||
+             ( buddy_page->order != order ) ) {
+            break;
+        }
+
+        free_list_remove( memory_desc, buddy_page );
+
+        index &= ~( 1U << order );
+        order++;
+    }
+
+    free_list_insert( memory_desc, &memory_pages[ index ], order );
+}
+
+/* Splits the free pages in the [index, index + count) range to the biggest
+   naturally aligned blocks and puts them back to the free lists. */
+static void buddy_free_range( memory_type_desc_t* memory_desc, ptr_t index, uint32_t count ) {
+    uint32_t order;
+
+    while ( count > 0 ) {
+        order = 0;
+
+        while ( ( order < MAX_PAGE_ORDER - 1 ) &&
+                ( ( index & ( ( 2U << order ) - 1 ) ) == 0 ) &&
+                ( ( 2U << order ) <= count ) ) {
+            order++;
+        }
+
+        buddy_free_block( memory_desc, index, order );
+
+        index += ( 1U << order );
+        count -= ( 1U << order );
+    }
+}
+
+/* Takes the page at the specified index out of the free block containing
+   it. The rest of the block is split up and put back to the free lists. */
+static int buddy_remove_page( memory_type_desc_t* memory_desc, ptr_t index ) {
+    ptr_t head;
+    uint32_t order;
+    memory_page_t* page;
+
+    for ( order = 0; order < MAX_PAGE_ORDER; order++ ) {
+        head = index & ~( ( 1U << order ) - 1 );
+        page = &memory_pages[ head ];
+
+        if ( ( page->flags & PAGE_FREE_BLOCK ) &&
+             ( page->order >= order ) ) {
+            break;
+        }
+    }
+
+    if ( order == MAX_PAGE_ORDER ) {
+        return -EINVAL;
+    }
+
+    order = page->order;
+    free_list_remove( memory_desc, page );
+
+    while ( order > 0 ) {
+        order--;
+
+        if ( index < head + ( 1U << order ) ) {
+            free_list_insert( memory_desc, &memory_pages[ head + ( 1U << order ) ], order );
         } else {
-            found = false;
+            free_list_insert( memory_desc, &memory_pages[ head ], order );
+            head += ( 1U << order );
         }
     }
 
-    return p;
+    memory_desc->free_page_count--;
+
+    return 0;
 }
 
-void* alloc_pages( uint32_t count, int mem_type ) {
-    void* p;
-    memory_type_desc_t* memory_desc;
+/* Allocates a block of the specified order and gives back the pages
+   after the first count pages of it. */
+static void* buddy_alloc_block( memory_type_desc_t* memory_desc, uint32_t count, uint32_t order ) {
+    ptr_t index;
+    uint32_t i;
+    uint32_t current;
+    memory_page_t* page;
 
-    ASSERT( ( mem_type >= 0 ) && ( mem_type < MAX_MEMORY_TYPES ) );
+    for ( current = order; current < MAX_PAGE_ORDER; current++ ) {
+        if ( memory_desc->free_lists[ current ] != NULL ) {
+            break;
+        }
+    }
 
-    memory_desc = &memory_descriptors[ mem_type ];
+    if ( current == MAX_PAGE_ORDER ) {
+        return NULL;
+    }
 
-    ASSERT( !memory_desc->free );
+    page = memory_desc->free_lists[ current ];
+    index = page - memory_pages;
 
-    spinlock_disable( &pages_lock );
+    free_list_remove( memory_desc, page );
 
-    p = do_alloc_pages( memory_desc, count );
+    /* Split the block until we reach the requested order */
 
-    spinunlock_enable( &pages_lock );
+    while ( current > order ) {
+        current--;
+        free_list_insert( memory_desc, &memory_pages[ index + ( 1U << current ) ], current );
+    }
 
-    return p;
+    memory_desc->free_page_count -= ( 1U << order );
+
+    for ( i = 0; i < count; i++, page++ ) {
+        ASSERT( page->ref_count == 0 );
+        page->ref_count = 1;
+    }
+
+    if ( count < ( 1U << order ) ) {
+        buddy_free_range( memory_desc, index + count, ( 1U << order ) - count );
+    }
+
+    return ( void* )( index * PAGE_SIZE );
 }
 
-static void* do_alloc_pages_aligned( memory_type_desc_t* memory_desc, uint32_t count, uint32_t alignment ) {
+/* Fallback for requests that can't be served by a single buddy block
+   (too big or not power of two aligned). It scans the page array of the
+   memory type and carves the found pages out of the free lists. */
+static void* scan_alloc_pages( memory_type_desc_t* memory_desc, uint32_t count, uint32_t alignment ) {
     ptr_t i;
-    void* p;
     uint32_t j;
     ptr_t start;
-    memory_page_t* page;
     uint32_t step;
     ptr_t start_page;
     ptr_t end_page;
 
-    start = memory_desc->start;
-
-    if ( ( start % alignment ) != 0 ) {
-        start = ALIGN( start, alignment );
-    }
-
+    start = ALIGN( memory_desc->start, alignment );
     step = ALIGN( count * PAGE_SIZE, alignment ) / PAGE_SIZE;
-    start_page = ( start - memory_desc->start ) / PAGE_SIZE;
-    end_page = memory_desc->size / PAGE_SIZE;
+    start_page = start / PAGE_SIZE;
+    end_page = ( memory_desc->start + memory_desc->size ) / PAGE_SIZE;
 
-    p = NULL;
-    page = &memory_pages[ start / PAGE_SIZE ];
-
-    for ( i = start_page; i < end_page; i += step ) {
+    for ( i = start_page; i + count <= end_page; i += step ) {
         bool free = true;
 
         for ( j = 0; j < count; j++ ) {
@@ -163,25 +275,208 @@ static void* do_alloc_pages_aligned( memory_type_desc_t* memory_desc, uint32_t c
 
         if ( free ) {
             for ( j = 0; j < count; j++ ) {
+                buddy_remove_page( memory_desc, i + j );
                 memory_pages[ i + j ].ref_count = 1;
             }
 
-            p = ( void* )( memory_desc->start + ( i * PAGE_SIZE ) );
+            return ( void* )( i * PAGE_SIZE );
+        }
+    }
+
+    return NULL;
+}
+
+/* Moves at most count pages from the global allocator to the page cache.
+   The caller has to hold pages_lock. */
+static void page_cache_refill( page_cache_t* cache, memory_type_desc_t* memory_desc, uint32_t count ) {
+    void* p;
 
+    count = MIN( count, MAX_PAGE_CACHE_SIZE - cache->count );
+
+    while ( count-- > 0 ) {
+        p = buddy_alloc_block( memory_desc, 1, 0 );
+
+        if ( p == NULL ) {
             break;
         }
+
+        cache->pages[ cache->count++ ] = p;
+    }
+}
+
+/* Gives back the count least recently cached pages to the global
+   allocator. The caller has to hold pages_lock. */
+static void page_cache_drain( page_cache_t* cache, memory_type_desc_t* memory_desc, uint32_t count ) {
+    uint32_t i;
+    ptr_t index;
+
+    count = MIN( count, cache->count );
+
+    for ( i = 0; i < count; i++ ) {
+        index = ( ptr_t )cache->pages[ i ] / PAGE_SIZE;
+
+        ASSERT( memory_pages[ index ].ref_count == 1 );
+        memory_pages[ index ].ref_count = 0;
+
+        buddy_free_block( memory_desc, index, 0 );
+    }
+
+    cache->count -= count;
+
+    for ( i = 0; i < cache->count; i++ ) {
+        cache->pages[ i ] = cache->pages[ i + count ];
+    }
+}
+
+static void* page_cache_alloc( memory_type_desc_t* memory_desc ) {
+    bool ints;
+    void* p;
+    page_cache_t* cache;
+
+    ints = disable_interrupts();
+
+    cache = &get_processor()->page_cache;
+
+    if ( __likely( cache->count > 0 ) ) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+
+        spinlock( &pages_lock );
+        page_cache_refill( cache, memory_desc, page_cache_batch );
+        spinunlock( &pages_lock );
+    }
+
+    if ( cache->count > 0 ) {
+        p = cache->pages[ --cache->count ];
+    } else {
+        p = NULL;
+    }
+
+    if ( ints ) {
+        enable_interrupts();
     }
 
     return p;
 }
 
-void* alloc_pages_aligned( uint32_t count, int mem_type, uint32_t alignment ) {
+/* Puts an allocated page (with ref_count of 1) to the cache of the current
+   CPU. Interrupts have to be disabled by the caller. */
+static void page_cache_free( memory_type_desc_t* memory_desc, void* address, bool locked ) {
+    page_cache_t* cache;
+
+    cache = &get_processor()->page_cache;
+
+    if ( cache->count >= page_cache_high ) {
+        if ( !locked ) {
+            spinlock( &pages_lock );
+        }
+
+        page_cache_drain( cache, memory_desc, page_cache_batch );
+
+        if ( !locked ) {
+            spinunlock( &pages_lock );
+        }
+    }
+
+    cache->pages[ cache->count++ ] = address;
+}
+
+void* do_alloc_pages( memory_type_desc_t* memory_desc, uint32_t count ) {
+    uint32_t order;
+
+    if ( __unlikely( memory_desc->free_page_count < count ) ) {
+        return NULL;
+    }
+
+    order = get_block_order( count );
+
+    if ( __unlikely( order >= MAX_PAGE_ORDER ) ) {
+        return scan_alloc_pages( memory_desc, count, PAGE_SIZE );
+    }
+
+    return buddy_alloc_block( memory_desc, count, order );
+}
+
+void* alloc_pages( uint32_t count, int mem_type ) {
     void* p;
     memory_type_desc_t* memory_desc;
 
     ASSERT( ( mem_type >= 0 ) && ( mem_type < MAX_MEMORY_TYPES ) );
+
+    if ( __unlikely( ( mem_type < 0 ) || ( mem_type >= MAX_MEMORY_TYPES ) ) ) {
+        return NULL;
+    }
+
+    memory_desc = &memory_descriptors[ mem_type ];
+
+    ASSERT( !memory_desc->free );
+
+    if ( ( count == 1 ) &&
+         ( mem_type == MEM_COMMON ) &&
+         ( page_cache_enabled ) ) {
+        p = page_cache_alloc( memory_desc );
+
+        if ( __likely( p != NULL ) ) {
+            return p;
+        }
+    }
+
+    spinlock_disable( &pages_lock );
+
+    p = do_alloc_pages( memory_desc, count );
+
+    /* Pages sitting in the cache of the current CPU might
+       be enough to satisfy the request. */
+
+    if ( ( p == NULL ) && ( page_cache_enabled ) ) {
+        page_cache_t* cache = &get_processor()->page_cache;
+
+        page_cache_drain( cache, &memory_descriptors[ MEM_COMMON ], cache->count );
+        p = do_alloc_pages( memory_desc, count );
+    }
+
+    spinunlock_enable( &pages_lock );
+
+    return p;
+}
+
+static void* do_alloc_pages_aligned( memory_type_desc_t* memory_desc, uint32_t count, uint32_t alignment ) {
+    uint32_t order;
+    uint32_t alignment_pages;
+
+    if ( __unlikely( memory_desc->free_page_count < count ) ) {
+        return NULL;
+    }
+
+    /* Buddy blocks are naturally aligned to their size, so a power of two
+       alignment can be satisfied by allocating a big enough block. */
+
+    alignment_pages = alignment / PAGE_SIZE;
+
+    if ( ( alignment_pages & ( alignment_pages - 1 ) ) == 0 ) {
+        order = MAX( get_block_order( count ), get_block_order( alignment_pages ) );
+
+        if ( order < MAX_PAGE_ORDER ) {
+            return buddy_alloc_block( memory_desc, count, order );
+        }
+    }
+
+    return scan_alloc_pages( memory_desc, count, alignment );
+}
+
+void* alloc_pages_aligned( uint32_t count, int mem_type, uint32_t alignment ) {
+    void* p;
+    memory_type_desc_t* memory_desc;
+
     ASSERT( ( alignment % PAGE_SIZE ) == 0 );
 
+    ASSERT( ( mem_type >= 0 ) && ( mem_type < MAX_MEMORY_TYPES ) );
+
+    if ( __unlikely( ( mem_type < 0 ) || ( mem_type >= MAX_MEMORY_TYPES ) ) ) {
+        return NULL;
+    }
+
     memory_desc = &memory_descriptors[ mem_type ];
 
     ASSERT( !memory_desc->free );
@@ -216,6 +511,23 @@ void free_pages( void* address, uint32_t count ) {
 
     ASSERT( memory_desc != NULL );
 
+    if ( ( count == 1 ) &&
+         ( memory_desc == &memory_descriptors[ MEM_COMMON ] ) &&
+         ( page_cache_enabled ) ) {
+        bool ints;
+
+        ASSERT( tmp->ref_count == 1 );
+
+        ints = disable_interrupts();
+        page_cache_free( memory_desc, address, false );
+
+        if ( ints ) {
+            enable_interrupts();
+        }
+
+        return;
+    }
+
     spinlock_disable( &pages_lock );
 
     for ( i = 0; i < count; i++, tmp++ ) {
@@ -223,22 +535,87 @@ void free_pages( void* address, uint32_t count ) {
         tmp->ref_count = 0;
     }
 
+    buddy_free_range( memory_desc, region_start, count );
+
+    spinunlock_enable( &pages_lock );
+}
+
+void do_put_page( memory_page_t* page ) {
+    ptr_t index;
+    memory_type_desc_t* memory_desc;
+
+    ASSERT( page->ref_count > 0 );
+
+    if ( --page->ref_count > 0 ) {
+        return;
+    }
+
+    index = page - memory_pages;
+    memory_desc = get_memory_descriptor( index * PAGE_SIZE );
+
+    if ( memory_desc == NULL ) {
+        return;
+    }
+
+    if ( ( memory_desc == &memory_descriptors[ MEM_COMMON ] ) &&
+         ( page_cache_enabled ) ) {
+        page->ref_count = 1;
+        page_cache_free( memory_desc, ( void* )( index * PAGE_SIZE ), true );
+    } else {
+        buddy_free_block( memory_desc, index, 0 );
+    }
+}
+
+void do_put_page_deferred( memory_page_t* page, memory_page_t** list ) {
+    ASSERT( page->ref_count > 0 );
+
+    if ( page->ref_count > 1 ) {
+        page->ref_count--;
+        return;
+    }
+
+    /* The last reference is kept until the list is freed, the
+       list links of the page are only used while it is free. */
+
+    page->next = *list;
+    *list = page;
+}
+
+void put_page_list( memory_page_t* list ) {
+    memory_page_t* next;
+
+    if ( list == NULL ) {
+        return;
+    }
+
+    spinlock_disable( &pages_lock );
+
+    for ( ; list != NULL; list = next ) {
+        next = list->next;
+        list->next = NULL;
+
+        do_put_page( list );
+    }
+
     spinunlock_enable( &pages_lock );
 }
 
 uint32_t get_free_page_count( void ) {
-    uint32_t i;
+    int i;
     uint32_t count = 0;
-    memory_page_t* page;
 
     spinlock_disable( &pages_lock );
 
-    for ( i = 0, page = memory_pages; i < ( memory_size / PAGE_SIZE ); i++, page++ ) {
-        if ( page->ref_count == 0 ) {
-            count++;
+    for ( i = 0; i < MAX_MEMORY_TYPES; i++ ) {
+        if ( !memory_descriptors[ i ].free ) {
+            count += memory_descriptors[ i ].free_page_count;
         }
     }
 
+    for ( i = 0; i < MAX_CPU_COUNT; i++ ) {
+        count += processor_table[ i ].page_cache.count;
+    }
+
     spinunlock_enable( &pages_lock );
 
     return count;
@@ -249,18 +626,53 @@ uint32_t get_total_page_count( void ) {
 }
 
 int sys_get_memory_info( memory_info_t* info ) {
+    int i;
+    kmalloc_statistics_t kmalloc_stats;
+    file_cache_statistics_t file_cache_stats;
+    region_fault_statistics_t fault_stats;
+
     info->free_page_count = get_free_page_count();
     info->total_page_count = get_total_page_count();
 
-    kmalloc_get_statistics(
-        &info->kmalloc_used_pages,
-        &info->kmalloc_alloc_size
-    );
+    kmalloc_get_statistics( &kmalloc_stats );
+
+    info->kmalloc_used_pages = kmalloc_stats.used_pages;
+    info->kmalloc_alloc_size = kmalloc_stats.alloc_size;
+    info->kmalloc_cached_objects = kmalloc_stats.cached_objects;
+    info->kmalloc_magazine_hits = kmalloc_stats.magazine_hits;
+    info->kmalloc_magazine_misses = kmalloc_stats.magazine_misses;
+    info->kmalloc_magazine_flushes = kmalloc_stats.magazine_flushes;
+
+    info->page_cache_pages = 0;
+    info->page_cache_hits = 0;
+    info->page_cache_misses = 0;
+
+    for ( i = 0; i < MAX_CPU_COUNT; i++ ) {
+        page_cache_t* cache = &processor_table[ i ].page_cache;
+
+        info->page_cache_pages += cache->count;
+        info->page_cache_hits += cache->hits;
+        info->page_cache_misses += cache->misses;
+    }
+
+    file_cache_get_statistics( &file_cache_stats );
+
+    info->file_cache_pages = file_cache_stats.page_count;
+    info->file_cache_hits = file_cache_stats.hits;
+    info->file_cache_misses = file_cache_stats.misses;
+    info->file_cache_evictions = file_cache_stats.evictions;
+
+    memory_region_get_fault_statistics( &fault_stats );
+
+    info->file_map_faults = fault_stats.faults;
+    info->file_map_sequential_faults = fault_stats.sequential_faults;
+    info->file_map_pages = fault_stats.pages;
 
     return 0;
 }
 
 int reserve_memory_pages( ptr_t start, ptr_t size ) {
+    int error;
     ptr_t i;
     ptr_t count;
     memory_page_t* page;
@@ -270,23 +682,39 @@ int reserve_memory_pages( ptr_t start, ptr_t size ) {
     ASSERT( ( size % PAGE_SIZE ) == 0 );
     ASSERT( ( start + size ) <= memory_size );
 
+    error = 0;
     count = size / PAGE_SIZE;
     page = &memory_pages[ start / PAGE_SIZE ];
-    memory_desc = get_memory_descriptor( start );
-
-    ASSERT( memory_desc != NULL );
-    ASSERT( ( start - memory_desc->start + size ) <= memory_desc->size );
 
     for ( i = 0; i < count; i++, page++ ) {
-        if ( page->ref_count == 0 ) {
-            page->ref_count++;
+        if ( page->ref_count != 0 ) {
+            continue;
+        }
+
+        /* Pages outside of the registered memory types are not
+           on the free lists, they only have to be marked as used.
+           A free page of a memory type missing from the free lists
+           means broken allocator state. It is still marked as used
+           to keep it away from the allocator. */
+
+        memory_desc = get_memory_descriptor( start + i * PAGE_SIZE );
+
+        if ( ( memory_desc != NULL ) &&
+             ( buddy_remove_page( memory_desc, start / PAGE_SIZE + i ) != 0 ) ) {
+            kprintf( WARNING, "reserve_memory_pages(): Page %x is not on the free lists!\n", start + i * PAGE_SIZE );
+            error = -EINVAL;
         }
+
+        page->ref_count++;
     }
 
-    return 0;
+    return error;
 }
 
 __init int register_memory_type( int mem_type, ptr_t start, ptr_t size ) {
+    ptr_t i;
+    ptr_t first_index;
+    ptr_t last_index;
     memory_type_desc_t* memory_desc;
 
     if ( ( mem_type < 0 ) || ( mem_type >= MAX_MEMORY_TYPES ) ) {
@@ -302,6 +730,22 @@ __init int register_memory_type( int mem_type, ptr_t start, ptr_t size ) {
     memory_desc->free = false;
     memory_desc->start = start;
     memory_desc->size = size;
+    memory_desc->free_page_count = 0;
+
+    for ( i = 0; i < MAX_PAGE_ORDER; i++ ) {
+        memory_desc->free_lists[ i ] = NULL;
+    }
+
+    /* Build the free lists from the currently unused pages */
+
+    first_index = PAGE_ALIGN( start ) / PAGE_SIZE;
+    last_index = ( start + size ) / PAGE_SIZE;
+
+    for ( i = first_index; i < last_index; i++ ) {
+        if ( memory_pages[ i ].ref_count == 0 ) {
+            buddy_free_block( memory_desc, i, 0 );
+        }
+    }
 
     return 0;
 }
@@ -340,3 +784,23 @@ __init int init_page_allocator_late( void ) {
 
     return 0;
 }
+
+__init int init_page_caches( void ) {
+    int value;
+
+    /* The watermarks of the per-CPU page caches can be tuned
+       with kernel parameters. */
+
+    if ( get_kernel_param_as_int( "page_cache_high", &value ) == 0 ) {
+        page_cache_high = MAX( 1, MIN( value, MAX_PAGE_CACHE_SIZE ) );
+    }
+
+    if ( get_kernel_param_as_int( "page_cache_batch", &value ) == 0 ) {
+        page_cache_batch = MAX( 1, value );
+    }
+
+    page_cache_batch = MIN( page_cache_batch, page_cache_high );
+    page_cache_enabled = true;
+
+    return 0;
+}
@@ -29,6 +29,7 @@
 #include <sched/scheduler.h>
 #include <lib/string.h>
 
+#include <arch/spinlock.h>
 #include <arch/mm/region.h>
 
 lock_id region_lock;
@@ -36,6 +37,9 @@ hashtable_t region_table;
 
 static int region_id_counter = 0;
 
+static region_fault_statistics_t fault_stats;
+static spinlock_t fault_stats_lock = INIT_SPINLOCK( "region fault statistics" );
+
 memory_region_t* memory_region_allocate( memory_context_t* context, const char* name,
                                          ptr_t address, uint64_t size, uint32_t flags ) {
     size_t name_length;
@@ -78,6 +82,91 @@ void memory_region_destroy( memory_region_t* region ) {
     kfree( region );
 }
 
+void memory_region_account_pages( memory_region_t* region, int count ) {
+    process_t* process;
+
+    region->rss += count;
+    process = region->context->process;
+
+    if ( process != NULL ) {
+        scheduler_lock();
+        process->pmem_size += ( int64_t )count * PAGE_SIZE;
+        scheduler_unlock();
+    }
+}
+
+uint32_t memory_region_readahead( memory_region_t* region, uint32_t index, uint32_t* first ) {
+    bool sequential;
+    uint32_t start;
+    uint32_t window;
+    uint32_t page_count;
+
+    page_count = PAGE_ALIGN( region->size ) / PAGE_SIZE;
+
+    ASSERT( index < page_count );
+
+    /* A fault in the window following the previously loaded one means
+       that the region is read sequentially, the window is doubled then.
+       Otherwise only the aligned minimal window around the page is
+       loaded to map the neighbours that are likely used together. */
+
+    sequential = ( ( region->ra_window > 0 ) &&
+                   ( index >= region->ra_next ) &&
+                   ( index < region->ra_next + region->ra_window ) );
+
+    if ( sequential ) {
+        start = index;
+        window = MIN( region->ra_window * 2, REGION_RA_MAX_PAGES );
+    } else {
+        start = index - ( index % REGION_RA_MIN_PAGES );
+        window = REGION_RA_MIN_PAGES;
+    }
+
+    window = MIN( window, page_count - start );
+
+    region->ra_next = start + window;
+    region->ra_window = window;
+    region->file_faults++;
+
+    spinlock_disable( &fault_stats_lock );
+
+    fault_stats.faults++;
+
+    if ( sequential ) {
+        fault_stats.sequential_faults++;
+    }
+
+    spinunlock_enable( &fault_stats_lock );
+
+    *first = start;
+
+    return window;
+}
+
+void memory_region_account_file_fault( memory_region_t* region, uint32_t count ) {
+    region->file_fault_pages += count;
+
+    spinlock_disable( &fault_stats_lock );
+    fault_stats.pages += count;
+    spinunlock_enable( &fault_stats_lock );
+}
+
+void memory_region_get_fault_statistics( region_fault_statistics_t* stats ) {
+    spinlock_disable( &fault_stats_lock );
+    memcpy( stats, &fault_stats, sizeof( region_fault_statistics_t ) );
+    spinunlock_enable( &fault_stats_lock );
+}
+
+static void memory_region_unmap_pages( memory_region_t* region, ptr_t address, uint64_t size ) {
+    int count;
+
+    count = arch_memory_region_unmap_pages( region, address, size );
+
+    if ( count > 0 ) {
+        memory_region_account_pages( region, -count );
+    }
+}
+
 static int memory_region_insert_global( memory_region_t* region ) {
     int error;
 
@@ -127,7 +216,7 @@ int do_memory_region_put( memory_region_t* region ) {
         memory_context_remove_region( context, region );
     }
 
-    arch_memory_region_unmap_pages( region, region->address, region->size );
+    memory_region_unmap_pages( region, region->address, region->size );
     memory_region_destroy( region );
 
     return 0;
@@ -158,7 +247,7 @@ static int do_memory_region_put_times( memory_region_t* region, int times ) {
 
         mutex_lock( context->mutex, LOCK_IGNORE_SIGNAL );
         memory_context_remove_region( context, region );
-        arch_memory_region_unmap_pages( region, region->address, region->size );
+        memory_region_unmap_pages( region, region->address, region->size );
         mutex_unlock( context->mutex );
 
         memory_region_destroy( region );
@@ -192,7 +281,15 @@ memory_region_t* do_create_memory_region( memory_context_t* context, const char*
         end = LAST_USER_ADDRESS;
     }
 
-    if ( !memory_context_find_unmapped_region( context, start, end, size, &address ) ) {
+    /* Try to find an aligned address for big regions first. The gap
+       found has to be bigger to make sure that the aligned address
+       still has enough space after it. */
+
+    if ( ( size >= REGION_LARGE_ALIGN ) &&
+         ( size <= 0xFFFFFFFF - REGION_LARGE_ALIGN ) &&
+         ( memory_context_find_unmapped_region( context, start, end, size + REGION_LARGE_ALIGN - PAGE_SIZE, &address ) ) ) {
+        address = ( address + REGION_LARGE_ALIGN - 1 ) & ~( REGION_LARGE_ALIGN - 1 );
+    } else if ( !memory_context_find_unmapped_region( context, start, end, size, &address ) ) {
         return NULL;
     }
 
@@ -217,6 +314,10 @@ memory_region_t* memory_region_create( const char* name, uint64_t size, uint32_t
     flags &= REGION_USER_FLAGS;
 
     if ( flags & REGION_KERNEL ) {
+        /* Kernel regions can be accessed with interrupts disabled,
+           their pages are always allocated up front. */
+
+        flags &= ~REGION_LAZY;
         context = &kernel_memory_context;
     } else {
         context = current_process()->memory_context;
@@ -281,6 +382,10 @@ int do_memory_region_alloc_pages( memory_region_t* region ) {
 
     if ( error == 0 ) {
         region->flags |= REGION_ALLOCATED;
+
+        if ( ( region->flags & REGION_LAZY ) == 0 ) {
+            memory_region_account_pages( region, region->size / PAGE_SIZE );
+        }
     }
 
     return error;
@@ -348,18 +453,26 @@ int memory_region_resize( memory_region_t* region, uint64_t new_size ) {
     mutex_lock( context->mutex, LOCK_IGNORE_SIGNAL );
 
     if ( new_size < region->size ) {
-        arch_memory_region_unmap_pages( region, region->address + new_size, region->size - new_size );
+        memory_region_unmap_pages( region, region->address + new_size, region->size - new_size );
         region->size = new_size;
+        memory_context_update_region( context, region );
     } else if ( new_size > region->size ) {
         if ( memory_context_can_resize_region( context, region, new_size ) ) {
             switch ( region->flags & REGION_MAPPING_FLAGS ) {
                 case REGION_ALLOCATED :
                     ret = arch_memory_region_alloc_pages( region, region->address + region->size, new_size - region->size );
+
+                    if ( ( ret == 0 ) &&
+                         ( ( region->flags & REGION_LAZY ) == 0 ) ) {
+                        memory_region_account_pages( region, ( new_size - region->size ) / PAGE_SIZE );
+                    }
+
                     break;
             }
 
             if ( ret == 0 ) {
                 region->size = new_size;
+                memory_context_update_region( context, region );
             }
         } else {
             ret = -ENOSPC;
@@ -453,7 +566,11 @@ int sys_memory_region_clone_pages( region_id id, void** address ) {
         return -EINVAL;
     }
 
-    if ( ( old_region->flags & REGION_MAPPING_FLAGS ) != REGION_ALLOCATED ) {
+    /* The pages of lazy regions are allocated one-by-one on the first
+       access, they could not be shared with the new region. */
+
+    if ( ( ( old_region->flags & REGION_MAPPING_FLAGS ) != REGION_ALLOCATED ) ||
+         ( old_region->flags & REGION_LAZY ) ) {
         error = -EINVAL;
         goto out;
     }
@@ -470,6 +587,10 @@ int sys_memory_region_clone_pages( region_id id, void** address ) {
     new_region->flags |= REGION_CLONED;
     error = arch_memory_region_clone_pages( old_region, new_region );
 
+    if ( error == 0 ) {
+        memory_region_account_pages( new_region, old_region->rss );
+    }
+
     mutex_unlock( new_region->context->mutex );
 
     if ( error != 0 ) {
@@ -502,6 +623,7 @@ void memory_region_dump( memory_region_t* region, int index ) {
     if ( region->flags & REGION_READ ) { kprintf( INFO, "r" ); } else { kprintf( INFO, "-" ); }
     if ( region->flags & REGION_WRITE ) { kprintf( INFO, "w" ); } else { kprintf( INFO, "-" ); }
     if ( region->flags & REGION_STACK ) { kprintf( INFO, "S" ); } else { kprintf( INFO, "-" ); }
+    if ( region->flags & REGION_LAZY ) { kprintf( INFO, "L" ); } else { kprintf( INFO, "-" ); }
 
     uint32_t mapping_flags = region->flags & REGION_MAPPING_FLAGS;
 
@@ -512,7 +634,16 @@ void memory_region_dump( memory_region_t* region, int index ) {
         default : kprintf( INFO, "?" ); break;
     }
 
-    kprintf( INFO, " %s\n", region->name );
+    kprintf( INFO, " %6u/%-6u %s", region->rss, ( uint32_t )( region->size / PAGE_SIZE ), region->name );
+
+    if ( region->file_faults > 0 ) {
+        kprintf(
+            INFO, " (%u faults, %u pages/fault)",
+            region->file_faults, region->file_fault_pages / region->file_faults
+        );
+    }
+
+    kprintf( INFO, "\n" );
 }
 
 static void* region_key( hashitem_t* item ) {
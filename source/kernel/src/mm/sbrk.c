@@ -68,7 +68,7 @@ void* sys_sbrk( int increment ) {
         if ( process->heap_region == NULL ) {
             process->heap_region = memory_region_create(
                 "heap", increment,
-                REGION_READ | REGION_WRITE
+                REGION_READ | REGION_WRITE | REGION_LAZY
             );
 
             if ( process->heap_region != NULL ) {
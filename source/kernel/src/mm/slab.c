@@ -0,0 +1,541 @@
+/* Slab allocator
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <types.h>
+#include <errno.h>
+#include <kernel.h>
+#include <macros.h>
+#include <bitops.h>
+#include <smp.h>
+#include <mm/slab.h>
+#include <mm/pages.h>
+#include <mm/kmalloc.h>
+#include <lib/string.h>
+
+#include <arch/interrupt.h>
+#include <arch/mm/config.h>
+
+/* The number of objects that a slab should hold at least. Slabs of
+   caches with big objects are made of more pages to reach this. */
+#define KMEM_SLAB_MIN_OBJECTS 8
+
+#define KMEM_SLAB_HEADER_SIZE ALIGN( sizeof( kmem_slab_t ), KMEM_OBJECT_ALIGN )
+
+static kmem_cache_t* cache_list = NULL;
+static spinlock_t cache_list_lock = INIT_SPINLOCK( "kmem cache list" );
+
+static bool magazines_enabled = false;
+
+static inline void slab_list_add( kmem_slab_t** list, kmem_slab_t* slab ) {
+    slab->prev = NULL;
+    slab->next = *list;
+
+    if ( *list != NULL ) {
+        ( *list )->prev = slab;
+    }
+
+    *list = slab;
+}
+
+static inline void slab_list_remove( kmem_slab_t** list, kmem_slab_t* slab ) {
+    if ( slab->prev == NULL ) {
+        *list = slab->next;
+    } else {
+        slab->prev->next = slab->next;
+    }
+
+    if ( slab->next != NULL ) {
+        slab->next->prev = slab->prev;
+    }
+
+    slab->prev = NULL;
+    slab->next = NULL;
+}
+
+static kmem_slab_t* kmem_slab_create( kmem_cache_t* cache ) {
+    uint32_t i;
+    kmem_slab_t* slab;
+    memory_page_t* page;
+
+    slab = ( kmem_slab_t* )alloc_pages( cache->slab_pages, MEM_COMMON );
+
+    if ( __unlikely( slab == NULL ) ) {
+        return NULL;
+    }
+
+    slab->magic = KMEM_SLAB_MAGIC;
+    slab->cache = cache;
+    slab->prev = NULL;
+    slab->next = NULL;
+    slab->objects = ( uint8_t* )slab + cache->objects_offset;
+
+    if ( cache->flags & KMEM_CACHE_TAGGED ) {
+        slab->tags = ( uint16_t* )( ( uint8_t* )slab + KMEM_SLAB_HEADER_SIZE );
+    } else {
+        slab->tags = NULL;
+    }
+
+    slab->free_count = cache->objects_per_slab;
+
+    memset( slab->bitmap, 0, sizeof( slab->bitmap ) );
+
+    for ( i = 0; i < cache->objects_per_slab / 32; i++ ) {
+        slab->bitmap[ i ] = 0xFFFFFFFF;
+    }
+
+    if ( ( cache->objects_per_slab % 32 ) != 0 ) {
+        slab->bitmap[ i ] = ( 1U << ( cache->objects_per_slab % 32 ) ) - 1;
+    }
+
+    /* Tell the page allocator which slab the pages belong to */
+
+    page = &memory_pages[ ( ptr_t )slab / PAGE_SIZE ];
+
+    for ( i = 0; i < cache->slab_pages; i++, page++ ) {
+        page->flags |= PAGE_SLAB;
+        page->owner = ( void* )slab;
+    }
+
+    cache->slab_count++;
+
+    return slab;
+}
+
+static void kmem_slab_destroy( kmem_cache_t* cache, kmem_slab_t* slab ) {
+    uint32_t i;
+    memory_page_t* page;
+
+    ASSERT( slab->free_count == cache->objects_per_slab );
+
+    page = &memory_pages[ ( ptr_t )slab / PAGE_SIZE ];
+
+    for ( i = 0; i < cache->slab_pages; i++, page++ ) {
+        page->flags &= ~PAGE_SLAB;
+        page->owner = NULL;
+    }
+
+    slab->magic = 0;
+    cache->slab_count--;
+
+    free_pages( ( void* )slab, cache->slab_pages );
+}
+
+kmem_slab_t* kmem_get_slab( void* p ) {
+    memory_page_t* page;
+
+    if ( __unlikely( ( ptr_t )p >= memory_size ) ) {
+        return NULL;
+    }
+
+    page = &memory_pages[ ( ptr_t )p / PAGE_SIZE ];
+
+    if ( ( page->flags & PAGE_SLAB ) == 0 ) {
+        return NULL;
+    }
+
+    return ( kmem_slab_t* )page->owner;
+}
+
+/* Takes a free object from the slabs of the cache. The
+   cache has to be locked by the caller. */
+static void* kmem_slab_alloc_object( kmem_cache_t* cache ) {
+    uint32_t i;
+    uint32_t index;
+    kmem_slab_t* slab;
+
+    slab = cache->partial_slabs;
+
+    if ( __unlikely( slab == NULL ) ) {
+        if ( cache->empty_slab != NULL ) {
+            slab = cache->empty_slab;
+            cache->empty_slab = NULL;
+        } else {
+            slab = kmem_slab_create( cache );
+
+            if ( __unlikely( slab == NULL ) ) {
+                return NULL;
+            }
+        }
+
+        slab_list_add( &cache->partial_slabs, slab );
+    }
+
+    /* Find a free object in the bitmap of the slab */
+
+    for ( i = 0; slab->bitmap[ i ] == 0; i++ ) {
+        ASSERT( i < ( KMEM_SLAB_MAX_OBJECTS / 32 ) - 1 );
+    }
+
+    index = find_first_set_bit( slab->bitmap[ i ] );
+    slab->bitmap[ i ] &= ~( 1U << index );
+    index += i * 32;
+
+    if ( --slab->free_count == 0 ) {
+        slab_list_remove( &cache->partial_slabs, slab );
+        slab_list_add( &cache->full_slabs, slab );
+    }
+
+    cache->object_count++;
+
+    return ( void* )( slab->objects + index * cache->object_size );
+}
+
+/* Gives back an object to its slab. The cache has to be
+   locked by the caller. */
+static void kmem_slab_free_object( kmem_cache_t* cache, void* p ) {
+    uint32_t index;
+    kmem_slab_t* slab;
+
+    slab = kmem_get_slab( p );
+    index = ( ( uint8_t* )p - slab->objects ) / cache->object_size;
+
+    if ( __unlikely( slab->bitmap[ index / 32 ] & ( 1U << ( index % 32 ) ) ) ) {
+        panic( "kmem_cache_free(): Tried to free a non-allocated object! (%x)\n", p );
+    }
+
+    slab->bitmap[ index / 32 ] |= ( 1U << ( index % 32 ) );
+
+    if ( slab->free_count++ == 0 ) {
+        slab_list_remove( &cache->full_slabs, slab );
+        slab_list_add( &cache->partial_slabs, slab );
+    }
+
+    /* Keep one empty slab around, give back the rest to the page allocator */
+
+    if ( slab->free_count == cache->objects_per_slab ) {
+        slab_list_remove( &cache->partial_slabs, slab );
+
+        if ( cache->empty_slab == NULL ) {
+            cache->empty_slab = slab;
+        } else {
+            kmem_slab_destroy( cache, slab );
+        }
+    }
+
+    cache->object_count--;
+}
+
+/* Gives back the oldest objects of a magazine to the slabs. The
+   cache has to be locked by the caller. */
+static void kmem_magazine_flush( kmem_cache_t* cache, kmem_magazine_t* magazine, uint32_t count ) {
+    uint32_t i;
+
+    count = MIN( count, magazine->count );
+
+    for ( i = 0; i < count; i++ ) {
+        kmem_slab_free_object( cache, magazine->objects[ i ] );
+    }
+
+    magazine->count -= count;
+
+    for ( i = 0; i < magazine->count; i++ ) {
+        magazine->objects[ i ] = magazine->objects[ i + count ];
+    }
+}
+
+void kmem_set_tag( kmem_slab_t* slab, void* p, uint16_t tag ) {
+    ASSERT( slab->tags != NULL );
+
+    slab->tags[ ( ( uint8_t* )p - slab->objects ) / slab->cache->object_size ] = tag;
+}
+
+uint16_t kmem_get_tag( kmem_slab_t* slab, void* p ) {
+    ASSERT( slab->tags != NULL );
+
+    return slab->tags[ ( ( uint8_t* )p - slab->objects ) / slab->cache->object_size ];
+}
+
+int kmem_get_processor_index( void ) {
+    if ( __unlikely( !magazines_enabled ) ) {
+        return 0;
+    }
+
+    return get_processor_index();
+}
+
+void* kmem_cache_alloc( kmem_cache_t* cache ) {
+    bool ints;
+    void* p;
+    kmem_magazine_t* magazine;
+
+    if ( __unlikely( !magazines_enabled ) ) {
+        spinlock_disable( &cache->lock );
+        p = kmem_slab_alloc_object( cache );
+        spinunlock_enable( &cache->lock );
+
+        return p;
+    }
+
+    ints = disable_interrupts();
+
+    magazine = &cache->magazines[ get_processor_index() ];
+
+    if ( __likely( magazine->count > 0 ) ) {
+        magazine->hits++;
+    } else {
+        magazine->misses++;
+
+        /* Refill the magazine from the slabs */
+
+        spinlock( &cache->lock );
+
+        while ( magazine->count < KMEM_MAGAZINE_BATCH ) {
+            p = kmem_slab_alloc_object( cache );
+
+            if ( __unlikely( p == NULL ) ) {
+                break;
+            }
+
+            magazine->objects[ magazine->count++ ] = p;
+        }
+
+        spinunlock( &cache->lock );
+    }
+
+    if ( __likely( magazine->count > 0 ) ) {
+        p = magazine->objects[ --magazine->count ];
+    } else {
+        p = NULL;
+    }
+
+    if ( ints ) {
+        enable_interrupts();
+    }
+
+    return p;
+}
+
+void kmem_cache_free( kmem_cache_t* cache, void* p ) {
+    bool ints;
+    uint32_t offset;
+    kmem_slab_t* slab;
+    kmem_magazine_t* magazine;
+
+    if ( __unlikely( p == NULL ) ) {
+        return;
+    }
+
+    slab = kmem_get_slab( p );
+
+    if ( __unlikely( ( slab == NULL ) ||
+                     ( slab->magic != KMEM_SLAB_MAGIC ) ||
+                     ( slab->cache != cache ) ) ) {
+        panic( "kmem_cache_free(): Tried to free an invalid object! (%x)\n", p );
+    }
+
+    offset = ( uint8_t* )p - slab->objects;
+
+    if ( __unlikely( ( ( offset % cache->object_size ) != 0 ) ||
+                     ( ( offset / cache->object_size ) >= cache->objects_per_slab ) ) ) {
+        panic( "kmem_cache_free(): Tried to free an invalid object! (%x)\n", p );
+    }
+
+    if ( __unlikely( !magazines_enabled ) ) {
+        spinlock_disable( &cache->lock );
+        kmem_slab_free_object( cache, p );
+        spinunlock_enable( &cache->lock );
+
+        return;
+    }
+
+    /* The object is put to the magazine of the current CPU even if it was
+       allocated on an other one, full magazines give back a batch of the
+       oldest objects to the slabs under a single lock. */
+
+    ints = disable_interrupts();
+
+    magazine = &cache->magazines[ get_processor_index() ];
+
+    if ( magazine->count == KMEM_MAGAZINE_SIZE ) {
+        magazine->flushes++;
+
+        spinlock( &cache->lock );
+        kmem_magazine_flush( cache, magazine, KMEM_MAGAZINE_BATCH );
+        spinunlock( &cache->lock );
+    }
+
+    magazine->objects[ magazine->count++ ] = p;
+
+    if ( ints ) {
+        enable_interrupts();
+    }
+}
+
+static uint32_t kmem_slab_object_count( uint32_t slab_pages, uint32_t object_size, uint32_t tag_size ) {
+    uint32_t count;
+    uint32_t available;
+
+    available = slab_pages * PAGE_SIZE - KMEM_SLAB_HEADER_SIZE;
+    count = available / ( object_size + tag_size );
+
+    /* The tag array is padded to keep the objects aligned */
+
+    while ( ( count > 0 ) &&
+            ( ALIGN( count * tag_size, KMEM_OBJECT_ALIGN ) + count * object_size > available ) ) {
+        count--;
+    }
+
+    return MIN( count, KMEM_SLAB_MAX_OBJECTS );
+}
+
+int kmem_cache_init( kmem_cache_t* cache, const char* name, uint32_t object_size, uint32_t flags ) {
+    uint32_t tag_size;
+    uint32_t slab_pages;
+    uint32_t object_count;
+
+    if ( object_size == 0 ) {
+        return -EINVAL;
+    }
+
+    object_size = ALIGN( object_size, KMEM_OBJECT_ALIGN );
+    tag_size = ( flags & KMEM_CACHE_TAGGED ) ? sizeof( uint16_t ) : 0;
+
+    /* Calculate the size of the slabs */
+
+    slab_pages = 1;
+
+    while ( kmem_slab_object_count( slab_pages, object_size, tag_size ) < KMEM_SLAB_MIN_OBJECTS ) {
+        slab_pages *= 2;
+    }
+
+    object_count = kmem_slab_object_count( slab_pages, object_size, tag_size );
+
+    memset( cache, 0, sizeof( kmem_cache_t ) );
+
+    cache->name = name;
+    cache->flags = flags;
+    cache->object_size = object_size;
+    cache->objects_offset = KMEM_SLAB_HEADER_SIZE + ALIGN( object_count * tag_size, KMEM_OBJECT_ALIGN );
+    cache->slab_pages = slab_pages;
+    cache->objects_per_slab = object_count;
+
+    init_spinlock( &cache->lock, name );
+
+    /* Link the cache to the global list */
+
+    spinlock_disable( &cache_list_lock );
+
+    cache->next = cache_list;
+    cache_list = cache;
+
+    spinunlock_enable( &cache_list_lock );
+
+    return 0;
+}
+
+kmem_cache_t* kmem_cache_create( const char* name, uint32_t object_size ) {
+    kmem_cache_t* cache;
+
+    cache = ( kmem_cache_t* )kmalloc( sizeof( kmem_cache_t ) );
+
+    if ( cache == NULL ) {
+        return NULL;
+    }
+
+    if ( kmem_cache_init( cache, name, object_size, 0 ) != 0 ) {
+        kfree( cache );
+        return NULL;
+    }
+
+    return cache;
+}
+
+void kmem_cache_destroy( kmem_cache_t* cache ) {
+    int i;
+    kmem_cache_t* tmp;
+
+    /* Unlink the cache from the global list */
+
+    spinlock_disable( &cache_list_lock );
+
+    if ( cache_list == cache ) {
+        cache_list = cache->next;
+    } else {
+        for ( tmp = cache_list; tmp->next != cache; tmp = tmp->next ) {
+            ASSERT( tmp->next != NULL );
+        }
+
+        tmp->next = cache->next;
+    }
+
+    spinunlock_enable( &cache_list_lock );
+
+    /* Give back the cached objects of all CPUs */
+
+    spinlock_disable( &cache->lock );
+
+    for ( i = 0; i < MAX_CPU_COUNT; i++ ) {
+        kmem_magazine_flush( cache, &cache->magazines[ i ], KMEM_MAGAZINE_SIZE );
+    }
+
+    spinunlock_enable( &cache->lock );
+
+    ASSERT( cache->object_count == 0 );
+    ASSERT( cache->partial_slabs == NULL );
+    ASSERT( cache->full_slabs == NULL );
+
+    if ( cache->empty_slab != NULL ) {
+        kmem_slab_destroy( cache, cache->empty_slab );
+    }
+
+    kfree( cache );
+}
+
+void kmem_get_statistics( uint32_t* used_pages, uint32_t* alloc_size, kmem_magazine_t* magazine ) {
+    int i;
+    uint32_t cached;
+    kmem_cache_t* cache;
+    kmem_magazine_t* tmp;
+
+    *used_pages = 0;
+    *alloc_size = 0;
+
+    magazine->count = 0;
+    magazine->hits = 0;
+    magazine->misses = 0;
+    magazine->flushes = 0;
+
+    spinlock_disable( &cache_list_lock );
+
+    for ( cache = cache_list; cache != NULL; cache = cache->next ) {
+        cached = 0;
+
+        for ( i = 0; i < MAX_CPU_COUNT; i++ ) {
+            tmp = &cache->magazines[ i ];
+
+            cached += tmp->count;
+            magazine->hits += tmp->hits;
+            magazine->misses += tmp->misses;
+            magazine->flushes += tmp->flushes;
+        }
+
+        /* Objects in the magazines are not allocated */
+
+        *used_pages += cache->slab_count * cache->slab_pages;
+        *alloc_size += ( cache->object_count - cached ) * cache->object_size;
+        magazine->count += cached;
+    }
+
+    spinunlock_enable( &cache_list_lock );
+}
+
+__init int init_kmem_magazines( void ) {
+    magazines_enabled = true;
+
+    return 0;
+}
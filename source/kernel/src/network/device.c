@@ -23,6 +23,7 @@
 #include <ioctl.h>
 #include <errno.h>
 #include <console.h>
+#include <smp.h>
 #include <mm/kmalloc.h>
 #include <network/device.h>
 #include <network/interface.h>
@@ -34,6 +35,7 @@
 static uint32_t device_id;
 static lock_id device_lock;
 static array_t device_table;
+static int next_rx_cpu = 0;
 
 net_device_t* net_device_create( size_t priv_size ) {
     net_device_t* device;
@@ -301,6 +303,22 @@ static int network_rx_thread( void* data ) {
     return 0;
 }
 
+static int get_next_rx_cpu( void ) {
+    int i;
+    int cpu;
+
+    for ( i = 0; i < MAX_CPU_COUNT; i++ ) {
+        cpu = next_rx_cpu;
+        next_rx_cpu = ( next_rx_cpu + 1 ) % MAX_CPU_COUNT;
+
+        if ( processor_table[ cpu ].running ) {
+            return cpu;
+        }
+    }
+
+    return 0;
+}
+
 static int do_net_device_start( net_device_t* device ) {
     /* Create the RX thread for the device. */
 
@@ -316,6 +334,11 @@ static int do_net_device_start( net_device_t* device ) {
         return 0;
     }
 
+    /* Pin the RX threads of the devices to different CPUs, so the
+       packets of a device are always processed on the same one. */
+
+    thread_set_affinity( device->rx_thread, 1 << get_next_rx_cpu() );
+
     /* Start the RX thread. */
 
     thread_wake_up( device->rx_thread );
@@ -25,12 +25,12 @@
 #include <kernel.h>
 #include <macros.h>
 #include <mm/kmalloc.h>
-#include <lock/mutex.h>
+#include <lock/rwlock.h>
 #include <network/route.h>
 #include <network/socket.h>
 #include <lib/array.h>
 
-static lock_id route_mutex;
+static lock_id route_lock;
 static array_t static_routes;
 static array_t device_routes;
 
@@ -122,7 +122,7 @@ route_t* route_find( uint8_t* ipv4_addr ) {
     route_t* found;
     net_device_t* device;
 
-    mutex_lock( route_mutex, LOCK_IGNORE_SIGNAL );
+    rwlock_read_lock( route_lock, LOCK_IGNORE_SIGNAL );
 
     /* Find a device that has a suitable address and netmask to send the packet. */
 
@@ -183,7 +183,7 @@ route_t* route_find( uint8_t* ipv4_addr ) {
     route->device = device;
 
  out:
-    mutex_unlock( route_mutex );
+    rwlock_read_unlock( route_lock );
 
     return route;
 }
@@ -194,7 +194,7 @@ route_t* route_find_device( char* dev_name ) {
     route_t* route;
     net_device_t* device;
 
-    mutex_lock( route_mutex, LOCK_IGNORE_SIGNAL );
+    rwlock_write_lock( route_lock, LOCK_IGNORE_SIGNAL );
 
     size = array_get_size(&device_routes);
 
@@ -237,7 +237,7 @@ route_t* route_find_device( char* dev_name ) {
     route_insert( &device_routes, route );
 
  out:
-    mutex_unlock( route_mutex );
+    rwlock_write_unlock( route_lock );
 
     return route;
 }
@@ -247,14 +247,14 @@ void route_put( route_t* route ) {
 
     do_delete = false;
 
-    mutex_lock( route_mutex, LOCK_IGNORE_SIGNAL );
+    rwlock_write_lock( route_lock, LOCK_IGNORE_SIGNAL );
 
     if ( --route->ref_count == 0 ) {
         array_remove_item( &device_routes, route );
         do_delete = true;
     }
 
-    mutex_unlock( route_mutex );
+    rwlock_write_unlock( route_lock );
 
     if ( do_delete ) {
         if ( route->device != NULL ) {
@@ -282,7 +282,10 @@ int route_add( struct rtentry* entry ) {
         return -ENOMEM;
     }
 
+    rwlock_write_lock( route_lock, LOCK_IGNORE_SIGNAL );
     error = route_insert( &static_routes, route );
+    rwlock_write_unlock( route_lock );
+
     route_put( route );
 
     return error;
@@ -301,7 +304,7 @@ int route_get_table( struct rttable* table ) {
 
     /* Static routes */
 
-    mutex_lock( route_mutex, LOCK_IGNORE_SIGNAL );
+    rwlock_read_lock( route_lock, LOCK_IGNORE_SIGNAL );
 
     size = array_get_size(&static_routes);
 
@@ -327,7 +330,7 @@ int route_get_table( struct rttable* table ) {
         }
     }
 
-    mutex_unlock( route_mutex );
+    rwlock_read_unlock( route_lock );
 
     /* Network interface routes */
 
@@ -378,9 +381,9 @@ __init int init_routes( void ) {
     array_set_realloc_size( &static_routes, 32 );
     array_set_realloc_size( &device_routes, 8 );
 
-    route_mutex = mutex_create( "route mutex", MUTEX_NONE );
+    route_lock = rwlock_create( "route lock" );
 
-    if ( route_mutex < 0 ) {
+    if ( route_lock < 0 ) {
         goto error3;
     }
 
@@ -26,11 +26,13 @@
 #include <thread.h>
 #include <kernel.h>
 #include <mm/kmalloc.h>
+#include <mm/slab.h>
 #include <network/tcp.h>
 #include <network/ipv4.h>
 #include <network/ethernet.h>
 #include <network/route.h>
 #include <network/device.h>
+#include <lock/rwlock.h>
 #include <lib/string.h>
 
 #include <arch/interrupt.h>
@@ -38,6 +40,7 @@
 static lock_id tcp_endpoint_lock;
 static thread_id tcp_timer_thread;
 static hashtable_t tcp_endpoint_table;
+static kmem_cache_t* tcp_socket_cache;
 
 static uint16_t tcp_checksum( uint8_t* src_address, uint8_t* dest_address, uint8_t* tcp_header, size_t tcp_size ) {
     int i;
@@ -276,9 +279,9 @@ static int tcp_connect( socket_t* socket, struct sockaddr* address, socklen_t ad
 
     /* Put the new endpoint to the table */
 
-    mutex_lock( tcp_endpoint_lock, LOCK_IGNORE_SIGNAL );
+    rwlock_write_lock( tcp_endpoint_lock, LOCK_IGNORE_SIGNAL );
     hashtable_add( &tcp_endpoint_table, ( hashitem_t* )tcp_socket );
-    mutex_unlock( tcp_endpoint_lock );
+    rwlock_write_unlock( tcp_endpoint_lock );
 
     /* Send the SYN packet */
 
@@ -722,7 +725,7 @@ int tcp_create_socket( socket_t* socket ) {
     int error;
     tcp_socket_t* tcp_socket;
 
-    tcp_socket = ( tcp_socket_t* )kmalloc( sizeof( tcp_socket_t ) );
+    tcp_socket = ( tcp_socket_t* )kmem_cache_alloc( tcp_socket_cache );
 
     if ( tcp_socket == NULL ) {
         goto error1;
@@ -809,7 +812,7 @@ int tcp_create_socket( socket_t* socket ) {
     destroy_circular_buffer( &tcp_socket->rx_buffer );
 
  error2:
-    kfree( tcp_socket );
+    kmem_cache_free( tcp_socket_cache, tcp_socket );
 
  error1:
     return -ENOMEM;
@@ -829,7 +832,10 @@ static tcp_socket_t* get_tcp_endpoint( packet_t* packet ) {
     memcpy( &endpoint_key.src_address, ip_header->dest_address, IPV4_ADDR_LEN );
     endpoint_key.src_port = ntohw( tcp_header->dest_port );
 
-    mutex_lock( tcp_endpoint_lock, LOCK_IGNORE_SIGNAL );
+    /* The lookups of the incoming packets can go in parallel, the
+       reference count is changed atomically under the read lock. */
+
+    rwlock_read_lock( tcp_endpoint_lock, LOCK_IGNORE_SIGNAL );
 
     tcp_socket = ( tcp_socket_t* )hashtable_get( &tcp_endpoint_table, ( const void* )&endpoint_key );
 
@@ -839,17 +845,35 @@ static tcp_socket_t* get_tcp_endpoint( packet_t* packet ) {
         atomic_inc( &tcp_socket->ref_count );
     }
 
-    mutex_unlock( tcp_endpoint_lock );
+    rwlock_read_unlock( tcp_endpoint_lock );
 
     return tcp_socket;
 }
 
 void put_tcp_endpoint( tcp_socket_t* tcp_socket ) {
+    int ref_count;
     bool do_delete;
 
+    /* Drop the reference without the table lock if it is not the
+       last one, only the removal from the table has to be locked. */
+
+    ref_count = atomic_get( &tcp_socket->ref_count );
+
+    while ( ref_count > 1 ) {
+        int old;
+
+        old = atomic_cmpxchg( &tcp_socket->ref_count, ref_count, ref_count - 1 );
+
+        if ( old == ref_count ) {
+            return;
+        }
+
+        ref_count = old;
+    }
+
     do_delete = false;
 
-    mutex_lock( tcp_endpoint_lock, LOCK_IGNORE_SIGNAL );
+    rwlock_write_lock( tcp_endpoint_lock, LOCK_IGNORE_SIGNAL );
 
     if ( atomic_dec_and_test( &tcp_socket->ref_count ) ) {
         hashtable_remove( &tcp_endpoint_table, ( const void* )&tcp_socket->endpoint_info );
@@ -857,7 +881,7 @@ void put_tcp_endpoint( tcp_socket_t* tcp_socket ) {
         do_delete = true;
     }
 
-    mutex_unlock( tcp_endpoint_lock );
+    rwlock_write_unlock( tcp_endpoint_lock );
 
     if ( do_delete ) {
         mutex_destroy( tcp_socket->mutex );
@@ -868,7 +892,7 @@ void put_tcp_endpoint( tcp_socket_t* tcp_socket ) {
         destroy_circular_buffer( &tcp_socket->rx_buffer );
         destroy_circular_buffer( &tcp_socket->tx_buffer );
 
-        kfree( tcp_socket );
+        kmem_cache_free( tcp_socket_cache, tcp_socket );
     }
 }
 
@@ -1197,9 +1221,9 @@ static int tcp_timer_thread_entry( void* data ) {
 
     while ( 1 ) {
         do {
-            mutex_lock( tcp_endpoint_lock, LOCK_IGNORE_SIGNAL );
+            rwlock_read_lock( tcp_endpoint_lock, LOCK_IGNORE_SIGNAL );
             tcp_socket = get_tcp_socket_for_work();
-            mutex_unlock( tcp_endpoint_lock );
+            rwlock_read_unlock( tcp_endpoint_lock );
 
             if ( tcp_socket != NULL ) {
                 mutex_lock( tcp_socket->mutex, LOCK_IGNORE_SIGNAL );
@@ -1217,6 +1241,12 @@ static int tcp_timer_thread_entry( void* data ) {
 __init int init_tcp( void ) {
     int error;
 
+    tcp_socket_cache = kmem_cache_create( "tcp socket", sizeof( tcp_socket_t ) );
+
+    if ( tcp_socket_cache == NULL ) {
+        return -ENOMEM;
+    }
+
     error = init_hashtable(
         &tcp_endpoint_table,
         64,
@@ -1229,7 +1259,7 @@ __init int init_tcp( void ) {
         return error;
     }
 
-    tcp_endpoint_lock = mutex_create( "TCP endpoint mutex", MUTEX_NONE );
+    tcp_endpoint_lock = rwlock_create( "TCP endpoint lock" );
 
     if ( tcp_endpoint_lock < 0 ) {
         destroy_hashtable( &tcp_endpoint_table );
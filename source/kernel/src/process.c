@@ -26,6 +26,7 @@
 #include <sched/scheduler.h>
 #include <mm/kmalloc.h>
 #include <mm/context.h>
+#include <mm/userspace.h>
 #include <vfs/vfs.h>
 #include <lib/hashtable.h>
 #include <lib/string.h>
@@ -70,6 +71,7 @@ process_t* allocate_process( char* name ) {
 
     process->id = -1;
     process->heap_region = NULL;
+    process->time_page = 0;
 
     atomic_set( &process->thread_count, 0 );
 
@@ -216,16 +218,42 @@ static int get_process_info_iterator( hashitem_t* item, void* _data ) {
 }
 
 uint32_t sys_get_process_info( process_info_t* info_table, uint32_t max_count ) {
+    uint32_t count;
     process_info_iter_data_t data;
 
+    /* The user buffer can't be written while the scheduler is locked,
+       because the page fault handler may have to lock it as well to
+       populate a lazy or copy-on-write page. The table is collected
+       into a kernel buffer first and copied out after unlocking. */
+
+    scheduler_lock();
+    count = hashtable_get_item_count( &process_table );
+    scheduler_unlock();
+
+    count = MIN( count, max_count );
+
+    if ( count == 0 ) {
+        return 0;
+    }
+
     data.curr_index = 0;
-    data.max_count = max_count;
-    data.info_table = info_table;
+    data.max_count = count;
+    data.info_table = ( process_info_t* )kmalloc( sizeof( process_info_t ) * count );
+
+    if ( data.info_table == NULL ) {
+        return 0;
+    }
 
     scheduler_lock();
     hashtable_iterate( &process_table, get_process_info_iterator, ( void* )&data );
     scheduler_unlock();
 
+    if ( copy_to_user( info_table, data.info_table, sizeof( process_info_t ) * data.curr_index ) < 0 ) {
+        data.curr_index = 0;
+    }
+
+    kfree( data.info_table );
+
     return data.curr_index;
 }
 
@@ -371,6 +399,13 @@ process_id sys_wait4( process_id pid, int* status, int options, struct rusage* r
                 tv->tv_usec = tmp->user_time % 1000000;
             }
 
+            /* The CPU that ran the zombie may still be switching
+               away from its kernel stack */
+
+            while ( tmp->on_cpu ) {
+                __asm__ __volatile__( "pause" );
+            }
+
             destroy_thread( tmp );
 
             return error;
@@ -400,28 +435,54 @@ process_id sys_wait4( process_id pid, int* status, int options, struct rusage* r
     return -EINVAL;
 }
 
+typedef struct rusage_iter_data {
+    process_t* process;
+    uint64_t user_time;
+    uint64_t sys_time;
+} rusage_iter_data_t;
+
+static int rusage_process_iterator( hashitem_t* item, void* _data ) {
+    thread_t* thread;
+    rusage_iter_data_t* data;
+
+    thread = ( thread_t* )item;
+    data = ( rusage_iter_data_t* )_data;
+
+    if ( thread->process == data->process ) {
+        data->user_time += thread->user_time;
+        data->sys_time += thread->sys_time;
+    }
+
+    return 0;
+}
+
 int sys_getrusage( int who, struct rusage* usage ) {
+    int error;
     thread_t* thread;
-    struct timeval* tv;
+    struct timeval utime;
+    struct timeval stime;
+    rusage_iter_data_t data;
 
     thread = current_thread();
 
+    data.process = thread->process;
+    data.user_time = 0;
+    data.sys_time = 0;
+
     switch ( who ) {
         case RUSAGE_SELF :
             scheduler_lock();
+            hashtable_iterate( &thread_table, rusage_process_iterator, ( void* )&data );
+            scheduler_unlock();
 
-            tv = &usage->ru_utime;
-            tv->tv_sec = thread->user_time / 1000000;
-            tv->tv_usec = thread->user_time % 1000000;
-
-            tv = &usage->ru_stime;
-            tv->tv_sec = thread->sys_time / 1000000;
-            tv->tv_usec = thread->sys_time % 1000000;
+            break;
 
+        case RUSAGE_THREAD :
+            scheduler_lock();
+            data.user_time = thread->user_time;
+            data.sys_time = thread->sys_time;
             scheduler_unlock();
 
-            /* TODO: add time usage from other threads as well */
-
             break;
 
         case RUSAGE_CHILDREN :
@@ -432,21 +493,6 @@ int sys_getrusage( int who, struct rusage* usage ) {
 
             return -ENOSYS;
 
-        case RUSAGE_THREAD :
-            scheduler_lock();
-
-            tv = &usage->ru_utime;
-            tv->tv_sec = thread->user_time / 1000000;
-            tv->tv_usec = thread->user_time % 1000000;
-
-            tv = &usage->ru_stime;
-            tv->tv_sec = thread->sys_time / 1000000;
-            tv->tv_usec = thread->sys_time % 1000000;
-
-            scheduler_unlock();
-
-            break;
-
         default :
             kprintf(
                 WARNING,
@@ -457,7 +503,21 @@ int sys_getrusage( int who, struct rusage* usage ) {
             return -EINVAL;
     }
 
-    return 0;
+    utime.tv_sec = data.user_time / 1000000;
+    utime.tv_usec = data.user_time % 1000000;
+    stime.tv_sec = data.sys_time / 1000000;
+    stime.tv_usec = data.sys_time % 1000000;
+
+    /* The user buffer is filled after unlocking the scheduler, writing
+       it may cause a page fault. */
+
+    error = copy_to_user( &usage->ru_utime, &utime, sizeof( struct timeval ) );
+
+    if ( error < 0 ) {
+        return error;
+    }
+
+    return copy_to_user( &usage->ru_stime, &stime, sizeof( struct timeval ) );
 }
 
 int sys_alloc_tld(void) {
@@ -21,94 +21,649 @@
 #include <smp.h>
 #include <kernel.h>
 #include <macros.h>
+#include <errno.h>
 #include <debug.h>
+#include <bitops.h>
+#include <clockevent.h>
 #include <sched/scheduler.h>
+#include <lib/string.h>
 
-waitqueue_t sleep_queue;
+#include <arch/interrupt.h>
+
+timer_wheel_t sleep_queue;
 spinlock_t scheduler_lock = INIT_SPINLOCK( "scheduler" );
 
-static thread_t* first_ready;
-static thread_t* last_ready;
+static inline int clamp_priority( int priority ) {
+    if ( priority < PRIORITY_IDLE ) {
+        return PRIORITY_IDLE;
+    }
 
-static thread_t* first_expired;
-static thread_t* last_expired;
+    if ( priority > PRIORITY_HIGH ) {
+        return PRIORITY_HIGH;
+    }
 
-int add_thread_to_ready( thread_t* thread ) {
-    ASSERT( scheduler_is_locked() );
+    return priority;
+}
 
-    if ( thread->in_scheduler ) {
-        return 0;
-    }
+static inline int is_rt_thread( thread_t* thread ) {
+    return ( thread->sched_policy != SCHED_OTHER );
+}
+
+static void priority_array_add( priority_array_t* array, thread_t* thread, int priority, int head ) {
+    thread->dynamic_priority = priority;
 
     thread->state = THREAD_READY;
     thread->queue_next = NULL;
-    thread->in_scheduler = 1;
 
-    if ( first_ready == NULL ) {
-        first_ready = thread;
-        last_ready = thread;
+    if ( array->first[ priority ] == NULL ) {
+        array->first[ priority ] = thread;
+        array->last[ priority ] = thread;
+        array->bitmap |= ( 1 << priority );
+    } else if ( head ) {
+        thread->queue_next = array->first[ priority ];
+        array->first[ priority ] = thread;
+    } else {
+        array->last[ priority ]->queue_next = thread;
+        array->last[ priority ] = thread;
+    }
+
+    array->count++;
+}
+
+static void priority_array_insert( priority_array_t* array, thread_t* thread ) {
+    int priority;
+
+    /* Real-time threads are queued by their fixed real-time priority */
+
+    if ( is_rt_thread( thread ) ) {
+        priority_array_add( array, thread, thread->rt_priority, 0 );
+        return;
+    }
+
+    /* Threads that sleep a lot are boosted and CPU bound ones are
+       penalized, but the bonus never moves a thread far from its
+       static priority. */
+
+    priority = clamp_priority( clamp_priority( thread->priority ) + thread->sleep_bonus );
+
+    priority_array_add( array, thread, priority, 0 );
+}
+
+static void priority_array_unlink( priority_array_t* array, thread_t* thread, thread_t* prev ) {
+    int priority;
+
+    priority = thread->dynamic_priority;
+
+    if ( prev == NULL ) {
+        array->first[ priority ] = thread->queue_next;
     } else {
-        last_ready->queue_next = thread;
-        last_ready = thread;
+        prev->queue_next = thread->queue_next;
+    }
+
+    if ( array->last[ priority ] == thread ) {
+        array->last[ priority ] = prev;
+    }
+
+    if ( array->first[ priority ] == NULL ) {
+        array->bitmap &= ~( 1 << priority );
+    }
+
+    thread->queue_next = NULL;
+    array->count--;
+}
+
+static thread_t* priority_array_get_first( priority_array_t* array ) {
+    int priority;
+    thread_t* thread;
+
+    if ( array->bitmap == 0 ) {
+        return NULL;
+    }
+
+    priority = find_last_set_bit( array->bitmap );
+    thread = array->first[ priority ];
+
+    priority_array_unlink( array, thread, NULL );
+
+    return thread;
+}
+
+static inline int thread_can_run_on( thread_t* thread, int cpu ) {
+    return ( ( thread->cpu_affinity & ( 1 << cpu ) ) != 0 );
+}
+
+static thread_t* priority_array_get_first_for_cpu( priority_array_t* array, int cpu ) {
+    int priority;
+    uint32_t bitmap;
+    thread_t* prev;
+    thread_t* thread;
+
+    bitmap = array->bitmap;
+
+    while ( bitmap != 0 ) {
+        priority = find_last_set_bit( bitmap );
+        bitmap &= ~( 1 << priority );
+
+        for ( prev = NULL, thread = array->first[ priority ];
+              thread != NULL;
+              prev = thread, thread = thread->queue_next ) {
+            if ( thread_can_run_on( thread, cpu ) ) {
+                priority_array_unlink( array, thread, prev );
+
+                return thread;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int priority_array_remove( priority_array_t* array, thread_t* thread ) {
+    thread_t* prev;
+    thread_t* tmp;
+
+    for ( prev = NULL, tmp = array->first[ thread->dynamic_priority ];
+          tmp != NULL;
+          prev = tmp, tmp = tmp->queue_next ) {
+        if ( tmp == thread ) {
+            priority_array_unlink( array, thread, prev );
+
+            return 1;
+        }
     }
 
     return 0;
 }
 
-int add_thread_to_expired( thread_t* thread ) {
+uint32_t get_run_queue_length( run_queue_t* queue ) {
+    return queue->rt.count + queue->active->count + queue->expired->count;
+}
+
+static void run_queue_insert( run_queue_t* queue, thread_t* thread, int expired ) {
+    thread->cpu = queue->processor;
+
+    /* Real-time threads never expire, they are only moved to
+       the end of their list */
+
+    if ( is_rt_thread( thread ) ) {
+        priority_array_insert( &queue->rt, thread );
+    } else if ( expired ) {
+        priority_array_insert( queue->expired, thread );
+    } else {
+        priority_array_insert( queue->active, thread );
+    }
+}
+
+/* Locks the run queue the thread was last put to. The CPU of the thread
+   may change until the lock is taken, so it has to be checked again. */
+static run_queue_t* lock_thread_run_queue( thread_t* thread ) {
+    int cpu;
+    run_queue_t* queue;
+
+    for ( ;; ) {
+        cpu = thread->cpu;
+
+        if ( cpu < 0 ) {
+            return NULL;
+        }
+
+        queue = &processor_table[ cpu ].run_queue;
+
+        spinlock_disable( &queue->lock );
+
+        if ( thread->cpu == cpu ) {
+            return queue;
+        }
+
+        spinunlock_enable( &queue->lock );
+    }
+}
+
+/* Two run queues are always locked in the order of their CPUs,
+   otherwise two CPUs stealing from each other could deadlock. */
+static void lock_run_queues( run_queue_t* queue1, run_queue_t* queue2 ) {
+    if ( queue1->processor < queue2->processor ) {
+        spinlock( &queue1->lock );
+        spinlock( &queue2->lock );
+    } else {
+        spinlock( &queue2->lock );
+        spinlock( &queue1->lock );
+    }
+}
+
+static void unlock_run_queues( run_queue_t* queue1, run_queue_t* queue2 ) {
+    spinunlock( &queue1->lock );
+    spinunlock( &queue2->lock );
+}
+
+static run_queue_t* select_run_queue( thread_t* thread ) {
+    int i;
+    cpu_t* cpu;
+    run_queue_t* queue;
+
+    /* Keep the thread on the CPU it was running on last time
+       to make use of the data it left in the caches */
+
+    if ( ( thread->cpu >= 0 ) &&
+         ( processor_table[ thread->cpu ].running ) &&
+         ( thread_can_run_on( thread, thread->cpu ) ) ) {
+        return &processor_table[ thread->cpu ].run_queue;
+    }
+
+    /* New threads are placed on the least loaded allowed CPU */
+
+    queue = NULL;
+
+    for ( i = 0, cpu = processor_table; i < MAX_CPU_COUNT; i++, cpu++ ) {
+        if ( ( !cpu->running ) ||
+             ( !thread_can_run_on( thread, i ) ) ) {
+            continue;
+        }
+
+        if ( ( queue == NULL ) ||
+             ( get_run_queue_length( &cpu->run_queue ) < get_run_queue_length( queue ) ) ) {
+            queue = &cpu->run_queue;
+        }
+    }
+
+    if ( queue == NULL ) {
+        queue = &get_processor()->run_queue;
+    }
+
+    return queue;
+}
+
+/* Tells if the newly queued thread has to preempt the current thread
+   of the CPU. Real-time threads always preempt time-sliced ones and a
+   higher real-time priority wins between two real-time threads. */
+static int thread_preempts( thread_t* thread, thread_t* current, int expired ) {
+    if ( is_rt_thread( thread ) ) {
+        return ( ( !is_rt_thread( current ) ) ||
+                 ( thread->rt_priority > current->rt_priority ) );
+    }
+
+    /* An expired thread waits until the active array is empty */
+
+    return ( ( !is_rt_thread( current ) ) &&
+             ( !expired ) &&
+             ( thread->dynamic_priority > current->dynamic_priority ) );
+}
+
+static void wake_up_processor( run_queue_t* queue, thread_t* thread, int expired ) {
+    int i;
+    cpu_t* cpu;
+    thread_t* current;
+
+    cpu = &processor_table[ queue->processor ];
+    current = cpu->current_thread;
+
+    /* Nothing to do if the running thread is put back to the queue */
+
+    if ( thread == current ) {
+        return;
+    }
+
+    /* Idle CPUs don't get timer interrupts, so they have to be notified
+       about the new thread. A thread with higher priority than the
+       running one preempts it right away instead of waiting for the
+       next tick. */
+
+    if ( ( current == cpu->idle_thread ) ||
+         ( ( current != NULL ) &&
+           ( thread_preempts( thread, current, expired ) ) ) ) {
+        clockevent_kick( queue->processor );
+        return;
+    }
+
+    /* The CPU of the run queue is busy, let an idle one steal the thread */
+
+    for ( i = 0, cpu = processor_table; i < MAX_CPU_COUNT; i++, cpu++ ) {
+        if ( ( cpu->running ) &&
+             ( cpu->current_thread == cpu->idle_thread ) &&
+             ( thread_can_run_on( thread, i ) ) ) {
+            clockevent_kick( i );
+            break;
+        }
+    }
+}
+
+static void enqueue_thread( thread_t* thread, int expired ) {
+    run_queue_t* queue;
+
+    queue = select_run_queue( thread );
+
+    spinlock_disable( &queue->lock );
+
+    run_queue_insert( queue, thread, expired );
+    wake_up_processor( queue, thread, expired );
+
+    spinunlock_enable( &queue->lock );
+}
+
+void update_thread_affinity( thread_t* thread ) {
+    int expired;
+    run_queue_t* queue;
+
     ASSERT( scheduler_is_locked() );
 
-    if ( thread->in_scheduler ) {
-        return 0;
+    if ( ( atomic_get( &thread->in_scheduler ) == 0 ) ||
+         ( thread->state != THREAD_READY ) ) {
+        return;
     }
 
-    thread->state = THREAD_READY;
-    thread->queue_next = NULL;
-    thread->in_scheduler = 1;
+    queue = lock_thread_run_queue( thread );
 
-    reset_thread_quantum( thread );
+    if ( queue == NULL ) {
+        return;
+    }
 
-    if ( first_expired == NULL ) {
-        first_expired = thread;
-        last_expired = thread;
+    if ( thread_can_run_on( thread, queue->processor ) ) {
+        spinunlock_enable( &queue->lock );
+        return;
+    }
+
+    if ( ( priority_array_remove( &queue->rt, thread ) ) ||
+         ( priority_array_remove( queue->active, thread ) ) ) {
+        expired = 0;
+    } else if ( priority_array_remove( queue->expired, thread ) ) {
+        expired = 1;
     } else {
-        last_expired->queue_next = thread;
-        last_expired = thread;
+        spinunlock_enable( &queue->lock );
+        return;
+    }
+
+    spinunlock_enable( &queue->lock );
+
+    /* The thread is still marked as being in the scheduler, so nobody
+       else queues it while it is moved to the new run queue */
+
+    enqueue_thread( thread, expired );
+}
+
+int do_set_thread_scheduler( thread_t* thread, int policy, int priority ) {
+    int queued;
+    run_queue_t* queue;
+
+    ASSERT( scheduler_is_locked() );
+
+    switch ( policy ) {
+        case SCHED_OTHER :
+            if ( priority != 0 ) {
+                return -EINVAL;
+            }
+
+            break;
+
+        case SCHED_FIFO :
+        case SCHED_RR :
+            if ( ( priority < SCHED_RT_PRIORITY_MIN ) ||
+                 ( priority > SCHED_RT_PRIORITY_MAX ) ) {
+                return -EINVAL;
+            }
+
+            break;
+
+        default :
+            return -EINVAL;
+    }
+
+    /* Take the thread out of the run queue while its class is changed */
+
+    queued = 0;
+
+    if ( ( atomic_get( &thread->in_scheduler ) != 0 ) &&
+         ( thread->state == THREAD_READY ) ) {
+        queue = lock_thread_run_queue( thread );
+
+        if ( queue != NULL ) {
+            queued = ( priority_array_remove( &queue->rt, thread ) ||
+                       priority_array_remove( queue->active, thread ) ||
+                       priority_array_remove( queue->expired, thread ) );
+
+            spinunlock_enable( &queue->lock );
+        }
+    }
+
+    thread->sched_policy = policy;
+    thread->rt_priority = priority;
+
+    reset_thread_quantum( thread );
+
+    if ( queued ) {
+        enqueue_thread( thread, 0 );
     }
 
     return 0;
 }
 
+/* Puts the thread to a run queue unless it is already there. This doesn't
+   need the scheduler lock, the flag makes sure that the thread is queued
+   only once if it is preempted and woken up at the same time. */
+static void queue_thread( thread_t* thread, int expired ) {
+    if ( atomic_swap( &thread->in_scheduler, 1 ) != 0 ) {
+        return;
+    }
+
+    if ( expired ) {
+        reset_thread_quantum( thread );
+    }
+
+    enqueue_thread( thread, expired );
+}
+
+int add_thread_to_ready( thread_t* thread ) {
+    ASSERT( scheduler_is_locked() );
+
+    queue_thread( thread, 0 );
+
+    return 0;
+}
+
+int add_thread_to_expired( thread_t* thread ) {
+    ASSERT( scheduler_is_locked() );
+
+    queue_thread( thread, 1 );
+
+    return 0;
+}
+
+static void requeue_rt_thread( thread_t* thread, uint64_t runtime ) {
+    int head;
+    run_queue_t* queue;
+
+    if ( atomic_swap( &thread->in_scheduler, 1 ) != 0 ) {
+        return;
+    }
+
+    /* A preempted FIFO thread stays at the head of its list, a round-robin
+       one goes to the tail only after it used up its time slice */
+
+    if ( ( thread->sched_policy == SCHED_RR ) &&
+         ( runtime >= thread->quantum ) ) {
+        reset_thread_quantum( thread );
+        head = 0;
+    } else {
+        if ( thread->sched_policy == SCHED_RR ) {
+            thread->quantum -= runtime;
+        }
+
+        head = 1;
+    }
+
+    queue = select_run_queue( thread );
+
+    spinlock( &queue->lock );
+
+    thread->cpu = queue->processor;
+    priority_array_add( &queue->rt, thread, thread->rt_priority, head );
+
+    spinunlock( &queue->lock );
+}
+
 void reset_thread_quantum( thread_t* thread ) {
-    thread->quantum = 50 * 1000;
+    if ( is_rt_thread( thread ) ) {
+        thread->quantum = SCHED_RR_QUANTUM;
+        return;
+    }
+
+    /* Threads with higher priority get longer time slices */
+
+    thread->quantum = SCHED_MIN_QUANTUM +
+        clamp_priority( thread->priority ) * ( SCHED_MAX_QUANTUM - SCHED_MIN_QUANTUM ) / PRIORITY_HIGH;
+}
+
+static void swap_expired_and_ready_arrays( run_queue_t* queue ) {
+    priority_array_t* tmp;
+
+    tmp = queue->active;
+    queue->active = queue->expired;
+    queue->expired = tmp;
+}
+
+static run_queue_t* find_busiest_run_queue( run_queue_t* local ) {
+    int i;
+    cpu_t* cpu;
+    uint32_t length;
+    uint32_t max_length;
+    run_queue_t* busiest;
+
+    busiest = NULL;
+    max_length = 0;
+
+    for ( i = 0, cpu = processor_table; i < MAX_CPU_COUNT; i++, cpu++ ) {
+        if ( ( !cpu->running ) ||
+             ( &cpu->run_queue == local ) ) {
+            continue;
+        }
+
+        length = get_run_queue_length( &cpu->run_queue );
+
+        if ( length > max_length ) {
+            busiest = &cpu->run_queue;
+            max_length = length;
+        }
+    }
+
+    return busiest;
+}
+
+static int migrate_thread( run_queue_t* from, run_queue_t* to ) {
+    int cpu;
+    thread_t* thread;
+
+    /* Waiting real-time threads are moved first, then the expired ones
+       that are probably not cache hot on their current CPU anymore.
+       Threads that are not allowed to run on this CPU are skipped. */
+
+    cpu = to->processor;
+    thread = priority_array_get_first_for_cpu( &from->rt, cpu );
+
+    if ( thread != NULL ) {
+        priority_array_insert( &to->rt, thread );
+    } else if ( ( thread = priority_array_get_first_for_cpu( from->expired, cpu ) ) != NULL ) {
+        priority_array_insert( to->expired, thread );
+    } else {
+        thread = priority_array_get_first_for_cpu( from->active, cpu );
+
+        if ( thread == NULL ) {
+            return 0;
+        }
+
+        priority_array_insert( to->active, thread );
+    }
+
+    thread->cpu = to->processor;
+    to->migrations++;
+
+    return 1;
+}
+
+static void balance_run_queues( run_queue_t* local ) {
+    run_queue_t* busiest;
+
+    busiest = find_busiest_run_queue( local );
+
+    if ( busiest == NULL ) {
+        return;
+    }
+
+    lock_run_queues( local, busiest );
+
+    /* Pull threads until the difference between the two queues is
+       at most one, otherwise the threads would bounce between them */
+
+    while ( get_run_queue_length( busiest ) > get_run_queue_length( local ) + 1 ) {
+        if ( !migrate_thread( busiest, local ) ) {
+            break;
+        }
+    }
+
+    unlock_run_queues( local, busiest );
+}
+
+static void steal_thread( run_queue_t* local ) {
+    run_queue_t* busiest;
+
+    busiest = find_busiest_run_queue( local );
+
+    if ( busiest == NULL ) {
+        return;
+    }
+
+    lock_run_queues( local, busiest );
+
+    /* The busiest queue was selected without locking, someone may have
+       put a thread to the local queue since then */
+
+    if ( get_run_queue_length( local ) == 0 ) {
+        migrate_thread( busiest, local );
+    }
+
+    unlock_run_queues( local, busiest );
+}
+
+/* The user and system time of a thread is only updated by the CPU the
+   thread is running on (by the scheduler or by the thread itself), so
+   it is enough to disable interrupts on the local CPU to update them. */
+static void update_thread_checkpoint( thread_t* thread, uint64_t now ) {
+    uint64_t time_used;
+
+    time_used = now - thread->prev_checkpoint;
+
+    if ( thread->in_system ) {
+        thread->sys_time += time_used;
+    } else {
+        thread->user_time += time_used;
+    }
+
+    thread->prev_checkpoint = now;
 }
 
-static void swap_expired_and_ready_lists( void ) {
-    first_ready = first_expired;
-    last_ready = last_expired;
+void set_thread_in_system( thread_t* thread, int in_system ) {
+    bool ints;
 
-    first_expired = NULL;
-    last_expired = NULL;
+    ints = disable_interrupts();
+
+    update_thread_checkpoint( thread, get_system_time() );
+    thread->in_system = in_system;
+
+    if ( ints ) {
+        enable_interrupts();
+    }
 }
 
 static void update_prev_thread( thread_t* thread, uint64_t now ) {
     cpu_t* cpu;
     uint64_t runtime;
-    uint64_t time_used;
 
     /* Calculate the time how long the previous thread
        was running */
 
     runtime = now - thread->exec_time;
-    time_used = now - thread->prev_checkpoint;
 
     thread->cpu_time += runtime;
 
-    if ( thread->in_system ) {
-        thread->sys_time += time_used;
-    } else {
-        thread->user_time += time_used;
-    }
+    update_thread_checkpoint( thread, now );
 
     /* Handle the idle thread separately */
 
@@ -116,20 +671,30 @@ static void update_prev_thread( thread_t* thread, uint64_t now ) {
 
     if ( thread == cpu->idle_thread ) {
         thread->state = THREAD_WAITING;
-        thread->in_scheduler = 1;
+        atomic_set( &thread->in_scheduler, 1 );
 
         cpu->idle_time += runtime;
 
         return;
     }
 
+    if ( is_rt_thread( thread ) ) {
+        cpu->run_queue.rt_time += runtime;
+    }
+
     switch ( thread->state ) {
         case THREAD_RUNNING :
-            if ( runtime >= thread->quantum ) {
-                add_thread_to_expired( thread );
+            if ( is_rt_thread( thread ) ) {
+                requeue_rt_thread( thread, runtime );
+            } else if ( runtime >= thread->quantum ) {
+                if ( thread->sleep_bonus > -SCHED_MAX_SLEEP_BONUS ) {
+                    thread->sleep_bonus--;
+                }
+
+                queue_thread( thread, 1 );
             } else {
                 thread->quantum -= runtime;
-                add_thread_to_ready( thread );
+                queue_thread( thread, 0 );
             }
 
             break;
@@ -141,6 +706,12 @@ static void update_prev_thread( thread_t* thread, uint64_t now ) {
 
         case THREAD_WAITING :
         case THREAD_SLEEPING :
+            /* The thread gave up the CPU before using its quantum */
+
+            if ( thread->sleep_bonus < SCHED_MAX_SLEEP_BONUS ) {
+                thread->sleep_bonus++;
+            }
+
             if ( runtime >= thread->quantum ) {
                 /* 0 as a quantum is used to tell the wakeup functions
                    that this thread has to be added to the expired list
@@ -168,65 +739,149 @@ static void update_prev_thread( thread_t* thread, uint64_t now ) {
 }
 
 static void update_next_thread( thread_t* thread, uint64_t now ) {
+    thread->cpu = get_processor_index();
+    thread->on_cpu = 1;
     thread->exec_time = now;
     thread->prev_checkpoint = now;
-    thread->in_scheduler = 0;
+    atomic_set( &thread->in_scheduler, 0 );
 }
 
 thread_t* do_schedule( thread_t* current ) {
     uint64_t now;
     thread_t* next;
+    run_queue_t* queue;
+
+    ASSERT( is_interrupts_disabled() );
 
     now = get_system_time();
+    queue = &get_processor()->run_queue;
 
     if ( __likely( current != NULL ) ) {
         update_prev_thread( current, now );
     }
 
-    /* Swap the expired and ready thread lists if the ready list is
-       empty (this means that all runnable thread used its quantum) */
+    /* Even out the length of the run queues from time to time */
+
+    if ( now - queue->last_balance >= SCHED_BALANCE_INTERVAL ) {
+        balance_run_queues( queue );
+        queue->last_balance = now;
+    }
+
+    /* Steal a thread from the busiest CPU if this one would be idle */
+
+    if ( get_run_queue_length( queue ) == 0 ) {
+        steal_thread( queue );
+    }
+
+    spinlock( &queue->lock );
+
+    /* Start a new real-time throttling period if the previous one is over */
 
-    if ( first_ready == NULL ) {
-        swap_expired_and_ready_lists();
+    if ( now - queue->rt_period_start >= SCHED_RT_PERIOD ) {
+        queue->rt_period_start = now;
+        queue->rt_time = 0;
     }
 
-    /* Get the first thread from the ready list */
+    /* Real-time threads preempt everything else as long as they
+       did not use up their budget in the current period */
 
-    next = first_ready;
+    next = NULL;
 
-    if ( first_ready != NULL ) {
-        first_ready = first_ready->queue_next;
-        next->queue_next = NULL;
+    if ( queue->rt_time < SCHED_RT_RUNTIME ) {
+        next = priority_array_get_first( &queue->rt );
     }
 
-    /* If the ready list is empty then execute the idle thread */
+    if ( next == NULL ) {
+        /* Swap the expired and active arrays if the active one is
+           empty (this means that all runnable thread used its quantum) */
+
+        if ( queue->active->count == 0 ) {
+            swap_expired_and_ready_arrays( queue );
+        }
+
+        /* Get the first thread with the highest priority */
+
+        next = priority_array_get_first( queue->active );
+    }
+
+    /* Throttled real-time threads may still use an otherwise idle CPU */
+
+    if ( next == NULL ) {
+        next = priority_array_get_first( &queue->rt );
+    }
+
+    spinunlock( &queue->lock );
+
+    /* If there is no ready thread then execute the idle thread */
 
     if ( next == NULL ) {
         next = idle_thread();
     }
 
+    /* The thread may have been put back to a run queue by another CPU that
+       didn't switch away from its kernel stack yet. It takes only a few
+       instructions, wait for it instead of corrupting the stack. */
+
+    if ( next != current ) {
+        while ( next->on_cpu ) {
+            __asm__ __volatile__( "pause" );
+        }
+    }
+
     /* Save the execution time of the next thread */
 
     update_next_thread( next, now );
 
+    /* Program the timer of the CPU for the next event */
+
+    clockevent_update( next, now );
+
     return next;
 }
 
 #ifdef ENABLE_DEBUGGER
-int dbg_dump_ready_list( const char* params ) {
+static void dbg_dump_priority_array( const char* name, priority_array_t* array ) {
+    int priority;
     thread_t* thread;
 
-    thread = first_ready;
+    if ( array->count == 0 ) {
+        dbg_printf( "There is no %s thread!\n", name );
+        return;
+    }
+
+    dbg_printf( "%s threads (%u):\n", name, array->count );
 
-    if ( thread == NULL ) {
-        dbg_printf( "There is no ready thread!\n" );
-    } else {
-        dbg_printf( "Ready threads:\n" );
+    for ( priority = PRIORITY_HIGH; priority >= PRIORITY_IDLE; priority-- ) {
+        thread = array->first[ priority ];
 
-        while ( thread != NULL ) {
-            dbg_printf( "  %s\n", thread->name );
-            thread = thread->queue_next;
+        if ( thread == NULL ) {
+            continue;
         }
+
+        dbg_printf( "  %2d:", priority );
+
+        for ( ; thread != NULL; thread = thread->queue_next ) {
+            dbg_printf( " %s(%d)", thread->name, thread->priority );
+        }
+
+        dbg_printf( "\n" );
+    }
+}
+
+int dbg_dump_ready_list( const char* params ) {
+    int i;
+    cpu_t* cpu;
+
+    for ( i = 0, cpu = processor_table; i < MAX_CPU_COUNT; i++, cpu++ ) {
+        if ( !cpu->running ) {
+            continue;
+        }
+
+        dbg_printf( "CPU %d (%u migrations):\n", i, cpu->run_queue.migrations );
+
+        dbg_dump_priority_array( "Real-time", &cpu->run_queue.rt );
+        dbg_dump_priority_array( "Active", cpu->run_queue.active );
+        dbg_dump_priority_array( "Expired", cpu->run_queue.expired );
     }
 
     return 0;
@@ -234,17 +889,25 @@ int dbg_dump_ready_list( const char* params ) {
 #endif /* ENABLE_DEBUGGER */
 
 __init int init_scheduler( void ) {
+    int i;
     int error;
+    run_queue_t* queue;
+
+    for ( i = 0; i < MAX_CPU_COUNT; i++ ) {
+        queue = &processor_table[ i ].run_queue;
 
-    first_ready = NULL;
-    last_ready = NULL;
+        memset( queue, 0, sizeof( run_queue_t ) );
 
-    first_expired = NULL;
-    last_expired = NULL;
+        init_spinlock( &queue->lock, "run queue" );
+
+        queue->active = &queue->arrays[ 0 ];
+        queue->expired = &queue->arrays[ 1 ];
+        queue->processor = i;
+    }
 
     /* Initialize the sleep queue */
 
-    error = init_waitqueue( &sleep_queue );
+    error = init_timer_wheel( &sleep_queue, get_system_time() );
 
     if ( error < 0 ) {
         return error;
@@ -0,0 +1,365 @@
+/* Hierarchical timer wheel
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <macros.h>
+#include <sched/timerwheel.h>
+#include <sched/scheduler.h>
+
+static inline uint64_t time_to_tick( uint64_t time ) {
+    return time >> TIMER_WHEEL_SHIFT;
+}
+
+static waitqueue_t* timer_wheel_get_slot( timer_wheel_t* wheel, uint64_t expires ) {
+    int level;
+    int shift;
+    uint64_t delta;
+
+    /* Nodes that should have been expired already go to the
+       slot that is processed next */
+
+    if ( expires < wheel->current_tick ) {
+        expires = wheel->current_tick;
+    }
+
+    delta = expires - wheel->current_tick;
+
+    if ( delta < TIMER_ROOT_SIZE ) {
+        return &wheel->root[ expires & ( TIMER_ROOT_SIZE - 1 ) ];
+    }
+
+    shift = TIMER_ROOT_BITS;
+
+    for ( level = 0; level < TIMER_LEVEL_COUNT - 1; level++, shift += TIMER_LEVEL_BITS ) {
+        if ( delta < ( 1ULL << ( shift + TIMER_LEVEL_BITS ) ) ) {
+            break;
+        }
+    }
+
+    /* Nodes beyond the range of the wheel are put to the farthest slot
+       and they are moved again when that slot is cascaded */
+
+    if ( delta >= ( 1ULL << ( shift + TIMER_LEVEL_BITS ) ) ) {
+        expires = wheel->current_tick + ( 1ULL << ( shift + TIMER_LEVEL_BITS ) ) - 1;
+    }
+
+    return &wheel->levels[ level ][ ( expires >> shift ) & ( TIMER_LEVEL_SIZE - 1 ) ];
+}
+
+static void do_timer_wheel_add_node( timer_wheel_t* wheel, waitnode_t* node ) {
+    waitqueue_t* slot;
+
+    slot = timer_wheel_get_slot( wheel, time_to_tick( node->wakeup_time ) );
+
+    waitqueue_add_node_tail( slot, node );
+    node->slot = slot;
+
+    wheel->count++;
+}
+
+int timer_wheel_add_node( timer_wheel_t* wheel, waitnode_t* node ) {
+    spinlock_disable( &wheel->lock );
+    do_timer_wheel_add_node( wheel, node );
+    spinunlock_enable( &wheel->lock );
+
+    return 0;
+}
+
+int timer_wheel_remove_node( timer_wheel_t* wheel, waitnode_t* node ) {
+    spinlock_disable( &wheel->lock );
+
+    if ( node->in_queue ) {
+        ASSERT( node->slot != NULL );
+
+        waitqueue_remove_node( node->slot, node );
+        node->slot = NULL;
+
+        wheel->count--;
+    }
+
+    spinunlock_enable( &wheel->lock );
+
+    return 0;
+}
+
+static void timer_wheel_cascade( timer_wheel_t* wheel, waitqueue_t* slot ) {
+    waitnode_t* node;
+    waitnode_t* next;
+
+    node = slot->first_node;
+
+    slot->first_node = NULL;
+    slot->last_node = NULL;
+
+    /* Put the nodes to their new slots closer to the root */
+
+    while ( node != NULL ) {
+        next = node->next;
+
+        node->prev = NULL;
+        node->next = NULL;
+        node->in_queue = false;
+
+        wheel->count--;
+
+        do_timer_wheel_add_node( wheel, node );
+
+        node = next;
+    }
+}
+
+static void timer_wheel_turn( timer_wheel_t* wheel ) {
+    int level;
+    int shift;
+    uint32_t index;
+
+    /* Each time a level wraps around, the next slot of the outer
+       level is distributed over the inner ones */
+
+    if ( ( wheel->current_tick & ( TIMER_ROOT_SIZE - 1 ) ) != 0 ) {
+        return;
+    }
+
+    shift = TIMER_ROOT_BITS;
+
+    for ( level = 0; level < TIMER_LEVEL_COUNT; level++, shift += TIMER_LEVEL_BITS ) {
+        index = ( wheel->current_tick >> shift ) & ( TIMER_LEVEL_SIZE - 1 );
+
+        timer_wheel_cascade( wheel, &wheel->levels[ level ][ index ] );
+
+        if ( index != 0 ) {
+            break;
+        }
+    }
+}
+
+static void timer_wheel_expire_node( timer_wheel_t* wheel, waitnode_t* node,
+                                     waitnode_t** threads, waitnode_t** callbacks ) {
+    waitqueue_remove_node( node->slot, node );
+    node->slot = NULL;
+
+    wheel->count--;
+
+    /* The threads are woken up after the wheel is unlocked, because
+       that locks run queues. The nodes stay valid until then as their
+       threads can't leave the wait without locking the scheduler. */
+
+    switch ( node->type ) {
+        case WAIT_THREAD :
+            node->next = *threads;
+            *threads = node;
+
+            break;
+
+        case WAIT_CALLBACK :
+            node->next = *callbacks;
+            *callbacks = node;
+
+            break;
+    }
+}
+
+static uint64_t do_timer_wheel_next_expiry( timer_wheel_t* wheel, uint64_t limit ) {
+    uint64_t tick;
+    uint64_t boundary;
+    uint64_t expiry;
+    waitnode_t* node;
+
+    if ( wheel->count == 0 ) {
+        return limit;
+    }
+
+    /* The outer levels are not cascaded before the root wraps around,
+       so the nodes there can't expire earlier than that */
+
+    boundary = ( wheel->current_tick | ( TIMER_ROOT_SIZE - 1 ) ) + 1;
+
+    for ( tick = wheel->current_tick; tick < boundary; tick++ ) {
+        if ( ( tick << TIMER_WHEEL_SHIFT ) >= limit ) {
+            return limit;
+        }
+
+        node = wheel->root[ tick & ( TIMER_ROOT_SIZE - 1 ) ].first_node;
+
+        if ( node == NULL ) {
+            continue;
+        }
+
+        expiry = node->wakeup_time;
+
+        for ( node = node->next; node != NULL; node = node->next ) {
+            expiry = MIN( expiry, node->wakeup_time );
+        }
+
+        return MIN( expiry, limit );
+    }
+
+    return MIN( boundary << TIMER_WHEEL_SHIFT, limit );
+}
+
+static void timer_wheel_wake_up_threads( waitnode_t* node ) {
+    thread_t* thread;
+    waitnode_t* next;
+
+    for ( ; node != NULL; node = next ) {
+        next = node->next;
+        node->next = NULL;
+
+        thread = get_thread_by_id( node->u.thread );
+
+        if ( __likely( thread != NULL ) ) {
+            /* If the thread doesn't have time to run add
+               it to the list of expired threads, otherwise
+               add it to the ready list */
+
+            if ( thread->quantum == 0 ) {
+                add_thread_to_expired( thread );
+            } else {
+                add_thread_to_ready( thread );
+            }
+        }
+    }
+}
+
+int timer_wheel_expire( timer_wheel_t* wheel, uint64_t now ) {
+    uint64_t now_tick;
+    waitqueue_t* slot;
+    waitnode_t* node;
+    waitnode_t* next;
+
+    waitnode_t* threads = NULL;
+    waitnode_t* callbacks = NULL;
+
+    now_tick = time_to_tick( now );
+
+    /* Most of the ticks have nothing to expire, the scheduler is not
+       locked for them. The wheel is turned later in that case, the
+       nodes are inserted relative to the current tick of the wheel,
+       so it doesn't matter if it lags behind the time a bit. */
+
+    spinlock_disable( &wheel->lock );
+
+    if ( wheel->count == 0 ) {
+        if ( wheel->current_tick < now_tick ) {
+            wheel->current_tick = now_tick;
+        }
+
+        spinunlock_enable( &wheel->lock );
+
+        return 0;
+    }
+
+    if ( do_timer_wheel_next_expiry( wheel, now + 1 ) > now ) {
+        spinunlock_enable( &wheel->lock );
+
+        return 0;
+    }
+
+    spinunlock_enable( &wheel->lock );
+
+    scheduler_lock();
+    spinlock( &wheel->lock );
+
+    for ( ;; ) {
+        /* Nothing to turn if the wheel is empty */
+
+        if ( wheel->count == 0 ) {
+            if ( wheel->current_tick < now_tick ) {
+                wheel->current_tick = now_tick;
+            }
+
+            break;
+        }
+
+        /* The slots of the past ticks are expired entirely, from the
+           slot of the current tick only the nodes that are due now */
+
+        slot = &wheel->root[ wheel->current_tick & ( TIMER_ROOT_SIZE - 1 ) ];
+        node = slot->first_node;
+
+        while ( node != NULL ) {
+            next = node->next;
+
+            if ( ( wheel->current_tick < now_tick ) ||
+                 ( node->wakeup_time <= now ) ) {
+                timer_wheel_expire_node( wheel, node, &threads, &callbacks );
+            }
+
+            node = next;
+        }
+
+        if ( wheel->current_tick >= now_tick ) {
+            break;
+        }
+
+        wheel->current_tick++;
+
+        timer_wheel_turn( wheel );
+    }
+
+    spinunlock( &wheel->lock );
+
+    timer_wheel_wake_up_threads( threads );
+
+    scheduler_unlock();
+
+    /* Fire callbacks */
+
+    while ( callbacks != NULL ) {
+        waitnode_t* callback;
+
+        callback = callbacks;
+        callbacks = callback->next;
+
+        callback->next = NULL;
+        callback->u.callback( callback->u.data );
+    }
+
+    return 0;
+}
+
+uint64_t timer_wheel_next_expiry( timer_wheel_t* wheel, uint64_t limit ) {
+    uint64_t expiry;
+
+    spinlock_disable( &wheel->lock );
+    expiry = do_timer_wheel_next_expiry( wheel, limit );
+    spinunlock_enable( &wheel->lock );
+
+    return expiry;
+}
+
+int init_timer_wheel( timer_wheel_t* wheel, uint64_t now ) {
+    int i;
+    int j;
+
+    init_spinlock( &wheel->lock, "timer wheel" );
+
+    wheel->current_tick = now >> TIMER_WHEEL_SHIFT;
+    wheel->count = 0;
+
+    for ( i = 0; i < TIMER_ROOT_SIZE; i++ ) {
+        init_waitqueue( &wheel->root[ i ] );
+    }
+
+    for ( i = 0; i < TIMER_LEVEL_COUNT; i++ ) {
+        for ( j = 0; j < TIMER_LEVEL_SIZE; j++ ) {
+            init_waitqueue( &wheel->levels[ i ][ j ] );
+        }
+    }
+
+    return 0;
+}
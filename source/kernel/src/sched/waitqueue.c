@@ -20,65 +20,6 @@
 #include <sched/waitqueue.h>
 #include <sched/scheduler.h>
 
-int waitqueue_add_node( waitqueue_t* queue, waitnode_t* node ) {
-    waitnode_t* current;
-
-    ASSERT( node->in_queue == false );
-
-    node->in_queue = true;
-
-    /* Insert the new node as the first or before the first node if the
-       waitqueue is empty or the wakeup time of the new node is less than
-       the wakeup time of the first node */
-
-    if ( ( queue->first_node == NULL ) || ( node->wakeup_time < queue->first_node->wakeup_time ) ) {
-        node->prev = NULL;
-        node->next = queue->first_node;
-
-        queue->first_node = node;
-
-        if ( node->next != NULL ) {
-            ASSERT( queue->last_node != NULL );
-            node->next->prev = node;
-        } else {
-            ASSERT( queue->last_node == NULL );
-            queue->last_node = node;
-        }
-
-        return 0;
-    }
-
-    /* We have to insert to a non-trivial position so loop throught the nodes
-       and find the appropriate position for the new node */
-
-    current = queue->first_node;
-
-    while ( current->next != NULL ) {
-        if ( node->wakeup_time < current->wakeup_time ) {
-            current->prev->next = node;
-            node->prev = current->prev;
-            node->next = current;
-            current->prev = node;
-
-            return 0;
-        }
-
-        current = current->next;
-    }
-
-    /* If we get here we have to insert the new node to the end of the queue */
-
-    ASSERT( current == queue->last_node );
-
-    node->prev = current;
-    node->next = NULL;
-
-    current->next = node;
-    queue->last_node = node;
-
-    return 0;
-}
-
 int waitqueue_add_node_tail( waitqueue_t* queue, waitnode_t* node ) {
     ASSERT( node->in_queue == false );
 
@@ -143,82 +84,6 @@ int waitqueue_remove_node( waitqueue_t* queue, waitnode_t* node ) {
     return 0;
 }
 
-int waitqueue_wake_up( waitqueue_t* queue, uint64_t now ) {
-    waitnode_t* node;
-    waitnode_t* next;
-
-    waitnode_t* callbacks = NULL;
-
-    scheduler_lock();
-
-    node = queue->first_node;
-
-    while ( ( node != NULL ) && ( node->wakeup_time <= now ) ) {
-        next = node->next;
-
-        switch ( node->type ) {
-            case WAIT_THREAD : {
-                thread_t* thread;
-
-                thread = get_thread_by_id( node->u.thread );
-
-                if ( __likely( thread != NULL ) ) {
-                    /* If the thread doesn't have time to run add
-                       it to the list of expired threads, otherwise
-                       add it to the ready list */
-
-                    if ( thread->quantum == 0 ) {
-                        add_thread_to_expired( thread );
-                    } else {
-                        add_thread_to_ready( thread );
-                    }
-                }
-
-                node->prev = NULL;
-                node->next = NULL;
-                node->in_queue = false;
-
-                break;
-            }
-
-            case WAIT_CALLBACK :
-                node->in_queue = false;
-                node->next = callbacks;
-                callbacks = node;
-
-                break;
-
-        }
-
-        node = next;
-    }
-
-    /* Update the waitqueue */
-
-    queue->first_node = node;
-
-    if ( queue->first_node != NULL ) {
-        queue->first_node->prev = NULL;
-    } else {
-        queue->last_node = NULL;
-    }
-
-    scheduler_unlock();
-
-    /* Fire callbacks */
-
-    while ( callbacks != NULL ) {
-        waitnode_t* callback;
-
-        callback = callbacks;
-        callbacks = callback->next;
-
-        callback->u.callback( callback->u.data );
-    }
-
-    return 0;
-}
-
 int waitqueue_wake_up_head( waitqueue_t* queue, int count ) {
     waitnode_t* node;
     waitnode_t* next;
@@ -95,6 +95,12 @@ uint32_t sys_get_processor_info( processor_info_t* info_table, uint32_t max_coun
         processor_info->running = cpu->running;
         processor_info->core_speed = cpu->core_speed;
         processor_info->features = cpu->features;
+        processor_info->tlb_ipis_sent = cpu->tlb_ipis_sent;
+        processor_info->tlb_ipis_received = cpu->tlb_ipis_received;
+        processor_info->tlb_full_flushes = cpu->tlb_full_flushes;
+        processor_info->tlb_page_flushes = cpu->tlb_page_flushes;
+        processor_info->run_queue_length = get_run_queue_length( &cpu->run_queue );
+        processor_info->migrations = cpu->run_queue.migrations;
     }
 
     return max;
@@ -36,6 +36,8 @@
 #include <vfs/vfs.h>
 #include <network/socket.h>
 #include <lock/mutex.h>
+#include <lock/futex.h>
+#include <lock/rwlock.h>
 
 //#define ENABLE_SYSCALL_TRACE
 
@@ -146,7 +148,20 @@ static system_call_entry_t system_call_table[] = {
     { "dlsym", sys_dlsym, 0, PARAM_COUNT(2) },
     { "dlgetglobalinit", sys_dlgetglobalinit, 0, PARAM_COUNT(3) },
     { "alloc_tld", sys_alloc_tld, 0, PARAM_COUNT(0) },
-    { "free_tlc", sys_free_tld, 0, PARAM_COUNT(1) | PARAM_TYPE(1, P_TYPE_INT) }
+    { "free_tlc", sys_free_tld, 0, PARAM_COUNT(1) | PARAM_TYPE(1, P_TYPE_INT) },
+    { "vfork", sys_vfork, SYSCALL_SAVE_STACK, PARAM_COUNT(0) },
+    { "set_thread_affinity", sys_set_thread_affinity, 0, PARAM_COUNT(0) },
+    { "get_thread_affinity", sys_get_thread_affinity, 0, PARAM_COUNT(0) },
+    { "sched_setscheduler", sys_sched_setscheduler, 0, PARAM_COUNT(0) },
+    { "sched_getscheduler", sys_sched_getscheduler, 0, PARAM_COUNT(0) },
+    { "get_time_page", sys_get_time_page, 0, PARAM_COUNT(0) },
+    { "futex_wait", sys_futex_wait, SYSCALL_DONT_TRACE, PARAM_COUNT(0) },
+    { "futex_wake", sys_futex_wake, SYSCALL_DONT_TRACE, PARAM_COUNT(0) },
+    { "rwlock_read_lock", sys_rwlock_read_lock, SYSCALL_DONT_TRACE, PARAM_COUNT(0) },
+    { "rwlock_write_lock", sys_rwlock_write_lock, SYSCALL_DONT_TRACE, PARAM_COUNT(0) },
+    { "rwlock_unlock", sys_rwlock_unlock, SYSCALL_DONT_TRACE, PARAM_COUNT(0) },
+    { "rwlock_create", sys_rwlock_create, SYSCALL_DONT_TRACE, PARAM_COUNT(0) },
+    { "rwlock_destroy", sys_rwlock_destroy, SYSCALL_DONT_TRACE, PARAM_COUNT(0) }
 };
 
 #ifdef ENABLE_SYSCALL_TRACE
@@ -211,7 +226,6 @@ static int trace_system_call_exit( system_call_entry_t* syscall, int result ) {
 
 int handle_system_call( uint32_t number, uint32_t* params, void* stack ) {
     int result;
-    uint64_t now;
     thread_t* thread;
     system_call_t* syscall;
     system_call_entry_t* syscall_entry;
@@ -227,13 +241,7 @@ int handle_system_call( uint32_t number, uint32_t* params, void* stack ) {
 
     /* Update timing information of the thread */
 
-    now = get_system_time();
-
-    scheduler_lock();
-    thread->in_system = 1;
-    thread->user_time += ( now - thread->prev_checkpoint );
-    thread->prev_checkpoint = now;
-    scheduler_unlock();
+    set_thread_in_system( thread, 1 );
 
     /* Save the stack after the system call */
 
@@ -273,13 +281,7 @@ int handle_system_call( uint32_t number, uint32_t* params, void* stack ) {
 
     ASSERT( thread->in_system );
 
-    now = get_system_time();
-
-    scheduler_lock();
-    thread->in_system = 0;
-    thread->sys_time += ( now - thread->prev_checkpoint );
-    thread->prev_checkpoint = now;
-    scheduler_unlock();
+    set_thread_in_system( thread, 0 );
 
     return result;
 }
@@ -18,6 +18,7 @@
 
 #include <thread.h>
 #include <errno.h>
+#include <fork.h>
 #include <kernel.h>
 #include <smp.h>
 #include <macros.h>
@@ -27,6 +28,7 @@
 #include <sched/scheduler.h>
 #include <mm/kmalloc.h>
 #include <mm/pages.h>
+#include <mm/userspace.h>
 #include <lib/hashtable.h>
 #include <lib/string.h>
 
@@ -83,6 +85,11 @@ thread_t* allocate_thread( const char* name, process_t* process, int priority, u
     thread->parent_id = -1;
     thread->state = THREAD_NEW;
     thread->priority = priority;
+    thread->dynamic_priority = priority;
+    thread->cpu = -1;
+    thread->cpu_affinity = THREAD_AFFINITY_ALL;
+    thread->sched_policy = SCHED_OTHER;
+    thread->rt_priority = 0;
     thread->process = process;
     thread->user_stack_end = NULL;
     thread->user_stack_region = NULL;
@@ -221,6 +228,17 @@ void thread_exit( int exit_code ) {
     thread->state = THREAD_ZOMBIE;
     thread->exit_code = exit_code;
 
+    /* A process created by vfork() gives back the memory context
+       of its parent if it exits before calling execve(). */
+
+    if ( __unlikely( thread->process->vfork_parent != NULL ) ) {
+        thread->process->memory_context = NULL;
+        thread->process->heap_region = NULL;
+        thread->process->time_page = 0;
+
+        vfork_release( thread->process );
+    }
+
     if ( __likely( thread->parent_id != -1 ) ) {
         thread_t* parent;
 
@@ -381,7 +399,7 @@ thread_id sys_create_thread( const char* name, int priority, thread_entry_t* ent
     thread->user_stack_region = memory_region_create(
         "stack",
         user_stack_size,
-        REGION_READ | REGION_WRITE | REGION_STACK
+        REGION_READ | REGION_WRITE | REGION_STACK | REGION_LAZY
     );
 
     if ( thread->user_stack_region == NULL ) {
@@ -411,6 +429,9 @@ thread_id sys_create_thread( const char* name, int priority, thread_entry_t* ent
 
     thread->in_system = 0;
     thread->parent_id = current->id;
+    thread->cpu_affinity = current->cpu_affinity;
+    thread->sched_policy = current->sched_policy;
+    thread->rt_priority = current->rt_priority;
 
     /* Get an unique ID to the new thread and add to the others */
 
@@ -475,13 +496,13 @@ static int do_sleep_thread( uint64_t microsecs, uint64_t* remaining ) {
     node.type = WAIT_THREAD;
     node.u.thread = thread->id;
 
-    waitqueue_add_node( &sleep_queue, &node );
+    timer_wheel_add_node( &sleep_queue, &node );
 
     scheduler_unlock();
     sched_preempt();
     scheduler_lock();
 
-    waitqueue_remove_node( &sleep_queue, &node );
+    timer_wheel_remove_node( &sleep_queue, &node );
 
     scheduler_unlock();
 
@@ -554,11 +575,26 @@ uint32_t sys_get_thread_count_for_process( process_id id ) {
 }
 
 uint32_t sys_get_thread_info_for_process( process_id id, thread_info_t* info_table, uint32_t max_count ) {
+    uint32_t count;
     thread_info_iter_data_t data;
 
+    /* Collect the informations into a kernel buffer, the user one
+       can't be touched while the scheduler is locked. See the same
+       note at sys_get_process_info(). */
+
+    count = MIN( sys_get_thread_count_for_process( id ), max_count );
+
+    if ( count == 0 ) {
+        return 0;
+    }
+
     data.curr_index = 0;
-    data.max_count = max_count;
-    data.info_table = info_table;
+    data.max_count = count;
+    data.info_table = ( thread_info_t* )kmalloc( sizeof( thread_info_t ) * count );
+
+    if ( data.info_table == NULL ) {
+        return 0;
+    }
 
     scheduler_lock();
 
@@ -572,6 +608,12 @@ uint32_t sys_get_thread_info_for_process( process_id id, thread_info_t* info_tab
 
     scheduler_unlock();
 
+    if ( copy_to_user( info_table, data.info_table, sizeof( thread_info_t ) * data.curr_index ) < 0 ) {
+        data.curr_index = 0;
+    }
+
+    kfree( data.info_table );
+
     return data.curr_index;
 }
 
@@ -638,6 +680,158 @@ int sys_wake_up_thread( thread_id id ) {
     return error;
 }
 
+static uint32_t get_running_processor_mask( void ) {
+    int i;
+    uint32_t mask;
+
+    mask = 0;
+
+    for ( i = 0; i < MAX_CPU_COUNT; i++ ) {
+        if ( processor_table[ i ].running ) {
+            mask |= ( 1 << i );
+        }
+    }
+
+    return mask;
+}
+
+int do_set_thread_affinity( thread_t* thread, uint32_t affinity ) {
+    ASSERT( scheduler_is_locked() );
+
+    if ( ( affinity & get_running_processor_mask() ) == 0 ) {
+        return -EINVAL;
+    }
+
+    thread->cpu_affinity = affinity;
+
+    /* Move the thread away if it is waiting in the run
+       queue of a CPU that is no longer allowed */
+
+    update_thread_affinity( thread );
+
+    return 0;
+}
+
+static int set_thread_affinity( thread_id id, uint32_t affinity ) {
+    int error;
+    bool preempt;
+    thread_t* thread;
+
+    preempt = false;
+
+    scheduler_lock();
+
+    thread = get_thread_by_id( id );
+
+    if ( thread != NULL ) {
+        error = do_set_thread_affinity( thread, affinity );
+
+        /* Give up the CPU if the current thread is not
+           allowed to run here anymore */
+
+        if ( ( error == 0 ) &&
+             ( thread == current_thread() ) &&
+             ( ( affinity & ( 1 << get_processor_index() ) ) == 0 ) ) {
+            preempt = true;
+        }
+    } else {
+        error = -EINVAL;
+    }
+
+    scheduler_unlock();
+
+    if ( preempt ) {
+        sched_preempt();
+    }
+
+    return error;
+}
+
+int thread_set_affinity( thread_id id, uint32_t affinity ) {
+    return set_thread_affinity( id, affinity );
+}
+
+int sys_set_thread_affinity( thread_id id, uint32_t affinity ) {
+    return set_thread_affinity( id, affinity );
+}
+
+int sys_get_thread_affinity( thread_id id, uint32_t* affinity ) {
+    thread_t* thread;
+    uint32_t cpu_affinity;
+
+    scheduler_lock();
+
+    thread = get_thread_by_id( id );
+
+    if ( thread == NULL ) {
+        scheduler_unlock();
+
+        return -EINVAL;
+    }
+
+    cpu_affinity = thread->cpu_affinity;
+
+    scheduler_unlock();
+
+    /* Writing the user pointer may page fault, so it
+       can't be done while the scheduler is locked */
+
+    *affinity = cpu_affinity;
+
+    return 0;
+}
+
+int thread_set_scheduler( thread_id id, int policy, int priority ) {
+    int error;
+    thread_t* thread;
+
+    scheduler_lock();
+
+    thread = get_thread_by_id( id );
+
+    if ( thread != NULL ) {
+        error = do_set_thread_scheduler( thread, policy, priority );
+    } else {
+        error = -EINVAL;
+    }
+
+    scheduler_unlock();
+
+    return error;
+}
+
+int sys_sched_setscheduler( thread_id id, int policy, int priority ) {
+    return thread_set_scheduler( id, policy, priority );
+}
+
+int sys_sched_getscheduler( thread_id id, int* priority ) {
+    int policy;
+    int rt_priority;
+    thread_t* thread;
+
+    scheduler_lock();
+
+    thread = get_thread_by_id( id );
+
+    if ( thread == NULL ) {
+        scheduler_unlock();
+
+        return -EINVAL;
+    }
+
+    policy = thread->sched_policy;
+    rt_priority = thread->rt_priority;
+
+    scheduler_unlock();
+
+    /* The user pointer is written after unlocking
+       the scheduler as it may page fault */
+
+    *priority = rt_priority;
+
+    return policy;
+}
+
 thread_id sys_gettid( void ) {
     return current_thread()->id;
 }
@@ -731,7 +925,9 @@ int dbg_show_thread_info( const char* params ) {
     dbg_printf( "  process: %s\n", thread->process->name );
     dbg_printf( "  name: %s\n", thread->name );
     dbg_printf( "  state: %s\n", thread_states[ thread->state ] );
-    dbg_printf( "  priority: %d\n", thread->priority );
+    dbg_printf( "  priority: %d (dynamic: %d)\n", thread->priority, thread->dynamic_priority );
+    dbg_printf( "  last cpu: %d, affinity: %08x\n", thread->cpu, thread->cpu_affinity );
+    dbg_printf( "  policy: %d (real-time priority: %d)\n", thread->sched_policy, thread->rt_priority );
     dbg_printf( "  in system: %d\n", thread->in_system );
     dbg_printf( "  system time: %llu, user time: %llu\n", thread->sys_time, thread->user_time );
     dbg_printf( "  pending signals: %llx\n", thread->pending_signals );
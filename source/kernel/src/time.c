@@ -20,6 +20,13 @@
 #include <lib/time.h>
 #include <time.h>
 #include <errno.h>
+#include <smp.h>
+#include <process.h>
+#include <lock/mutex.h>
+#include <mm/region.h>
+#include <mm/context.h>
+
+time_page_t* time_page = NULL;
 
 int sys_stime( int* tptr ) {
     if ( tptr == NULL ) {
@@ -69,3 +76,81 @@ int sys_get_idle_time( time_t* _time ) {
     *_time = get_idle_time();
     return 0;
 }
+
+/* Tells if the time page is still mapped to the specified address. The
+   region of the page can be deleted by the process, so the cached address
+   has to be checked before handing it out again. The reference taken on
+   the region keeps it mapped during the check. */
+static bool time_page_is_mapped( memory_context_t* context, ptr_t address ) {
+    bool mapped;
+    ptr_t physical;
+    memory_region_t* region;
+
+    region = memory_context_get_region_for( context, address );
+
+    if ( region == NULL ) {
+        return false;
+    }
+
+    mapped = ( ( region->address == address ) &&
+               ( ( region->flags & REGION_REMAPPED ) != 0 ) &&
+               ( memory_context_translate_address( context, address, &physical ) == 0 ) &&
+               ( physical == ( ptr_t )time_page ) );
+
+    memory_region_put( region );
+
+    return mapped;
+}
+
+int sys_get_time_page( void** address ) {
+    int error;
+    process_t* process;
+    memory_region_t* region;
+    memory_context_t* context;
+
+    if ( time_page == NULL ) {
+        return -ENOENT;
+    }
+
+    /* The page belongs to the owner of the memory context. A vfork()-ed
+       child borrows the context of its parent, so the mapping is recorded
+       on the parent and the child doesn't leave a stale address behind. */
+
+    context = current_process()->memory_context;
+    process = context->process;
+
+    mutex_lock( process->mutex, LOCK_IGNORE_SIGNAL );
+
+    if ( ( process->time_page != 0 ) &&
+         ( !time_page_is_mapped( context, process->time_page ) ) ) {
+        process->time_page = 0;
+    }
+
+    /* The page is mapped to the process on the first request */
+
+    if ( process->time_page == 0 ) {
+        region = memory_region_create( "time page", PAGE_SIZE, REGION_READ );
+
+        if ( region == NULL ) {
+            error = -ENOMEM;
+            goto out;
+        }
+
+        error = memory_region_remap_pages( region, ( ptr_t )time_page );
+
+        if ( error < 0 ) {
+            memory_region_put( region );
+            goto out;
+        }
+
+        process->time_page = region->address;
+    }
+
+    *address = ( void* )process->time_page;
+    error = 0;
+
+ out:
+    mutex_unlock( process->mutex );
+
+    return error;
+}
@@ -18,6 +18,7 @@
 
 #include <timer.h>
 #include <smp.h>
+#include <clockevent.h>
 #include <sched/scheduler.h>
 #include <lib/string.h>
 
@@ -48,7 +49,7 @@ int timer_setup( timer_t* timer, uint64_t expire_time ) {
     /* Remove the timer from the sleep list if it's already on it. */
 
     if ( node->in_queue ) {
-        waitqueue_remove_node( &sleep_queue, node );
+        timer_wheel_remove_node( &sleep_queue, node );
     }
 
     /* Update the timer node. */
@@ -57,7 +58,11 @@ int timer_setup( timer_t* timer, uint64_t expire_time ) {
 
     /* Put the timer to the sleep list. */
 
-    waitqueue_add_node( &sleep_queue, node );
+    timer_wheel_add_node( &sleep_queue, node );
+
+    /* Make sure that the timer is not late if this CPU is idle */
+
+    clockevent_timer_added( expire_time );
 
     scheduler_unlock();
 
@@ -74,7 +79,7 @@ int timer_cancel( timer_t* timer ) {
     /* Remove the timer from the sleep list if it's already on it. */
 
     if ( node->in_queue ) {
-        waitqueue_remove_node( &sleep_queue, node );
+        timer_wheel_remove_node( &sleep_queue, node );
     }
 
     scheduler_unlock();
@@ -0,0 +1,419 @@
+/* File page cache
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <types.h>
+#include <errno.h>
+#include <macros.h>
+#include <lock/mutex.h>
+#include <mm/pages.h>
+#include <mm/slab.h>
+#include <vfs/filecache.h>
+#include <vfs/vfs.h>
+#include <lib/string.h>
+
+#include <arch/mm/config.h>
+
+static lock_id file_cache_mutex;
+static hashtable_t file_page_table;
+static kmem_cache_t* file_page_cache;
+
+/* The most recently used page is at the head of the list */
+static file_page_t* lru_first = NULL;
+static file_page_t* lru_last = NULL;
+
+static file_cache_statistics_t file_cache_stats;
+
+static void file_page_lru_unlink( file_page_t* page ) {
+    if ( page->lru_prev == NULL ) {
+        lru_first = page->lru_next;
+    } else {
+        page->lru_prev->lru_next = page->lru_next;
+    }
+
+    if ( page->lru_next == NULL ) {
+        lru_last = page->lru_prev;
+    } else {
+        page->lru_next->lru_prev = page->lru_prev;
+    }
+}
+
+static void file_page_lru_insert( file_page_t* page ) {
+    page->lru_prev = NULL;
+    page->lru_next = lru_first;
+
+    if ( lru_first == NULL ) {
+        lru_last = page;
+    } else {
+        lru_first->lru_prev = page;
+    }
+
+    lru_first = page;
+}
+
+/* Removes a page from the cache and drops the reference of the
+   cache to the physical page. The cache has to be locked. */
+static void file_page_remove( file_page_t* page ) {
+    inode_t* inode;
+
+    inode = page->key.inode;
+
+    hashtable_remove( &file_page_table, ( const void* )&page->key );
+
+    if ( page->inode_prev == NULL ) {
+        inode->cached_pages = page->inode_next;
+    } else {
+        page->inode_prev->inode_next = page->inode_next;
+    }
+
+    if ( page->inode_next != NULL ) {
+        page->inode_next->inode_prev = page->inode_prev;
+    }
+
+    file_page_lru_unlink( page );
+
+    spinlock_disable( &pages_lock );
+    do_put_page( &memory_pages[ page->address / PAGE_SIZE ] );
+    spinunlock_enable( &pages_lock );
+
+    kmem_cache_free( file_page_cache, page );
+
+    file_cache_stats.page_count--;
+}
+
+static file_page_t* file_page_insert( inode_t* inode, uint32_t index, ptr_t address ) {
+    file_page_t* page;
+
+    page = ( file_page_t* )kmem_cache_alloc( file_page_cache );
+
+    if ( page == NULL ) {
+        return NULL;
+    }
+
+    page->key.inode = inode;
+    page->key.index = index;
+    page->address = address;
+
+    if ( hashtable_add( &file_page_table, ( hashitem_t* )page ) != 0 ) {
+        kmem_cache_free( file_page_cache, page );
+        return NULL;
+    }
+
+    page->inode_prev = NULL;
+    page->inode_next = inode->cached_pages;
+
+    if ( inode->cached_pages != NULL ) {
+        inode->cached_pages->inode_prev = page;
+    }
+
+    inode->cached_pages = page;
+
+    file_page_lru_insert( page );
+
+    file_cache_stats.page_count++;
+
+    return page;
+}
+
+static inline file_page_t* file_page_lookup( inode_t* inode, uint32_t index ) {
+    file_page_key_t key;
+
+    key.inode = inode;
+    key.index = index;
+
+    return ( file_page_t* )hashtable_get( &file_page_table, ( const void* )&key );
+}
+
+/* Takes a reference to a cached page for the caller and moves
+   it to the head of the LRU list. The cache has to be locked. */
+static ptr_t file_page_get( file_page_t* page ) {
+    spinlock_disable( &pages_lock );
+    memory_pages[ page->address / PAGE_SIZE ].ref_count++;
+    spinunlock_enable( &pages_lock );
+
+    file_page_lru_unlink( page );
+    file_page_lru_insert( page );
+
+    return page->address;
+}
+
+static uint32_t do_file_cache_shrink( uint32_t count ) {
+    uint32_t freed;
+    file_page_t* page;
+    file_page_t* prev;
+
+    freed = 0;
+
+    for ( page = lru_last; ( page != NULL ) && ( freed < count ); page = prev ) {
+        prev = page->lru_prev;
+
+        /* Pages mapped to a region can't be evicted. New references are taken
+           only with the cache locked, so the page can't be mapped meanwhile. */
+
+        if ( memory_pages[ page->address / PAGE_SIZE ].ref_count > 1 ) {
+            continue;
+        }
+
+        file_page_remove( page );
+
+        freed++;
+    }
+
+    file_cache_stats.evictions += freed;
+
+    return freed;
+}
+
+int file_cache_get_pages( file_t* file, uint32_t index, uint32_t count, ptr_t* pages ) {
+    int error;
+    uint32_t i;
+    uint8_t* data;
+    inode_t* inode;
+    file_page_t* page;
+    uint32_t sequence;
+
+    ASSERT( count > 0 );
+
+    inode = file->inode;
+
+    mutex_lock( file_cache_mutex, LOCK_IGNORE_SIGNAL );
+
+    /* Return the cached pages from the start of the range */
+
+    for ( i = 0; i < count; i++ ) {
+        page = file_page_lookup( inode, index + i );
+
+        if ( page == NULL ) {
+            break;
+        }
+
+        pages[ i ] = file_page_get( page );
+    }
+
+    if ( i > 0 ) {
+        file_cache_stats.hits += i;
+
+        mutex_unlock( file_cache_mutex );
+
+        return i;
+    }
+
+    /* The first page is not cached, read all the missing
+       pages from the start of the range with one request. */
+
+    for ( i = 1; i < count; i++ ) {
+        if ( file_page_lookup( inode, index + i ) != NULL ) {
+            break;
+        }
+    }
+
+    count = i;
+
+    if ( get_free_page_count() < FILE_CACHE_LOW_FREE_PAGES + count ) {
+        do_file_cache_shrink( FILE_CACHE_SHRINK_BATCH );
+    }
+
+    sequence = inode->cache_sequence;
+
+    mutex_unlock( file_cache_mutex );
+
+    data = ( uint8_t* )alloc_pages( count, MEM_COMMON );
+
+    if ( data == NULL ) {
+        file_cache_shrink( count + FILE_CACHE_SHRINK_BATCH );
+        data = ( uint8_t* )alloc_pages( count, MEM_COMMON );
+    }
+
+    /* The memory may be too fragmented for a big block,
+       the first page is still read on its own then. */
+
+    if ( ( data == NULL ) && ( count > 1 ) ) {
+        count = 1;
+        data = ( uint8_t* )alloc_pages( count, MEM_COMMON );
+    }
+
+    if ( data == NULL ) {
+        return -ENOMEM;
+    }
+
+    error = do_pread_helper( file, data, count * PAGE_SIZE, ( off_t )index * PAGE_SIZE );
+
+    if ( error < 0 ) {
+        free_pages( data, count );
+        return -EIO;
+    }
+
+    /* The part after the end of the file is filled with zeros */
+
+    if ( error < count * PAGE_SIZE ) {
+        memset( data + error, 0, count * PAGE_SIZE - error );
+    }
+
+    mutex_lock( file_cache_mutex, LOCK_IGNORE_SIGNAL );
+
+    file_cache_stats.misses += count;
+
+    for ( i = 0; i < count; i++, data += PAGE_SIZE ) {
+        /* An other thread could read the same page in the meantime,
+           the one in the cache is used then. */
+
+        page = file_page_lookup( inode, index + i );
+
+        if ( page != NULL ) {
+            pages[ i ] = file_page_get( page );
+            free_pages( data, 1 );
+
+            continue;
+        }
+
+        /* The file was modified while it was read, the data may be
+           stale so it is given to the caller without caching it. */
+
+        if ( inode->cache_sequence != sequence ) {
+            pages[ i ] = ( ptr_t )data;
+
+            continue;
+        }
+
+        page = file_page_insert( inode, index + i, ( ptr_t )data );
+
+        if ( page == NULL ) {
+            /* The page could not be cached, the caller gets its only reference */
+
+            pages[ i ] = ( ptr_t )data;
+        } else {
+            pages[ i ] = file_page_get( page );
+        }
+    }
+
+    mutex_unlock( file_cache_mutex );
+
+    return count;
+}
+
+void file_cache_invalidate( inode_t* inode, off_t offset, off_t size ) {
+    uint32_t first;
+    uint32_t last;
+    file_page_t* page;
+    file_page_t* next;
+
+    if ( size <= 0 ) {
+        return;
+    }
+
+    first = offset / PAGE_SIZE;
+    last = ( offset + size - 1 ) / PAGE_SIZE;
+
+    mutex_lock( file_cache_mutex, LOCK_IGNORE_SIGNAL );
+
+    inode->cache_sequence++;
+
+    for ( page = inode->cached_pages; page != NULL; page = next ) {
+        next = page->inode_next;
+
+        if ( ( page->key.index >= first ) &&
+             ( page->key.index <= last ) ) {
+            file_page_remove( page );
+        }
+    }
+
+    mutex_unlock( file_cache_mutex );
+}
+
+void file_cache_drop_inode( inode_t* inode ) {
+    mutex_lock( file_cache_mutex, LOCK_IGNORE_SIGNAL );
+
+    inode->cache_sequence++;
+
+    while ( inode->cached_pages != NULL ) {
+        file_page_remove( inode->cached_pages );
+    }
+
+    mutex_unlock( file_cache_mutex );
+}
+
+uint32_t file_cache_shrink( uint32_t count ) {
+    uint32_t freed;
+
+    mutex_lock( file_cache_mutex, LOCK_IGNORE_SIGNAL );
+    freed = do_file_cache_shrink( count );
+    mutex_unlock( file_cache_mutex );
+
+    return freed;
+}
+
+void file_cache_get_statistics( file_cache_statistics_t* stats ) {
+    mutex_lock( file_cache_mutex, LOCK_IGNORE_SIGNAL );
+    memcpy( stats, &file_cache_stats, sizeof( file_cache_statistics_t ) );
+    mutex_unlock( file_cache_mutex );
+}
+
+static void* file_page_key( hashitem_t* item ) {
+    file_page_t* page;
+
+    page = ( file_page_t* )item;
+
+    return ( void* )&page->key;
+}
+
+static uint32_t file_page_hash( const void* key ) {
+    return hash_number( ( uint8_t* )key, sizeof( file_page_key_t ) );
+}
+
+static bool file_page_compare( const void* key1, const void* key2 ) {
+    return ( memcmp( key1, key2, sizeof( file_page_key_t ) ) == 0 );
+}
+
+__init int init_file_cache( void ) {
+    int error;
+
+    file_page_cache = kmem_cache_create( "file_page", sizeof( file_page_t ) );
+
+    if ( file_page_cache == NULL ) {
+        error = -ENOMEM;
+        goto error1;
+    }
+
+    error = init_hashtable(
+        &file_page_table, 256,
+        file_page_key, file_page_hash, file_page_compare
+    );
+
+    if ( error < 0 ) {
+        goto error2;
+    }
+
+    file_cache_mutex = mutex_create( "file cache mutex", MUTEX_NONE );
+
+    if ( file_cache_mutex < 0 ) {
+        error = file_cache_mutex;
+        goto error3;
+    }
+
+    memset( &file_cache_stats, 0, sizeof( file_cache_statistics_t ) );
+
+    return 0;
+
+ error3:
+    destroy_hashtable( &file_page_table );
+
+ error2:
+    kmem_cache_destroy( file_page_cache );
+
+ error1:
+    return error;
+}
@@ -21,10 +21,15 @@
 #include <errno.h>
 #include <console.h>
 #include <mm/kmalloc.h>
+#include <mm/slab.h>
+#include <lock/rwlock.h>
 #include <vfs/inode.h>
+#include <vfs/filecache.h>
 #include <vfs/vfs.h>
 #include <lib/string.h>
 
+static kmem_cache_t* inode_kmem_cache;
+
 inode_t* get_inode( mount_point_t* mount_point, ino_t inode_number ) {
     int error;
     inode_t* inode;
@@ -33,9 +38,11 @@ inode_t* get_inode( mount_point_t* mount_point, ino_t inode_number ) {
 
     cache = &mount_point->inode_cache;
 
-    mutex_lock( cache->mutex, LOCK_IGNORE_SIGNAL );
+    /* Get the inode from the hashtable. Lookups of cached inodes
+       only need the read lock, the reference counter is incremented
+       atomically. */
 
-    /* Get the inode from the hashtable */
+    rwlock_read_lock( cache->lock, LOCK_IGNORE_SIGNAL );
 
     inode = ( inode_t* )hashtable_get( &cache->inode_table, ( const void* )&inode_number );
 
@@ -45,15 +52,32 @@ inode_t* get_inode( mount_point_t* mount_point, ino_t inode_number ) {
     if ( inode != NULL ) {
         atomic_inc( &inode->ref_count );
 
-        mutex_unlock( cache->mutex );
+        rwlock_read_unlock( cache->lock );
+
+        return inode;
+    }
+
+    rwlock_read_unlock( cache->lock );
+
+    /* The inode is not cached, take the write lock and check the table
+       again as somebody else could load the same inode in the meantime. */
+
+    rwlock_write_lock( cache->lock, LOCK_IGNORE_SIGNAL );
+
+    inode = ( inode_t* )hashtable_get( &cache->inode_table, ( const void* )&inode_number );
+
+    if ( inode != NULL ) {
+        atomic_inc( &inode->ref_count );
+
+        rwlock_write_unlock( cache->lock );
 
         return inode;
     }
 
     /* The inode is not found so we have to load it. First
        allocate a new inode structure. We get it from the
-       free inode list if it isn't empty, otherwise we use
-       kmalloc to create it. */
+       free inode list if it isn't empty, otherwise we
+       allocate it from the inode object cache. */
 
     if ( cache->free_inode_count > 0 ) {
         ASSERT( cache->free_inodes != NULL );
@@ -64,10 +88,10 @@ inode_t* get_inode( mount_point_t* mount_point, ino_t inode_number ) {
 
         ASSERT( cache->free_inode_count >= 0 );
     } else {
-        inode = ( inode_t* )kmalloc( sizeof( inode_t ) );
+        inode = ( inode_t* )kmem_cache_alloc( inode_kmem_cache );
 
         if ( inode == NULL ) {
-            mutex_unlock( cache->mutex );
+            rwlock_write_unlock( cache->lock );
 
             return NULL;
         }
@@ -78,6 +102,8 @@ inode_t* get_inode( mount_point_t* mount_point, ino_t inode_number ) {
     inode->inode_number = inode_number;
     inode->mount_point = mount_point;
     inode->mount = NULL;
+    inode->cached_pages = NULL;
+    inode->cache_sequence = 0;
     atomic_set( &inode->ref_count, 1 );
 
     /* Read the inode from the filesystem */
@@ -99,9 +125,9 @@ inode_t* get_inode( mount_point_t* mount_point, ino_t inode_number ) {
             inode = NULL;
         }
 
-        mutex_unlock( cache->mutex );
+        rwlock_write_unlock( cache->lock );
 
-        kfree( inode );
+        kmem_cache_free( inode_kmem_cache, inode );
 
         return NULL;
     }
@@ -124,19 +150,20 @@ inode_t* get_inode( mount_point_t* mount_point, ino_t inode_number ) {
             mount_point->fs_calls->write_inode( mount_point->fs_data, tmp_fs_node );
         }
 
-        mutex_unlock( cache->mutex );
+        rwlock_write_unlock( cache->lock );
 
-        kfree( inode );
+        kmem_cache_free( inode_kmem_cache, inode );
 
         return NULL;
     }
 
-    mutex_unlock( cache->mutex );
+    rwlock_write_unlock( cache->lock );
 
     return inode;
 }
 
 int put_inode( inode_t* inode ) {
+    int ref_count;
     void* tmp_fs_node;
     inode_cache_t* cache;
     mount_point_t* mount_point;
@@ -144,7 +171,24 @@ int put_inode( inode_t* inode ) {
     mount_point = inode->mount_point;
     cache = &mount_point->inode_cache;
 
-    mutex_lock( cache->mutex, LOCK_IGNORE_SIGNAL );
+    /* Drop the reference without locking the cache if it is not the
+       last one, only the removal of the inode has to be locked. */
+
+    ref_count = atomic_get( &inode->ref_count );
+
+    while ( ref_count > 1 ) {
+        int old;
+
+        old = atomic_cmpxchg( &inode->ref_count, ref_count, ref_count - 1 );
+
+        if ( old == ref_count ) {
+            return 0;
+        }
+
+        ref_count = old;
+    }
+
+    rwlock_write_lock( cache->lock, LOCK_IGNORE_SIGNAL );
 
     ASSERT( atomic_get( &inode->ref_count ) > 0 );
 
@@ -155,6 +199,10 @@ int put_inode( inode_t* inode ) {
 
         hashtable_remove( &cache->inode_table, ( const void* )&inode->inode_number );
 
+        /* Drop the cached pages of the file */
+
+        file_cache_drop_inode( inode );
+
         /* Add the inode to the free list if it's not full */
 
         if ( cache->free_inode_count < cache->max_free_inode_count ) {
@@ -166,7 +214,7 @@ int put_inode( inode_t* inode ) {
 
         /* Free the inode */
 
-        kfree( inode );
+        kmem_cache_free( inode_kmem_cache, inode );
 
         /* Write the inode */
 
@@ -175,7 +223,7 @@ int put_inode( inode_t* inode ) {
         }
     }
 
-    mutex_unlock( cache->mutex );
+    rwlock_write_unlock( cache->lock );
 
     return 0;
 }
@@ -439,11 +487,11 @@ int lookup_inode( io_context_t* io_context, inode_t* parent, const char* path, i
 uint32_t get_inode_cache_size( inode_cache_t* cache ) {
     uint32_t size;
 
-    mutex_lock( cache->mutex, LOCK_IGNORE_SIGNAL );
+    rwlock_read_lock( cache->lock, LOCK_IGNORE_SIGNAL );
 
     size = hashtable_get_item_count( &cache->inode_table );
 
-    mutex_unlock( cache->mutex );
+    rwlock_read_unlock( cache->lock );
 
     return size;
 }
@@ -467,13 +515,13 @@ int init_inode_cache( inode_cache_t* cache, int current_size, int free_inodes, i
         return error;
     }
 
-    /* Create the inode cache semaphore */
+    /* Create the inode cache lock */
 
-    cache->mutex = mutex_create( "inode cache mutex", MUTEX_NONE );
+    cache->lock = rwlock_create( "inode cache lock" );
 
-    if ( cache->mutex < 0 ) {
+    if ( cache->lock < 0 ) {
         destroy_hashtable( &cache->inode_table );
-        return cache->mutex;
+        return cache->lock;
     }
 
     /* Create the initial free inodes */
@@ -483,7 +531,7 @@ int init_inode_cache( inode_cache_t* cache, int current_size, int free_inodes, i
     cache->free_inodes = NULL;
 
     for ( i = 0; i < free_inodes; i++ ) {
-        inode = ( inode_t* )kmalloc( sizeof( inode_t ) );
+        inode = ( inode_t* )kmem_cache_alloc( inode_kmem_cache );
 
         if ( inode == NULL ) {
             inode_t* tmp;
@@ -492,11 +540,11 @@ int init_inode_cache( inode_cache_t* cache, int current_size, int free_inodes, i
                 tmp = cache->free_inodes;
                 cache->free_inodes = tmp->next_free;
 
-                kfree( tmp );
+                kmem_cache_free( inode_kmem_cache, tmp );
             }
 
             destroy_hashtable( &cache->inode_table );
-            mutex_destroy( cache->mutex );
+            rwlock_destroy( cache->lock );
 
             return -ENOMEM;
         }
@@ -518,7 +566,7 @@ void destroy_inode_cache( inode_cache_t* cache ) {
     /* TODO: destroy loaded inodes? */
 
     destroy_hashtable( &cache->inode_table );
-    mutex_destroy( cache->mutex );
+    rwlock_destroy( cache->lock );
 
     inode = cache->free_inodes;
 
@@ -526,6 +574,16 @@ void destroy_inode_cache( inode_cache_t* cache ) {
         inode = cache->free_inodes;
         cache->free_inodes = inode->next_free;
 
-        kfree( inode );
+        kmem_cache_free( inode_kmem_cache, inode );
     }
 }
+
+__init int init_inode_allocator( void ) {
+    inode_kmem_cache = kmem_cache_create( "inode", sizeof( inode_t ) );
+
+    if ( inode_kmem_cache == NULL ) {
+        return -ENOMEM;
+    }
+
+    return 0;
+}
@@ -25,6 +25,7 @@
 #include <lib/string.h>
 
 static lock_id inode_lock;
+static lock_id update_lock;
 static hashtable_t inode_table;
 static ino_t next_inode_number = 0;
 
@@ -48,6 +49,8 @@ static kdbgfs_node_t* kdebugfs_do_create_node( const char* name, size_t max_buff
     node->buffer = node->name + name_length + 1;
     node->buffer_size = 0;
     node->max_buffer_size = max_buffer_size;
+    node->update = NULL;
+    node->update_data = NULL;
 
     mutex_lock( inode_lock, LOCK_IGNORE_SIGNAL );
 
@@ -172,6 +175,34 @@ static int kdebugfs_open( void* fs_cookie, void* _node, int mode, void** file_co
         cookie->position = 0;
 
         *file_cookie = ( void* )cookie;
+    } else if ( node->update != NULL ) {
+        kdbgfs_snapshot_t* snapshot;
+
+        /* The update function rebuilds the shared buffer of the node,
+           so only one of them can run at a time. The result is copied
+           while the update lock is held. */
+
+        mutex_lock( update_lock, LOCK_IGNORE_SIGNAL );
+
+        node->update( node, node->update_data );
+
+        mutex_lock( inode_lock, LOCK_IGNORE_SIGNAL );
+
+        snapshot = ( kdbgfs_snapshot_t* )kmalloc( sizeof( kdbgfs_snapshot_t ) + node->buffer_size );
+
+        if ( snapshot != NULL ) {
+            snapshot->size = node->buffer_size;
+            memcpy( snapshot->data, node->buffer, node->buffer_size );
+        }
+
+        mutex_unlock( inode_lock );
+        mutex_unlock( update_lock );
+
+        if ( snapshot == NULL ) {
+            return -ENOMEM;
+        }
+
+        *file_cookie = ( void* )snapshot;
     }
 
     return 0;
@@ -182,7 +213,8 @@ static int kdebugfs_close( void* fs_cookie, void* _node, void* file_cookie ) {
 
     node = ( kdbgfs_node_t* )_node;
 
-    if ( node == root_node ) {
+    if ( ( node == root_node ) ||
+         ( node->update != NULL ) ) {
         kfree( file_cookie );
     }
 
@@ -202,6 +234,24 @@ static int kdebugfs_read( void* fs_cookie, void* _node, void* file_cookie, void*
         return -EISDIR;
     }
 
+    if ( node->update != NULL ) {
+        kdbgfs_snapshot_t* snapshot;
+
+        snapshot = ( kdbgfs_snapshot_t* )file_cookie;
+
+        if ( pos >= snapshot->size ) {
+            return 0;
+        }
+
+        if ( size > ( snapshot->size - pos ) ) {
+            size = snapshot->size - pos;
+        }
+
+        memcpy( buffer, snapshot->data + pos, size );
+
+        return size;
+    }
+
     if ( pos >= node->buffer_size ) {
         return 0;
     }
@@ -381,6 +431,23 @@ int kdebugfs_write_node( kdbgfs_node_t* node, void* data, size_t size ) {
     return 0;
 }
 
+int kdebugfs_clear_node( kdbgfs_node_t* node ) {
+    mutex_lock( inode_lock, LOCK_IGNORE_SIGNAL );
+    node->buffer_size = 0;
+    mutex_unlock( inode_lock );
+
+    return 0;
+}
+
+int kdebugfs_set_update( kdbgfs_node_t* node, kdbgfs_update_t* update, void* data ) {
+    mutex_lock( inode_lock, LOCK_IGNORE_SIGNAL );
+    node->update = update;
+    node->update_data = data;
+    mutex_unlock( inode_lock );
+
+    return 0;
+}
+
 static void* kdebugfs_inode_key( hashitem_t* item ) {
     kdbgfs_node_t* node;
 
@@ -408,6 +475,13 @@ __init int init_kdebugfs( void ) {
         return inode_lock;
     }
 
+    update_lock = mutex_create( "kdbgfs update lock", MUTEX_NONE );
+
+    if ( update_lock < 0 ) {
+        mutex_destroy( inode_lock );
+        return update_lock;
+    }
+
     error = register_filesystem( "kdebugfs", &kdebugfs_calls );
 
     if ( error < 0 ) {
@@ -29,6 +29,7 @@
 #include <vfs/inode.h>
 #include <vfs/devfs.h>
 #include <vfs/kdebugfs.h>
+#include <vfs/filecache.h>
 #include <lib/string.h>
 
 io_context_t kernel_io_context;
@@ -267,6 +268,12 @@ static int do_open_helper1( io_context_t* io_context, file_t* file, inode_t** _p
         if ( error < 0 ) {
             return error;
         }
+
+        /* The contents of the file are gone, drop the cached pages */
+
+        if ( flags & O_TRUNC ) {
+            file_cache_drop_inode( file->inode );
+        }
     }
 
     return 0;
@@ -486,6 +493,14 @@ static int do_read( io_context_t* io_context, int fd, void* buffer, size_t count
     }
 
     if ( error > 0 ) {
+        /* Appending writes don't happen at the current position */
+
+        if ( file->flags & O_APPEND ) {
+            file_cache_drop_inode( file->inode );
+        } else {
+            file_cache_invalidate( file->inode, file->position, error );
+        }
+
         file->position += error;
     }
 
@@ -525,6 +540,10 @@ static int do_pwrite( io_context_t* io_context, int fd, const void* buffer, size
             offset,
             count
         );
+
+        if ( error > 0 ) {
+            file_cache_invalidate( file->inode, offset, error );
+        }
     } else {
         error = -ENOSYS;
     }
@@ -576,6 +595,14 @@ static int do_write( io_context_t* io_context, int fd, const void* buffer, size_
     }
 
     if ( error > 0 ) {
+        /* Appending writes don't happen at the current position */
+
+        if ( file->flags & O_APPEND ) {
+            file_cache_drop_inode( file->inode );
+        } else {
+            file_cache_invalidate( file->inode, file->position, error );
+        }
+
         file->position += error;
     }
 
@@ -1712,6 +1739,22 @@ __init int init_vfs( void ) {
 
     mount_points = NULL;
 
+    /* Initialize the inode allocator */
+
+    error = init_inode_allocator();
+
+    if ( error < 0 ) {
+        goto error1;
+    }
+
+    /* Initialize the file page cache */
+
+    error = init_file_cache();
+
+    if ( error < 0 ) {
+        goto error1;
+    }
+
     /* Initialize the kernel I/O context */
 
     error = init_io_context( &kernel_io_context, INIT_FILE_TABLE_SIZE );
@@ -0,0 +1,264 @@
+/* Benchmark for the page allocator
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#define PAGE_SIZE 4096
+#define MEMORY_SIZE ( 256 * 1024 * 1024 )
+#define PAGE_COUNT ( MEMORY_SIZE / PAGE_SIZE )
+#define FIRST_PAGE ( 0x100000 / PAGE_SIZE )
+#define KERNEL_PAGES ( 4 * 1024 * 1024 / PAGE_SIZE )
+
+#define BATCH_SIZE 64
+#define ROUNDS 64
+
+/* Page allocator interface (kernel/include/mm/pages.h) */
+
+int init_page_allocator( unsigned int page_map_address, unsigned long long _memory_size );
+int register_memory_type( int mem_type, unsigned int start, unsigned int size );
+int reserve_memory_pages( unsigned int start, unsigned int size );
+void* alloc_pages( unsigned int count, int mem_type );
+void free_pages( void* address, unsigned int count );
+unsigned int get_free_page_count( void );
+
+/* Kernel functions used by the page allocator */
+
+/* Big enough to hold the cpu_t structures of the kernel. The per-CPU
+   page caches are not enabled by the benchmark. */
+char processor_table[ 64 * 1024 ];
+
+void* get_processor( void ) {
+    return processor_table;
+}
+
+int disable_interrupts( void ) {
+    return 0;
+}
+
+void enable_interrupts( void ) {
+}
+
+void spinlock( void* lock ) {
+}
+
+void spinunlock( void* lock ) {
+}
+
+void spinlock_disable( void* lock ) {
+}
+
+void spinunlock_enable( void* lock ) {
+}
+
+int get_kernel_param_as_int( const char* key, int* value ) {
+    return -1;
+}
+
+/* Only referenced by sys_get_memory_info(), which the benchmark never
+   calls, so the statistics structures don't have to be filled. */
+
+void kmalloc_get_statistics( void* stats ) {
+}
+
+void file_cache_get_statistics( void* stats ) {
+}
+
+void memory_region_get_fault_statistics( void* stats ) {
+}
+
+void handle_panic( const char* file, int line, const char* format, ... ) {
+    va_list args;
+
+    printf( "panic at %s:%d: ", file, line );
+
+    va_start( args, format );
+    vprintf( format, args );
+    va_end( args );
+
+    exit( 1 );
+}
+
+static inline unsigned long long rdtsc( void ) {
+    unsigned int low;
+    unsigned int high;
+
+    __asm__ __volatile__( "rdtsc" : "=a" ( low ), "=d" ( high ) );
+
+    return ( ( unsigned long long )high << 32 ) | low;
+}
+
+/* The linear page scanner used by the page allocator before the buddy
+   allocator was introduced. It is kept here as the reference. */
+
+static int scan_pages[ PAGE_COUNT ];
+
+static void* scan_alloc_pages( unsigned int count ) {
+    unsigned int i;
+    unsigned int j;
+    unsigned int free_count = 0;
+
+    for ( i = FIRST_PAGE; i < PAGE_COUNT; i++ ) {
+        if ( scan_pages[ i ] != 0 ) {
+            free_count = 0;
+            continue;
+        }
+
+        if ( ++free_count == count ) {
+            i -= count - 1;
+
+            for ( j = 0; j < count; j++ ) {
+                scan_pages[ i + j ] = 1;
+            }
+
+            return ( void* )( i * PAGE_SIZE );
+        }
+    }
+
+    return NULL;
+}
+
+static void scan_free_pages( void* address, unsigned int count ) {
+    unsigned int i;
+    unsigned int index = ( unsigned int )address / PAGE_SIZE;
+
+    for ( i = 0; i < count; i++ ) {
+        scan_pages[ index + i ] = 0;
+    }
+}
+
+static void setup_allocators( void ) {
+    unsigned int i;
+    unsigned int fragment_count;
+    void** fragments;
+    void* page_map;
+
+    /* Buddy allocator: reserve the "kernel" then fragment the first half
+       of the memory by freeing every second single page allocation. */
+
+    page_map = malloc( PAGE_COUNT * 32 );
+
+    init_page_allocator( ( unsigned int )page_map, MEMORY_SIZE );
+    register_memory_type( 0, 0x100000, MEMORY_SIZE - 0x100000 );
+    reserve_memory_pages( 0x100000, KERNEL_PAGES * PAGE_SIZE );
+
+    fragment_count = ( PAGE_COUNT - FIRST_PAGE - KERNEL_PAGES ) / 2;
+    fragments = ( void** )malloc( fragment_count * sizeof( void* ) );
+
+    for ( i = 0; i < fragment_count; i++ ) {
+        fragments[ i ] = alloc_pages( 1, 0 );
+    }
+
+    for ( i = 0; i < fragment_count; i += 2 ) {
+        free_pages( fragments[ i ], 1 );
+    }
+
+    free( fragments );
+
+    /* Linear scanner: the same layout */
+
+    memset( scan_pages, 0, sizeof( scan_pages ) );
+
+    for ( i = FIRST_PAGE; i < FIRST_PAGE + KERNEL_PAGES; i++ ) {
+        scan_pages[ i ] = 1;
+    }
+
+    for ( ; i < FIRST_PAGE + KERNEL_PAGES + fragment_count; i += 2 ) {
+        scan_pages[ i + 1 ] = 1;
+    }
+}
+
+typedef void* alloc_func_t( unsigned int count );
+typedef void free_func_t( void* address, unsigned int count );
+
+static void* buddy_alloc_pages( unsigned int count ) {
+    return alloc_pages( count, 0 );
+}
+
+static void run_benchmark( alloc_func_t* alloc_func, free_func_t* free_func, unsigned int count,
+                           unsigned long long* alloc_cycles, unsigned long long* free_cycles ) {
+    int i;
+    int j;
+    unsigned long long start;
+    void* pages[ BATCH_SIZE ];
+
+    *alloc_cycles = 0;
+    *free_cycles = 0;
+
+    for ( i = 0; i < ROUNDS; i++ ) {
+        start = rdtsc();
+
+        for ( j = 0; j < BATCH_SIZE; j++ ) {
+            pages[ j ] = alloc_func( count );
+        }
+
+        *alloc_cycles += rdtsc() - start;
+
+        for ( j = 0; j < BATCH_SIZE; j++ ) {
+            if ( pages[ j ] == NULL ) {
+                printf( "Failed to allocate %u pages!\n", count );
+                exit( 1 );
+            }
+        }
+
+        start = rdtsc();
+
+        for ( j = BATCH_SIZE - 1; j >= 0; j-- ) {
+            free_func( pages[ j ], count );
+        }
+
+        *free_cycles += rdtsc() - start;
+    }
+
+    *alloc_cycles /= ROUNDS * BATCH_SIZE;
+    *free_cycles /= ROUNDS * BATCH_SIZE;
+}
+
+int main( int argc, char** argv ) {
+    unsigned int i;
+    unsigned int free_page_count;
+    unsigned long long scan_alloc;
+    unsigned long long scan_free;
+    unsigned long long buddy_alloc;
+    unsigned long long buddy_free;
+    static unsigned int counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    setup_allocators();
+
+    free_page_count = get_free_page_count();
+
+    printf( "Page allocator benchmark (%u Mb, %u free pages, first half fragmented)\n\n",
+            MEMORY_SIZE / ( 1024 * 1024 ), free_page_count );
+    printf( "pages   scanner alloc   scanner free   buddy alloc   buddy free (cycles/call)\n" );
+
+    for ( i = 0; i < sizeof( counts ) / sizeof( counts[ 0 ] ); i++ ) {
+        run_benchmark( scan_alloc_pages, scan_free_pages, counts[ i ], &scan_alloc, &scan_free );
+        run_benchmark( buddy_alloc_pages, free_pages, counts[ i ], &buddy_alloc, &buddy_free );
+
+        printf( "%5u %15llu %14llu %13llu %12llu\n", counts[ i ], scan_alloc, scan_free, buddy_alloc, buddy_free );
+    }
+
+    if ( get_free_page_count() != free_page_count ) {
+        printf( "Free page count mismatch: %u instead of %u!\n", get_free_page_count(), free_page_count );
+        return 1;
+    }
+
+    return 0;
+}
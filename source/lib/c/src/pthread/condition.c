@@ -19,88 +19,105 @@
 #include <pthread.h>
 #include <errno.h>
 
-#include <yaosp/debug.h>
-#include <yaosp/syscall.h>
-#include <yaosp/syscall_table.h>
+#include <yaosp/atomic.h>
+#include <yaosp/futex.h>
+
+#include "pthread_int.h"
+
+/* Waiters sleep on the sequence number of the condition variable, it is
+   increased by every signal and broadcast. A wakeup that happens after
+   the waiter released the mutex changes the sequence, so futex_wait()
+   returns immediately and the wakeup can't be lost. The number of waiters
+   is kept to avoid the system call when nobody waits. */
 
 int pthread_cond_init( pthread_cond_t* cond, const pthread_condattr_t* attr ) {
     if ( cond == NULL ) {
         return EINVAL;
     }
 
-    cond->cond_id = syscall1( SYS_condition_create, ( int )"pthread condition" );
-
-    if ( cond->cond_id < 0 ) {
-        return -cond->cond_id;
-    }
-
-    cond->init_magic = PTHREAD_COND_MAGIC;
+    cond->sequence = 0;
+    cond->waiters = 0;
 
     return 0;
 }
 
 int pthread_cond_destroy( pthread_cond_t* cond ) {
-    /* TODO */
-
-    dbprintf( "TODO: pthread_cond_destroy() not yet implemented!\n" );
+    if ( cond->waiters != 0 ) {
+        return EBUSY;
+    }
 
     return 0;
 }
 
-int pthread_cond_wait( pthread_cond_t* cond, pthread_mutex_t* mutex ) {
+static int do_cond_wait( pthread_cond_t* cond, pthread_mutex_t* mutex, const time_t* wakeup_time ) {
     int error;
+    int owner;
+    int count;
+    int sequence;
+
+    sequence = cond->sequence;
+    atomic_add( &cond->waiters, 1 );
 
-    /* TODO */
+    /* Release the mutex. The recursion count is saved and restored
+       after the wait as the whole mutex is released here. */
 
-    error = syscall2( SYS_condition_wait, cond->cond_id, mutex->mutex_id );
+    owner = mutex->owner;
+    count = mutex->count;
 
-    if ( error < 0 ) {
-        return -error;
+    mutex->owner = 0;
+    mutex->count = 0;
+
+    if ( atomic_swap( &mutex->state, MUTEX_UNLOCKED ) == MUTEX_CONTENDED ) {
+        futex_wake( &mutex->state, 1 );
     }
 
-    return 0;
-}
+    error = futex_wait( &cond->sequence, sequence, wakeup_time );
 
-int pthread_cond_timedwait( pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime ) {
-    int error;
-    time_t wakeup_time;
+    atomic_add( &cond->waiters, -1 );
 
-    /* TODO */
+    /* Lock the mutex again. Threads woken up by a broadcast race for
+       it, so it is locked as a contended one to make sure the others
+       are woken up when it is released. */
 
-    wakeup_time = (time_t)abstime->tv_sec * 1000000 + (time_t)abstime->tv_nsec / 1000;
+    _pthread_mutex_lock_contended( mutex );
 
-    error = syscall3( SYS_condition_timedwait, cond->cond_id, mutex->mutex_id, &wakeup_time );
+    mutex->owner = owner;
+    mutex->count = count;
 
-    if ( error < 0 ) {
-        return -error;
+    if ( error == -ETIME ) {
+        return ETIMEDOUT;
     }
 
     return 0;
 }
 
-int pthread_cond_signal( pthread_cond_t* cond ) {
-    int error;
+int pthread_cond_wait( pthread_cond_t* cond, pthread_mutex_t* mutex ) {
+    return do_cond_wait( cond, mutex, NULL );
+}
+
+int pthread_cond_timedwait( pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime ) {
+    time_t wakeup_time;
+
+    wakeup_time = ( time_t )abstime->tv_sec * 1000000 + ( time_t )abstime->tv_nsec / 1000;
 
-    /* TODO */
+    return do_cond_wait( cond, mutex, &wakeup_time );
+}
 
-    error = syscall1( SYS_condition_signal, cond->cond_id );
+int pthread_cond_signal( pthread_cond_t* cond ) {
+    atomic_add( &cond->sequence, 1 );
 
-    if ( error < 0 ) {
-        return -error;
+    if ( cond->waiters > 0 ) {
+        futex_wake( &cond->sequence, 1 );
     }
 
     return 0;
 }
 
 int pthread_cond_broadcast( pthread_cond_t* cond ) {
-    int error;
-
-    /* todo */
-
-    error = syscall1( SYS_condition_broadcast, cond->cond_id );
+    atomic_add( &cond->sequence, 1 );
 
-    if ( error < 0 ) {
-        return -error;
+    if ( cond->waiters > 0 ) {
+        futex_wake( &cond->sequence, FUTEX_WAKE_ALL );
     }
 
     return 0;
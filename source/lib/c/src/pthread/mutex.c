@@ -18,100 +18,138 @@
 
 #include <pthread.h>
 #include <errno.h>
+#include <unistd.h>
 
-#include <yaosp/debug.h>
+#include <yaosp/atomic.h>
+#include <yaosp/futex.h>
 #include <yaosp/syscall.h>
 #include <yaosp/syscall_table.h>
 
+#include "pthread_int.h"
+
+/* Locking an unlocked mutex and unlocking a mutex without waiters only
+   takes a single atomic instruction. The owner is tracked only for
+   recursive and error checking mutexes, gettid() reads it from the
+   thread local data, so they don't need a system call either. */
+
+static inline int mutex_tracks_owner( pthread_mutex_t* mutex ) {
+    return ( ( mutex->type == PTHREAD_MUTEX_RECURSIVE ) ||
+             ( mutex->type == PTHREAD_MUTEX_ERRORCHECK ) );
+}
+
+void _pthread_mutex_lock_contended( pthread_mutex_t* mutex ) {
+    int state;
+
+    /* Mark the mutex as contended, so the holder will wake us up */
+
+    state = atomic_swap( &mutex->state, MUTEX_CONTENDED );
+
+    while ( state != MUTEX_UNLOCKED ) {
+        futex_wait( &mutex->state, MUTEX_CONTENDED, NULL );
+        state = atomic_swap( &mutex->state, MUTEX_CONTENDED );
+    }
+}
+
 int pthread_mutex_init( pthread_mutex_t* mutex, pthread_mutexattr_t* attr ) {
     if ( mutex == NULL ) {
         return EINVAL;
     }
 
-    mutex->mutex_id = syscall2( SYS_mutex_create, ( int )"pthread mutex", 0 );
-
-    if ( mutex->mutex_id < 0 ) {
-        return -mutex->mutex_id;
-    }
-
-    mutex->init_magic = PTHREAD_MUTEX_MAGIC;
+    mutex->state = MUTEX_UNLOCKED;
+    mutex->type = ( attr != NULL ) ? attr->type : PTHREAD_MUTEX_DEFAULT;
+    mutex->owner = 0;
+    mutex->count = 0;
 
     return 0;
 }
 
 int pthread_mutex_destroy( pthread_mutex_t* mutex ) {
-    if ( mutex->init_magic != PTHREAD_MUTEX_MAGIC ) {
-        return -1;
+    if ( mutex->state != MUTEX_UNLOCKED ) {
+        return EBUSY;
     }
 
-    syscall1( SYS_mutex_destroy, mutex->mutex_id );
-
-    mutex->mutex_id = -1;
-    mutex->init_magic = 0;
-
     return 0;
 }
 
 int pthread_mutex_lock( pthread_mutex_t* mutex ) {
-    int error;
+    int tid;
 
-    if ( mutex->init_magic != PTHREAD_MUTEX_MAGIC ) {
-        error = pthread_mutex_init( mutex, NULL );
-
-        if ( error < 0 ) {
-            return -1;
+    if ( !mutex_tracks_owner( mutex ) ) {
+        if ( atomic_cmpxchg( &mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED ) != MUTEX_UNLOCKED ) {
+            _pthread_mutex_lock_contended( mutex );
         }
+
+        return 0;
     }
 
-    error = syscall1( SYS_mutex_lock, mutex->mutex_id );
+    tid = gettid();
 
-    if ( error < 0 ) {
-        errno = error;
-        return -1;
+    if ( mutex->owner == tid ) {
+        if ( mutex->type == PTHREAD_MUTEX_ERRORCHECK ) {
+            return EDEADLK;
+        }
+
+        mutex->count++;
+
+        return 0;
+    }
+
+    if ( atomic_cmpxchg( &mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED ) != MUTEX_UNLOCKED ) {
+        _pthread_mutex_lock_contended( mutex );
     }
 
+    mutex->owner = tid;
+    mutex->count = 1;
+
     return 0;
 }
 
 int pthread_mutex_trylock( pthread_mutex_t* mutex ) {
-    int error;
-
-    if ( mutex->init_magic != PTHREAD_MUTEX_MAGIC ) {
-        error = pthread_mutex_init( mutex, NULL );
+    int tid;
 
-        if ( error < 0 ) {
-            return -1;
+    if ( !mutex_tracks_owner( mutex ) ) {
+        if ( atomic_cmpxchg( &mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED ) != MUTEX_UNLOCKED ) {
+            return EBUSY;
         }
+
+        return 0;
     }
 
-    error = syscall1( SYS_mutex_trylock, mutex->mutex_id );
+    tid = gettid();
+
+    if ( ( mutex->owner == tid ) &&
+         ( mutex->type == PTHREAD_MUTEX_RECURSIVE ) ) {
+        mutex->count++;
 
-    if ( error < 0 ) {
-        errno = error;
-        return -1;
+        return 0;
     }
 
+    if ( atomic_cmpxchg( &mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED ) != MUTEX_UNLOCKED ) {
+        return EBUSY;
+    }
+
+    mutex->owner = tid;
+    mutex->count = 1;
+
     return 0;
 }
 
 int pthread_mutex_unlock( pthread_mutex_t* mutex ) {
-    int error;
-
-    if ( mutex->init_magic != PTHREAD_MUTEX_MAGIC ) {
-        error = pthread_mutex_init( mutex, NULL );
+    if ( mutex_tracks_owner( mutex ) ) {
+        if ( mutex->owner != gettid() ) {
+            return EPERM;
+        }
 
-        if ( error < 0 ) {
-            return -1;
+        if ( --mutex->count > 0 ) {
+            return 0;
         }
-    }
 
-    error = syscall1( SYS_mutex_unlock, mutex->mutex_id );
+        mutex->owner = 0;
+    }
 
-    if ( error < 0 ) {
-        errno = error;
-        return -1;
+    if ( atomic_swap( &mutex->state, MUTEX_UNLOCKED ) == MUTEX_CONTENDED ) {
+        futex_wake( &mutex->state, 1 );
     }
 
     return 0;
 }
-
@@ -21,6 +21,7 @@
 
 int pthread_mutexattr_init( pthread_mutexattr_t* attr ) {
     attr->flags = 0;
+    attr->type = PTHREAD_MUTEX_DEFAULT;
 
     return 0;
 }
@@ -50,9 +51,9 @@ int pthread_mutexattr_getpshared( const pthread_mutexattr_t* attr, int* shared )
 }
 
 int pthread_mutexattr_gettype( const pthread_mutexattr_t* attr, int* type) {
-    /* TODO */
+    *type = attr->type;
 
-    return ENOSYS;
+    return 0;
 }
 
 int pthread_mutexattr_setprioceiling( pthread_mutexattr_t* attr, int prioceiling ) {
@@ -74,8 +75,16 @@ int pthread_mutexattr_setpshared( pthread_mutexattr_t* attr, int shared ) {
 }
 
 int pthread_mutexattr_settype( pthread_mutexattr_t* attr, int type ) {
-    /* TODO */
-
-    return ENOSYS;
+    switch ( type ) {
+        case PTHREAD_MUTEX_DEFAULT :
+        case PTHREAD_MUTEX_ERRORCHECK :
+        case PTHREAD_MUTEX_NORMAL :
+        case PTHREAD_MUTEX_RECURSIVE :
+            attr->type = type;
+            return 0;
+
+        default :
+            return EINVAL;
+    }
 }
 
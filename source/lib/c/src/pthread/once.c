@@ -18,10 +18,37 @@
 
 #include <pthread.h>
 #include <yaosp/atomic.h>
+#include <yaosp/futex.h>
+
+enum {
+    ONCE_NOT_DONE = PTHREAD_ONCE_INIT,
+    ONCE_RUNNING,
+    ONCE_DONE
+};
 
 int pthread_once(pthread_once_t* once_control, void (*init_routine)(void)) {
-    if (atomic_swap(once_control, 1) == 0) {
+    int state;
+
+    if (*(volatile pthread_once_t*)once_control == ONCE_DONE) {
+        return 0;
+    }
+
+    state = atomic_cmpxchg(once_control, ONCE_NOT_DONE, ONCE_RUNNING);
+
+    if (state == ONCE_NOT_DONE) {
         init_routine();
+
+        atomic_swap(once_control, ONCE_DONE);
+        futex_wake(once_control, FUTEX_WAKE_ALL);
+
+        return 0;
+    }
+
+    /* Another thread is running the init routine, wait for it to finish */
+
+    while (state != ONCE_DONE) {
+        futex_wait(once_control, ONCE_RUNNING, NULL);
+        state = *(volatile pthread_once_t*)once_control;
     }
 
     return 0;
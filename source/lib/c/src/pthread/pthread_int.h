@@ -0,0 +1,35 @@
+/* yaosp C library
+ *
+ * Copyright (c) 2009 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _PTHREAD_INT_H_
+#define _PTHREAD_INT_H_
+
+#include <pthread.h>
+
+/* The states of a futex based mutex */
+enum {
+    MUTEX_UNLOCKED,
+    MUTEX_LOCKED,
+    MUTEX_CONTENDED /* Locked, other threads may wait for it */
+};
+
+/* Locks the mutex through the futex slow path. The mutex is left in the
+   contended state, so the next unlock will wake up a waiter. */
+void _pthread_mutex_lock_contended( pthread_mutex_t* mutex );
+
+#endif /* _PTHREAD_INT_H_ */
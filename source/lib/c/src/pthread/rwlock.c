@@ -0,0 +1,187 @@
+/* pthread read-write lock functions
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <errno.h>
+
+#include <yaosp/futex.h>
+
+/* The state of the lock is protected by the internal futex mutex, so
+   locking and unlocking it without contention doesn't enter the kernel.
+   Readers and writers sleep on separate sequence numbers that are
+   increased before waking them up, the same way as condition variables
+   do it. Writers are preferred, readers are only woken up when no writer
+   waits for the lock. The owner of a write lock is not tracked, it would
+   cost a system call to get the thread id. */
+
+int pthread_rwlockattr_init( pthread_rwlockattr_t* attr ) {
+    attr->flags = 0;
+
+    return 0;
+}
+
+int pthread_rwlockattr_destroy( pthread_rwlockattr_t* attr ) {
+    return 0;
+}
+
+int pthread_rwlock_init( pthread_rwlock_t* rwlock, const pthread_rwlockattr_t* attr ) {
+    if ( rwlock == NULL ) {
+        return EINVAL;
+    }
+
+    pthread_mutex_init( &rwlock->mutex, NULL );
+
+    rwlock->readers = 0;
+    rwlock->writer = 0;
+    rwlock->readers_waiting = 0;
+    rwlock->writers_waiting = 0;
+    rwlock->read_sequence = 0;
+    rwlock->write_sequence = 0;
+
+    return 0;
+}
+
+int pthread_rwlock_destroy( pthread_rwlock_t* rwlock ) {
+    if ( ( rwlock->readers > 0 ) ||
+         ( rwlock->writer ) ) {
+        return EBUSY;
+    }
+
+    return 0;
+}
+
+static int do_rwlock_rdlock( pthread_rwlock_t* rwlock, int try ) {
+    int sequence;
+
+    pthread_mutex_lock( &rwlock->mutex );
+
+    while ( ( rwlock->writer ) ||
+            ( rwlock->writers_waiting > 0 ) ) {
+        if ( try ) {
+            pthread_mutex_unlock( &rwlock->mutex );
+
+            return EBUSY;
+        }
+
+        sequence = rwlock->read_sequence;
+        rwlock->readers_waiting++;
+
+        pthread_mutex_unlock( &rwlock->mutex );
+        futex_wait( &rwlock->read_sequence, sequence, NULL );
+        pthread_mutex_lock( &rwlock->mutex );
+
+        rwlock->readers_waiting--;
+    }
+
+    rwlock->readers++;
+
+    pthread_mutex_unlock( &rwlock->mutex );
+
+    return 0;
+}
+
+int pthread_rwlock_rdlock( pthread_rwlock_t* rwlock ) {
+    return do_rwlock_rdlock( rwlock, 0 );
+}
+
+int pthread_rwlock_tryrdlock( pthread_rwlock_t* rwlock ) {
+    return do_rwlock_rdlock( rwlock, 1 );
+}
+
+static int do_rwlock_wrlock( pthread_rwlock_t* rwlock, int try ) {
+    int sequence;
+
+    pthread_mutex_lock( &rwlock->mutex );
+
+    while ( ( rwlock->writer ) ||
+            ( rwlock->readers > 0 ) ) {
+        if ( try ) {
+            pthread_mutex_unlock( &rwlock->mutex );
+
+            return EBUSY;
+        }
+
+        sequence = rwlock->write_sequence;
+        rwlock->writers_waiting++;
+
+        pthread_mutex_unlock( &rwlock->mutex );
+        futex_wait( &rwlock->write_sequence, sequence, NULL );
+        pthread_mutex_lock( &rwlock->mutex );
+
+        rwlock->writers_waiting--;
+    }
+
+    rwlock->writer = 1;
+
+    pthread_mutex_unlock( &rwlock->mutex );
+
+    return 0;
+}
+
+int pthread_rwlock_wrlock( pthread_rwlock_t* rwlock ) {
+    return do_rwlock_wrlock( rwlock, 0 );
+}
+
+int pthread_rwlock_trywrlock( pthread_rwlock_t* rwlock ) {
+    return do_rwlock_wrlock( rwlock, 1 );
+}
+
+int pthread_rwlock_unlock( pthread_rwlock_t* rwlock ) {
+    int* wake_up;
+    int count;
+
+    pthread_mutex_lock( &rwlock->mutex );
+
+    if ( rwlock->writer ) {
+        rwlock->writer = 0;
+    } else if ( rwlock->readers > 0 ) {
+        rwlock->readers--;
+    } else {
+        pthread_mutex_unlock( &rwlock->mutex );
+
+        return EPERM;
+    }
+
+    wake_up = NULL;
+    count = 0;
+
+    if ( rwlock->readers == 0 ) {
+        if ( rwlock->writers_waiting > 0 ) {
+            rwlock->write_sequence++;
+
+            wake_up = &rwlock->write_sequence;
+            count = 1;
+        } else if ( rwlock->readers_waiting > 0 ) {
+            rwlock->read_sequence++;
+
+            wake_up = &rwlock->read_sequence;
+            count = FUTEX_WAKE_ALL;
+        }
+    }
+
+    pthread_mutex_unlock( &rwlock->mutex );
+
+    /* The woken up threads check the state of the lock again, so
+       it's safe to wake them up after releasing the mutex. */
+
+    if ( wake_up != NULL ) {
+        futex_wake( wake_up, count );
+    }
+
+    return 0;
+}
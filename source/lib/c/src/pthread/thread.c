@@ -18,6 +18,7 @@
 
 #include <errno.h>
 #include <pthread.h>
+#include <unistd.h>
 
 #include <yaosp/syscall.h>
 #include <yaosp/syscall_table.h>
@@ -65,3 +66,80 @@ int pthread_create( pthread_t* thread, const pthread_attr_t* attr,
 
     return 0;
 }
+
+pthread_t pthread_self( void ) {
+    pthread_t thread;
+
+    thread.thread_id = gettid();
+
+    return thread;
+}
+
+int pthread_setaffinity_np( pthread_t thread, size_t cpusetsize, const cpu_set_t* cpuset ) {
+    int error;
+
+    if ( ( cpuset == NULL ) ||
+         ( cpusetsize < sizeof( cpu_set_t ) ) ) {
+        return EINVAL;
+    }
+
+    error = syscall2( SYS_set_thread_affinity, thread.thread_id, cpuset->mask );
+
+    if ( error < 0 ) {
+        return -error;
+    }
+
+    return 0;
+}
+
+int pthread_getaffinity_np( pthread_t thread, size_t cpusetsize, cpu_set_t* cpuset ) {
+    int error;
+
+    if ( ( cpuset == NULL ) ||
+         ( cpusetsize < sizeof( cpu_set_t ) ) ) {
+        return EINVAL;
+    }
+
+    error = syscall2( SYS_get_thread_affinity, thread.thread_id, ( int )&cpuset->mask );
+
+    if ( error < 0 ) {
+        return -error;
+    }
+
+    return 0;
+}
+
+int pthread_setschedparam( pthread_t thread, int policy, const struct sched_param* param ) {
+    int error;
+
+    if ( param == NULL ) {
+        return EINVAL;
+    }
+
+    error = syscall3( SYS_sched_setscheduler, thread.thread_id, policy, param->sched_priority );
+
+    if ( error < 0 ) {
+        return -error;
+    }
+
+    return 0;
+}
+
+int pthread_getschedparam( pthread_t thread, int* policy, struct sched_param* param ) {
+    int error;
+
+    if ( ( policy == NULL ) ||
+         ( param == NULL ) ) {
+        return EINVAL;
+    }
+
+    error = syscall2( SYS_sched_getscheduler, thread.thread_id, ( int )&param->sched_priority );
+
+    if ( error < 0 ) {
+        return -error;
+    }
+
+    *policy = error;
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+/* sched functions
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <yaosp/syscall.h>
+#include <yaosp/syscall_table.h>
+
+/* The kernel schedules threads, a process id refers to the main
+   thread of the process and 0 means the calling thread. */
+
+static inline pid_t get_thread_id( pid_t pid ) {
+    if ( pid == 0 ) {
+        return gettid();
+    }
+
+    return pid;
+}
+
+int sched_setscheduler( pid_t pid, int policy, const struct sched_param* param ) {
+    int error;
+
+    if ( param == NULL ) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    error = syscall3(
+        SYS_sched_setscheduler,
+        get_thread_id( pid ),
+        policy,
+        param->sched_priority
+    );
+
+    if ( error < 0 ) {
+        errno = -error;
+        return -1;
+    }
+
+    return 0;
+}
+
+int sched_getscheduler( pid_t pid ) {
+    int error;
+    int priority;
+
+    error = syscall2( SYS_sched_getscheduler, get_thread_id( pid ), ( int )&priority );
+
+    if ( error < 0 ) {
+        errno = -error;
+        return -1;
+    }
+
+    return error;
+}
+
+int sched_setparam( pid_t pid, const struct sched_param* param ) {
+    int policy;
+
+    policy = sched_getscheduler( pid );
+
+    if ( policy < 0 ) {
+        return -1;
+    }
+
+    return sched_setscheduler( pid, policy, param );
+}
+
+int sched_getparam( pid_t pid, struct sched_param* param ) {
+    int error;
+
+    if ( param == NULL ) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    error = syscall2( SYS_sched_getscheduler, get_thread_id( pid ), ( int )&param->sched_priority );
+
+    if ( error < 0 ) {
+        errno = -error;
+        return -1;
+    }
+
+    return 0;
+}
+
+int sched_get_priority_min( int policy ) {
+    switch ( policy ) {
+        case SCHED_OTHER :
+            return 0;
+
+        case SCHED_FIFO :
+        case SCHED_RR :
+            return 1;
+
+        default :
+            errno = EINVAL;
+            return -1;
+    }
+}
+
+int sched_get_priority_max( int policy ) {
+    switch ( policy ) {
+        case SCHED_OTHER :
+            return 0;
+
+        case SCHED_FIFO :
+        case SCHED_RR :
+            return 31;
+
+        default :
+            errno = EINVAL;
+            return -1;
+    }
+}
@@ -0,0 +1,134 @@
+/* yaosp C library
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <spawn.h>
+
+#include "spawn_internal.h"
+
+static spawn_file_action_t* add_file_action( posix_spawn_file_actions_t* file_actions, int type, int fd ) {
+    spawn_file_action_t* action;
+
+    if ( file_actions->count == file_actions->allocated ) {
+        int new_size;
+        spawn_file_action_t* new_actions;
+
+        new_size = file_actions->allocated + 8;
+        new_actions = ( spawn_file_action_t* )realloc( file_actions->actions, sizeof( spawn_file_action_t ) * new_size );
+
+        if ( new_actions == NULL ) {
+            return NULL;
+        }
+
+        file_actions->actions = new_actions;
+        file_actions->allocated = new_size;
+    }
+
+    action = &file_actions->actions[ file_actions->count++ ];
+
+    memset( action, 0, sizeof( spawn_file_action_t ) );
+    action->type = type;
+    action->fd = fd;
+
+    return action;
+}
+
+int posix_spawn_file_actions_init( posix_spawn_file_actions_t* file_actions ) {
+    file_actions->count = 0;
+    file_actions->allocated = 0;
+    file_actions->actions = NULL;
+
+    return 0;
+}
+
+int posix_spawn_file_actions_destroy( posix_spawn_file_actions_t* file_actions ) {
+    int i;
+
+    for ( i = 0; i < file_actions->count; i++ ) {
+        free( file_actions->actions[ i ].path );
+    }
+
+    free( file_actions->actions );
+
+    file_actions->count = 0;
+    file_actions->allocated = 0;
+    file_actions->actions = NULL;
+
+    return 0;
+}
+
+int posix_spawn_file_actions_addopen( posix_spawn_file_actions_t* file_actions, int fd,
+                                      const char* path, int flags, mode_t mode ) {
+    char* path_copy;
+    spawn_file_action_t* action;
+
+    if ( fd < 0 ) {
+        return EBADF;
+    }
+
+    path_copy = strdup( path );
+
+    if ( path_copy == NULL ) {
+        return ENOMEM;
+    }
+
+    action = add_file_action( file_actions, SPAWN_OPEN, fd );
+
+    if ( action == NULL ) {
+        free( path_copy );
+        return ENOMEM;
+    }
+
+    action->path = path_copy;
+    action->flags = flags;
+    action->mode = mode;
+
+    return 0;
+}
+
+int posix_spawn_file_actions_addclose( posix_spawn_file_actions_t* file_actions, int fd ) {
+    if ( fd < 0 ) {
+        return EBADF;
+    }
+
+    if ( add_file_action( file_actions, SPAWN_CLOSE, fd ) == NULL ) {
+        return ENOMEM;
+    }
+
+    return 0;
+}
+
+int posix_spawn_file_actions_adddup2( posix_spawn_file_actions_t* file_actions, int fd, int new_fd ) {
+    spawn_file_action_t* action;
+
+    if ( ( fd < 0 ) || ( new_fd < 0 ) ) {
+        return EBADF;
+    }
+
+    action = add_file_action( file_actions, SPAWN_DUP2, fd );
+
+    if ( action == NULL ) {
+        return ENOMEM;
+    }
+
+    action->new_fd = new_fd;
+
+    return 0;
+}
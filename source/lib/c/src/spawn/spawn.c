@@ -0,0 +1,176 @@
+/* yaosp C library
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "spawn_internal.h"
+
+static int spawn_do_file_actions( const posix_spawn_file_actions_t* file_actions ) {
+    int i;
+    int fd;
+    spawn_file_action_t* action;
+
+    for ( i = 0; i < file_actions->count; i++ ) {
+        action = &file_actions->actions[ i ];
+
+        switch ( action->type ) {
+            case SPAWN_OPEN :
+                fd = open( action->path, action->flags, action->mode );
+
+                if ( fd < 0 ) {
+                    return errno;
+                }
+
+                if ( fd != action->fd ) {
+                    if ( dup2( fd, action->fd ) < 0 ) {
+                        return errno;
+                    }
+
+                    close( fd );
+                }
+
+                break;
+
+            case SPAWN_CLOSE :
+                close( action->fd );
+                break;
+
+            case SPAWN_DUP2 :
+                if ( dup2( action->fd, action->new_fd ) < 0 ) {
+                    return errno;
+                }
+
+                break;
+        }
+    }
+
+    return 0;
+}
+
+static int spawn_execute( const char* file, char* const argv[], char* const envp[], int use_path ) {
+    if ( use_path ) {
+        execvpe( file, argv, envp );
+    } else {
+        execve( file, argv, envp );
+    }
+
+    return errno;
+}
+
+static int spawn_child( const char* file, const posix_spawn_file_actions_t* file_actions,
+                        const posix_spawnattr_t* attr, char* const argv[], char* const envp[],
+                        int use_path, sigset_t* old_mask ) {
+    int i;
+    int error;
+
+    /* Set the requested signals to their default handler. The child
+       has its own copy of the handlers, so this doesn't affect the parent. */
+
+    if ( ( attr != NULL ) &&
+         ( attr->flags & POSIX_SPAWN_SETSIGDEF ) ) {
+        struct sigaction action;
+
+        memset( &action, 0, sizeof( struct sigaction ) );
+        action.sa_handler = SIG_DFL;
+
+        for ( i = 1; i < _NSIG; i++ ) {
+            if ( sigismember( &attr->sigdefault, i ) ) {
+                sigaction( i, &action, NULL );
+            }
+        }
+    }
+
+    if ( file_actions != NULL ) {
+        error = spawn_do_file_actions( file_actions );
+
+        if ( error != 0 ) {
+            return error;
+        }
+    }
+
+    if ( ( attr != NULL ) &&
+         ( attr->flags & POSIX_SPAWN_SETSIGMASK ) ) {
+        sigprocmask( SIG_SETMASK, &attr->sigmask, NULL );
+    } else {
+        sigprocmask( SIG_SETMASK, old_mask, NULL );
+    }
+
+    return spawn_execute( file, argv, envp, use_path );
+}
+
+static int do_posix_spawn( pid_t* pid, const char* file, const posix_spawn_file_actions_t* file_actions,
+                           const posix_spawnattr_t* attr, char* const argv[], char* const envp[],
+                           int use_path ) {
+    pid_t child;
+    sigset_t all_signals;
+    sigset_t old_mask;
+    volatile int error;
+
+    /* The child runs in our memory until it calls execve(), so all signals
+       are blocked to keep our signal handlers from running in the child. */
+
+    sigfillset( &all_signals );
+    sigprocmask( SIG_BLOCK, &all_signals, &old_mask );
+
+    error = 0;
+    child = vfork();
+
+    if ( child == 0 ) {
+        /* The error code is written to the memory of the parent, it
+           can read it after we called execve() or exited. */
+
+        error = spawn_child( file, file_actions, attr, argv, envp, use_path, &old_mask );
+
+        _exit( 127 );
+    }
+
+    sigprocmask( SIG_SETMASK, &old_mask, NULL );
+
+    if ( child < 0 ) {
+        return -child;
+    }
+
+    if ( error != 0 ) {
+        waitpid( child, NULL, 0 );
+
+        return error;
+    }
+
+    if ( pid != NULL ) {
+        *pid = child;
+    }
+
+    return 0;
+}
+
+int posix_spawn( pid_t* pid, const char* path, const posix_spawn_file_actions_t* file_actions,
+                 const posix_spawnattr_t* attr, char* const argv[], char* const envp[] ) {
+    return do_posix_spawn( pid, path, file_actions, attr, argv, envp, 0 );
+}
+
+int posix_spawnp( pid_t* pid, const char* file, const posix_spawn_file_actions_t* file_actions,
+                  const posix_spawnattr_t* attr, char* const argv[], char* const envp[] ) {
+    return do_posix_spawn( pid, file, file_actions, attr, argv, envp, 1 );
+}
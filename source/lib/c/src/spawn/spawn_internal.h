@@ -0,0 +1,39 @@
+/* yaosp C library
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SPAWN_INTERNAL_H_
+#define _SPAWN_INTERNAL_H_
+
+#include <spawn.h>
+
+enum {
+    SPAWN_OPEN,
+    SPAWN_CLOSE,
+    SPAWN_DUP2
+};
+
+typedef struct spawn_file_action {
+    int type;
+    int fd;
+    int new_fd;
+    char* path;
+    int flags;
+    mode_t mode;
+} spawn_file_action_t;
+
+#endif /* _SPAWN_INTERNAL_H_ */
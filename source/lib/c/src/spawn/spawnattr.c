@@ -0,0 +1,72 @@
+/* yaosp C library
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <spawn.h>
+
+int posix_spawnattr_init( posix_spawnattr_t* attr ) {
+    attr->flags = 0;
+    sigemptyset( &attr->sigmask );
+    sigemptyset( &attr->sigdefault );
+
+    return 0;
+}
+
+int posix_spawnattr_destroy( posix_spawnattr_t* attr ) {
+    return 0;
+}
+
+int posix_spawnattr_getflags( const posix_spawnattr_t* attr, short* flags ) {
+    *flags = attr->flags;
+
+    return 0;
+}
+
+int posix_spawnattr_setflags( posix_spawnattr_t* attr, short flags ) {
+    if ( flags & ~( POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF ) ) {
+        return EINVAL;
+    }
+
+    attr->flags = flags;
+
+    return 0;
+}
+
+int posix_spawnattr_getsigmask( const posix_spawnattr_t* attr, sigset_t* sigmask ) {
+    *sigmask = attr->sigmask;
+
+    return 0;
+}
+
+int posix_spawnattr_setsigmask( posix_spawnattr_t* attr, const sigset_t* sigmask ) {
+    attr->sigmask = *sigmask;
+
+    return 0;
+}
+
+int posix_spawnattr_getsigdefault( const posix_spawnattr_t* attr, sigset_t* sigdefault ) {
+    *sigdefault = attr->sigdefault;
+
+    return 0;
+}
+
+int posix_spawnattr_setsigdefault( posix_spawnattr_t* attr, const sigset_t* sigdefault ) {
+    attr->sigdefault = *sigdefault;
+
+    return 0;
+}
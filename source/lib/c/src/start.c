@@ -20,11 +20,15 @@
 #include <stdlib.h>
 
 #include <yaosp/debug.h>
+#include <yaosp/sysinfo.h>
 
 #define MAX_ENV_COUNT 256
 
 extern int main( int argc, char** argv, char** envp );
 
+extern void* __syscall_entry;
+extern void __syscall_sysenter( void );
+
 static int errno;
 
 int* __errno_location( void ) {
@@ -36,11 +40,27 @@ int __environ_allocated;
 
 typedef void ctor_t( void );
 
+static void init_syscall_entry( void ) {
+    processor_info_t info;
+
+    if ( get_processor_info( &info, 1 ) != 1 ) {
+        return;
+    }
+
+    if ( info.features & CPU_FEATURE_SEP ) {
+        __syscall_entry = ( void* )__syscall_sysenter;
+    }
+}
+
 void __libc_start_main( char** argv, char** envp, uint32_t ctor_count, uint32_t* ctor_list ) {
     int argc;
     int error;
     uint32_t i;
 
+    /* Use the fast system call entry if the CPU supports it */
+
+    init_syscall_entry();
+
     /* Call global constructors. */
 
     for ( i = 0; i < ctor_count; i++ ) {
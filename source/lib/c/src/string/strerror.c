@@ -63,7 +63,9 @@ static char* error_strings[] = {
     "Network is down", /* ENETDOWN */
     "Transport endpoint is not connected", /* ENOTCONN */
     "Address family not supported by protocol", /* EAFNOSUPPORT */
-    "Connection refused" /* ECONNREFUSED */
+    "Connection refused", /* ECONNREFUSED */
+    "Socket operation on non-socket", /* ENOTSOCK */
+    "Bad address" /* EFAULT */
 };
 
 char* strerror( int errnum ) {
@@ -0,0 +1,66 @@
+/* clock_gettime and clock_getres functions
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <time.h>
+#include <errno.h>
+
+#include "time_int.h"
+
+int clock_gettime( clockid_t clock_id, struct timespec* tp ) {
+    uint64_t time;
+
+    switch ( clock_id ) {
+        case CLOCK_REALTIME :
+            time = _get_system_time_ns();
+            break;
+
+        case CLOCK_MONOTONIC :
+            time = _get_system_time_ns() - _get_boot_time() * 1000;
+            break;
+
+        default :
+            errno = EINVAL;
+            return -1;
+    }
+
+    if ( tp != NULL ) {
+        tp->tv_sec = time / 1000000000;
+        tp->tv_nsec = time % 1000000000;
+    }
+
+    return 0;
+}
+
+int clock_getres( clockid_t clock_id, struct timespec* res ) {
+    switch ( clock_id ) {
+        case CLOCK_REALTIME :
+        case CLOCK_MONOTONIC :
+            break;
+
+        default :
+            errno = EINVAL;
+            return -1;
+    }
+
+    if ( res != NULL ) {
+        res->tv_sec = 0;
+        res->tv_nsec = 1;
+    }
+
+    return 0;
+}
@@ -42,4 +42,12 @@ int dayofweek(int year, int month, int day);
 /* Returns the number of days since the epoch */
 int daysdiff(int year, int month, int day);
 
+/* Return the current time and the boot time in usecs since the epoch,
+   calculated from the time page if the kernel provides it */
+uint64_t _get_system_time( void );
+uint64_t _get_boot_time( void );
+
+/* Returns the current time in nsecs since the epoch */
+uint64_t _get_system_time_ns( void );
+
 #endif // _TIME_INT_H_
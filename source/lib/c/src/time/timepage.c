@@ -0,0 +1,119 @@
+/* Time page handling
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <time.h>
+#include <yaosp/time.h>
+#include <yaosp/syscall.h>
+#include <yaosp/syscall_table.h>
+
+#include "time_int.h"
+
+static time_page_t* time_page = NULL;
+static int time_page_available = 1;
+
+static inline uint64_t rdtsc( void ) {
+    uint64_t value;
+
+    __asm__ __volatile__(
+        "rdtsc\n"
+        : "=A" ( value )
+    );
+
+    return value;
+}
+
+static inline uint64_t scale_clock( uint64_t value, uint32_t mult, int shift ) {
+    uint64_t low;
+    uint64_t high;
+
+    low = ( uint64_t )( uint32_t )value * mult;
+    high = ( value >> 32 ) * mult;
+
+    return ( low >> shift ) + ( high << ( 32 - shift ) );
+}
+
+static time_page_t* get_time_page( void ) {
+    void* address;
+
+    /* The page is asked from the kernel only once, the mapping
+       is inherited by the child processes. */
+
+    if ( ( time_page == NULL ) &&
+         ( time_page_available ) ) {
+        if ( ( syscall1( SYS_get_time_page, ( int )&address ) < 0 ) ||
+             ( ( ( time_page_t* )address )->clock_mode != TIME_PAGE_TSC ) ) {
+            time_page_available = 0;
+        } else {
+            time_page = ( time_page_t* )address;
+        }
+    }
+
+    return time_page;
+}
+
+uint64_t _get_system_time( void ) {
+    uint64_t time;
+    time_page_t* page;
+
+    page = get_time_page();
+
+    if ( page != NULL ) {
+        return scale_clock( rdtsc() - page->tsc_base, page->tsc_to_us_mult, TIME_PAGE_US_SHIFT ) + page->boot_time;
+    }
+
+    if ( syscall1( SYS_get_system_time, ( int )&time ) < 0 ) {
+        return 0;
+    }
+
+    return time;
+}
+
+uint64_t _get_system_time_ns( void ) {
+    uint64_t time;
+    time_page_t* page;
+
+    page = get_time_page();
+
+    if ( page == NULL ) {
+        return _get_system_time() * 1000;
+    }
+
+    /* Keep 10 more fraction bits than for the usecs, this way the
+       result is consistent with the one of _get_system_time() */
+
+    time = scale_clock( rdtsc() - page->tsc_base, page->tsc_to_us_mult, TIME_PAGE_US_SHIFT - 10 );
+
+    return ( ( time >> 10 ) + page->boot_time ) * 1000 + ( ( time & 1023 ) * 1000 >> 10 );
+}
+
+uint64_t _get_boot_time( void ) {
+    uint64_t time;
+    time_page_t* page;
+
+    page = get_time_page();
+
+    if ( page != NULL ) {
+        return page->boot_time;
+    }
+
+    if ( syscall1( SYS_get_boot_time, ( int )&time ) < 0 ) {
+        return 0;
+    }
+
+    return time;
+}
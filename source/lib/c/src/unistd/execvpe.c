@@ -0,0 +1,85 @@
+/* execvpe function
+ *
+ * Copyright (c) 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+
+int execvpe( const char* file, char* const argv[], char* const envp[] ) {
+    int error;
+    size_t length;
+    size_t file_length;
+    const char* path;
+    const char* separator;
+    char tmp_exec[ PATH_MAX ];
+
+    if ( *file == 0 ) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    path = getenv( "PATH" );
+
+    if ( ( path == NULL ) ||
+         ( strchr( file, '/' ) != NULL ) ) {
+        return execve( file, argv, envp );
+    }
+
+    file_length = strlen( file );
+    error = ENOENT;
+
+    do {
+        separator = strchr( path, ':' );
+
+        if ( separator == NULL ) {
+            length = strlen( path );
+        } else {
+            length = separator - path;
+        }
+
+        /* Entries that don't fit into the buffer are skipped,
+           an empty entry means the current directory */
+
+        if ( length + file_length + 2 > sizeof( tmp_exec ) ) {
+            error = ENAMETOOLONG;
+        } else {
+            if ( length == 0 ) {
+                tmp_exec[ length++ ] = '.';
+            } else {
+                memcpy( tmp_exec, path, length );
+            }
+
+            tmp_exec[ length ] = '/';
+            memcpy( tmp_exec + length + 1, file, file_length + 1 );
+
+            execve( tmp_exec, argv, envp );
+
+            if ( errno != ENOENT ) {
+                error = errno;
+            }
+        }
+
+        path = separator + 1;
+    } while ( separator != NULL );
+
+    errno = error;
+
+    return -1;
+}
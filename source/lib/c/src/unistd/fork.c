@@ -21,6 +21,16 @@
 #include <yaosp/syscall.h>
 #include <yaosp/syscall_table.h>
 
+void __gettid_reset( void );
+
 pid_t fork( void ) {
-    return syscall0( SYS_fork );
+    pid_t pid;
+
+    pid = syscall0( SYS_fork );
+
+    if ( pid == 0 ) {
+        __gettid_reset();
+    }
+
+    return pid;
 }
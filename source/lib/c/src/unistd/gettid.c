@@ -18,10 +18,46 @@
 
 #include <errno.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include <yaosp/syscall.h>
 #include <yaosp/syscall_table.h>
 
+/* The ID of the thread is cached in a thread local slot, so the pthread
+   mutexes that track their owner don't need a system call for it. The
+   slot of a new thread is zero, which is never a valid user thread ID. */
+
+static pthread_key_t tid_key = -1;
+static pthread_once_t tid_once = PTHREAD_ONCE_INIT;
+
+static void tid_key_create( void ) {
+    if ( pthread_key_create( &tid_key, NULL ) != 0 ) {
+        tid_key = -1;
+    }
+}
+
 pid_t gettid( void ) {
-    return syscall0( SYS_gettid );
+    pid_t tid;
+
+    pthread_once( &tid_once, tid_key_create );
+
+    if ( tid_key < 0 ) {
+        return syscall0( SYS_gettid );
+    }
+
+    tid = ( pid_t )pthread_getspecific( tid_key );
+
+    if ( tid == 0 ) {
+        tid = syscall0( SYS_gettid );
+        pthread_setspecific( tid_key, ( void* )tid );
+    }
+
+    return tid;
+}
+
+/* The child of fork() gets a copy of the thread local data of its parent */
+void __gettid_reset( void ) {
+    if ( tid_key >= 0 ) {
+        pthread_setspecific( tid_key, NULL );
+    }
 }
@@ -0,0 +1,24 @@
+/* vfork function
+ *
+ * Copyright (c) 2009, 2010 Zoltan Kovacs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <yaosp/syscall_table.h>
+
+/* The system call table is generated as a C enum, so the vfork() stub
+   in arch/i386/vfork.S takes the system call number from here. */
+
+const int __vfork_syscall_number = SYS_vfork;
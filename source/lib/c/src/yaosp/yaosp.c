@@ -27,3 +27,11 @@ void reboot( void ) {
 void halt( void ) {
     syscall0( SYS_shutdown );
 }
+
+int set_thread_affinity( int thread_id, uint32_t affinity ) {
+    return syscall2( SYS_set_thread_affinity, thread_id, affinity );
+}
+
+int get_thread_affinity( int thread_id, uint32_t* affinity ) {
+    return syscall2( SYS_get_thread_affinity, thread_id, ( int )affinity );
+}
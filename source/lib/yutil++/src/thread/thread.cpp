@@ -46,6 +46,14 @@ bool Thread::start( void ) {
     return true;
 }
 
+bool Thread::setAffinity( uint32_t mask ) {
+    if ( m_id < 0 ) {
+        return false;
+    }
+
+    return ( syscall2( SYS_set_thread_affinity, m_id, mask ) == 0 );
+}
+
 void Thread::starter( void* arg ) {
     Thread* t;
 